@@ -0,0 +1,68 @@
+# Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+import asyncio
+import json
+
+import triton_python_backend_utils as pb_utils
+
+
+class TritonPythonModel:
+    """Sends FANOUT concurrent BLS requests to "identity_fp32" for every
+    request and returns the output of the first one.
+    """
+
+    def initialize(self, args):
+        model_config = json.loads(args['model_config'])
+        self.fanout = int(
+            model_config['parameters']['FANOUT']['string_value'])
+
+    async def execute(self, requests):
+        responses = []
+        for request in requests:
+            input0 = pb_utils.get_input_tensor_by_name(request, "INPUT0")
+            # The identity model accepts batches, add the batch dimension.
+            bls_input = pb_utils.Tensor("INPUT0", input0.as_numpy()[None, :])
+            infer_requests = [
+                pb_utils.InferenceRequest(model_name="identity_fp32",
+                                          requested_output_names=["OUTPUT0"],
+                                          inputs=[bls_input])
+                for _ in range(self.fanout)
+            ]
+            infer_responses = await asyncio.gather(
+                *[infer_request.async_exec() for infer_request in infer_requests])
+
+            for infer_response in infer_responses:
+                if infer_response.has_error():
+                    raise pb_utils.TritonModelException(
+                        infer_response.error().message())
+
+            output0 = pb_utils.get_output_tensor_by_name(
+                infer_responses[0], "OUTPUT0")
+            responses.append(
+                pb_utils.InferenceResponse(
+                    [pb_utils.Tensor("OUTPUT0", output0.as_numpy()[0])]))
+        return responses
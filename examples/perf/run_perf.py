@@ -0,0 +1,167 @@
+# Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Runs the perf_analyzer scenarios of the Python backend against a running
+Triton server that serves ./model_repository and prints the throughput and
+the p50/p99 latency of every scenario.
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# Every scenario runs perf_analyzer on 'model'. The scenarios with a
+# 'baseline' also run the same load on the C++ backend model so that the
+# overhead of the Python backend can be compared.
+SCENARIOS = [
+    {
+        'name': 'small_tensor_high_qps',
+        'model': 'identity_fp32',
+        'baseline': 'identity_fp32_cpp',
+        'args': ['--shape', 'INPUT0:16', '--concurrency-range', '16'],
+    },
+    {
+        'name': 'large_tensor_throughput',
+        'model': 'identity_fp32',
+        'baseline': 'identity_fp32_cpp',
+        'args': ['--shape', 'INPUT0:1048576', '--concurrency-range', '4'],
+    },
+    {
+        'name': 'bls_fanout',
+        'model': 'bls_fanout',
+        'args': ['--shape', 'INPUT0:16', '--concurrency-range', '8'],
+    },
+    {
+        'name': 'decoupled_token_streaming',
+        'model': 'decoupled_stream',
+        'protocol': 'grpc',
+        'args': [
+            '--shape', 'INPUT0:1', '--concurrency-range', '8', '--streaming'
+        ],
+    },
+    {
+        'name': 'gpu_dlpack_passthrough',
+        'model': 'dlpack_gpu',
+        'args': [
+            '--shape', 'INPUT0:1048576', '--concurrency-range', '4',
+            '--shared-memory', 'cuda', '--output-shared-memory-size',
+            '4194304'
+        ],
+    },
+]
+
+
+def run_perf_analyzer(flags, model, scenario, csv_path):
+    protocol = scenario.get('protocol', flags.protocol)
+    url = flags.grpc_url if protocol == 'grpc' else flags.http_url
+    command = [
+        flags.perf_analyzer, '-m', model, '-i', protocol, '-u', url,
+        '--measurement-interval',
+        str(flags.measurement_interval), '--percentile', '99', '-f', csv_path
+    ] + scenario['args']
+    print(' '.join(command), file=sys.stderr)
+    subprocess.run(command, check=True, stdout=sys.stderr)
+
+    # perf_analyzer writes one row per concurrency, the latencies are in
+    # microseconds.
+    with open(csv_path) as csv_file:
+        row = list(csv.DictReader(csv_file))[-1]
+    return {
+        'model': model,
+        'throughput': float(row['Inferences/Second']),
+        'p50_us': float(row['p50 latency']),
+        'p99_us': float(row['p99 latency']),
+    }
+
+
+def print_summary(results):
+    header = '{:<28} {:<20} {:>12} {:>10} {:>10} {:>10}'
+    row = '{:<28} {:<20} {:>12.1f} {:>10.0f} {:>10.0f} {:>10}'
+    print(
+        header.format('scenario', 'model', 'infer/sec', 'p50 us', 'p99 us',
+                      'vs C++'))
+    for result in results:
+        for run in [result['python']] + ([result['baseline']]
+                                         if 'baseline' in result else []):
+            ratio = ''
+            if run is result['python'] and 'baseline' in result:
+                ratio = '{:.2f}x'.format(run['throughput'] /
+                                         result['baseline']['throughput'])
+            print(
+                row.format(result['name'], run['model'], run['throughput'],
+                           run['p50_us'], run['p99_us'], ratio))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--perf-analyzer',
+                        default='perf_analyzer',
+                        help='Path of the perf_analyzer binary.')
+    parser.add_argument('--http-url', default='localhost:8000')
+    parser.add_argument('--grpc-url', default='localhost:8001')
+    parser.add_argument('--protocol', default='http', choices=['http', 'grpc'])
+    parser.add_argument('--measurement-interval',
+                        type=int,
+                        default=5000,
+                        help='Measurement window in milliseconds.')
+    parser.add_argument('--scenarios',
+                        default='.*',
+                        help='Regular expression of the scenarios to run.')
+    parser.add_argument('--no-baseline',
+                        action='store_true',
+                        help='Do not run the C++ backend baseline models.')
+    parser.add_argument('--output',
+                        help='Write the results to this JSON file as well.')
+    flags = parser.parse_args()
+
+    results = []
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for scenario in SCENARIOS:
+            if not re.search(flags.scenarios, scenario['name']):
+                continue
+            result = {'name': scenario['name']}
+            csv_path = os.path.join(tmp_dir, scenario['name'] + '.csv')
+            result['python'] = run_perf_analyzer(flags, scenario['model'],
+                                                 scenario, csv_path)
+            if 'baseline' in scenario and not flags.no_baseline:
+                result['baseline'] = run_perf_analyzer(flags,
+                                                       scenario['baseline'],
+                                                       scenario, csv_path)
+            results.append(result)
+
+    print_summary(results)
+    if flags.output:
+        with open(flags.output, 'w') as output_file:
+            json.dump(results, output_file, indent=2)
+
+
+if __name__ == '__main__':
+    main()
@@ -108,7 +108,8 @@ def create_modelconfig(model_name, max_batch_size, inputs, outputs,
                        compiled_model_path, nc_start_idx, nc_end_idx,
                        threads_per_core, instance_count,
                        enable_dynamic_batching, preferred_batch_size,
-                       max_queue_delay_microseconds):
+                       max_queue_delay_microseconds,
+                       neuron_cores_per_instance=None):
     config = "name: \"{}\"\n".format(model_name)
     config += "backend: \"python\"\n"
     config += "max_batch_size: {}\n".format(max_batch_size)
@@ -154,8 +155,12 @@ instance_group [
     }}
 ]\n'''.format(instance_count)
     config += get_parameter_spec("COMPILED_MODEL", compiled_model_path)
-    config += get_parameter_spec("NEURON_CORE_START_INDEX", nc_start_idx)
-    config += get_parameter_spec("NEURON_CORE_END_INDEX", nc_end_idx)
+    if neuron_cores_per_instance is not None:
+        config += get_parameter_spec("NEURON_CORES_PER_INSTANCE",
+                                     neuron_cores_per_instance)
+    else:
+        config += get_parameter_spec("NEURON_CORE_START_INDEX", nc_start_idx)
+        config += get_parameter_spec("NEURON_CORE_END_INDEX", nc_end_idx)
     config += get_parameter_spec("NUM_THREADS_PER_CORE", threads_per_core)
     return config
 
@@ -231,8 +236,19 @@ def get_common_initialize_impl():
 
         params = model_config['parameters']
         compiled_model = params['COMPILED_MODEL']['string_value']
-        nc_start_idx = int(params['NEURON_CORE_START_INDEX']['string_value'])
-        nc_end_idx = int(params['NEURON_CORE_END_INDEX']['string_value'])
+        if 'neuron_core_range' in args:
+            # The backend has allocated the NeuronCores of this instance since
+            # the model sets NEURON_CORES_PER_INSTANCE.
+            nc_start_idx, nc_end_idx = [
+                int(i) for i in args['neuron_core_range'].split("-")
+            ]
+            os.environ["NEURON_RT_VISIBLE_CORES"] = args['neuron_core_range']
+            instance_idx = 0
+            instance_count = 1
+        else:
+            nc_start_idx = int(
+                params['NEURON_CORE_START_INDEX']['string_value'])
+            nc_end_idx = int(params['NEURON_CORE_END_INDEX']['string_value'])
         if nc_end_idx < nc_start_idx:
             raise pb_utils.TritonModelException(
                 "the neuron core end index should be greater than or equal to the start index"
@@ -727,7 +743,6 @@ if __name__ == '__main__':
         This option is not required when using tensorflow model''')
     parser.add_argument('--neuron_core_range',
                         type=str,
-                        required=True,
                         help='''The range of neuron core indices
                         where the model needs to be loaded. The
                         range should be specified in format
@@ -741,6 +756,15 @@ if __name__ == '__main__':
                         on cores 2:3, Instance2 will get loaded on
                         cores 4:5 and Instance 3 will get loaded on
                         cores 6:7''')
+    parser.add_argument('--neuron_cores_per_instance',
+                        type=int,
+                        help='''The number of neuron cores of each
+                        triton model instance. Instead of a fixed
+                        range, the python backend allocates the cores
+                        of each instance when it is loaded from the
+                        cores given by its 'neuron-core-count' option.
+                        This option can not be combined with
+                        `--neuron_core_range`.''')
     parser.add_argument('--threads_per_core',
                         type=int,
                         default=1,
@@ -780,9 +804,21 @@ if __name__ == '__main__':
         inputs, outputs = parse_tf_tensors(FLAGS.compiled_model, FLAGS.tag_set,
                                            FLAGS.signature_def_key)
 
-    nc_start_idx, nc_end_idx = [
-        int(i) for i in FLAGS.neuron_core_range.split(":")
-    ]
+    if (FLAGS.neuron_core_range is None) == (FLAGS.neuron_cores_per_instance
+                                             is None):
+        raise Exception(
+            "Exactly one of --neuron_core_range and "
+            "--neuron_cores_per_instance should be specified")
+    if FLAGS.neuron_cores_per_instance is not None:
+        if FLAGS.neuron_cores_per_instance < 1:
+            raise Exception(
+                "--neuron_cores_per_instance should be greater than or equal to 1"
+            )
+        nc_start_idx, nc_end_idx = None, None
+    else:
+        nc_start_idx, nc_end_idx = [
+            int(i) for i in FLAGS.neuron_core_range.split(":")
+        ]
 
     model_version_dir = FLAGS.triton_model_dir + "/" + str(FLAGS.model_version)
     try:
@@ -795,7 +831,8 @@ if __name__ == '__main__':
         model_name, FLAGS.max_batch_size, inputs, outputs, FLAGS.compiled_model,
         nc_start_idx, nc_end_idx, FLAGS.threads_per_core,
         FLAGS.triton_model_instance_count, FLAGS.enable_dynamic_batching,
-        FLAGS.preferred_batch_size, FLAGS.max_queue_delay_microseconds)
+        FLAGS.preferred_batch_size, FLAGS.max_queue_delay_microseconds,
+        FLAGS.neuron_cores_per_instance)
     with open(FLAGS.triton_model_dir + "/config.pbtxt", "w") as config_file:
         config_file.write(mc)
 
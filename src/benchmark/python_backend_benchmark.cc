@@ -0,0 +1,576 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Micro-benchmarks of the IPC and serialization code of the Python backend.
+// The benchmarks run without a Triton server. The benchmarks that need two
+// processes fork a child process that plays the role of the stub process and
+// opens the shared memory region like the stub does.
+//
+// Usage:
+//   triton_python_backend_benchmark [--benchmark_filter=<regex>]
+//       [--benchmark_min_time=<seconds>] [--benchmark_out=<file>]
+//
+// The results are written in the JSON format of Google Benchmark so that the
+// runs can be compared with the usual tools, e.g. `compare.py`.
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../infer_response.h"
+#include "../ipc_message.h"
+#include "../message_queue.h"
+#include "../pb_tensor.h"
+#include "../pb_utils.h"
+#include "../shm_manager.h"
+
+namespace triton { namespace backend { namespace python {
+
+namespace {
+
+constexpr size_t kShmDefaultSize = 64 * 1024 * 1024;
+constexpr size_t kShmGrowthSize = 64 * 1024 * 1024;
+constexpr uint32_t kMessageQueueSize = 1000;
+constexpr uint64_t kMaxIterations = 1000000;
+constexpr uint64_t kWarmupIterations = 10;
+
+struct BenchmarkOptions {
+  std::string filter = ".*";
+  double min_time_s = 0.5;
+  std::string out;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  uint64_t iterations;
+  double real_time_ns;
+  double cpu_time_ns;
+  double p50_ns;
+  double p99_ns;
+  double bytes_per_second;
+};
+
+class BenchmarkRunner {
+ public:
+  explicit BenchmarkRunner(const BenchmarkOptions& options)
+      : options_(options), filter_(options.filter)
+  {
+  }
+
+  // Run 'iteration' repeatedly for at least the minimum time and record the
+  // latency of every iteration. 'bytes' is the number of bytes processed by
+  // one iteration, or zero if the throughput is not reported.
+  void Run(
+      const std::string& name, uint64_t bytes,
+      const std::function<void()>& iteration)
+  {
+    for (uint64_t i = 0; i < kWarmupIterations; ++i) {
+      iteration();
+    }
+
+    std::vector<double> latencies_ns;
+    std::clock_t cpu_start = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    auto min_end =
+        start + std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::duration<double>(options_.min_time_s));
+    auto now = start;
+    while ((now < min_end || latencies_ns.size() < kWarmupIterations) &&
+           latencies_ns.size() < kMaxIterations) {
+      iteration();
+      auto end = std::chrono::steady_clock::now();
+      latencies_ns.push_back(
+          std::chrono::duration<double, std::nano>(end - now).count());
+      now = end;
+    }
+    double cpu_time_s =
+        static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    double real_time_s = std::chrono::duration<double>(now - start).count();
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = latencies_ns.size();
+    result.real_time_ns = real_time_s * 1e9 / result.iterations;
+    result.cpu_time_ns = cpu_time_s * 1e9 / result.iterations;
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    result.p50_ns = latencies_ns[latencies_ns.size() / 2];
+    result.p99_ns = latencies_ns[latencies_ns.size() * 99 / 100];
+    result.bytes_per_second =
+        real_time_s > 0 ? bytes * result.iterations / real_time_s : 0;
+    results_.push_back(result);
+
+    std::cerr << name << ": " << result.real_time_ns << " ns (p50 "
+              << result.p50_ns << " ns, p99 " << result.p99_ns << " ns, "
+              << result.iterations << " iterations)" << std::endl;
+  }
+
+  bool Enabled(const std::string& name)
+  {
+    return std::regex_search(name, filter_);
+  }
+
+  void WriteJson(std::ostream& out, const std::string& executable)
+  {
+    std::time_t now = std::time(nullptr);
+    char date[64];
+    std::strftime(date, sizeof(date), "%FT%T%z", std::localtime(&now));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"executable\": \"" << executable << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"library_build_type\": \"release\"\n  },\n"
+        << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const BenchmarkResult& result = results_[i];
+      out << (i == 0 ? "\n" : ",\n") << "    {\n"
+          << "      \"name\": \"" << result.name << "\",\n"
+          << "      \"run_name\": \"" << result.name << "\",\n"
+          << "      \"run_type\": \"iteration\",\n"
+          << "      \"iterations\": " << result.iterations << ",\n"
+          << "      \"real_time\": " << result.real_time_ns << ",\n"
+          << "      \"cpu_time\": " << result.cpu_time_ns << ",\n"
+          << "      \"time_unit\": \"ns\",\n"
+          << "      \"p50_time\": " << result.p50_ns << ",\n"
+          << "      \"p99_time\": " << result.p99_ns;
+      if (result.bytes_per_second > 0) {
+        out << ",\n      \"bytes_per_second\": " << result.bytes_per_second;
+      }
+      out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+ private:
+  const BenchmarkOptions& options_;
+  std::regex filter_;
+  std::vector<BenchmarkResult> results_;
+};
+
+// Start a child process that opens the shared memory region and runs
+// 'child_main'. The child exits with '_exit' so that it does not run the
+// destructors of the objects copied from the parent process, such as the
+// thread caches of the parent's shared memory manager.
+pid_t
+ForkChild(
+    const std::string& shm_region_name,
+    const std::function<void(std::unique_ptr<SharedMemoryManager>&)>&
+        child_main)
+{
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw PythonBackendException("Failed to fork the benchmark process.");
+  }
+
+  if (pid == 0) {
+    int status = 0;
+    try {
+      std::unique_ptr<SharedMemoryManager> shm_pool =
+          std::make_unique<SharedMemoryManager>(
+              shm_region_name, kShmDefaultSize, kShmGrowthSize,
+              false /* create */);
+      child_main(shm_pool);
+    }
+    catch (const PythonBackendException& pb_exception) {
+      std::cerr << "Benchmark child process failed: " << pb_exception.what()
+                << std::endl;
+      status = 1;
+    }
+    _exit(status);
+  }
+
+  return pid;
+}
+
+void
+WaitForChild(pid_t pid)
+{
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    throw PythonBackendException("The benchmark child process failed.");
+  }
+}
+
+std::string
+ShapeName(const std::vector<int64_t>& dims)
+{
+  std::stringstream name;
+  for (size_t i = 0; i < dims.size(); ++i) {
+    name << (i == 0 ? "" : "x") << dims[i];
+  }
+  return name.str();
+}
+
+// Create the data of a tensor. BYTES tensors are serialized as 4-byte lengths
+// followed by the elements, each element being 'element_size' bytes long.
+std::vector<char>
+TensorData(
+    TRITONSERVER_DataType dtype, const std::vector<int64_t>& dims,
+    size_t element_size)
+{
+  int64_t element_count = 1;
+  for (int64_t dim : dims) {
+    element_count *= dim;
+  }
+
+  std::vector<char> data;
+  if (dtype == TRITONSERVER_TYPE_BYTES) {
+    std::string element(element_size, 'x');
+    uint32_t length = element_size;
+    for (int64_t i = 0; i < element_count; ++i) {
+      const char* length_ptr = reinterpret_cast<const char*>(&length);
+      data.insert(data.end(), length_ptr, length_ptr + sizeof(uint32_t));
+      data.insert(data.end(), element.begin(), element.end());
+    }
+  } else {
+    data.resize(element_count * TRITONSERVER_DataTypeByteSize(dtype), 1);
+  }
+  return data;
+}
+
+void
+BenchmarkMessageQueue(
+    BenchmarkRunner& runner, std::unique_ptr<SharedMemoryManager>& shm_pool)
+{
+  for (bool spsc : {false, true}) {
+    std::string name =
+        "BM_MessageQueuePushPop/spsc:" + std::to_string(spsc ? 1 : 0);
+    if (!runner.Enabled(name)) {
+      continue;
+    }
+    auto queue = MessageQueue<bi::managed_external_buffer::handle_t>::Create(
+        shm_pool, kMessageQueueSize, spsc);
+    runner.Run(name, 0, [&queue] {
+      queue->Push(1);
+      queue->Pop();
+    });
+  }
+}
+
+void
+BenchmarkMessageQueuePingPong(
+    BenchmarkRunner& runner, std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const std::string& shm_region_name)
+{
+  for (bool spsc : {false, true}) {
+    for (uint64_t spin_wait_us : {0, 50}) {
+      std::string name =
+          "BM_MessageQueuePingPong/spsc:" + std::to_string(spsc ? 1 : 0) +
+          "/spin_us:" + std::to_string(spin_wait_us);
+      if (!runner.Enabled(name)) {
+        continue;
+      }
+
+      auto request_queue =
+          MessageQueue<bi::managed_external_buffer::handle_t>::Create(
+              shm_pool, kMessageQueueSize, spsc);
+      auto response_queue =
+          MessageQueue<bi::managed_external_buffer::handle_t>::Create(
+              shm_pool, kMessageQueueSize, spsc);
+      request_queue->SetSpinWait(spin_wait_us);
+      response_queue->SetSpinWait(spin_wait_us);
+      bi::managed_external_buffer::handle_t request_handle =
+          request_queue->ShmHandle();
+      bi::managed_external_buffer::handle_t response_handle =
+          response_queue->ShmHandle();
+
+      // The child echoes the messages until it receives zero.
+      pid_t pid = ForkChild(
+          shm_region_name, [request_handle, response_handle](
+                               std::unique_ptr<SharedMemoryManager>& pool) {
+            auto requests =
+                MessageQueue<bi::managed_external_buffer::handle_t>::
+                    LoadFromSharedMemory(pool, request_handle);
+            auto responses =
+                MessageQueue<bi::managed_external_buffer::handle_t>::
+                    LoadFromSharedMemory(pool, response_handle);
+            while (true) {
+              bi::managed_external_buffer::handle_t message = requests->Pop();
+              responses->Push(message);
+              if (message == 0) {
+                break;
+              }
+            }
+          });
+
+      runner.Run(name, 0, [&request_queue, &response_queue] {
+        request_queue->Push(1);
+        response_queue->Pop();
+      });
+      request_queue->Push(0);
+      response_queue->Pop();
+      WaitForChild(pid);
+    }
+  }
+}
+
+void
+BenchmarkAllocator(
+    BenchmarkRunner& runner, std::unique_ptr<SharedMemoryManager>& shm_pool)
+{
+  // The first four sizes fall into the slab size classes once the ownership
+  // header is added.
+  for (uint64_t byte_size :
+       {16, 100, 200, 400, 4096, 64 * 1024, 1024 * 1024}) {
+    std::string name = "BM_ShmAllocate/" + std::to_string(byte_size);
+    if (!runner.Enabled(name)) {
+      continue;
+    }
+    runner.Run(name, 0, [&shm_pool, byte_size] {
+      AllocatedSharedMemory<char> memory =
+          shm_pool->Construct<char>(byte_size);
+    });
+  }
+}
+
+struct TensorCase {
+  TRITONSERVER_DataType dtype;
+  std::vector<int64_t> dims;
+  size_t element_size;
+};
+
+void
+BenchmarkTensor(
+    BenchmarkRunner& runner, std::unique_ptr<SharedMemoryManager>& shm_pool)
+{
+  std::vector<TensorCase> cases{
+      {TRITONSERVER_TYPE_FP32, {1}, 0},
+      {TRITONSERVER_TYPE_FP32, {1, 1024}, 0},
+      {TRITONSERVER_TYPE_FP32, {1024, 1024}, 0},
+      {TRITONSERVER_TYPE_INT64, {64, 1024}, 0},
+      {TRITONSERVER_TYPE_BYTES, {1024}, 16},
+      {TRITONSERVER_TYPE_BYTES, {64}, 4096}};
+
+  for (const TensorCase& tensor_case : cases) {
+    std::string name = std::string("BM_TensorSaveLoad/") +
+                       TRITONSERVER_DataTypeString(tensor_case.dtype) + "/" +
+                       ShapeName(tensor_case.dims);
+    if (tensor_case.dtype == TRITONSERVER_TYPE_BYTES) {
+      name += "/element:" + std::to_string(tensor_case.element_size);
+    }
+    if (!runner.Enabled(name)) {
+      continue;
+    }
+
+    std::vector<char> data = TensorData(
+        tensor_case.dtype, tensor_case.dims, tensor_case.element_size);
+    runner.Run(name, data.size(), [&shm_pool, &tensor_case, &data] {
+      PbTensor tensor(
+          "INPUT0", tensor_case.dims, tensor_case.dtype,
+          TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, data.data(),
+          data.size());
+      tensor.SaveToSharedMemory(shm_pool, false /* copy_gpu */);
+      std::unique_ptr<PbTensor> loaded_tensor = PbTensor::LoadFromSharedMemory(
+          shm_pool, tensor.ShmHandle(), false /* open_cuda_handle */);
+    });
+  }
+}
+
+// The child process loads the input tensor of every execute request and
+// returns a response with a copy of it, like an identity model.
+void
+EchoExecuteRequests(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    bi::managed_external_buffer::handle_t request_handle,
+    bi::managed_external_buffer::handle_t response_handle)
+{
+  auto requests =
+      MessageQueue<bi::managed_external_buffer::handle_t>::LoadFromSharedMemory(
+          shm_pool, request_handle);
+  auto responses =
+      MessageQueue<bi::managed_external_buffer::handle_t>::LoadFromSharedMemory(
+          shm_pool, response_handle);
+  while (true) {
+    std::unique_ptr<IPCMessage> request_message =
+        IPCMessage::LoadFromSharedMemory(shm_pool, requests->Pop());
+    if (request_message->Command() == PYTHONSTUB_FinalizeRequest) {
+      break;
+    }
+
+    std::shared_ptr<PbTensor> input = PbTensor::LoadFromSharedMemory(
+        shm_pool, request_message->Args(), false /* open_cuda_handle */);
+    std::shared_ptr<PbTensor> output = std::make_shared<PbTensor>(
+        "OUTPUT0", input->Dims(), input->TritonDtype(),
+        TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, input->DataPtr(),
+        input->ByteSize());
+    InferResponse response({output});
+    response.SaveToSharedMemory(shm_pool, false /* copy_gpu */);
+
+    std::unique_ptr<IPCMessage> response_message =
+        IPCMessage::Create(shm_pool, false /* inline_response */);
+    response_message->Command() = PYTHONSTUB_ExecuteResponse;
+    response_message->Args() = response.ShmHandle();
+    responses->Push(response_message->ShmHandle());
+
+    // Like the stub process, keep the response alive until the parent
+    // process has loaded it.
+    requests->Pop();
+  }
+}
+
+void
+BenchmarkExecuteRoundTrip(
+    BenchmarkRunner& runner, std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const std::string& shm_region_name)
+{
+  std::vector<std::vector<int64_t>> shapes{{1, 16}, {1, 1024}, {1024, 1024}};
+  for (const std::vector<int64_t>& dims : shapes) {
+    std::string name = "BM_ExecuteRoundTrip/FP32/" + ShapeName(dims);
+    if (!runner.Enabled(name)) {
+      continue;
+    }
+
+    auto request_queue =
+        MessageQueue<bi::managed_external_buffer::handle_t>::Create(
+            shm_pool, kMessageQueueSize);
+    auto response_queue =
+        MessageQueue<bi::managed_external_buffer::handle_t>::Create(
+            shm_pool, kMessageQueueSize);
+    bi::managed_external_buffer::handle_t request_handle =
+        request_queue->ShmHandle();
+    bi::managed_external_buffer::handle_t response_handle =
+        response_queue->ShmHandle();
+    pid_t pid = ForkChild(
+        shm_region_name, [request_handle, response_handle](
+                             std::unique_ptr<SharedMemoryManager>& pool) {
+          EchoExecuteRequests(pool, request_handle, response_handle);
+        });
+
+    std::vector<char> data = TensorData(TRITONSERVER_TYPE_FP32, dims, 0);
+    runner.Run(
+        name, data.size(),
+        [&shm_pool, &request_queue, &response_queue, &dims, &data] {
+          PbTensor input(
+              "INPUT0", dims, TRITONSERVER_TYPE_FP32, TRITONSERVER_MEMORY_CPU,
+              0 /* memory_type_id */, data.data(), data.size());
+          input.SaveToSharedMemory(shm_pool, false /* copy_gpu */);
+          std::unique_ptr<IPCMessage> request_message =
+              IPCMessage::Create(shm_pool, false /* inline_response */);
+          request_message->Command() = PYTHONSTUB_ExecuteRequest;
+          request_message->Args() = input.ShmHandle();
+          request_queue->Push(request_message->ShmHandle());
+
+          std::unique_ptr<IPCMessage> response_message =
+              IPCMessage::LoadFromSharedMemory(shm_pool, response_queue->Pop());
+          std::unique_ptr<InferResponse> response =
+              InferResponse::LoadFromSharedMemory(
+                  shm_pool, response_message->Args(),
+                  false /* open_cuda_handle */);
+          request_queue->Push(DUMMY_MESSAGE);
+        });
+
+    std::unique_ptr<IPCMessage> finalize_message =
+        IPCMessage::Create(shm_pool, false /* inline_response */);
+    finalize_message->Command() = PYTHONSTUB_FinalizeRequest;
+    request_queue->Push(finalize_message->ShmHandle());
+    WaitForChild(pid);
+  }
+}
+
+bool
+ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+{
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::string::size_type separator = arg.find('=');
+    std::string key = arg.substr(0, separator);
+    std::string value =
+        separator == std::string::npos ? "" : arg.substr(separator + 1);
+    if (key == "--benchmark_filter") {
+      options.filter = value;
+    } else if (key == "--benchmark_min_time") {
+      options.min_time_s = std::stod(value);
+    } else if (key == "--benchmark_out") {
+      options.out = value;
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--benchmark_filter=<regex>]"
+                   " [--benchmark_min_time=<seconds>]"
+                   " [--benchmark_out=<file>]"
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int
+RunBenchmarks(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, options)) {
+    return 1;
+  }
+
+  BenchmarkRunner runner(options);
+  std::string shm_region_name =
+      "triton_python_backend_benchmark_" + std::to_string(getpid());
+  try {
+    std::unique_ptr<SharedMemoryManager> shm_pool =
+        std::make_unique<SharedMemoryManager>(
+            shm_region_name, kShmDefaultSize, kShmGrowthSize,
+            true /* create */);
+    BenchmarkMessageQueue(runner, shm_pool);
+    BenchmarkMessageQueuePingPong(runner, shm_pool, shm_region_name);
+    BenchmarkAllocator(runner, shm_pool);
+    BenchmarkTensor(runner, shm_pool);
+    BenchmarkExecuteRoundTrip(runner, shm_pool, shm_region_name);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    std::cerr << "Benchmark failed: " << pb_exception.what() << std::endl;
+    return 1;
+  }
+
+  if (options.out.empty()) {
+    runner.WriteJson(std::cout, argv[0]);
+  } else {
+    std::ofstream out(options.out);
+    runner.WriteJson(out, argv[0]);
+  }
+  return 0;
+}
+
+}}}  // namespace triton::backend::python
+
+int
+main(int argc, char** argv)
+{
+  return triton::backend::python::RunBenchmarks(argc, argv);
+}
@@ -0,0 +1,239 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "cuda_shared_pool.h"
+
+#ifdef TRITON_ENABLE_GPU
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+#include "pb_utils.h"
+
+namespace triton { namespace backend { namespace python {
+
+namespace {
+
+// The alignment of the buffers allocated from the pool, the same as the
+// alignment of the buffers returned by cudaMalloc.
+constexpr uint64_t kCudaSharedPoolAlignment = 256;
+
+}  // namespace
+
+std::mutex CudaSharedPool::registry_mu_;
+std::unordered_map<int32_t, std::shared_ptr<CudaSharedPool>>
+    CudaSharedPool::registry_;
+
+CudaSharedPool::CudaSharedPool(
+    int32_t device, uint64_t byte_size, char* base, bool is_owner)
+    : device_(device), byte_size_(byte_size), base_(base),
+      is_owner_(is_owner)
+{
+  if (is_owner_) {
+    free_ranges_.emplace(0, byte_size_);
+  }
+}
+
+std::shared_ptr<CudaSharedPool>
+CudaSharedPool::Create(int32_t device, uint64_t byte_size)
+{
+  THROW_IF_CUDA_ERROR(cudaSetDevice(device));
+  void* base;
+  THROW_IF_CUDA_ERROR(cudaMalloc(&base, byte_size));
+  std::shared_ptr<CudaSharedPool> pool(new CudaSharedPool(
+      device, byte_size, reinterpret_cast<char*>(base), true /* is_owner */));
+  THROW_IF_CUDA_ERROR(cudaIpcGetMemHandle(&pool->ipc_handle_, base));
+
+  return pool;
+}
+
+std::shared_ptr<CudaSharedPool>
+CudaSharedPool::Open(
+    int32_t device, uint64_t byte_size, const std::string& ipc_handle)
+{
+  cudaIpcMemHandle_t handle;
+  if (ipc_handle.size() != 2 * sizeof(handle)) {
+    throw PythonBackendException(
+        "Invalid CUDA IPC handle of the shared pool of device " +
+        std::to_string(device) + ".");
+  }
+  unsigned char* handle_bytes = reinterpret_cast<unsigned char*>(&handle);
+  for (size_t i = 0; i < sizeof(handle); ++i) {
+    handle_bytes[i] = static_cast<unsigned char>(
+        std::stoul(ipc_handle.substr(2 * i, 2), nullptr, 16));
+  }
+
+  THROW_IF_CUDA_ERROR(cudaSetDevice(device));
+  void* base;
+  THROW_IF_CUDA_ERROR(
+      cudaIpcOpenMemHandle(&base, handle, cudaIpcMemLazyEnablePeerAccess));
+  std::shared_ptr<CudaSharedPool> pool(new CudaSharedPool(
+      device, byte_size, reinterpret_cast<char*>(base),
+      false /* is_owner */));
+  pool->ipc_handle_ = handle;
+
+  return pool;
+}
+
+std::shared_ptr<CudaSharedPool>
+CudaSharedPool::GetOrCreate(int32_t device, uint64_t byte_size)
+{
+  std::lock_guard<std::mutex> lock{registry_mu_};
+  auto it = registry_.find(device);
+  if (it != registry_.end()) {
+    return it->second;
+  }
+
+  std::shared_ptr<CudaSharedPool> pool = Create(device, byte_size);
+  registry_.emplace(device, pool);
+  return pool;
+}
+
+void
+CudaSharedPool::Register(const std::shared_ptr<CudaSharedPool>& pool)
+{
+  std::lock_guard<std::mutex> lock{registry_mu_};
+  registry_[pool->DeviceId()] = pool;
+}
+
+CudaSharedPool*
+CudaSharedPool::Find(int32_t device)
+{
+  std::lock_guard<std::mutex> lock{registry_mu_};
+  auto it = registry_.find(device);
+  if (it == registry_.end()) {
+    return nullptr;
+  }
+
+  return it->second.get();
+}
+
+CudaSharedPool*
+CudaSharedPool::FindByAddress(const void* address)
+{
+  std::lock_guard<std::mutex> lock{registry_mu_};
+  for (auto& pool : registry_) {
+    if (pool.second->Contains(address)) {
+      return pool.second.get();
+    }
+  }
+
+  return nullptr;
+}
+
+void*
+CudaSharedPool::Allocate(uint64_t byte_size)
+{
+  if (!is_owner_ || byte_size == 0) {
+    return nullptr;
+  }
+
+  byte_size = (byte_size + kCudaSharedPoolAlignment - 1) /
+              kCudaSharedPoolAlignment * kCudaSharedPoolAlignment;
+
+  std::lock_guard<std::mutex> lock{mu_};
+  for (auto it = free_ranges_.begin(); it != free_ranges_.end(); ++it) {
+    if (it->second < byte_size) {
+      continue;
+    }
+
+    uint64_t offset = it->first;
+    uint64_t remaining_byte_size = it->second - byte_size;
+    free_ranges_.erase(it);
+    if (remaining_byte_size > 0) {
+      free_ranges_.emplace(offset + byte_size, remaining_byte_size);
+    }
+    allocated_ranges_.emplace(offset, byte_size);
+
+    return base_ + offset;
+  }
+
+  return nullptr;
+}
+
+void
+CudaSharedPool::Free(void* buffer)
+{
+  std::lock_guard<std::mutex> lock{mu_};
+  uint64_t offset = reinterpret_cast<char*>(buffer) - base_;
+  auto allocated = allocated_ranges_.find(offset);
+  if (allocated == allocated_ranges_.end()) {
+    return;
+  }
+
+  uint64_t byte_size = allocated->second;
+  allocated_ranges_.erase(allocated);
+
+  // Merge the range with the adjacent free ranges.
+  auto next = free_ranges_.lower_bound(offset);
+  if (next != free_ranges_.end() && offset + byte_size == next->first) {
+    byte_size += next->second;
+    next = free_ranges_.erase(next);
+  }
+  if (next != free_ranges_.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += byte_size;
+      return;
+    }
+  }
+  free_ranges_.emplace(offset, byte_size);
+}
+
+std::string
+CudaSharedPool::IpcHandleString() const
+{
+  std::stringstream ss;
+  const unsigned char* handle_bytes =
+      reinterpret_cast<const unsigned char*>(&ipc_handle_);
+  for (size_t i = 0; i < sizeof(ipc_handle_); ++i) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<unsigned int>(handle_bytes[i]);
+  }
+
+  return ss.str();
+}
+
+bool
+CudaSharedPool::Contains(const void* address) const
+{
+  const char* ptr = reinterpret_cast<const char*>(address);
+  return ptr >= base_ && ptr < base_ + byte_size_;
+}
+
+CudaSharedPool::~CudaSharedPool()
+{
+  // The errors are ignored as the pools are released when the process exits
+  // and the CUDA driver may already be shut down.
+  if (is_owner_) {
+    cudaFree(base_);
+  } else {
+    cudaIpcCloseMemHandle(base_);
+  }
+}
+
+}}}  // namespace triton::backend::python
+#endif  // TRITON_ENABLE_GPU
@@ -0,0 +1,117 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#ifdef TRITON_ENABLE_GPU
+#include <cuda_runtime_api.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace triton { namespace backend { namespace python {
+
+/// A device allocation that is shared with the stub processes through a
+/// single CUDA IPC handle. The stub processes open the handle once when they
+/// are initialized so that the tensors allocated from the pool are passed
+/// between the processes as an offset from the base address, without opening
+/// a CUDA IPC handle per tensor.
+class CudaSharedPool {
+ public:
+  /// Allocate a pool of 'byte_size' bytes on 'device'. Only the process that
+  /// creates the pool can allocate from it.
+  /// \throws PythonBackendException if the allocation fails.
+  static std::shared_ptr<CudaSharedPool> Create(
+      int32_t device, uint64_t byte_size);
+
+  /// Open a pool created by another process.
+  /// \param ipc_handle The serialized handle returned by 'IpcHandleString'.
+  /// \throws PythonBackendException if the handle can't be opened.
+  static std::shared_ptr<CudaSharedPool> Open(
+      int32_t device, uint64_t byte_size, const std::string& ipc_handle);
+
+  /// Get the pool of 'device', creating it if this process doesn't have one.
+  static std::shared_ptr<CudaSharedPool> GetOrCreate(
+      int32_t device, uint64_t byte_size);
+
+  /// Make the pool available to 'Find' and 'FindByAddress'.
+  static void Register(const std::shared_ptr<CudaSharedPool>& pool);
+
+  /// Get the pool of 'device'.
+  /// \return The pool, or nullptr if this process doesn't have one.
+  static CudaSharedPool* Find(int32_t device);
+
+  /// Get the pool that contains 'address'.
+  /// \return The pool, or nullptr if the address is not in a pool.
+  static CudaSharedPool* FindByAddress(const void* address);
+
+  /// Allocate 'byte_size' bytes from the pool.
+  /// \return The allocated buffer, or nullptr if the pool is exhausted or
+  /// was opened from another process.
+  void* Allocate(uint64_t byte_size);
+
+  /// Return a buffer returned by 'Allocate' to the pool.
+  void Free(void* buffer);
+
+  char* Base() const { return base_; }
+  int32_t DeviceId() const { return device_; }
+  uint64_t ByteSize() const { return byte_size_; }
+  const cudaIpcMemHandle_t& IpcHandle() const { return ipc_handle_; }
+
+  /// Get the CUDA IPC handle of the pool as a string that can be passed to
+  /// the stub processes.
+  std::string IpcHandleString() const;
+
+  bool Contains(const void* address) const;
+
+  ~CudaSharedPool();
+
+ private:
+  CudaSharedPool(
+      int32_t device, uint64_t byte_size, char* base, bool is_owner);
+
+  static std::mutex registry_mu_;
+  static std::unordered_map<int32_t, std::shared_ptr<CudaSharedPool>>
+      registry_;
+
+  int32_t device_;
+  uint64_t byte_size_;
+  char* base_;
+  bool is_owner_;
+  cudaIpcMemHandle_t ipc_handle_;
+
+  // The free ranges of the pool as offset -> byte size, and the allocated
+  // ranges as offset -> byte size. Only used by the owner of the pool.
+  std::mutex mu_;
+  std::map<uint64_t, uint64_t> free_ranges_;
+  std::unordered_map<uint64_t, uint64_t> allocated_ranges_;
+};
+
+}}}  // namespace triton::backend::python
+#endif  // TRITON_ENABLE_GPU
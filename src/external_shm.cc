@@ -0,0 +1,288 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "external_shm.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "pb_exception.h"
+
+namespace triton { namespace backend { namespace python {
+
+namespace {
+
+constexpr std::size_t kExternalShmMaxMappings = 16;
+const char kDevShmPrefix[] = "/dev/shm/";
+
+// Age after which the buffers that are not found in the snapshot of the maps
+// as shared memory objects are looked up again, since the snapshot may miss
+// the objects that were mapped after it was taken.
+constexpr std::chrono::seconds kProcMapsSnapshotTtl{1};
+
+struct ProcMapsEntry {
+  uintptr_t start;
+  uintptr_t end;
+  uint64_t offset;
+  uint64_t inode;
+  std::string path;
+};
+
+bool
+ParseProcMapsLine(const std::string& line, ProcMapsEntry* entry)
+{
+  std::istringstream stream(line);
+  std::string range, perms, offset, dev;
+  if (!(stream >> range >> perms >> offset >> dev >> entry->inode)) {
+    return false;
+  }
+  std::getline(stream >> std::ws, entry->path);
+
+  std::size_t dash = range.find('-');
+  if (dash == std::string::npos) {
+    return false;
+  }
+  entry->start = std::stoull(range.substr(0, dash), nullptr, 16);
+  entry->end = std::stoull(range.substr(dash + 1), nullptr, 16);
+  entry->offset = std::stoull(offset, nullptr, 16);
+  return true;
+}
+
+// Snapshot of '/proc/self/maps'. Reading the maps is linear in the number of
+// mappings, so it is only done when a buffer can't be resolved from the
+// snapshot.
+struct ProcMapsSnapshot {
+  static ProcMapsSnapshot& GetInstance()
+  {
+    static ProcMapsSnapshot* snapshot = new ProcMapsSnapshot;
+    return *snapshot;
+  }
+
+  void Read()
+  {
+    entries.clear();
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    ProcMapsEntry entry;
+    while (std::getline(maps, line)) {
+      if (ParseProcMapsLine(line, &entry)) {
+        entries.push_back(entry);
+      }
+    }
+    read_time = std::chrono::steady_clock::now();
+  }
+
+  std::mutex mu;
+  // Sorted by address, like the maps.
+  std::vector<ProcMapsEntry> entries;
+  std::chrono::steady_clock::time_point read_time;
+};
+
+// Whether the mapping of the snapshot entry still maps the same object. The
+// address range may have been unmapped and reused by another mapping since
+// the snapshot was taken. The link of the range in 'map_files' only exists
+// while a file is mapped at exactly that range.
+bool
+IsStillMapped(const ProcMapsEntry& entry)
+{
+  char path[64];
+  snprintf(
+      path, sizeof(path), "/proc/self/map_files/%lx-%lx",
+      static_cast<unsigned long>(entry.start),
+      static_cast<unsigned long>(entry.end));
+  struct stat object_stat;
+  return stat(path, &object_stat) == 0 &&
+         static_cast<uint64_t>(object_stat.st_ino) == entry.inode;
+}
+
+enum class ResolveResult { kFound, kNotFound, kStale };
+
+// Look up the buffer in the snapshot. kStale if the snapshot may be out of
+// date for the buffer, in which case the maps must be read again. The entries
+// used are only validated if 'validate' is set, since a snapshot that was just
+// read is up to date and 'map_files' may not be accessible.
+ResolveResult
+Resolve(
+    const std::vector<ProcMapsEntry>& entries, const void* ptr,
+    uint64_t byte_size, bool validate, ExternalShmLocation* location)
+{
+  uintptr_t start = reinterpret_cast<uintptr_t>(ptr);
+  uintptr_t end = start + byte_size;
+  auto entry = std::upper_bound(
+      entries.begin(), entries.end(), start,
+      [](uintptr_t address, const ProcMapsEntry& entry) {
+        return address < entry.end;
+      });
+  if (entry == entries.end() || start < entry->start) {
+    return ResolveResult::kStale;
+  }
+
+  // Objects that were removed cannot be opened by name.
+  if (entry->path.compare(0, sizeof(kDevShmPrefix) - 1, kDevShmPrefix) != 0 ||
+      entry->path.find(" (deleted)") != std::string::npos) {
+    return ResolveResult::kNotFound;
+  }
+  location->name = "/" + entry->path.substr(sizeof(kDevShmPrefix) - 1);
+  location->inode = entry->inode;
+  location->offset = entry->offset + (start - entry->start);
+
+  // A single mapping can be split into several entries, for example by
+  // 'madvise'. The entries must be contiguous in both the address space and
+  // the object.
+  uintptr_t covered_end = entry->start;
+  uint64_t next_offset = entry->offset;
+  for (; entry != entries.end(); ++entry) {
+    if (entry->start != covered_end || entry->inode != location->inode ||
+        entry->offset != next_offset) {
+      return ResolveResult::kNotFound;
+    }
+    if (validate && !IsStillMapped(*entry)) {
+      return ResolveResult::kStale;
+    }
+
+    covered_end = entry->end;
+    next_offset = entry->offset + (entry->end - entry->start);
+    if (end <= covered_end) {
+      return ResolveResult::kFound;
+    }
+  }
+
+  return ResolveResult::kStale;
+}
+
+}  // namespace
+
+bool
+FindExternalShm(
+    const void* ptr, uint64_t byte_size, ExternalShmLocation* location)
+{
+  ProcMapsSnapshot& snapshot = ProcMapsSnapshot::GetInstance();
+  std::lock_guard<std::mutex> lock{snapshot.mu};
+  bool is_fresh = false;
+  if (snapshot.entries.empty() ||
+      std::chrono::steady_clock::now() - snapshot.read_time >
+          kProcMapsSnapshotTtl) {
+    snapshot.Read();
+    is_fresh = true;
+  }
+
+  ResolveResult result =
+      Resolve(snapshot.entries, ptr, byte_size, !is_fresh, location);
+  if (result == ResolveResult::kStale && !is_fresh) {
+    snapshot.Read();
+    result = Resolve(
+        snapshot.entries, ptr, byte_size, false /* validate */, location);
+  }
+
+  return result == ResolveResult::kFound;
+}
+
+ExternalShmMappings&
+ExternalShmMappings::GetInstance()
+{
+  static ExternalShmMappings instance;
+  return instance;
+}
+
+std::shared_ptr<char>
+ExternalShmMappings::Map(
+    const std::string& name, uint64_t inode, uint64_t offset,
+    uint64_t byte_size)
+{
+  std::lock_guard<std::mutex> lock{mu_};
+  for (auto it = mappings_.begin(); it != mappings_.end(); ++it) {
+    if (it->name == name && it->inode == inode &&
+        offset + byte_size <= it->byte_size) {
+      std::shared_ptr<char> base = it->base;
+      if (it != mappings_.begin()) {
+        std::rotate(mappings_.begin(), it, it + 1);
+      }
+      return std::shared_ptr<char>(base, base.get() + offset);
+    }
+  }
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    throw PythonBackendException(
+        "Failed to open shared memory object '" + name +
+        "': " + std::strerror(errno));
+  }
+
+  struct stat object_stat;
+  if (fstat(fd, &object_stat) == -1) {
+    close(fd);
+    throw PythonBackendException(
+        "Failed to get the size of shared memory object '" + name +
+        "': " + std::strerror(errno));
+  }
+  if (static_cast<uint64_t>(object_stat.st_ino) != inode ||
+      offset + byte_size > static_cast<uint64_t>(object_stat.st_size)) {
+    close(fd);
+    throw PythonBackendException(
+        "Shared memory object '" + name +
+        "' was replaced or resized while in use.");
+  }
+
+  uint64_t mapped_size = object_stat.st_size;
+  void* address = mmap(
+      nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    throw PythonBackendException(
+        "Failed to map shared memory object '" + name +
+        "': " + std::strerror(errno));
+  }
+
+  std::shared_ptr<char> base(
+      reinterpret_cast<char*>(address),
+      [mapped_size](char* ptr) { munmap(ptr, mapped_size); });
+
+  // Replace the stale mappings of the object.
+  for (auto it = mappings_.begin(); it != mappings_.end();) {
+    if (it->name == name) {
+      it = mappings_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (mappings_.size() >= kExternalShmMaxMappings) {
+    mappings_.pop_back();
+  }
+  mappings_.insert(mappings_.begin(), Mapping{name, inode, mapped_size, base});
+
+  return std::shared_ptr<char>(base, base.get() + offset);
+}
+
+}}}  // namespace triton::backend::python
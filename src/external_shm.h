@@ -0,0 +1,95 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace triton { namespace backend { namespace python {
+
+//
+// Location of a buffer inside a POSIX shared memory object that is mapped by
+// the current process, e.g. a system shared memory region registered by a
+// client or the shared memory pool of another Python model.
+//
+struct ExternalShmLocation {
+  // Name of the shared memory object as passed to 'shm_open'.
+  std::string name;
+  // Inode of the shared memory object. It is used to detect objects that
+  // were removed and created again with the same name.
+  uint64_t inode;
+  // Offset of the buffer from the start of the object.
+  uint64_t offset;
+};
+
+/// Find the shared memory object that backs the buffer. The mappings of the
+/// process are cached and only read again when the buffer is not in the cache,
+/// or when the mappings used are no longer mapped.
+/// \param ptr The start of the buffer.
+/// \param byte_size The size of the buffer.
+/// \param location Set to the location of the buffer if it is found.
+/// \return Whether the whole buffer is backed by a single shared memory
+/// object that can be opened by name.
+bool FindExternalShm(
+    const void* ptr, uint64_t byte_size, ExternalShmLocation* location);
+
+//
+// Process-wide cache of the mappings of external shared memory objects. The
+// objects are mapped copy-on-write so that writes to a mapped buffer are not
+// visible to the process that owns the object.
+//
+class ExternalShmMappings {
+ public:
+  static ExternalShmMappings& GetInstance();
+
+  /// Map a buffer of an external shared memory object. The mapping stays
+  /// valid while the returned pointer is alive.
+  /// \throws PythonBackendException if the object cannot be mapped.
+  std::shared_ptr<char> Map(
+      const std::string& name, uint64_t inode, uint64_t offset,
+      uint64_t byte_size);
+
+ private:
+  struct Mapping {
+    std::string name;
+    uint64_t inode;
+    uint64_t byte_size;
+    std::shared_ptr<char> base;
+  };
+
+  ExternalShmMappings() = default;
+
+  std::mutex mu_;
+  // Most recently used mappings first. The mappings of objects that are no
+  // longer used are dropped once the cache is full.
+  std::vector<Mapping> mappings_;
+};
+
+}}}  // namespace triton::backend::python
@@ -50,6 +50,10 @@ void
 InferPayload::SetValueForPrevPromise(
     std::unique_ptr<InferResponse> infer_response)
 {
+  if (completion_callback_) {
+    completion_callback_(infer_response.get());
+    completion_callback_ = nullptr;
+  }
   prev_promise_->set_value(std::move(infer_response));
 }
 
@@ -72,4 +76,11 @@ InferPayload::IsDecoupled()
   return is_decoupled_;
 }
 
+void
+InferPayload::SetCompletionCallback(
+    std::function<void(InferResponse*)> callback)
+{
+  completion_callback_ = std::move(callback);
+}
+
 }}}  // namespace triton::backend::python
@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <functional>
 #include "infer_response.h"
 
 namespace triton { namespace backend { namespace python {
@@ -41,9 +42,15 @@ class InferPayload {
   void SetFuture(std::future<std::unique_ptr<InferResponse>>& response_future);
   bool IsDecoupled();
 
+  /// Set a function that is called with the first response before it is
+  /// passed to the future. The response is nullptr if Triton returned an
+  /// empty response.
+  void SetCompletionCallback(std::function<void(InferResponse*)> callback);
+
  private:
   std::unique_ptr<std::promise<std::unique_ptr<InferResponse>>> prev_promise_;
   bool is_decoupled_;
+  std::function<void(InferResponse*)> completion_callback_;
 };
 
 }}}  // namespace triton::backend::python
@@ -41,12 +41,16 @@ InferRequest::InferRequest(
     const std::set<std::string>& requested_output_names,
     const std::string& model_name, const int64_t model_version,
     const uint32_t flags, const int32_t timeout,
-    const intptr_t response_factory_address, const intptr_t request_address)
+    const intptr_t response_factory_address, const intptr_t request_address,
+    const std::unordered_map<std::string, uint64_t>& expected_output_byte_sizes,
+    const uint32_t priority)
     : request_id_(request_id), correlation_id_(correlation_id), inputs_(inputs),
-      requested_output_names_(requested_output_names), model_name_(model_name),
-      model_version_(model_version), flags_(flags), timeout_(timeout),
+      requested_output_names_(requested_output_names),
+      expected_output_byte_sizes_(expected_output_byte_sizes),
+      model_name_(model_name), model_version_(model_version), flags_(flags),
+      timeout_(timeout), priority_(priority),
       response_factory_address_(response_factory_address),
-      request_address_(request_address)
+      request_address_(request_address), trace_address_(0)
 {
   for (auto& input : inputs) {
     if (!input) {
@@ -64,11 +68,22 @@ InferRequest::InferRequest(
     }
   }
 
+  for (auto& expected_output_byte_size : expected_output_byte_sizes) {
+    if (requested_output_names.find(expected_output_byte_size.first) ==
+        requested_output_names.end()) {
+      throw PythonBackendException(
+          "Expected byte size is provided for output '" +
+          expected_output_byte_size.first + "' of request with id '" +
+          request_id + "' and model name '" + model_name +
+          "' which is not a requested output.");
+    }
+  }
+
   inputs_ = inputs;
   requested_output_names_ = requested_output_names;
 #ifdef TRITON_PB_STUB
   response_sender_ = std::make_shared<ResponseSender>(
-      request_address_, response_factory_address_,
+      request_address_, response_factory_address_, requested_output_names_,
       Stub::GetOrCreateInstance()->SharedMemory());
 #endif
 }
@@ -97,6 +112,12 @@ InferRequest::RequestedOutputNames()
   return requested_output_names_;
 }
 
+const std::unordered_map<std::string, uint64_t>&
+InferRequest::ExpectedOutputByteSizes()
+{
+  return expected_output_byte_sizes_;
+}
+
 const std::string&
 InferRequest::ModelName()
 {
@@ -121,6 +142,18 @@ InferRequest::RequestAddress()
   return request_address_;
 }
 
+intptr_t
+InferRequest::TraceAddress()
+{
+  return trace_address_;
+}
+
+void
+InferRequest::SetTraceAddress(intptr_t trace_address)
+{
+  trace_address_ = trace_address;
+}
+
 void
 InferRequest::SetFlags(uint32_t flags)
 {
@@ -139,6 +172,12 @@ InferRequest::Timeout()
   return timeout_;
 }
 
+uint32_t
+InferRequest::Priority()
+{
+  return priority_;
+}
+
 void
 InferRequest::SetIsDecoupled(const bool is_decoupled)
 {
@@ -159,8 +198,10 @@ InferRequest::SaveToSharedMemory(std::unique_ptr<SharedMemoryManager>& shm_pool)
       (RequestedOutputNames().size() *
        sizeof(bi::managed_external_buffer::handle_t)) +
       (Inputs().size() * sizeof(bi::managed_external_buffer::handle_t)) +
+      (RequestedOutputNames().size() * sizeof(uint64_t)) +
       PbString::ShmStructSize(ModelName()) +
-      PbString::ShmStructSize(RequestId()));
+          PbString::ShmStructSize(RequestId()),
+      false /* aligned */, ShmObjectType::kRequest);
 
   infer_request_shm_ptr_ =
       reinterpret_cast<InferRequestShm*>(infer_request_shm.data_.get());
@@ -174,6 +215,8 @@ InferRequest::SaveToSharedMemory(std::unique_ptr<SharedMemoryManager>& shm_pool)
   infer_request_shm_ptr_->response_factory_address = response_factory_address_;
   infer_request_shm_ptr_->is_decoupled = is_decoupled_;
   infer_request_shm_ptr_->timeout = timeout_;
+  infer_request_shm_ptr_->trace_address = trace_address_;
+  infer_request_shm_ptr_->priority = priority_;
 
   output_names_handle_shm_ptr_ =
       reinterpret_cast<bi::managed_external_buffer::handle_t*>(
@@ -204,11 +247,28 @@ InferRequest::SaveToSharedMemory(std::unique_ptr<SharedMemoryManager>& shm_pool)
     i++;
   }
 
+  // The expected byte sizes follow the input handles in the order of the
+  // requested output names. Zero means that the byte size is not known.
+  uint64_t* expected_output_byte_sizes_shm_ptr = reinterpret_cast<uint64_t*>(
+      reinterpret_cast<char*>(input_tensors_handle_ptr_) +
+      sizeof(bi::managed_external_buffer::handle_t) * Inputs().size());
+  i = 0;
+  for (auto& requested_output_name : requested_output_names_) {
+    auto expected_output_byte_size =
+        expected_output_byte_sizes_.find(requested_output_name);
+    expected_output_byte_sizes_shm_ptr[i] =
+        (expected_output_byte_size == expected_output_byte_sizes_.end())
+            ? 0
+            : expected_output_byte_size->second;
+    i++;
+  }
+
   size_t model_name_offset =
       sizeof(InferRequestShm) +
       (RequestedOutputNames().size() *
        sizeof(bi::managed_external_buffer::handle_t)) +
-      (Inputs().size() * sizeof(bi::managed_external_buffer::handle_t));
+      (Inputs().size() * sizeof(bi::managed_external_buffer::handle_t)) +
+      (RequestedOutputNames().size() * sizeof(uint64_t));
 
   std::unique_ptr<PbString> model_name_shm = PbString::Create(
       ModelName(),
@@ -275,7 +335,8 @@ InferRequest::LoadFromSharedMemory(
       sizeof(InferRequestShm) +
       (requested_output_count * sizeof(bi::managed_external_buffer::handle_t)) +
       (infer_request_shm_ptr->input_count *
-       sizeof(bi::managed_external_buffer::handle_t));
+       sizeof(bi::managed_external_buffer::handle_t)) +
+      (requested_output_count * sizeof(uint64_t));
 
   std::unique_ptr<PbString> model_name_shm = PbString::LoadFromSharedMemory(
       request_handle + model_name_offset,
@@ -316,12 +377,21 @@ InferRequest::InferRequest(
               infer_request_shm_ptr_->requested_output_count);
   inputs_ = std::move(input_tensors);
 
+  uint64_t* expected_output_byte_sizes_shm_ptr = reinterpret_cast<uint64_t*>(
+      reinterpret_cast<char*>(input_tensors_handle_ptr_) +
+      sizeof(bi::managed_external_buffer::handle_t) *
+          infer_request_shm_ptr_->input_count);
+
   std::set<std::string> requested_output_names;
   for (size_t output_idx = 0;
        output_idx < infer_request_shm_ptr_->requested_output_count;
        ++output_idx) {
     auto& pb_string = requested_output_names_shm_[output_idx];
     requested_output_names.emplace(pb_string->String());
+    if (expected_output_byte_sizes_shm_ptr[output_idx] != 0) {
+      expected_output_byte_sizes_[pb_string->String()] =
+          expected_output_byte_sizes_shm_ptr[output_idx];
+    }
   }
 
   request_id_ = request_id_shm_->String();
@@ -334,10 +404,12 @@ InferRequest::InferRequest(
   response_factory_address_ = infer_request_shm_ptr_->response_factory_address;
   is_decoupled_ = infer_request_shm_ptr_->is_decoupled;
   timeout_ = infer_request_shm_ptr_->timeout;
+  trace_address_ = infer_request_shm_ptr_->trace_address;
+  priority_ = infer_request_shm_ptr_->priority;
 
 #ifdef TRITON_PB_STUB
   response_sender_ = std::make_shared<ResponseSender>(
-      request_address_, response_factory_address_,
+      request_address_, response_factory_address_, requested_output_names_,
       Stub::GetOrCreateInstance()->SharedMemory());
 #endif
 }
@@ -370,8 +442,102 @@ InferRequest::GetResponseSender()
   return response_sender_;
 }
 
+std::shared_ptr<PbTensor>
+InferRequest::AllocateOutputTensor(
+    const std::string& name, const std::vector<int64_t>& dims,
+    const TRITONSERVER_DataType dtype)
+{
+  std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
+  if (stub->IsDecoupled()) {
+    throw PythonBackendException(
+        "'allocate_output_tensor' function is not supported for models using "
+        "the decoupled transaction policy.");
+  }
+  if (request_address_ == 0) {
+    throw PythonBackendException(
+        "'allocate_output_tensor' function must be called only for the "
+        "requests passed to the 'execute' function.");
+  }
+
+  std::unique_ptr<SharedMemoryManager>& shm_pool = stub->SharedMemory();
+  std::unique_ptr<PbString> name_shm = PbString::Create(shm_pool, name);
+  AllocatedSharedMemory<char> output_buffer_message_shm =
+      shm_pool->Construct<char>(
+          sizeof(OutputBufferMessage) + sizeof(int64_t) * dims.size());
+  OutputBufferMessage* output_buffer_message =
+      reinterpret_cast<OutputBufferMessage*>(
+          output_buffer_message_shm.data_.get());
+  output_buffer_message->request_address = request_address_;
+  output_buffer_message->name = name_shm->ShmHandle();
+  output_buffer_message->dtype = dtype;
+  output_buffer_message->dims_count = dims.size();
+  output_buffer_message->memory = 0;
+  output_buffer_message->has_error = false;
+  output_buffer_message->is_error_set = false;
+  std::copy(
+      dims.begin(), dims.end(),
+      reinterpret_cast<int64_t*>(
+          output_buffer_message_shm.data_.get() + sizeof(OutputBufferMessage)));
+
+  std::unique_ptr<IPCMessage> ipc_message =
+      IPCMessage::Create(shm_pool, true /* inline_response */);
+  ipc_message->Command() = PYTHONSTUB_OutputBufferRequest;
+  ipc_message->Args() = output_buffer_message_shm.handle_;
+
+  std::unique_ptr<PbMemory> pb_memory;
+  std::string error_message;
+  {
+    ScopedGilRelease release;
+    bi::scoped_lock<bi::interprocess_mutex> lock{
+        *(ipc_message->ResponseMutex())};
+    stub->SendIPCMessage(ipc_message);
+    ipc_message->ResponseCondition()->wait(lock);
+
+    // The parent process waits for the memory to be loaded before releasing
+    // its references.
+    try {
+      if (output_buffer_message->has_error) {
+        error_message = "Failed to allocate output '" + name + "'";
+        if (output_buffer_message->is_error_set) {
+          error_message +=
+              ": " + PbString::LoadFromSharedMemory(
+                         shm_pool, output_buffer_message->error)
+                         ->String();
+        }
+      } else {
+        pb_memory = PbMemory::LoadFromSharedMemory(
+            shm_pool, output_buffer_message->memory,
+            true /* open_cuda_handle */);
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      error_message = pb_exception.what();
+    }
+    ipc_message->ResponseCondition()->notify_all();
+  }
+
+  if (!pb_memory) {
+    throw PythonBackendException(error_message);
+  }
+
+  std::shared_ptr<PbTensor> output_tensor = std::make_shared<PbTensor>(
+      name, dims, dtype, pb_memory->MemoryType(), pb_memory->MemoryTypeId(),
+      pb_memory->DataPtr(), pb_memory->ByteSize(),
+      nullptr /* DLManagedTensor */);
+  output_tensor->SetMemory(std::move(pb_memory));
+
+  return output_tensor;
+}
+
 std::vector<std::shared_ptr<InferResponse>>
 InferRequest::Exec(const bool is_decoupled)
+{
+  return ExecBatch({this}, is_decoupled);
+}
+
+std::vector<std::shared_ptr<InferResponse>>
+InferRequest::ExecBatch(
+    const std::vector<InferRequest*>& infer_requests, const bool is_decoupled)
 {
   ResponseBatch* response_batch = nullptr;
   bool responses_is_set = false;
@@ -379,6 +545,24 @@ InferRequest::Exec(const bool is_decoupled)
   std::unique_ptr<SharedMemoryManager>& shm_pool = stub->SharedMemory();
   bi::managed_external_buffer::handle_t* response_handle = nullptr;
   std::vector<std::shared_ptr<InferResponse>> infer_responses;
+  const uint32_t batch_size = infer_requests.size();
+  auto exec_start = std::chrono::steady_clock::now();
+  ScopedDefer exec_timer([&stub, &exec_start] {
+    stub->AddBlsExecTime(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - exec_start)
+                             .count());
+  });
+
+  // An error of the whole batch is the response of every request.
+  auto error_responses = [batch_size](const std::string& message) {
+    std::vector<std::shared_ptr<InferResponse>> error_responses;
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      error_responses.emplace_back(std::make_shared<InferResponse>(
+          std::vector<std::shared_ptr<PbTensor>>{},
+          std::make_shared<PbError>(message)));
+    }
+    return error_responses;
+  };
 
   PythonBackendException pb_exception(std::string{});
   std::unique_ptr<IPCMessage> ipc_message;
@@ -391,7 +575,7 @@ InferRequest::Exec(const bool is_decoupled)
   });
 
   try {
-    py::gil_scoped_release release;
+    ScopedGilRelease release;
     ipc_message = IPCMessage::Create(shm_pool, true /* inline_response */);
     bool has_exception = false;
     PythonBackendException pb_exception(std::string{});
@@ -405,32 +589,53 @@ InferRequest::Exec(const bool is_decoupled)
     }
 
     request_batch = shm_pool->Construct<char>(
-        sizeof(RequestBatch) + sizeof(bi::managed_external_buffer::handle_t));
+        sizeof(RequestBatch) +
+            batch_size * sizeof(bi::managed_external_buffer::handle_t),
+        false /* aligned */, ShmObjectType::kBatch);
 
     RequestBatch* request_batch_shm_ptr =
         reinterpret_cast<RequestBatch*>(request_batch.data_.get());
-    request_batch_shm_ptr->batch_size = 1;
+    request_batch_shm_ptr->batch_size = batch_size;
+    request_batch_shm_ptr->batch_id = stub->ExecutingBatchId();
+    request_batch_shm_ptr->priority = 0;
+    request_batch_shm_ptr->is_dispatched = false;
+    request_batch_shm_ptr->released_batch_id = 0;
+    // The trace is passed with the batch instead of being stored in the
+    // requests, since a request may be sent again once the trace has been
+    // released.
+    request_batch_shm_ptr->trace_address = stub->ExecutingTraceAddress();
+    for (auto& infer_request : infer_requests) {
+      uint32_t priority = infer_request->priority_;
+      if (priority != 0 && (request_batch_shm_ptr->priority == 0 ||
+                            priority < request_batch_shm_ptr->priority)) {
+        request_batch_shm_ptr->priority = priority;
+      }
+    }
     ipc_message->Args() = request_batch.handle_;
 
     bi::managed_external_buffer::handle_t* requests_shm =
         reinterpret_cast<bi::managed_external_buffer::handle_t*>(
             request_batch.data_.get() + sizeof(RequestBatch));
-    request_batch_shm_ptr->batch_size = 1;
 
     bool has_gpu_tensor = false;
-    size_t i = 0;
-    for (auto& input_tensor : inputs_) {
-      input_tensor->SaveToSharedMemory(shm_pool, false /* copy_gpu */);
-      if (!input_tensor->IsCPU()) {
-        has_gpu_tensor = true;
+    for (size_t r = 0; r < batch_size; ++r) {
+      for (auto& input_tensor : infer_requests[r]->inputs_) {
+        input_tensor->SaveToSharedMemory(shm_pool, false /* copy_gpu */);
+        // The inputs of the model requests that are forwarded as is and the
+        // tensors in the CUDA shared pool don't need to be copied to the
+        // parent process.
+        if (!input_tensor->IsCPU() &&
+            !input_tensor->Memory()->IsUpstreamInput() &&
+            !input_tensor->Memory()->IsInCudaPool()) {
+          has_gpu_tensor = true;
+        }
       }
-      ++i;
-    }
 
-    SaveToSharedMemory(shm_pool);
+      infer_requests[r]->SaveToSharedMemory(shm_pool);
 
-    // Save the shared memory offset of the request.
-    *requests_shm = ShmHandle();
+      // Save the shared memory offset of the request.
+      requests_shm[r] = infer_requests[r]->ShmHandle();
+    }
 
     // Send the BLS request to the parent process and wait for the response.
     {
@@ -450,14 +655,18 @@ InferRequest::Exec(const bool is_decoupled)
       try {
 #ifdef TRITON_ENABLE_GPU
         size_t i = 0;
-        for (auto& input_tensor : this->Inputs()) {
-          if (!input_tensor->IsCPU()) {
-            std::unique_ptr<PbMemory> dst_buffer =
-                PbMemory::LoadFromSharedMemory(
-                    shm_pool, (gpu_buffers_handle.data_.get())[i],
-                    true /* open cuda handle */);
-            PbMemory::CopyBuffer(dst_buffer, input_tensor->Memory());
-            ++i;
+        for (InferRequest* infer_request : infer_requests) {
+          for (auto& input_tensor : infer_request->Inputs()) {
+            if (!input_tensor->IsCPU() &&
+                !input_tensor->Memory()->IsUpstreamInput() &&
+                !input_tensor->Memory()->IsInCudaPool()) {
+              std::unique_ptr<PbMemory> dst_buffer =
+                  PbMemory::LoadFromSharedMemory(
+                      shm_pool, (gpu_buffers_handle.data_.get())[i],
+                      true /* open cuda handle */);
+              PbMemory::CopyBuffer(dst_buffer, input_tensor->Memory());
+              ++i;
+            }
           }
         }
 #endif  // TRITON_ENABLE_GPU
@@ -499,30 +708,15 @@ InferRequest::Exec(const bool is_decoupled)
       if (response_batch->is_error_set) {
         std::unique_ptr<PbString> pb_string =
             PbString::LoadFromSharedMemory(shm_pool, response_batch->error);
-        auto error_response = std::make_unique<InferResponse>(
-            std::vector<std::shared_ptr<PbTensor>>{},
-            std::make_shared<PbError>(pb_string->String()));
-        infer_responses.emplace_back(std::move(error_response));
-
-        return infer_responses;
+        return error_responses(pb_string->String());
       } else {
-        auto error_response = std::make_unique<InferResponse>(
-            std::vector<std::shared_ptr<PbTensor>>{},
-            std::make_shared<PbError>(
-                "An error occurred while performing BLS request."));
-        infer_responses.emplace_back(std::move(error_response));
-
-        return infer_responses;
+        return error_responses(
+            "An error occurred while performing BLS request.");
       }
     }
   }
   catch (const PythonBackendException& pb_exception) {
-    auto error_response = std::make_unique<InferResponse>(
-        std::vector<std::shared_ptr<PbTensor>>{},
-        std::make_shared<PbError>(pb_exception.what()));
-    infer_responses.emplace_back(std::move(error_response));
-
-    return infer_responses;
+    return error_responses(pb_exception.what());
   }
 
   if (responses_is_set) {
@@ -548,13 +742,7 @@ InferRequest::Exec(const bool is_decoupled)
 
     return infer_responses;
   } else {
-    auto error_response = std::make_unique<InferResponse>(
-        std::vector<std::shared_ptr<PbTensor>>{},
-        std::make_shared<PbError>(
-            "An error occurred while performing BLS request."));
-    infer_responses.emplace_back(std::move(error_response));
-
-    return infer_responses;
+    return error_responses("An error occurred while performing BLS request.");
   }
 }
 
@@ -28,6 +28,7 @@
 
 #include <future>
 #include <string>
+#include <unordered_map>
 #include "infer_response.h"
 #include "pb_tensor.h"
 
@@ -52,6 +53,8 @@ struct InferRequestShm {
   intptr_t response_factory_address;
   bool is_decoupled;
   int32_t timeout;
+  intptr_t trace_address;
+  uint32_t priority;
 };
 
 class InferRequest {
@@ -63,7 +66,10 @@ class InferRequest {
       const std::string& model_name, const int64_t model_version,
       const uint32_t flags = 0, const int32_t timeout = 0,
       const intptr_t response_factory_address = 0,
-      const intptr_t request_address = 0);
+      const intptr_t request_address = 0,
+      const std::unordered_map<std::string, uint64_t>&
+          expected_output_byte_sizes = {},
+      const uint32_t priority = 0);
 
   const std::vector<std::shared_ptr<PbTensor>>& Inputs();
   const std::string& RequestId();
@@ -73,14 +79,37 @@ class InferRequest {
   uint32_t Flags();
   void SetFlags(uint32_t flags);
   const std::set<std::string>& RequestedOutputNames();
+
+  /// The expected byte sizes of the requested outputs that are known in
+  /// advance, which are used to allocate the outputs of the responses
+  /// together.
+  const std::unordered_map<std::string, uint64_t>& ExpectedOutputByteSizes();
   bi::managed_external_buffer::handle_t ShmHandle();
   int32_t Timeout();
+
+  /// The priority of the request in the scheduler of the model. Lower values
+  /// have a higher priority, and zero uses the default priority of the model.
+  uint32_t Priority();
   bool IsDecoupled();
   void SetIsDecoupled(const bool is_decoupled);
 
 #ifdef TRITON_PB_STUB
   std::vector<std::shared_ptr<InferResponse>> Exec(const bool is_decoupled);
+
+  /// Execute several BLS requests with a single message to the parent
+  /// process. Returns one response per request, in the same order, unless
+  /// 'is_decoupled' is set, which is only supported for a single request.
+  static std::vector<std::shared_ptr<InferResponse>> ExecBatch(
+      const std::vector<InferRequest*>& infer_requests,
+      const bool is_decoupled);
   std::shared_ptr<ResponseSender> GetResponseSender();
+
+  /// Create an output of the response to this request in the buffer that
+  /// Triton provides for it, so that the output is not copied after the model
+  /// writes it. The returned tensor must be added to the response.
+  std::shared_ptr<PbTensor> AllocateOutputTensor(
+      const std::string& name, const std::vector<int64_t>& dims,
+      const TRITONSERVER_DataType dtype);
 #endif
 
   /// Save an Inference Request to shared memory.
@@ -104,6 +133,12 @@ class InferRequest {
   DISALLOW_COPY_AND_ASSIGN(InferRequest);
 
   intptr_t RequestAddress();
+
+  /// The address of the Triton trace of the request in the Triton process, or
+  /// zero if the request is not traced. The trace of a BLS request is the
+  /// parent of the trace of the request that is sent to Triton.
+  intptr_t TraceAddress();
+  void SetTraceAddress(intptr_t trace_address);
   ~InferRequest() {}
 
 #ifndef TRITON_PB_STUB
@@ -122,12 +157,15 @@ class InferRequest {
   uint64_t correlation_id_;
   std::vector<std::shared_ptr<PbTensor>> inputs_;
   std::set<std::string> requested_output_names_;
+  std::unordered_map<std::string, uint64_t> expected_output_byte_sizes_;
   std::string model_name_;
   int64_t model_version_;
   uint32_t flags_;
   int32_t timeout_;
+  uint32_t priority_;
   intptr_t response_factory_address_;
   intptr_t request_address_;
+  intptr_t trace_address_;
   bool is_decoupled_;
 
   // Shared Memory Data Structures
@@ -88,11 +88,13 @@ InferResponse::SaveToSharedMemory(
 {
   size_t output_tensor_length = output_tensors_.size();
   if (HasError()) {
-    response_shm_ = shm_pool->Construct<char>(sizeof(ResponseShm));
+    response_shm_ = shm_pool->Construct<char>(
+        sizeof(ResponseShm), false /* aligned */, ShmObjectType::kResponse);
   } else {
     response_shm_ = shm_pool->Construct<char>(
-        sizeof(ResponseShm) +
-        output_tensor_length * sizeof(bi::managed_external_buffer::handle_t));
+        sizeof(ResponseShm) + output_tensor_length *
+                                  sizeof(bi::managed_external_buffer::handle_t),
+        false /* aligned */, ShmObjectType::kResponse);
   }
 
   ResponseShm* response_shm_ptr =
@@ -212,7 +214,10 @@ InferResponse::Send(
     std::unique_ptr<SharedMemoryManager>& shm_pool,
     std::vector<std::pair<std::unique_ptr<PbMemory>, void*>>& output_buffers,
     const std::set<std::string>& requested_output_names,
-    TRITONBACKEND_Response* response)
+    TRITONBACKEND_Response* response,
+    std::unordered_map<
+        std::string, std::pair<std::unique_ptr<PbMemory>, void*>>*
+        preallocated_outputs)
 {
   std::shared_ptr<TRITONSERVER_Error*> response_error =
       WrapTritonErrorInSharedPtr(nullptr);
@@ -265,10 +270,69 @@ InferResponse::Send(
     return nullptr;
   }
 
+  // The preallocated outputs were already added to the response and Triton
+  // can't remove them, so the response would be sent with uninitialized
+  // contents for the outputs that were not returned.
+  if (preallocated_outputs != nullptr) {
+    for (auto& preallocated_output : *preallocated_outputs) {
+      bool is_returned = false;
+      for (auto& output_tensor : OutputTensors()) {
+        is_returned |= (output_tensor->Name() == preallocated_output.first);
+      }
+      if (!is_returned) {
+        SET_ERROR_AND_RETURN(
+            response_error,
+            TRITONSERVER_ErrorNew(
+                TRITONSERVER_ERROR_INVALID_ARG,
+                ("Output tensor '" + preallocated_output.first +
+                 "' was allocated by 'allocate_output_tensor' but is not "
+                 "in the response.")
+                    .c_str()));
+      }
+    }
+  }
+
   bool cuda_copy = false;
 
   for (auto& output_tensor : OutputTensors()) {
-    // FIXME: for decoupled models we will skip the requested output names.
+    if (preallocated_outputs != nullptr) {
+      auto preallocated_output =
+          preallocated_outputs->find(output_tensor->Name());
+      if (preallocated_output != preallocated_outputs->end()) {
+        std::unique_ptr<PbMemory>& pb_memory =
+            preallocated_output->second.first;
+        if (!output_tensor->Memory() ||
+            output_tensor->Memory()->ShmHandle() != pb_memory->ShmHandle()) {
+          SET_ERROR_AND_RETURN(
+              response_error,
+              TRITONSERVER_ErrorNew(
+                  TRITONSERVER_ERROR_INVALID_ARG,
+                  ("Output tensor '" + output_tensor->Name() +
+                   "' must be the tensor returned by "
+                   "'allocate_output_tensor'.")
+                      .c_str()));
+        }
+
+        // GPU outputs were written to the Triton buffer by the stub process.
+        // CPU outputs are in shared memory if Triton didn't provide a GPU
+        // buffer.
+        if (pb_memory->MemoryType() == TRITONSERVER_MEMORY_CPU) {
+          bool cuda_used = false;
+          SET_ERROR_AND_RETURN(
+              response_error,
+              CopyBuffer(
+                  "Failed to copy the output tensor to buffer.",
+                  TRITONSERVER_MEMORY_CPU, 0, TRITONSERVER_MEMORY_CPU, 0,
+                  pb_memory->ByteSize(), pb_memory->DataPtr(),
+                  preallocated_output->second.second,
+                  reinterpret_cast<cudaStream_t>(cuda_stream), &cuda_used));
+          cuda_copy |= cuda_used;
+        }
+        continue;
+      }
+    }
+
+    // The outputs that are not requested were removed by the stub process.
     TRITONSERVER_MemoryType src_memory_type = output_tensor->MemoryType();
     int64_t src_memory_type_id = output_tensor->MemoryTypeId();
 
@@ -94,14 +94,19 @@ class InferResponse {
   /// Send an inference response. If the response has a GPU tensor, sending the
   /// response needs to be done in two step. The boolean
   /// 'requires_deferred_callback' indicates whether DeferredSendCallback method
-  /// should be called or not.
+  /// should be called or not. 'preallocated_outputs' holds the outputs that
+  /// were already added to 'response' for the stub process to write to, and
+  /// the Triton buffers of the outputs.
   std::shared_ptr<TRITONSERVER_Error*> Send(
       TRITONBACKEND_ResponseFactory* response_factory, void* cuda_stream,
       bool& requires_deferred_callback, const uint32_t flags,
       std::unique_ptr<SharedMemoryManager>& shm_pool,
       std::vector<std::pair<std::unique_ptr<PbMemory>, void*>>& output_buffers,
       const std::set<std::string>& requested_output_names = {},
-      TRITONBACKEND_Response* response = nullptr);
+      TRITONBACKEND_Response* response = nullptr,
+      std::unordered_map<
+          std::string, std::pair<std::unique_ptr<PbMemory>, void*>>*
+          preallocated_outputs = nullptr);
 
   void DeferredSendCallback();
 #endif
@@ -49,7 +49,11 @@ typedef enum PYTHONSTUB_commandtype_enum {
   PYTHONSTUB_ResponseSend,
   PYTHONSTUB_ResponseClose,
   PYTHONSTUB_AutoCompleteRequest,
-  PYTHONSTUB_AutoCompleteResponse
+  PYTHONSTUB_AutoCompleteResponse,
+  PYTHONSTUB_ForkRequest,
+  PYTHONSTUB_ForkResponse,
+  PYTHONSTUB_OutputBufferRequest,
+  PYTHONSTUB_InputBufferRequest
 } PYTHONSTUB_CommandType;
 
 ///
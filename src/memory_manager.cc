@@ -25,17 +25,26 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "memory_manager.h"
+#include "cuda_shared_pool.h"
 #include "pb_utils.h"
 
 
 namespace triton { namespace backend { namespace python {
 
+// Maximum number of memory records released after a single wake up.
+constexpr size_t kMaxMemoryReleaseBatchSize = 64;
 
 #ifdef TRITON_ENABLE_GPU
 GPUMemoryRecord::GPUMemoryRecord(void* ptr)
 {
   ptr_ = ptr;
   release_callback_ = [](void* ptr) {
+    CudaSharedPool* cuda_pool = CudaSharedPool::FindByAddress(ptr);
+    if (cuda_pool != nullptr) {
+      cuda_pool->Free(ptr);
+      return;
+    }
+
     cudaError_t err = cudaFree(ptr);
     if (err != cudaSuccess) {
       LOG_MESSAGE(
@@ -82,25 +91,52 @@ MemoryManager::AddRecord(std::unique_ptr<MemoryRecord>&& memory_record)
 void
 MemoryManager::QueueMonitorThread()
 {
+  std::vector<intptr_t> memories;
+  std::vector<std::unique_ptr<MemoryRecord>> released_records;
   while (true) {
-    intptr_t memory = message_queue_->Pop();
-    if (memory == 0) {
-      return;
+    memories.clear();
+    memories.push_back(message_queue_->Pop());
+
+    // Take the other messages that are already in the queue without waiting.
+    bool success = true;
+    while (memories.size() < kMaxMemoryReleaseBatchSize) {
+      intptr_t memory = message_queue_->Pop(0 /* duration */, success);
+      if (!success) {
+        break;
+      }
+      memories.push_back(memory);
     }
 
+    bool exit = false;
     {
       std::lock_guard<std::mutex> lock{mu_};
-      auto it = records_.find(memory);
-      if (it == records_.end()) {
-        LOG_MESSAGE(
-            TRITONSERVER_LOG_ERROR,
-            "Unexpected memory index received for deallocation.");
-        continue;
+      for (intptr_t memory : memories) {
+        if (memory == 0) {
+          exit = true;
+          continue;
+        }
+
+        auto it = records_.find(memory);
+        if (it == records_.end()) {
+          LOG_MESSAGE(
+              TRITONSERVER_LOG_ERROR,
+              "Unexpected memory index received for deallocation.");
+          continue;
+        }
+        released_records.emplace_back(std::move(it->second));
+        records_.erase(it);
       }
+    }
+
+    // Call the release callbacks without holding the lock so that new records
+    // can be added while the memory is freed.
+    for (auto& record : released_records) {
+      record->ReleaseCallback()(record->MemoryId());
+    }
+    released_records.clear();
 
-      // Call the release callback.
-      it->second->ReleaseCallback()(it->second->MemoryId());
-      records_.erase(it);
+    if (exit) {
+      return;
     }
   }
 }
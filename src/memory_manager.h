@@ -30,6 +30,7 @@
 #include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 #include "message_queue.h"
 #include "triton/backend/backend_common.h"
 #include "triton/core/tritonserver.h"
@@ -64,7 +65,8 @@ class GPUMemoryRecord : public MemoryRecord {
 /// tensors in BLS. It mainly consists of a background thread that monitors a
 /// message queue in shared memory. Whenever a GPU tensor is created, it will
 /// be pushed to the memory manager. The stub process must send a message to the
-/// message queue asking the memory manager to deallocate the GPU tensor.
+/// message queue asking the memory manager to deallocate the GPU tensor. The
+/// messages that are already in the queue are released together.
 class MemoryManager {
  public:
   MemoryManager(std::unique_ptr<MessageQueue<intptr_t>>&& memory_message_queue);
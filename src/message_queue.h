@@ -26,16 +26,68 @@
 
 #pragma once
 
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/thread/thread_time.hpp>
+#include <cerrno>
+#include <chrono>
+#include <climits>
 #include <cstddef>
+#include <ctime>
 #include "shm_manager.h"
 
 namespace triton { namespace backend { namespace python {
 namespace bi = boost::interprocess;
 
+static_assert(
+    ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+    "SPSC message queues require address-free atomics in shared memory.");
+
+constexpr std::size_t kMessageQueueCacheLineSize = 64;
+
+// Bit of the producer lock word that is set when producers wait for the lock.
+// The other bits hold the pid of the owner, which never uses the top bit.
+constexpr uint32_t kProducerLockWaiters = 1u << 31;
+
+// Interval at which the producers waiting for the lock check whether its owner
+// is still alive, since its death doesn't wake them up.
+constexpr std::chrono::milliseconds kProducerLockPollInterval{100};
+
+/// Struct holding the state of a single-producer/single-consumer ring inside
+/// the shared memory. The fields written by the producer and the fields
+/// written by the consumer are separated by a full cache line so that the two
+/// processes do not false-share. 'push_seq' and 'pop_seq' are used as futex
+/// words and are only waited on when the ring is empty or full.
+/// \param head Total number of messages pushed.
+/// \param push_seq Incremented after every push. Consumers wait on it.
+/// \param push_waiters Number of producers waiting for a free slot.
+/// \param producer_lock Futex lock serializing the (rare) extra producers.
+/// Holds the pid of the owner, or 0 if the lock is free.
+/// \param tail Total number of messages popped.
+/// \param pop_seq Incremented after every pop. Producers wait on it.
+/// \param pop_waiters Number of consumers waiting for a message.
+/// \param spin_hits Number of pops that found a message while spinning.
+/// \param sleeps Number of pops that had to fall back to a futex wait.
+struct MessageQueueRingShm {
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint32_t> push_seq{0};
+  std::atomic<uint32_t> push_waiters{0};
+  std::atomic<uint32_t> producer_lock{0};
+  char producer_padding[kMessageQueueCacheLineSize];
+  std::atomic<uint64_t> tail{0};
+  std::atomic<uint32_t> pop_seq{0};
+  std::atomic<uint32_t> pop_waiters{0};
+  std::atomic<uint64_t> spin_hits{0};
+  std::atomic<uint64_t> sleeps{0};
+  char consumer_padding[kMessageQueueCacheLineSize];
+};
+
 /// Struct holding the represenation of a message queue inside the shared
 /// memory.
 /// \param size Total size of the message queue.
@@ -43,6 +95,11 @@ namespace bi = boost::interprocess;
 /// \param index Used element index.
 /// \param sem_empty Semaphore object counting the number of empty buffer slots.
 /// \param sem_full Semaphore object counting the number of used buffer slots.
+/// \param spsc Whether the queue uses the lock-free ring instead of the
+/// semaphores and the mutex.
+/// \param spin_wait_us Time in microseconds the consumer of the lock-free ring
+/// polls for a new message before going to sleep.
+/// \param ring State of the lock-free ring.
 struct MessageQueueShm {
   bi::interprocess_semaphore sem_empty{0};
   bi::interprocess_semaphore sem_full{0};
@@ -51,15 +108,24 @@ struct MessageQueueShm {
   bi::managed_external_buffer::handle_t buffer;
   int head;
   int tail;
+  bool spsc;
+  uint64_t spin_wait_us;
+  MessageQueueRingShm ring;
 };
 
 template <typename T>
 class MessageQueue {
  public:
   /// Create a new MessageQueue in the shared memory.
+  /// \param shm_pool The shared memory pool used for the allocation.
+  /// \param message_queue_size Number of slots in the message queue.
+  /// \param spsc If true, the queue is backed by a lock-free ring that only
+  /// falls back to a futex wait when it is empty or full. The queue must have
+  /// a single consumer at any point in time. Additional producers are allowed
+  /// but are serialized by a futex lock.
   static std::unique_ptr<MessageQueue<T>> Create(
       std::unique_ptr<SharedMemoryManager>& shm_pool,
-      uint32_t message_queue_size)
+      uint32_t message_queue_size, bool spsc = false)
   {
     AllocatedSharedMemory<MessageQueueShm> mq_shm =
         shm_pool->Construct<MessageQueueShm>();
@@ -70,7 +136,10 @@ class MessageQueue {
     mq_shm.data_->buffer = mq_buffer_shm.handle_;
     mq_shm.data_->head = 0;
     mq_shm.data_->tail = 0;
+    mq_shm.data_->spsc = spsc;
+    mq_shm.data_->spin_wait_us = 0;
 
+    new (&(mq_shm.data_->ring)) MessageQueueRingShm{};
     new (&(mq_shm.data_->mutex)) bi::interprocess_mutex{};
     new (&(mq_shm.data_->sem_empty))
         bi::interprocess_semaphore{message_queue_size};
@@ -98,6 +167,11 @@ class MessageQueue {
   /// \param message The shared memory handle of the message.
   void Push(T message)
   {
+    if (spsc_) {
+      RingPush(message, nullptr /* deadline */);
+      return;
+    }
+
     while (true) {
       try {
         SemEmptyMutable()->wait();
@@ -117,6 +191,14 @@ class MessageQueue {
 
   void Push(T message, int const& duration, bool& success)
   {
+    if (spsc_) {
+      std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::now() +
+          std::chrono::milliseconds(duration);
+      success = RingPush(message, &deadline);
+      return;
+    }
+
     boost::system_time timeout =
         boost::get_system_time() + boost::posix_time::milliseconds(duration);
 
@@ -157,6 +239,11 @@ class MessageQueue {
   {
     T message;
 
+    if (spsc_) {
+      bool success;
+      return RingPop(nullptr /* deadline */, success);
+    }
+
     while (true) {
       try {
         SemFullMutable()->wait();
@@ -180,6 +267,13 @@ class MessageQueue {
   T Pop(int const& duration, bool& success)
   {
     T message = 0;
+    if (spsc_) {
+      std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::now() +
+          std::chrono::milliseconds(duration);
+      return RingPop(&deadline, success);
+    }
+
     boost::system_time timeout =
         boost::get_system_time() + boost::posix_time::milliseconds(duration);
 
@@ -223,10 +317,32 @@ class MessageQueue {
     new (SemFullMutable()) bi::interprocess_semaphore(0);
     new (SemEmptyMutable()) bi::interprocess_semaphore(Size());
     new (MutexMutable()) bi::interprocess_mutex;
+    new (&(mq_shm_ptr_->ring)) MessageQueueRingShm{};
     mq_shm_ptr_->tail = 0;
     mq_shm_ptr_->head = 0;
   }
 
+  /// Set the time the consumer of a lock-free queue spins waiting for a
+  /// message before sleeping. The value is stored in the shared memory so it
+  /// applies to both processes.
+  /// \param spin_wait_us Spin budget in microseconds. Zero disables spinning.
+  void SetSpinWait(uint64_t spin_wait_us)
+  {
+    mq_shm_ptr_->spin_wait_us = spin_wait_us;
+  }
+
+  /// Number of pops that were satisfied while spinning.
+  uint64_t SpinHits()
+  {
+    return spsc_ ? Ring().spin_hits.load(std::memory_order_relaxed) : 0;
+  }
+
+  /// Number of pops that had to sleep waiting for a message.
+  uint64_t Sleeps()
+  {
+    return spsc_ ? Ring().sleeps.load(std::memory_order_relaxed) : 0;
+  }
+
   /// Get the shared memory handle of MessageQueue
   bi::managed_external_buffer::handle_t ShmHandle() { return mq_handle_; }
 
@@ -265,6 +381,222 @@ class MessageQueue {
 
   void HeadIncrement() { mq_shm_ptr_->head = (mq_shm_ptr_->head + 1) % Size(); }
   void TailIncrement() { mq_shm_ptr_->tail = (mq_shm_ptr_->tail + 1) % Size(); }
+  MessageQueueRingShm& Ring() { return mq_shm_ptr_->ring; }
+
+  /// Compute the time left until the deadline.
+  /// \param deadline The deadline or nullptr to wait indefinitely.
+  /// \param remaining Set to the remaining time when there is a deadline.
+  /// \return false if the deadline has already passed.
+  static bool RemainingTime(
+      const std::chrono::steady_clock::time_point* deadline,
+      struct timespec& remaining)
+  {
+    if (deadline == nullptr) {
+      return true;
+    }
+
+    std::chrono::nanoseconds left =
+        *deadline - std::chrono::steady_clock::now();
+    if (left.count() <= 0) {
+      return false;
+    }
+
+    remaining.tv_sec = left.count() / 1000000000;
+    remaining.tv_nsec = left.count() % 1000000000;
+    return true;
+  }
+
+  /// Wait on a futex word that lives in the shared memory. The futex is not
+  /// private since the waker is usually in the other process.
+  static void FutexWait(
+      std::atomic<uint32_t>* word, uint32_t expected,
+      const std::chrono::steady_clock::time_point* deadline)
+  {
+    struct timespec remaining;
+    if (!RemainingTime(deadline, remaining)) {
+      return;
+    }
+
+    // EAGAIN, EINTR and ETIMEDOUT are all handled by the callers re-checking
+    // the ring state.
+    syscall(
+        SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+        deadline == nullptr ? nullptr : &remaining, nullptr, 0);
+  }
+
+  static void CpuRelax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+  }
+
+  static void FutexWake(std::atomic<uint32_t>* word, int count)
+  {
+    syscall(
+        SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, count,
+        nullptr, nullptr, 0);
+  }
+
+  static bool ProcessIsAlive(uint32_t pid)
+  {
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+  }
+
+  /// Acquire the producer lock. The lock is uncontended when there is a
+  /// single producer, in which case it costs a single atomic operation. The
+  /// lock word holds the pid of the owner so that the waiters can take over
+  /// the lock of a process that died while holding it, e.g. a stub killed in
+  /// the middle of a push, instead of blocking forever.
+  bool LockProducer(const std::chrono::steady_clock::time_point* deadline)
+  {
+    std::atomic<uint32_t>& lock = Ring().producer_lock;
+    uint32_t state = 0;
+    if (lock.compare_exchange_strong(state, pid_, std::memory_order_acquire)) {
+      return true;
+    }
+
+    while (true) {
+      // Other producers may be waiting, so the lock is taken with the waiters
+      // bit set to wake them up on release.
+      if (state == 0 || !ProcessIsAlive(state & ~kProducerLockWaiters)) {
+        if (lock.compare_exchange_strong(
+                state, pid_ | kProducerLockWaiters,
+                std::memory_order_acquire)) {
+          return true;
+        }
+        continue;
+      }
+      if ((state & kProducerLockWaiters) == 0) {
+        if (!lock.compare_exchange_strong(
+                state, state | kProducerLockWaiters,
+                std::memory_order_relaxed)) {
+          continue;
+        }
+        state |= kProducerLockWaiters;
+      }
+
+      struct timespec remaining;
+      if (!RemainingTime(deadline, remaining)) {
+        return false;
+      }
+      std::chrono::steady_clock::time_point poll_deadline =
+          std::chrono::steady_clock::now() + kProducerLockPollInterval;
+      if (deadline != nullptr && *deadline < poll_deadline) {
+        poll_deadline = *deadline;
+      }
+      FutexWait(&lock, state, &poll_deadline);
+      state = lock.load(std::memory_order_relaxed);
+    }
+  }
+
+  void UnlockProducer()
+  {
+    std::atomic<uint32_t>& lock = Ring().producer_lock;
+    if (lock.exchange(0, std::memory_order_release) & kProducerLockWaiters) {
+      FutexWake(&lock, 1);
+    }
+  }
+
+  /// Push a message into the lock-free ring.
+  /// \return false if the deadline passed before the message was pushed.
+  bool RingPush(
+      T message, const std::chrono::steady_clock::time_point* deadline)
+  {
+    if (!LockProducer(deadline)) {
+      return false;
+    }
+
+    MessageQueueRingShm& ring = Ring();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    while (head - ring.tail.load(std::memory_order_acquire) >= Size()) {
+      struct timespec remaining;
+      if (!RemainingTime(deadline, remaining)) {
+        UnlockProducer();
+        return false;
+      }
+
+      // The sequence number must be read before registering as a waiter so
+      // that a pop happening in between makes the futex wait return
+      // immediately.
+      uint32_t seq = ring.pop_seq.load(std::memory_order_seq_cst);
+      ring.push_waiters.fetch_add(1, std::memory_order_seq_cst);
+      if (head - ring.tail.load(std::memory_order_seq_cst) >= Size()) {
+        FutexWait(&ring.pop_seq, seq, deadline);
+      }
+      ring.push_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    Buffer()[head % Size()] = message;
+    ring.head.store(head + 1, std::memory_order_seq_cst);
+    ring.push_seq.fetch_add(1, std::memory_order_seq_cst);
+    if (ring.pop_waiters.load(std::memory_order_seq_cst) != 0) {
+      FutexWake(&ring.push_seq, INT_MAX);
+    }
+
+    UnlockProducer();
+    return true;
+  }
+
+  /// Pop a message from the lock-free ring. Only a single thread may consume
+  /// from the ring at a time.
+  T RingPop(
+      const std::chrono::steady_clock::time_point* deadline, bool& success)
+  {
+    MessageQueueRingShm& ring = Ring();
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t spin_wait_us = mq_shm_ptr_->spin_wait_us;
+    if (spin_wait_us != 0 &&
+        ring.head.load(std::memory_order_acquire) == tail) {
+      // Poll for a bounded amount of time before sleeping. For short
+      // executions the wake-up latency of a sleeping process dominates.
+      std::chrono::steady_clock::time_point spin_end =
+          std::chrono::steady_clock::now() +
+          std::chrono::microseconds(spin_wait_us);
+      if (deadline != nullptr && *deadline < spin_end) {
+        spin_end = *deadline;
+      }
+      while (ring.head.load(std::memory_order_acquire) == tail &&
+             std::chrono::steady_clock::now() < spin_end) {
+        CpuRelax();
+      }
+      if (ring.head.load(std::memory_order_acquire) != tail) {
+        ring.spin_hits.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    bool slept = false;
+    while (ring.head.load(std::memory_order_acquire) == tail) {
+      struct timespec remaining;
+      if (!RemainingTime(deadline, remaining)) {
+        success = false;
+        return 0;
+      }
+
+      uint32_t seq = ring.push_seq.load(std::memory_order_seq_cst);
+      ring.pop_waiters.fetch_add(1, std::memory_order_seq_cst);
+      if (ring.head.load(std::memory_order_seq_cst) == tail) {
+        if (!slept) {
+          ring.sleeps.fetch_add(1, std::memory_order_relaxed);
+          slept = true;
+        }
+        FutexWait(&ring.push_seq, seq, deadline);
+      }
+      ring.pop_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    T message = Buffer()[tail % Size()];
+    ring.tail.store(tail + 1, std::memory_order_seq_cst);
+    ring.pop_seq.fetch_add(1, std::memory_order_seq_cst);
+    if (ring.push_waiters.load(std::memory_order_seq_cst) != 0) {
+      FutexWake(&ring.pop_seq, INT_MAX);
+    }
+
+    success = true;
+    return message;
+  }
 
   AllocatedSharedMemory<MessageQueueShm> mq_shm_;
   AllocatedSharedMemory<T> mq_buffer_shm_;
@@ -272,6 +604,9 @@ class MessageQueue {
   MessageQueueShm* mq_shm_ptr_;
   T* mq_buffer_shm_ptr_;
   bi::managed_external_buffer::handle_t mq_handle_;
+  bool spsc_;
+  // The queues are never used across a fork, so the pid is only read once.
+  uint32_t pid_;
 
   /// Create/load a Message queue.
   /// \param mq_shm Message queue representation in shared memory.
@@ -283,6 +618,8 @@ class MessageQueue {
     mq_buffer_shm_ptr_ = mq_buffer_shm_.data_.get();
     mq_shm_ptr_ = mq_shm_.data_.get();
     mq_handle_ = mq_shm_.handle_;
+    spsc_ = mq_shm_ptr_->spsc;
+    pid_ = static_cast<uint32_t>(getpid());
   }
 };
 }}}  // namespace triton::backend::python
@@ -0,0 +1,72 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "neuron_cores.h"
+
+namespace triton { namespace backend { namespace python {
+
+NeuronCoreAllocator::NeuronCoreAllocator(uint32_t core_count)
+    : in_use_(core_count, false)
+{
+}
+
+bool
+NeuronCoreAllocator::Allocate(uint32_t count, uint32_t* first_core)
+{
+  std::lock_guard<std::mutex> lock{mu_};
+  uint32_t free_cores = 0;
+  for (uint32_t core = 0; core < in_use_.size() && count > 0; core++) {
+    free_cores = in_use_[core] ? 0 : free_cores + 1;
+    if (free_cores == count) {
+      *first_core = core + 1 - count;
+      for (uint32_t i = *first_core; i <= core; i++) {
+        in_use_[i] = true;
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+NeuronCoreAllocator::Release(uint32_t first_core, uint32_t count)
+{
+  std::lock_guard<std::mutex> lock{mu_};
+  for (uint32_t core = first_core;
+       core < first_core + count && core < in_use_.size(); core++) {
+    in_use_[core] = false;
+  }
+}
+
+std::string
+NeuronCoreAllocator::CoreRange(uint32_t first_core, uint32_t count)
+{
+  return std::to_string(first_core) + "-" +
+         std::to_string(first_core + count - 1);
+}
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,62 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace triton { namespace backend { namespace python {
+
+//
+// Hands out contiguous ranges of the NeuronCores of the host to the model
+// instances, so that the instances of all the models share the cores without
+// a static layout in their configurations.
+//
+class NeuronCoreAllocator {
+ public:
+  NeuronCoreAllocator(uint32_t core_count);
+
+  // Allocate the first free range of 'count' cores. Returns false if there is
+  // no such range.
+  bool Allocate(uint32_t count, uint32_t* first_core);
+
+  // Return a range returned by 'Allocate'.
+  void Release(uint32_t first_core, uint32_t count);
+
+  uint32_t CoreCount() { return in_use_.size(); }
+
+  // Range of cores in the format of 'NEURON_RT_VISIBLE_CORES', such as "4-7".
+  static std::string CoreRange(uint32_t first_core, uint32_t count);
+
+ private:
+  std::mutex mu_;
+  std::vector<bool> in_use_;
+};
+
+}}}  // namespace triton::backend::python
@@ -28,10 +28,16 @@
 
 #include <archive.h>
 #include <archive_entry.h>
+#include <fcntl.h>
 #include <fts.h>
+#include <sys/file.h>
+#include <unistd.h>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include "pb_utils.h"
 
 
@@ -104,7 +110,7 @@ ExtractTarFile(std::string& archive_path, std::string& dst_path)
   THROW_IF_ERROR(
       "archive_read_open_filename() failed.",
       archive_read_open_filename(
-          input_archive, archive_path.c_str(), 10240 /* block_size */));
+          input_archive, archive_path.c_str(), 1 << 20 /* block_size */));
 
   while (true) {
     int read_status = archive_read_next_header(input_archive, &entry);
@@ -207,8 +213,71 @@ RecursiveDirectoryDelete(const char* dir)
   fts_close(ftsp);
 }
 
-EnvironmentManager::EnvironmentManager()
+// 64-bit FNV-1a hash of a buffer.
+uint64_t
+HashBytes(
+    const char* data, size_t size, uint64_t hash = 14695981039346656037ULL)
 {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string
+HexString(uint64_t value)
+{
+  std::stringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << value;
+  return ss.str();
+}
+
+// Returns a key that identifies the content of the archive.
+std::string
+ArchiveKey(const std::string& archive_path, const struct stat& archive_stat)
+{
+  std::ifstream archive(archive_path, std::ios::binary);
+  if (!archive) {
+    throw PythonBackendException(
+        std::string("Failed to open ") + archive_path + ".");
+  }
+
+  uint64_t hash = 14695981039346656037ULL;
+  std::vector<char> buffer(1 << 20);
+  while (archive) {
+    archive.read(buffer.data(), buffer.size());
+    hash = HashBytes(buffer.data(), archive.gcount(), hash);
+  }
+  if (archive.bad()) {
+    throw PythonBackendException(
+        std::string("Failed to read ") + archive_path + ".");
+  }
+
+  return HexString(hash) + "-" + std::to_string(archive_stat.st_size);
+}
+
+void
+CreateDirectory(const std::string& path)
+{
+  if (mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) != 0 &&
+      errno != EEXIST) {
+    throw PythonBackendException(
+        std::string("Failed to create directory '") + path +
+        "'. Error: " + std::strerror(errno));
+  }
+}
+
+EnvironmentManager::EnvironmentManager(const std::string& cache_path)
+    : cache_path_(cache_path)
+{
+  if (!cache_path_.empty()) {
+    CreateDirectory(cache_path_);
+    CreateDirectory(cache_path_ + "/index");
+    base_path_[0] = '\0';
+    return;
+  }
+
   char tmp_dir_template[PATH_MAX + 1];
   strcpy(tmp_dir_template, "/tmp/python_env_XXXXXX");
 
@@ -234,7 +303,17 @@ EnvironmentManager::ExtractIfNotExtracted(std::string env_path)
   }
 
   // Extract only if the env has not been extracted yet.
-  if (env_map_.find(canonical_env_path) == env_map_.end()) {
+  if (env_map_.find(canonical_env_path) == env_map_.end() &&
+      !cache_path_.empty()) {
+    struct stat env_stat;
+    if (stat(canonical_env_path, &env_stat) != 0) {
+      throw PythonBackendException(
+          std::string("Failed to stat ") + canonical_env_path + ".");
+    }
+    std::string dst_env_path = ExtractToCache(canonical_env_path, env_stat);
+    env_map_.insert({canonical_env_path, dst_env_path});
+    return dst_env_path;
+  } else if (env_map_.find(canonical_env_path) == env_map_.end()) {
     std::string dst_env_path(
         std::string(base_path_) + "/" + std::to_string(env_map_.size()));
 
@@ -258,8 +337,121 @@ EnvironmentManager::ExtractIfNotExtracted(std::string env_path)
   }
 }
 
+std::string
+EnvironmentManager::ExtractToCache(
+    const std::string& env_path, const struct stat& env_stat)
+{
+  // The index maps the path of an archive to the key of its content, so the
+  // archive is only hashed again if its size or modification time changes.
+  std::string index_path =
+      cache_path_ + "/index/" +
+      HexString(HashBytes(env_path.data(), env_path.size()));
+  std::string stamp = std::to_string(env_stat.st_size) + " " +
+                      std::to_string(env_stat.st_mtim.tv_sec) + " " +
+                      std::to_string(env_stat.st_mtim.tv_nsec);
+
+  std::string previous_key;
+  std::string key;
+  {
+    std::ifstream index(index_path);
+    std::string indexed_path, indexed_stamp;
+    if (std::getline(index, indexed_path) &&
+        std::getline(index, indexed_stamp) &&
+        std::getline(index, previous_key) && indexed_path != env_path) {
+      previous_key.clear();
+    }
+    if (!previous_key.empty() && indexed_stamp == stamp) {
+      key = previous_key;
+    }
+  }
+  if (key.empty()) {
+    key = ArchiveKey(env_path, env_stat);
+  }
+
+  // Hold a shared lock on the entry while it is used, including while it is
+  // extracted, so that it can't be removed by another process.
+  std::string entry_path = cache_path_ + "/" + key;
+  int lock_fd = open((entry_path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock_fd == -1 || flock(lock_fd, LOCK_SH) != 0) {
+    if (lock_fd != -1) {
+      close(lock_fd);
+    }
+    throw PythonBackendException(
+        std::string("Failed to lock the cache entry '") + entry_path +
+        "'. Error: " + std::strerror(errno));
+  }
+  cache_lock_fds_.push_back(lock_fd);
+
+  if (!FileExists(entry_path)) {
+    // Extract to a private directory and publish it with a rename, so that
+    // the other processes never see a partially extracted environment.
+    std::string tmp_path = entry_path + ".tmp." + std::to_string(getpid());
+    if (FileExists(tmp_path)) {
+      RecursiveDirectoryDelete(tmp_path.c_str());
+    }
+    CreateDirectory(tmp_path);
+    std::string archive_path(env_path);
+    ExtractTarFile(archive_path, tmp_path);
+    if (rename(tmp_path.c_str(), entry_path.c_str()) != 0) {
+      // Another process has extracted the same archive first.
+      RecursiveDirectoryDelete(tmp_path.c_str());
+      if (!FileExists(entry_path)) {
+        throw PythonBackendException(
+            std::string("Failed to move the environment to '") + entry_path +
+            "'. Error: " + std::strerror(errno));
+      }
+    }
+  }
+
+  if (key != previous_key) {
+    std::string tmp_index_path =
+        index_path + ".tmp." + std::to_string(getpid());
+    {
+      std::ofstream index(tmp_index_path, std::ios::trunc);
+      index << env_path << "\n" << stamp << "\n" << key << "\n";
+    }
+    rename(tmp_index_path.c_str(), index_path.c_str());
+
+    // The archive has changed since it was last extracted.
+    if (!previous_key.empty()) {
+      RemoveUnusedCacheEntry(previous_key);
+    }
+  }
+
+  return entry_path;
+}
+
+void
+EnvironmentManager::RemoveUnusedCacheEntry(const std::string& key)
+{
+  std::string entry_path = cache_path_ + "/" + key;
+  int lock_fd = open((entry_path + ".lock").c_str(), O_RDWR);
+  if (lock_fd == -1) {
+    return;
+  }
+
+  if (flock(lock_fd, LOCK_EX | LOCK_NB) == 0) {
+    try {
+      if (FileExists(entry_path)) {
+        RecursiveDirectoryDelete(entry_path.c_str());
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      // The entry is removed again the next time the archive changes.
+    }
+  }
+  close(lock_fd);
+}
+
 EnvironmentManager::~EnvironmentManager()
 {
+  if (!cache_path_.empty()) {
+    for (const int lock_fd : cache_lock_fds_) {
+      close(lock_fd);
+    }
+    return;
+  }
+
   RecursiveDirectoryDelete(base_path_);
 }
 
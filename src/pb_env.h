@@ -25,10 +25,12 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
+#include <sys/stat.h>
 #include <climits>
 #include <map>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace triton { namespace backend { namespace python {
 
@@ -42,10 +44,24 @@ bool FileExists(std::string& path);
 class EnvironmentManager {
   std::map<std::string, std::string> env_map_;
   char base_path_[PATH_MAX + 1];
+  // Directory of the persistent cache of extracted environments. Empty if the
+  // environments are extracted to a temporary directory.
+  std::string cache_path_;
+  // Shared locks on the cache entries used by this process. The entries are
+  // not removed while any process holds a lock on them.
+  std::vector<int> cache_lock_fds_;
   std::mutex mutex_;
 
+  // Returns the cache entry of the archive, extracting it if the cache
+  // doesn't contain it yet.
+  std::string ExtractToCache(
+      const std::string& env_path, const struct stat& env_stat);
+
+  // Removes a cache entry if no process is using it.
+  void RemoveUnusedCacheEntry(const std::string& key);
+
  public:
-  EnvironmentManager();
+  EnvironmentManager(const std::string& cache_path = "");
 
   // Extracts the tar.gz file in the 'env_path' if it has not been
   // already extracted.
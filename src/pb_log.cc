@@ -26,6 +26,8 @@
 
 #include "pb_log.h"
 
+#include <cstring>
+
 namespace triton { namespace backend { namespace python {
 
 PbLog::PbLog(
@@ -56,66 +58,72 @@ PbLog::Line()
   return line_;
 }
 
-PbLogShm::PbLogShm(
-    AllocatedSharedMemory<LogSendMessage>& log_container_shm,
-    std::unique_ptr<PbString>& filename, std::unique_ptr<PbString>& message)
-    : log_container_shm_(std::move(log_container_shm)),
-      filename_pb_string_(std::move(filename)),
-      message_pb_string_(std::move(message))
-{
-  log_container_shm_ptr_ = log_container_shm_.data_.get();
-  log_container_shm_ptr_->filename = filename_pb_string_->ShmHandle();
-  log_container_shm_ptr_->log_message = message_pb_string_->ShmHandle();
-}
-
-std::unique_ptr<PbLogShm>
-PbLogShm::Create(
-    std::unique_ptr<SharedMemoryManager>& shm_pool, const std::string& filename,
-    const uint32_t& line, const std::string& message, const LogLevel& level)
+bi::managed_external_buffer::handle_t
+PbLogBatch::Create(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const std::vector<std::unique_ptr<PbLog>>& logs, uint32_t dropped_count)
 {
-  std::unique_ptr<PbString> file_name = PbString::Create(shm_pool, filename);
-  std::unique_ptr<PbString> log_message = PbString::Create(shm_pool, message);
-  AllocatedSharedMemory<LogSendMessage> log_send_message =
-      shm_pool->Construct<LogSendMessage>();
+  std::size_t byte_size = sizeof(LogBatchShm);
+  for (auto& log : logs) {
+    byte_size += sizeof(LogRecordShm) + log->Filename().size() +
+                 log->Message().size();
+  }
 
-  LogSendMessage* send_message_payload = log_send_message.data_.get();
-  new (&(send_message_payload->log_mu)) bi::interprocess_mutex;
-  new (&(send_message_payload->log_cv)) bi::interprocess_condition;
-  send_message_payload->line = line;
-  send_message_payload->level = level;
+  AllocatedSharedMemory<char> log_batch_shm = shm_pool->Construct<char>(
+      byte_size, false /* aligned */, ShmObjectType::kLog);
+  char* data = log_batch_shm.data_.get();
+  LogBatchShm batch{static_cast<uint32_t>(logs.size()), dropped_count};
+  std::memcpy(data, &batch, sizeof(LogBatchShm));
+  std::size_t offset = sizeof(LogBatchShm);
+  for (auto& log : logs) {
+    LogRecordShm record{
+        log->Level(), log->Line(),
+        static_cast<uint32_t>(log->Filename().size()),
+        static_cast<uint32_t>(log->Message().size())};
+    std::memcpy(data + offset, &record, sizeof(LogRecordShm));
+    offset += sizeof(LogRecordShm);
+    std::memcpy(data + offset, log->Filename().data(), record.filename_size);
+    offset += record.filename_size;
+    std::memcpy(data + offset, log->Message().data(), record.message_size);
+    offset += record.message_size;
+  }
 
-  return std::unique_ptr<PbLogShm>(
-      new PbLogShm(log_send_message, file_name, log_message));
+  // The shared memory is released by the process that loads the batch.
+  bi::managed_external_buffer::handle_t handle = log_batch_shm.handle_;
+  log_batch_shm.data_.release();
+  return handle;
 }
 
-std::unique_ptr<PbLog>
-PbLogShm::LoadFromSharedMemory(
+std::vector<std::unique_ptr<PbLog>>
+PbLogBatch::LoadFromSharedMemory(
     std::unique_ptr<SharedMemoryManager>& shm_pool,
-    bi::managed_external_buffer::handle_t handle)
+    bi::managed_external_buffer::handle_t handle, uint32_t& dropped_count)
 {
-  AllocatedSharedMemory<LogSendMessage> log_container_shm =
-      shm_pool->Load<LogSendMessage>(handle);
-  std::unique_ptr<PbString> pb_string_filename = PbString::LoadFromSharedMemory(
-      shm_pool, log_container_shm.data_->filename);
-  const std::string& filename = pb_string_filename->String();
-  uint32_t line = log_container_shm.data_->line;
-  std::unique_ptr<PbString> pb_string_msg = PbString::LoadFromSharedMemory(
-      shm_pool, log_container_shm.data_->log_message);
-  const std::string& message = pb_string_msg->String();
-  LogLevel level = log_container_shm.data_->level;
-  return std::unique_ptr<PbLog>(new PbLog(filename, line, message, level));
-}
+  // The batch already holds the reference that was created by the other
+  // process.
+  AllocatedSharedMemory<char> log_batch_shm =
+      shm_pool->Load<char>(handle, true /* unsafe */);
+  const char* data = log_batch_shm.data_.get();
+  LogBatchShm batch;
+  std::memcpy(&batch, data, sizeof(LogBatchShm));
+  dropped_count = batch.dropped_count;
 
-bi::managed_external_buffer::handle_t
-PbLogShm::ShmHandle()
-{
-  return log_container_shm_.handle_;
-}
+  std::vector<std::unique_ptr<PbLog>> logs;
+  logs.reserve(batch.log_count);
+  std::size_t offset = sizeof(LogBatchShm);
+  for (uint32_t i = 0; i < batch.log_count; ++i) {
+    LogRecordShm record;
+    std::memcpy(&record, data + offset, sizeof(LogRecordShm));
+    offset += sizeof(LogRecordShm);
+    std::string filename(data + offset, record.filename_size);
+    offset += record.filename_size;
+    std::string message(data + offset, record.message_size);
+    offset += record.message_size;
+    logs.emplace_back(
+        std::make_unique<PbLog>(filename, record.line, message, record.level));
+  }
 
-LogSendMessage*
-PbLogShm::LogMessage()
-{
-  return log_container_shm_ptr_;
+  return logs;
 }
 
 }}}  // namespace triton::backend::python
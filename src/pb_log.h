@@ -27,6 +27,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "pb_string.h"
 #include "pb_utils.h"
 
@@ -58,34 +59,18 @@ class PbLog {
   LogLevel level_;
 };
 
-class PbLogShm {
+class PbLogBatch {
  public:
-  /// Save PbLog object to shared memory
-  static std::unique_ptr<PbLogShm> Create(
+  /// Save a batch of log messages to shared memory. The ownership of the
+  /// shared memory is passed to the process that loads the batch.
+  static bi::managed_external_buffer::handle_t Create(
       std::unique_ptr<SharedMemoryManager>& shm_pool,
-      const std::string& filename, const uint32_t& line,
-      const std::string& message, const LogLevel& level);
-  
-  /// Load PbLog object to shared memory
-  static std::unique_ptr<PbLog> LoadFromSharedMemory(
-      std::unique_ptr<SharedMemoryManager>& shm_pool,
-      bi::managed_external_buffer::handle_t handle);
-
-  /// Get the shared memory handle of the saved log message
-  bi::managed_external_buffer::handle_t ShmHandle();
+      const std::vector<std::unique_ptr<PbLog>>& logs, uint32_t dropped_count);
 
-  /// Get a pointer to the saved log message
-  LogSendMessage* LogMessage();
-
- private:
-  AllocatedSharedMemory<LogSendMessage> log_container_shm_;
-  std::unique_ptr<PbString> filename_pb_string_;
-  std::unique_ptr<PbString> message_pb_string_;
-
-  LogSendMessage* log_container_shm_ptr_;
-
-  PbLogShm(
-      AllocatedSharedMemory<LogSendMessage>& log_container_shm,
-      std::unique_ptr<PbString>& filename, std::unique_ptr<PbString>& message);
+  /// Load a batch of log messages from shared memory and release the shared
+  /// memory.
+  static std::vector<std::unique_ptr<PbLog>> LoadFromSharedMemory(
+      std::unique_ptr<SharedMemoryManager>& shm_pool,
+      bi::managed_external_buffer::handle_t handle, uint32_t& dropped_count);
 };
 }}};  // namespace triton::backend::python
@@ -45,7 +45,8 @@ PbMemory::Create(
   }
 
   AllocatedSharedMemory<char> memory_shm =
-      shm_pool->Construct<char>(requested_byte_size);
+      shm_pool->Construct<char>(
+          requested_byte_size, false /* aligned */, ShmObjectType::kMemory);
   PbMemory::FillShmData(
       memory_type, memory_type_id, byte_size, data, memory_shm.data_.get(),
       memory_shm.handle_, copy_gpu);
@@ -58,7 +59,8 @@ PbMemory::Create(
       new PbMemory(memory_shm, data, false /* opened_cuda_ipc_handle */));
 
 #ifdef TRITON_ENABLE_GPU
-  if (memory_type == TRITONSERVER_MEMORY_GPU) {
+  if (memory_type == TRITONSERVER_MEMORY_GPU &&
+      !pb_memory->memory_shm_ptr_->is_in_cuda_pool) {
     pb_memory->memory_shm_ptr_->gpu_pointer_offset =
         pb_memory->GetGPUPointerOffset();
   }
@@ -81,6 +83,70 @@ PbMemory::Create(
 }
 #endif
 
+std::unique_ptr<PbMemory>
+PbMemory::Create(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const ExternalShmLocation& location, uint64_t byte_size, char* data)
+{
+  AllocatedSharedMemory<char> memory_shm =
+      shm_pool->Construct<char>(
+          sizeof(MemoryShm) + location.name.size() + 1, false /* aligned */,
+          ShmObjectType::kMemory);
+  PbMemory::FillShmData(
+      TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, byte_size,
+      nullptr /* data */, memory_shm.data_.get(), memory_shm.handle_,
+      false /* copy_gpu */);
+
+  MemoryShm* memory_shm_ptr =
+      reinterpret_cast<MemoryShm*>(memory_shm.data_.get());
+  memory_shm_ptr->is_external = true;
+  memory_shm_ptr->external_inode = location.inode;
+  memory_shm_ptr->external_offset = location.offset;
+  std::memcpy(
+      memory_shm.data_.get() + sizeof(MemoryShm), location.name.c_str(),
+      location.name.size() + 1);
+
+  return std::unique_ptr<PbMemory>(
+      new PbMemory(memory_shm, data, false /* opened_cuda_ipc_handle */));
+}
+
+std::unique_ptr<PbMemory>
+PbMemory::Create(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    bi::managed_external_buffer::handle_t data_handle, uint64_t data_offset,
+    uint64_t byte_size)
+{
+  AllocatedSharedMemory<char> memory_shm =
+      shm_pool->Construct<char>(
+          sizeof(MemoryShm), false /* aligned */, ShmObjectType::kMemory);
+  PbMemory::FillShmData(
+      TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, byte_size,
+      nullptr /* data */, memory_shm.data_.get(), memory_shm.handle_,
+      false /* copy_gpu */);
+
+  MemoryShm* memory_shm_ptr =
+      reinterpret_cast<MemoryShm*>(memory_shm.data_.get());
+  memory_shm_ptr->data_handle = data_handle;
+  memory_shm_ptr->data_offset = data_offset;
+
+  AllocatedSharedMemory<char> data_shm = shm_pool->Load<char>(data_handle);
+  char* data = data_shm.data_.get() + data_offset;
+  std::unique_ptr<PbMemory> pb_memory(
+      new PbMemory(memory_shm, data, false /* opened_cuda_ipc_handle */));
+  pb_memory->data_shm_ = std::move(data_shm);
+
+  return pb_memory;
+}
+
+std::shared_ptr<char>
+PbMemory::MapExternalData(MemoryShm* memory_shm_ptr)
+{
+  std::string name(reinterpret_cast<char*>(memory_shm_ptr) + sizeof(MemoryShm));
+  return ExternalShmMappings::GetInstance().Map(
+      name, memory_shm_ptr->external_inode, memory_shm_ptr->external_offset,
+      memory_shm_ptr->byte_size);
+}
+
 std::unique_ptr<PbMemory>
 PbMemory::Create(
     TRITONSERVER_MemoryType memory_type, int64_t memory_type_id,
@@ -98,7 +164,8 @@ PbMemory::Create(
       new PbMemory(data_shm, data, handle, false /* opened_cuda_ipc_handle */));
 
 #ifdef TRITON_ENABLE_GPU
-  if (memory_type == TRITONSERVER_MEMORY_GPU) {
+  if (memory_type == TRITONSERVER_MEMORY_GPU &&
+      !pb_memory->memory_shm_ptr_->is_in_cuda_pool) {
     pb_memory->memory_shm_ptr_->gpu_pointer_offset =
         pb_memory->GetGPUPointerOffset();
   }
@@ -163,10 +230,25 @@ PbMemory::FillShmData(
   MemoryShm* memory_shm_ptr = reinterpret_cast<MemoryShm*>(data_shm);
   memory_shm_ptr->is_cuda_handle_set = copy_gpu;
   memory_shm_ptr->memory_release_id = 0;
+  memory_shm_ptr->is_external = false;
+  memory_shm_ptr->data_handle = 0;
+  memory_shm_ptr->upstream_input_address = 0;
+  memory_shm_ptr->is_in_cuda_pool = false;
 
   if (memory_type == TRITONSERVER_MEMORY_GPU) {
 #ifdef TRITON_ENABLE_GPU
-    if (data != nullptr) {
+    CudaSharedPool* cuda_pool =
+        data != nullptr ? CudaSharedPool::FindByAddress(data) : nullptr;
+    if (cuda_pool != nullptr) {
+      // The handle of the pool is set even if 'copy_gpu' is false so that the
+      // processes that didn't open the pool can still open the memory.
+      memory_shm_ptr->is_in_cuda_pool = true;
+      memory_shm_ptr->is_cuda_handle_set = true;
+      memory_shm_ptr->gpu_pointer_offset = data - cuda_pool->Base();
+      std::memcpy(
+          memory_data_shm, &cuda_pool->IpcHandle(),
+          sizeof(cudaIpcMemHandle_t));
+    } else if (data != nullptr) {
       if (copy_gpu) {
         // [FIXME] Restore the previous device
         THROW_IF_CUDA_ERROR(cudaSetDevice(memory_type_id));
@@ -196,7 +278,29 @@ PbMemory::LoadFromSharedMemory(
 
   char* data_ptr = nullptr;
   bool opened_cuda_ipc_handle = false;
-  if (memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU &&
+  std::shared_ptr<char> external_data;
+  if (memory_shm_ptr->data_handle != 0) {
+    throw PythonBackendException(
+        "Memory that refers to another allocation of the shared memory pool "
+        "must be loaded from the pool.");
+  } else if (memory_shm_ptr->is_external) {
+    external_data = MapExternalData(memory_shm_ptr);
+    data_ptr = external_data.get();
+#ifdef TRITON_ENABLE_GPU
+  } else if (
+      memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU &&
+      CudaPoolDataPtr(memory_shm_ptr) != nullptr) {
+    data_ptr = CudaPoolDataPtr(memory_shm_ptr);
+#endif
+#ifndef TRITON_PB_STUB
+  } else if (
+      memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU &&
+      memory_shm_ptr->upstream_input_address != 0 && !open_cuda_handle) {
+    data_ptr =
+        reinterpret_cast<char*>(memory_shm_ptr->upstream_input_address);
+#endif
+  } else if (
+      memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU &&
       open_cuda_handle) {
 #ifdef TRITON_ENABLE_GPU
     cudaIpcMemHandle_t* cuda_handle =
@@ -207,7 +311,8 @@ PbMemory::LoadFromSharedMemory(
     void* data_ptr_base;
     CUDAHandler& cuda_handler = CUDAHandler::getInstance();
     cuda_handler.OpenCudaHandle(
-        memory_shm_ptr->memory_type_id, cuda_handle, &data_ptr_base);
+        memory_shm_ptr->memory_type_id, cuda_handle, &data_ptr_base,
+        IsCudaHandleCacheable(memory_shm_ptr));
 
     data_ptr =
         (reinterpret_cast<char*>(data_ptr_base) +
@@ -217,9 +322,11 @@ PbMemory::LoadFromSharedMemory(
   } else {
     data_ptr = memory_data_shm;
   }
-  return std::unique_ptr<PbMemory>(new PbMemory(
+  std::unique_ptr<PbMemory> pb_memory(new PbMemory(
       data_shm, data_ptr, handle,
       opened_cuda_ipc_handle /* opened_cuda_ipc_handle */));
+  pb_memory->external_data_ = std::move(external_data);
+  return pb_memory;
 }
 
 
@@ -235,7 +342,21 @@ PbMemory::LoadFromSharedMemory(
 
   char* data_ptr = nullptr;
   bool opened_cuda_ipc_handle = false;
-  if (memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU) {
+  std::shared_ptr<char> external_data;
+  AllocatedSharedMemory<char> data_shm;
+  if (memory_shm_ptr->data_handle != 0) {
+    data_shm = shm_pool->Load<char>(memory_shm_ptr->data_handle);
+    data_ptr = data_shm.data_.get() + memory_shm_ptr->data_offset;
+  } else if (memory_shm_ptr->is_external) {
+    external_data = MapExternalData(memory_shm_ptr);
+    data_ptr = external_data.get();
+#ifdef TRITON_ENABLE_GPU
+  } else if (
+      memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU &&
+      CudaPoolDataPtr(memory_shm_ptr) != nullptr) {
+    data_ptr = CudaPoolDataPtr(memory_shm_ptr);
+#endif
+  } else if (memory_shm_ptr->memory_type == TRITONSERVER_MEMORY_GPU) {
     if (memory_shm_ptr->byte_size > 0 && open_cuda_handle) {
 #ifdef TRITON_ENABLE_GPU
       cudaIpcMemHandle_t* cuda_handle =
@@ -247,7 +368,8 @@ PbMemory::LoadFromSharedMemory(
       void* data_ptr_base;
       CUDAHandler& cuda_handler = CUDAHandler::getInstance();
       cuda_handler.OpenCudaHandle(
-          memory_shm_ptr->memory_type_id, cuda_handle, &data_ptr_base);
+          memory_shm_ptr->memory_type_id, cuda_handle, &data_ptr_base,
+          IsCudaHandleCacheable(memory_shm_ptr));
 
       data_ptr =
           (reinterpret_cast<char*>(data_ptr_base) +
@@ -255,12 +377,21 @@ PbMemory::LoadFromSharedMemory(
       opened_cuda_ipc_handle = true;
 #endif
     }
+#ifndef TRITON_PB_STUB
+    if (!open_cuda_handle) {
+      data_ptr =
+          reinterpret_cast<char*>(memory_shm_ptr->upstream_input_address);
+    }
+#endif
   } else {
     data_ptr = memory_data_shm;
   }
-  return std::unique_ptr<PbMemory>(new PbMemory(
+  std::unique_ptr<PbMemory> pb_memory(new PbMemory(
       memory_shm, data_ptr,
       opened_cuda_ipc_handle /* opened_cuda_ipc_handle */));
+  pb_memory->external_data_ = std::move(external_data);
+  pb_memory->data_shm_ = std::move(data_shm);
+  return pb_memory;
 }
 
 PbMemory::PbMemory(
@@ -362,6 +493,79 @@ PbMemory::DataPtr() const
   return data_ptr_;
 }
 
+bi::managed_external_buffer::handle_t
+PbMemory::DataHandle() const
+{
+  return memory_shm_ptr_->data_handle;
+}
+
+uint64_t
+PbMemory::DataOffset() const
+{
+  return memory_shm_ptr_->data_offset;
+}
+
+void
+PbMemory::SetUpstreamInputAddress(void* address)
+{
+  memory_shm_ptr_->upstream_input_address =
+      reinterpret_cast<uint64_t>(address);
+}
+
+bool
+PbMemory::IsUpstreamInput() const
+{
+  return memory_shm_ptr_->upstream_input_address != 0;
+}
+
+bool
+PbMemory::IsInCudaPool() const
+{
+  return memory_shm_ptr_->is_in_cuda_pool;
+}
+
+std::unique_ptr<PbMemory>
+PbMemory::Slice(
+    std::unique_ptr<SharedMemoryManager>& shm_pool, uint64_t offset,
+    uint64_t byte_size)
+{
+  if (MemoryType() == TRITONSERVER_MEMORY_GPU) {
+    throw PythonBackendException("GPU memory cannot be sliced.");
+  }
+
+  if (offset + byte_size > ByteSize()) {
+    throw PythonBackendException(
+        "Slice of " + std::to_string(byte_size) + " bytes at offset " +
+        std::to_string(offset) + " is out of the bounds of memory of " +
+        std::to_string(ByteSize()) + " bytes.");
+  }
+
+  if (memory_shm_ptr_->data_handle != 0) {
+    return PbMemory::Create(
+        shm_pool, memory_shm_ptr_->data_handle,
+        memory_shm_ptr_->data_offset + offset, byte_size);
+  }
+
+  if (memory_shm_ptr_->is_external) {
+    ExternalShmLocation location{
+        reinterpret_cast<char*>(memory_shm_ptr_) + sizeof(MemoryShm),
+        memory_shm_ptr_->external_inode,
+        memory_shm_ptr_->external_offset + offset};
+    std::unique_ptr<PbMemory> pb_memory =
+        PbMemory::Create(shm_pool, location, byte_size, data_ptr_ + offset);
+    pb_memory->external_data_ = external_data_;
+    return pb_memory;
+  }
+
+  if (memory_shm_.data_) {
+    return PbMemory::Create(
+        shm_pool, memory_shm_handle_, sizeof(MemoryShm) + offset, byte_size);
+  }
+
+  throw PythonBackendException(
+      "Memory that is stored inside another object cannot be sliced.");
+}
+
 uint64_t
 PbMemory::ShmStructSize(TRITONSERVER_MemoryType memory_type, uint64_t byte_size)
 {
@@ -378,6 +582,40 @@ PbMemory::ShmStructSize(TRITONSERVER_MemoryType memory_type, uint64_t byte_size)
 }
 
 #ifdef TRITON_ENABLE_GPU
+char*
+PbMemory::CudaPoolDataPtr(MemoryShm* memory_shm_ptr)
+{
+  if (!memory_shm_ptr->is_in_cuda_pool) {
+    return nullptr;
+  }
+
+  CudaSharedPool* cuda_pool =
+      CudaSharedPool::Find(memory_shm_ptr->memory_type_id);
+  if (cuda_pool == nullptr) {
+    return nullptr;
+  }
+
+  return cuda_pool->Base() + memory_shm_ptr->gpu_pointer_offset;
+}
+
+bool
+PbMemory::IsCudaHandleCacheable(MemoryShm* memory_shm_ptr)
+{
+  // The pool is never freed while the processes are running, so its handle
+  // can stay open.
+  if (memory_shm_ptr->is_in_cuda_pool) {
+    return true;
+  }
+
+#ifdef TRITON_PB_STUB
+  // The memory that is released through the memory manager is freed by the
+  // parent process once the stub closes it, which must not be delayed.
+  return memory_shm_ptr->memory_release_id == 0;
+#else
+  return false;
+#endif
+}
+
 void
 PbMemory::SetCudaIpcHandle(cudaIpcMemHandle_t* cuda_ipc_handle)
 {
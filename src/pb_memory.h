@@ -26,6 +26,8 @@
 
 #pragma once
 
+#include "cuda_shared_pool.h"
+#include "external_shm.h"
 #include "pb_utils.h"
 #include "shm_manager.h"
 #include "triton/backend/backend_common.h"
@@ -50,6 +52,29 @@ struct MemoryShm {
   uint64_t byte_size;
   bool is_cuda_handle_set;
   uint64_t memory_release_id;
+
+  // CPU memory that is stored in an external shared memory object instead of
+  // following this struct. The name of the object follows this struct.
+  bool is_external;
+  uint64_t external_inode;
+  uint64_t external_offset;
+
+  // CPU memory that is stored in another allocation of the shared memory
+  // pool instead of following this struct. Zero if the data follows this
+  // struct.
+  bi::managed_external_buffer::handle_t data_handle;
+  uint64_t data_offset;
+
+  // The address of the GPU buffer in the parent process if the memory holds
+  // an input of a model request, zero otherwise. BLS requests that forward
+  // the input use this buffer instead of a copy.
+  uint64_t upstream_input_address;
+
+  // GPU memory that is allocated from the CUDA shared pool of the device.
+  // 'gpu_pointer_offset' is the offset from the base of the pool, which the
+  // processes that opened the pool resolve without opening the CUDA IPC
+  // handle of the memory.
+  bool is_in_cuda_pool;
 };
 
 class PbMemory {
@@ -70,6 +95,23 @@ class PbMemory {
       std::unique_ptr<BackendMemory>&& backend_memory, bool copy_gpu = true);
 #endif
 
+  /// Create a reference to CPU memory in an external shared memory object
+  /// without copying the data.
+  /// \param location The location of the data in the external object.
+  /// \param data The data as mapped by the current process.
+  static std::unique_ptr<PbMemory> Create(
+      std::unique_ptr<SharedMemoryManager>& shm_pool,
+      const ExternalShmLocation& location, uint64_t byte_size, char* data);
+
+  /// Create a reference to a part of another CPU allocation of the pool, e.g.
+  /// a buffer that holds an input of all the requests of a batch.
+  /// \param data_handle The handle of the allocation that holds the data.
+  /// \param data_offset The offset of the data in the allocation.
+  static std::unique_ptr<PbMemory> Create(
+      std::unique_ptr<SharedMemoryManager>& shm_pool,
+      bi::managed_external_buffer::handle_t data_handle, uint64_t data_offset,
+      uint64_t byte_size);
+
 #ifdef TRITON_ENABLE_GPU
   void SetCudaIpcHandle(cudaIpcMemHandle_t* cuda_ipc_handle);
 #endif
@@ -109,6 +151,36 @@ class PbMemory {
   /// \return The memory type id of the tensor.
   char* ShmData() const;
 
+  /// Get the allocation that holds the data if the data does not follow the
+  /// memory struct.
+  /// \return The handle of the allocation, or zero.
+  bi::managed_external_buffer::handle_t DataHandle() const;
+
+  /// Get the offset of the data in the allocation returned by 'DataHandle'.
+  uint64_t DataOffset() const;
+
+  /// Mark the GPU memory as the buffer of an input of a model request.
+  /// \param address The address of the buffer in the parent process.
+  void SetUpstreamInputAddress(void* address);
+
+  /// Whether the GPU memory is the buffer of an input of a model request
+  /// that can be used by BLS requests without copying it.
+  bool IsUpstreamInput() const;
+
+  /// Whether the GPU memory is allocated from the CUDA shared pool of the
+  /// device, in which case it is resolved from the pool that both processes
+  /// opened.
+  bool IsInCudaPool() const;
+
+  /// Create a reference to a part of the CPU memory without copying it.
+  /// \param offset The offset of the part from the start of the memory.
+  /// \param byte_size The size of the part.
+  /// \throws PythonBackendException if the memory is in GPU or is stored
+  /// inside another object, e.g. a tensor.
+  std::unique_ptr<PbMemory> Slice(
+      std::unique_ptr<SharedMemoryManager>& shm_pool, uint64_t offset,
+      uint64_t byte_size);
+
   /// Set the memory release id
   void SetMemoryReleaseId(uint64_t memory_release_id);
 
@@ -129,6 +201,13 @@ class PbMemory {
 
   std::function<void()> release_callback_;
 
+  // Keeps the mapping of an external shared memory object alive.
+  std::shared_ptr<char> external_data_;
+
+  // Keeps the allocation that holds the data alive if the data does not
+  // follow the memory struct.
+  AllocatedSharedMemory<char> data_shm_;
+
   // Refers to the pointer that can hold the data. For CPU pointers this will be
   // the same as memory_data_shm_ptr_.
   char* data_ptr_;
@@ -137,6 +216,17 @@ class PbMemory {
   bool opened_cuda_ipc_handle_;
 
 #ifdef TRITON_ENABLE_GPU
+  /// Whether the CUDA IPC handle of the memory can stay open after the memory
+  /// is released so that it is reused by the next memory in the same base
+  /// allocation.
+  static bool IsCudaHandleCacheable(MemoryShm* memory_shm_ptr);
+
+  /// Get the address of memory allocated from a CUDA shared pool that this
+  /// process opened.
+  /// \return The address, or nullptr if the memory is not in a pool or this
+  /// process doesn't have the pool of the device.
+  static char* CudaPoolDataPtr(MemoryShm* memory_shm_ptr);
+
   /// Calculate the pointer offest from the base address.
   /// \return The offset of a device pointer.
   /// \throws PythonBackendException if the tensor is stored in CPU.
@@ -149,6 +239,9 @@ class PbMemory {
 
 #endif
 
+  // Map the data of an external shared memory object.
+  static std::shared_ptr<char> MapExternalData(MemoryShm* memory_shm_ptr);
+
   static void FillShmData(
       TRITONSERVER_MemoryType memory_type, int64_t memory_type_id,
       uint64_t byte_size, char* data, char* data_shm,
@@ -26,6 +26,8 @@
 
 #include "pb_metric_reporter.h"
 
+#include <algorithm>
+
 #include "triton/backend/backend_common.h"
 
 namespace triton { namespace backend { namespace python {
@@ -69,7 +71,16 @@ PbMetricReporter::~PbMetricReporter()
 
   // Report the entire batch statistics. This backend does not support
   // batching so the total batch size is always 1.
-  if (total_batch_size_ != 0) {
+  if (total_batch_size_ != 0 && pooled_batch_statistics_ != nullptr) {
+    std::lock_guard<std::mutex> lock(pooled_batch_statistics_->mu);
+    pooled_batch_statistics_->total_batch_size += total_batch_size_;
+    if (pooled_batch_statistics_->compute_start_ns == 0 ||
+        compute_start_ns_ < pooled_batch_statistics_->compute_start_ns) {
+      pooled_batch_statistics_->compute_start_ns = compute_start_ns_;
+    }
+    pooled_batch_statistics_->compute_end_ns =
+        std::max(pooled_batch_statistics_->compute_end_ns, compute_end_ns_);
+  } else if (total_batch_size_ != 0) {
     LOG_IF_ERROR(
         TRITONBACKEND_ModelInstanceReportBatchStatistics(
             instance_, total_batch_size_, exec_start_ns_, compute_start_ns_,
@@ -114,4 +125,11 @@ PbMetricReporter::SetSuccessStatus(const bool success_status)
   success_status_ = success_status;
 }
 
+void
+PbMetricReporter::SetPooledBatchStatistics(
+    std::shared_ptr<PooledBatchStatistics> pooled_batch_statistics)
+{
+  pooled_batch_statistics_ = pooled_batch_statistics;
+}
+
 }}}  // namespace triton::backend::python
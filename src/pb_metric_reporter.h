@@ -27,11 +27,23 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "triton/core/tritonbackend.h"
 
 namespace triton { namespace backend { namespace python {
+
+// Batch statistics of a batch whose requests are split between the stub
+// processes of a stub pool. Every part adds its batch size and compute time
+// and the owner of the batch reports the statistics once.
+struct PooledBatchStatistics {
+  std::mutex mu;
+  size_t total_batch_size = 0;
+  uint64_t compute_start_ns = 0;
+  uint64_t compute_end_ns = 0;
+};
+
 class PbMetricReporter {
   TRITONBACKEND_ModelInstance* instance_;
   TRITONBACKEND_Request** requests_;
@@ -43,6 +55,7 @@ class PbMetricReporter {
   uint64_t compute_end_ns_;
   uint64_t exec_end_ns_;
   bool success_status_;
+  std::shared_ptr<PooledBatchStatistics> pooled_batch_statistics_;
 
  public:
   PbMetricReporter(
@@ -56,5 +69,9 @@ class PbMetricReporter {
   void SetComputeEndNs(const uint64_t compute_end_ns);
   void SetExecEndNs(const uint64_t exec_end_ns);
   void SetSuccessStatus(const bool success_status);
+  // Add the batch statistics to the statistics of the pooled batch instead of
+  // reporting them.
+  void SetPooledBatchStatistics(
+      std::shared_ptr<PooledBatchStatistics> pooled_batch_statistics);
 };
 }}};  // namespace triton::backend::python
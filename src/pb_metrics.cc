@@ -0,0 +1,273 @@
+// Copyright (c) 2022, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "pb_metrics.h"
+
+#include "triton/backend/backend_common.h"
+
+namespace triton { namespace backend { namespace python {
+
+namespace {
+
+std::unique_ptr<PbMetricFamily>
+CreateFamily(
+    TRITONSERVER_MetricKind kind, const std::string& name,
+    const std::string& description, const std::vector<double>& buckets = {})
+{
+  try {
+    return std::make_unique<PbMetricFamily>(kind, name, description, buckets);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_WARN,
+        (std::string("Failed to register metric family '") + name +
+         "': " + pb_exception.what())
+            .c_str());
+  }
+
+  return nullptr;
+}
+
+}  // namespace
+
+PbMetricFamily::PbMetricFamily(
+    TRITONSERVER_MetricKind kind, const std::string& name,
+    const std::string& description, const std::vector<double>& buckets)
+    : family_(nullptr), kind_(kind), buckets_(buckets)
+{
+  THROW_IF_TRITON_ERROR(TRITONSERVER_MetricFamilyNew(
+      &family_, kind, name.c_str(), description.c_str()));
+}
+
+PbMetricFamily::~PbMetricFamily()
+{
+  if (family_ != nullptr) {
+    LOG_IF_ERROR(
+        TRITONSERVER_MetricFamilyDelete(family_),
+        "failed to delete metric family");
+  }
+}
+
+PbMetric::PbMetric(
+    PbMetricFamily* family,
+    const std::vector<std::pair<std::string, std::string>>& labels)
+    : metric_(nullptr), last_total_(0)
+{
+  std::vector<const TRITONSERVER_Parameter*> parameters;
+  for (const auto& label : labels) {
+    parameters.push_back(TRITONSERVER_ParameterNew(
+        label.first.c_str(), TRITONSERVER_PARAMETER_STRING,
+        label.second.c_str()));
+  }
+
+  TRITONSERVER_Error* error = nullptr;
+  if (family->Kind() == TRITONSERVER_METRIC_KIND_HISTOGRAM) {
+    TRITONSERVER_MetricArgs* args = nullptr;
+    error = TRITONSERVER_MetricArgsNew(&args);
+    if (error == nullptr) {
+      error = TRITONSERVER_MetricArgsSetHistogram(
+          args, family->Buckets().data(), family->Buckets().size());
+    }
+    if (error == nullptr) {
+      error = TRITONSERVER_MetricNewWithArgs(
+          &metric_, family->Family(), parameters.data(), parameters.size(),
+          args);
+    }
+    if (args != nullptr) {
+      LOG_IF_ERROR(
+          TRITONSERVER_MetricArgsDelete(args),
+          "failed to delete metric arguments");
+    }
+  } else {
+    error = TRITONSERVER_MetricNew(
+        &metric_, family->Family(), parameters.data(), parameters.size());
+  }
+  for (auto parameter : parameters) {
+    TRITONSERVER_ParameterDelete(
+        const_cast<TRITONSERVER_Parameter*>(parameter));
+  }
+  THROW_IF_TRITON_ERROR(error);
+}
+
+PbMetric::~PbMetric()
+{
+  if (metric_ != nullptr) {
+    LOG_IF_ERROR(
+        TRITONSERVER_MetricDelete(metric_), "failed to delete metric");
+  }
+}
+
+void
+PbMetric::Increment(double value)
+{
+  LOG_IF_ERROR(
+      TRITONSERVER_MetricIncrement(metric_, value),
+      "failed to increment metric");
+}
+
+void
+PbMetric::Set(double value)
+{
+  LOG_IF_ERROR(TRITONSERVER_MetricSet(metric_, value), "failed to set metric");
+}
+
+void
+PbMetric::Observe(double value)
+{
+  LOG_IF_ERROR(
+      TRITONSERVER_MetricObserve(metric_, value), "failed to observe metric");
+}
+
+void
+PbMetric::AdvanceTo(uint64_t total)
+{
+  if (total < last_total_) {
+    last_total_ = 0;
+  }
+
+  if (total != last_total_) {
+    Increment(total - last_total_);
+    last_total_ = total;
+  }
+}
+
+PbMetricFamilies::PbMetricFamilies()
+{
+  ipc_spin_hits = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER, "nv_python_backend_ipc_spin_hits",
+      "Number of IPC message waits that were satisfied while spinning");
+  ipc_sleeps = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER, "nv_python_backend_ipc_sleeps",
+      "Number of IPC message waits that had to sleep");
+  shm_lock_acquisitions = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER,
+      "nv_python_backend_shm_lock_acquisitions",
+      "Number of shared memory allocator lock acquisitions");
+  shm_lock_contentions = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER,
+      "nv_python_backend_shm_lock_contentions",
+      "Number of shared memory allocator lock acquisitions that had to wait");
+  shm_thread_cache_hits = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER,
+      "nv_python_backend_shm_thread_cache_hits",
+      "Number of small shared memory allocations served by a thread cache");
+  shm_thread_cache_misses = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER,
+      "nv_python_backend_shm_thread_cache_misses",
+      "Number of small shared memory allocations that refilled a thread "
+      "cache");
+  closed_request_checks = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER,
+      "nv_python_backend_closed_request_checks",
+      "Number of times a decoupled request was checked for a final response");
+  dropped_log_messages = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER,
+      "nv_python_backend_dropped_log_messages",
+      "Number of log messages of the stub that were dropped because the log "
+      "queue was full");
+  phase_duration = CreateFamily(
+      TRITONSERVER_METRIC_KIND_HISTOGRAM,
+      "nv_python_backend_phase_duration_us",
+      "Duration of the phases of the execution of a batch in microseconds",
+      {10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000});
+  stub_time = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER, "nv_python_backend_stub_time_us",
+      "Cumulative time of the stub process holding or waiting for the GIL, in "
+      "BLS requests and in garbage collections in microseconds");
+  shm_allocations = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER, "nv_python_backend_shm_allocations",
+      "Number of shared memory allocations by the largest requested size in "
+      "bytes");
+  shm_live_objects = CreateFamily(
+      TRITONSERVER_METRIC_KIND_GAUGE, "nv_python_backend_shm_live_objects",
+      "Number of objects in the shared memory by object type");
+  shm_peak_allocated_bytes = CreateFamily(
+      TRITONSERVER_METRIC_KIND_GAUGE,
+      "nv_python_backend_shm_peak_allocated_bytes",
+      "Largest number of bytes allocated from the shared memory region");
+  shm_grows = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER, "nv_python_backend_shm_grows",
+      "Number of attempts to grow the shared memory region by result");
+  shm_fragmentation = CreateFamily(
+      TRITONSERVER_METRIC_KIND_GAUGE, "nv_python_backend_shm_fragmentation",
+      "Fraction of the free shared memory that cannot be allocated as a "
+      "single block");
+  bls_cache_requests = CreateFamily(
+      TRITONSERVER_METRIC_KIND_COUNTER, "nv_python_backend_bls_cache_requests",
+      "Number of BLS requests that looked up the BLS response cache by result");
+  bls_cache_bytes = CreateFamily(
+      TRITONSERVER_METRIC_KIND_GAUGE, "nv_python_backend_bls_cache_bytes",
+      "Number of bytes of the inputs and outputs in the BLS response cache");
+}
+
+std::unique_ptr<PbMetric>
+CreateMetric(
+    std::unique_ptr<PbMetricFamily>& family,
+    const std::vector<std::pair<std::string, std::string>>& labels)
+{
+  if (family == nullptr) {
+    return nullptr;
+  }
+
+  try {
+    return std::make_unique<PbMetric>(family.get(), labels);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_WARN,
+        (std::string("Failed to create metric: ") + pb_exception.what())
+            .c_str());
+  }
+
+  return nullptr;
+}
+
+void
+AdvanceMetric(std::unique_ptr<PbMetric>& metric, uint64_t total)
+{
+  if (metric != nullptr) {
+    metric->AdvanceTo(total);
+  }
+}
+
+void
+ObserveMetric(std::unique_ptr<PbMetric>& metric, double value)
+{
+  if (metric != nullptr) {
+    metric->Observe(value);
+  }
+}
+
+void
+SetMetric(std::unique_ptr<PbMetric>& metric, double value)
+{
+  if (metric != nullptr) {
+    metric->Set(value);
+  }
+}
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,131 @@
+// Copyright (c) 2022, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "pb_utils.h"
+#include "triton/core/tritonserver.h"
+
+namespace triton { namespace backend { namespace python {
+
+// A metric family registered with the Triton metrics endpoint. The families
+// are created once per backend and shared by all the model instances. The
+// buckets are only used by histogram families and are shared by all the
+// metrics of the family.
+class PbMetricFamily {
+ public:
+  PbMetricFamily(
+      TRITONSERVER_MetricKind kind, const std::string& name,
+      const std::string& description,
+      const std::vector<double>& buckets = {});
+  ~PbMetricFamily();
+
+  TRITONSERVER_MetricFamily* Family() { return family_; }
+  TRITONSERVER_MetricKind Kind() { return kind_; }
+  const std::vector<double>& Buckets() { return buckets_; }
+
+  DISALLOW_COPY_AND_ASSIGN(PbMetricFamily);
+
+ private:
+  TRITONSERVER_MetricFamily* family_;
+  TRITONSERVER_MetricKind kind_;
+  std::vector<double> buckets_;
+};
+
+// A single labeled metric that belongs to a metric family.
+class PbMetric {
+ public:
+  PbMetric(
+      PbMetricFamily* family,
+      const std::vector<std::pair<std::string, std::string>>& labels);
+  ~PbMetric();
+
+  // Increment the value of a counter or gauge.
+  void Increment(double value);
+
+  // Set the value of a gauge.
+  void Set(double value);
+
+  // Add an observation to a histogram.
+  void Observe(double value);
+
+  // Advance a counter to 'total' given a monotonically increasing total that
+  // is maintained elsewhere (e.g. in the shared memory). If the total went
+  // backwards, the source was reset and the whole total is added.
+  void AdvanceTo(uint64_t total);
+
+  DISALLOW_COPY_AND_ASSIGN(PbMetric);
+
+ private:
+  TRITONSERVER_Metric* metric_;
+  uint64_t last_total_;
+};
+
+// Metric families exported by the Python backend. A family is nullptr if it
+// could not be registered, for example when metrics are disabled.
+struct PbMetricFamilies {
+  PbMetricFamilies();
+
+  std::unique_ptr<PbMetricFamily> ipc_spin_hits;
+  std::unique_ptr<PbMetricFamily> ipc_sleeps;
+  std::unique_ptr<PbMetricFamily> shm_lock_acquisitions;
+  std::unique_ptr<PbMetricFamily> shm_lock_contentions;
+  std::unique_ptr<PbMetricFamily> shm_thread_cache_hits;
+  std::unique_ptr<PbMetricFamily> shm_thread_cache_misses;
+  std::unique_ptr<PbMetricFamily> closed_request_checks;
+  std::unique_ptr<PbMetricFamily> dropped_log_messages;
+  std::unique_ptr<PbMetricFamily> phase_duration;
+  std::unique_ptr<PbMetricFamily> stub_time;
+  std::unique_ptr<PbMetricFamily> shm_allocations;
+  std::unique_ptr<PbMetricFamily> shm_live_objects;
+  std::unique_ptr<PbMetricFamily> shm_peak_allocated_bytes;
+  std::unique_ptr<PbMetricFamily> shm_grows;
+  std::unique_ptr<PbMetricFamily> shm_fragmentation;
+  std::unique_ptr<PbMetricFamily> bls_cache_requests;
+  std::unique_ptr<PbMetricFamily> bls_cache_bytes;
+};
+
+// Create a metric with the given labels. Returns nullptr if the family is not
+// registered.
+std::unique_ptr<PbMetric> CreateMetric(
+    std::unique_ptr<PbMetricFamily>& family,
+    const std::vector<std::pair<std::string, std::string>>& labels);
+
+// Advance a counter to 'total' if the metric exists.
+void AdvanceMetric(std::unique_ptr<PbMetric>& metric, uint64_t total);
+
+// Add an observation to a histogram if the metric exists.
+void ObserveMetric(std::unique_ptr<PbMetric>& metric, double value);
+
+// Set the value of a gauge if the metric exists.
+void SetMetric(std::unique_ptr<PbMetric>& metric, double value);
+
+}}}  // namespace triton::backend::python
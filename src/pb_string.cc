@@ -33,11 +33,13 @@ PbString::Create(
     std::unique_ptr<SharedMemoryManager>& shm_pool, const std::string& string)
 {
   AllocatedSharedMemory<StringShm> string_container_shm =
-      shm_pool->Construct<StringShm>();
+      shm_pool->Construct<StringShm>(
+          1 /* count */, false /* aligned */, ShmObjectType::kString);
   string_container_shm.data_->length = string.size();
 
   AllocatedSharedMemory<char> string_shm =
-      shm_pool->Construct<char>(string.size());
+      shm_pool->Construct<char>(
+          string.size(), false /* aligned */, ShmObjectType::kString);
   std::memcpy(string_shm.data_.get(), string.data(), string.size());
   string_container_shm.data_->data = string_shm.handle_;
 
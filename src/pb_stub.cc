@@ -26,14 +26,17 @@
 
 #include "pb_stub.h"
 
+#include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <algorithm>
 #include <atomic>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/thread/thread_time.hpp>
+#include <chrono>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
@@ -70,6 +73,102 @@ SignalHandler(int signum)
   // Skip the SIGINT and SIGTERM
 }
 
+namespace {
+
+uint64_t
+ElapsedNs(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// The timestamps of the spans use the same clock as SET_TIMESTAMP in the
+// Triton process.
+uint64_t
+SteadyClockNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Measures the execute phase of a batch. The GIL wait, BLS and garbage
+// collection times are the increments of the counters of the stub process
+// while the execute function runs, so they include the other threads of the
+// model.
+class ExecuteTimer {
+ public:
+  ExecuteTimer(IPCControlShm* ipc_control, ResponseBatch* response_batch)
+      : ipc_control_(ipc_control), response_batch_(response_batch),
+        start_(std::chrono::steady_clock::now()),
+        released_start_ns_(ScopedGilRelease::ThreadReleasedNs()),
+        gil_wait_start_ns_(ipc_control->gil_wait_ns.load()),
+        bls_exec_start_ns_(ipc_control->bls_exec_ns.load()),
+        gc_pause_start_ns_(ipc_control->gc_pause_ns.load())
+  {
+  }
+
+  void Stop()
+  {
+    uint64_t execute_ns = ElapsedNs(start_);
+    uint64_t released_ns =
+        ScopedGilRelease::ThreadReleasedNs() - released_start_ns_;
+    uint64_t gil_held_ns =
+        execute_ns > released_ns ? execute_ns - released_ns : 0;
+    ipc_control_->gil_held_ns.fetch_add(
+        gil_held_ns, std::memory_order_relaxed);
+
+    response_batch_->execute_ns = execute_ns;
+    response_batch_->execute_gil_held_ns = gil_held_ns;
+    response_batch_->execute_gil_wait_ns =
+        ipc_control_->gil_wait_ns.load() - gil_wait_start_ns_;
+    response_batch_->execute_bls_ns =
+        ipc_control_->bls_exec_ns.load() - bls_exec_start_ns_;
+    response_batch_->execute_gc_ns =
+        ipc_control_->gc_pause_ns.load() - gc_pause_start_ns_;
+  }
+
+ private:
+  IPCControlShm* ipc_control_;
+  ResponseBatch* response_batch_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t released_start_ns_;
+  uint64_t gil_wait_start_ns_;
+  uint64_t bls_exec_start_ns_;
+  uint64_t gc_pause_start_ns_;
+};
+
+}  // namespace
+
+thread_local uint64_t ScopedGilRelease::thread_released_ns_ = 0;
+
+ScopedGilRelease::ScopedGilRelease()
+{
+  if (PyGILState_Check()) {
+    release_start_ = std::chrono::steady_clock::now();
+    release_ = std::make_unique<py::gil_scoped_release>();
+  }
+}
+
+ScopedGilRelease::~ScopedGilRelease()
+{
+  if (release_ == nullptr) {
+    return;
+  }
+
+  auto reacquire_start = std::chrono::steady_clock::now();
+  release_.reset();
+  thread_released_ns_ += ElapsedNs(release_start_);
+  Stub::GetOrCreateInstance()->AddGilWaitTime(ElapsedNs(reacquire_start));
+}
+
+uint64_t
+ScopedGilRelease::ThreadReleasedNs()
+{
+  return thread_released_ns_;
+}
+
 void
 Stub::Instantiate(
     int64_t shm_growth_size, int64_t shm_default_size,
@@ -82,9 +181,9 @@ Stub::Instantiate(
   model_version_ = model_version;
   triton_install_path_ = triton_install_path;
   name_ = name;
-  health_mutex_ = nullptr;
   initialized_ = false;
   log_thread_ = false;
+  dropped_log_messages_ = 0;
 
   try {
     shm_pool_ = std::make_unique<SharedMemoryManager>(
@@ -94,8 +193,6 @@ Stub::Instantiate(
         shm_pool_->Load<IPCControlShm>(ipc_control_handle);
     ipc_control_ = ipc_control.data_.get();
 
-    health_mutex_ = &(ipc_control_->stub_health_mutex);
-
     stub_message_queue_ = MessageQueue<bi::managed_external_buffer::handle_t>::
         LoadFromSharedMemory(shm_pool_, ipc_control_->stub_message_queue);
 
@@ -156,18 +253,33 @@ Stub::MemoryManagerQueue()
   return memory_manager_message_queue_;
 }
 
-bool&
-Stub::Health()
-{
-  return ipc_control_->stub_health;
-}
-
 std::unique_ptr<SharedMemoryManager>&
 Stub::SharedMemory()
 {
   return shm_pool_;
 }
 
+std::shared_ptr<SequenceStateStore>&
+Stub::SequenceStates()
+{
+  return sequence_state_store_;
+}
+
+void
+Stub::EndSequenceStates(py::list requests, uint32_t flag)
+{
+  if (sequence_state_store_ == nullptr) {
+    return;
+  }
+
+  for (auto& py_request : requests) {
+    InferRequest* request = py_request.cast<InferRequest*>();
+    if ((request->Flags() & flag) != 0 && request->CorrelationId() != 0) {
+      sequence_state_store_->EndSequence(request->CorrelationId());
+    }
+  }
+}
+
 std::unique_ptr<IPCMessage>
 Stub::PopMessage()
 {
@@ -189,86 +301,334 @@ Stub::IsDecoupled()
   return ipc_control_->decoupled;
 }
 
+uint32_t
+Stub::DecoupledSendWindow()
+{
+  return ipc_control_->decoupled_send_window;
+}
+
+uint64_t
+Stub::ExecutingBatchId()
+{
+  return executing_batch_id_;
+}
+
+void
+Stub::AddGilWaitTime(uint64_t wait_ns)
+{
+  ipc_control_->gil_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+}
+
+void
+Stub::AddBlsExecTime(uint64_t exec_ns)
+{
+  ipc_control_->bls_exec_ns.fetch_add(exec_ns, std::memory_order_relaxed);
+}
+
+void
+Stub::RegisterGcCallback()
+{
+  // The callbacks run with the GIL held, at the start and at the end of each
+  // collection.
+  gc_callback_ = py::cpp_function([this](py::str phase, py::dict info) {
+    if (std::string(phase) == "start") {
+      gc_start_ = std::chrono::steady_clock::now();
+    } else {
+      ipc_control_->gc_pause_ns.fetch_add(
+          ElapsedNs(gc_start_), std::memory_order_relaxed);
+    }
+  });
+  py::module_::import("gc").attr("callbacks").attr("append")(gc_callback_);
+}
+
+py::array
+Stub::SharedWeights(const std::string& name)
+{
+  auto weight_file = shared_weight_files_.find(name);
+  if (weight_file == shared_weight_files_.end()) {
+    throw PythonBackendException(
+        "Shared weight file '" + name +
+        "' is not in the 'SHARED_WEIGHT_FILES' parameter of the model.");
+  }
+
+  // The file stays mapped as long as an array refers to it.
+  py::capsule base(
+      new std::shared_ptr<SharedWeightFile>(weight_file->second),
+      [](void* weight_file) {
+        delete reinterpret_cast<std::shared_ptr<SharedWeightFile>*>(
+            weight_file);
+      });
+  py::array weights(
+      py::dtype::of<uint8_t>(),
+      std::vector<py::ssize_t>{
+          static_cast<py::ssize_t>(weight_file->second->ByteSize())},
+      weight_file->second->Data(), base);
+  weights.attr("setflags")("write"_a = false);
+
+  return weights;
+}
+
+intptr_t
+Stub::ExecutingTraceAddress()
+{
+  return executing_trace_address_;
+}
+
 bool
-Stub::RunCommand()
+Stub::IsForkServer()
 {
-  NVTX_RANGE(nvtx_, "RunCommand " + name_);
-  std::unique_ptr<IPCMessage> ipc_message;
+  return ipc_control_->fork_server;
+}
+
+bool
+Stub::RunForkServer(pid_t parent_pid)
+{
+  // The forked stubs are not children of the parent process, so the fork
+  // server lets the kernel reap them.
+  signal(SIGCHLD, SIG_IGN);
+
   {
-    // Release the GIL lock when waiting for new message. Without this line, the
-    // other threads in the user's Python model cannot make progress if they
-    // give up GIL.
-    py::gil_scoped_release release;
-    ipc_message = this->PopMessage();
+    bool has_exception = false;
+    std::string error_string;
+    std::unique_ptr<IPCMessage> ready_response_msg =
+        IPCMessage::Create(shm_pool_, false /* inline_response */);
+    ready_response_msg->Command() = PYTHONSTUB_InitializeResponse;
+    std::unique_ptr<PbString> error_string_shm;
+    AllocatedSharedMemory<InitializeResponseShm> ready_response =
+        shm_pool_->Construct<InitializeResponseShm>();
+    ready_response.data_->response_has_error = false;
+    ready_response.data_->response_is_error_set = false;
+    ready_response_msg->Args() = ready_response.handle_;
+
+    // Importing the modules is the part of the startup that the forked stubs
+    // share. The model object is created by each stub during initialization.
+    try {
+      StubSetup();
+    }
+    catch (const PythonBackendException& pb_exception) {
+      has_exception = true;
+      error_string = pb_exception.what();
+    }
+    catch (const py::error_already_set& error) {
+      has_exception = true;
+      error_string = error.what();
+    }
+
+    if (has_exception) {
+      shm_pool_->SetDeleteRegion(false);
+      LOG_INFO << "Failed to start the Python stub fork server: "
+               << error_string;
+      ready_response.data_->response_has_error = true;
+      LOG_IF_EXCEPTION(
+          error_string_shm = PbString::Create(shm_pool_, error_string));
+      if (error_string_shm != nullptr) {
+        ready_response.data_->response_is_error_set = true;
+        ready_response.data_->response_error = error_string_shm->ShmHandle();
+      }
+    }
+
+    SendIPCMessage(ready_response_msg);
+    stub_message_queue_->Pop();
+    if (has_exception) {
+      return false;
+    }
   }
-  switch (ipc_message->Command()) {
-    case PYTHONSTUB_CommandType::PYTHONSTUB_AutoCompleteRequest: {
-      // Only run this case when auto complete was requested by
-      // Triton core.
-      bool has_exception = false;
-      std::string error_string;
-      std::string auto_complete_config;
 
-      std::unique_ptr<IPCMessage> auto_complete_response_msg =
-          IPCMessage::Create(shm_pool_, false /* inline_response */);
-      auto_complete_response_msg->Command() = PYTHONSTUB_AutoCompleteResponse;
-      std::unique_ptr<PbString> error_string_shm;
-      std::unique_ptr<PbString> auto_complete_config_shm;
-      AllocatedSharedMemory<AutoCompleteResponseShm> auto_complete_response =
-          shm_pool_->Construct<AutoCompleteResponseShm>();
+  while (true) {
+    bool success = false;
+    bi::managed_external_buffer::handle_t message;
+    while (!success) {
+      message = stub_message_queue_->Pop(1000, success);
+      if (!success && kill(parent_pid, 0) != 0) {
+        return false;
+      }
+    }
 
-      ScopedDefer receive_autocomplete_finalize(
-          [this] { stub_message_queue_->Pop(); });
-      ScopedDefer _([this, &auto_complete_response_msg] {
-        SendIPCMessage(auto_complete_response_msg);
-      });
+    std::unordered_map<std::string, std::string> fork_args;
+    {
+      std::unique_ptr<IPCMessage> ipc_message =
+          IPCMessage::LoadFromSharedMemory(shm_pool_, message);
+      if (ipc_message->Command() == PYTHONSTUB_FinalizeRequest) {
+        ipc_message->Command() = PYTHONSTUB_FinalizeResponse;
+        SendIPCMessage(ipc_message);
+        return false;
+      }
+      // The auto-complete runs in the fork server so that the modules it
+      // imports are shared by the forked stubs. A failure is reported to the
+      // parent process, which then finalizes the fork server.
+      if (ipc_message->Command() == PYTHONSTUB_AutoCompleteRequest) {
+        ProcessAutoCompleteRequest(ipc_message);
+        continue;
+      }
+      if (ipc_message->Command() != PYTHONSTUB_ForkRequest) {
+        continue;
+      }
+      fork_args =
+          PbMap::LoadFromSharedMemory(shm_pool_, ipc_message->Args())
+              ->UnorderedMap();
+    }
 
-      auto_complete_response.data_->response_has_error = false;
-      auto_complete_response.data_->response_is_error_set = false;
-      auto_complete_response.data_->response_has_model_config = false;
-      auto_complete_response_msg->Args() = auto_complete_response.handle_;
+    // No object of the region may be alive during the fork. The forked stub
+    // must not release them since they belong to the fork server.
+    PyOS_BeforeFork();
+    pid_t pid = fork();
+    if (pid == 0) {
+      PyOS_AfterFork_Child();
+      signal(SIGCHLD, SIG_DFL);
+
+      // The stub has a single thread right after the fork, so the threads it
+      // starts inherit the affinity of its model instance.
+      auto cpu_affinity = fork_args.find("cpu_affinity");
+      cpu_set_t cpu_set;
+      if (cpu_affinity != fork_args.end() &&
+          ParseCpuList(cpu_affinity->second, &cpu_set)) {
+        sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+      }
 
+      // Leave the region of the fork server untouched and attach to the
+      // region of the model instance. The manager of the fork server is
+      // detached so that the blocks inherited in the thread caches are not
+      // flushed back to the region of the fork server.
+      stub_message_queue_.release();
+      parent_message_queue_.release();
+      log_message_queue_.release();
+      memory_manager_message_queue_.release();
+      shm_pool_->DetachFromForkedChild();
+      shm_pool_.release();
       try {
-        AutoCompleteModelConfig(ipc_message->Args(), &auto_complete_config);
+        Instantiate(
+            std::stoll(fork_args["shm_growth_byte_size"]),
+            std::stoll(fork_args["shm_default_byte_size"]),
+            fork_args["shm_region_name"], model_path_, model_version_,
+            triton_install_path_,
+            std::stoull(fork_args["ipc_control_handle"]), fork_args["name"]);
       }
       catch (const PythonBackendException& pb_exception) {
-        has_exception = true;
-        error_string = pb_exception.what();
+        LOG_INFO << "Failed to preinitialize Python stub: "
+                 << pb_exception.what();
+        exit(1);
       }
-      catch (const py::error_already_set& error) {
-        has_exception = true;
-        error_string = error.what();
+      return true;
+    }
+    PyOS_AfterFork_Parent();
+
+    std::unique_ptr<IPCMessage> fork_response_msg =
+        IPCMessage::Create(shm_pool_, false /* inline_response */);
+    fork_response_msg->Command() = PYTHONSTUB_ForkResponse;
+    std::unique_ptr<PbString> error_string_shm;
+    AllocatedSharedMemory<ForkResponseShm> fork_response =
+        shm_pool_->Construct<ForkResponseShm>();
+    fork_response.data_->response_has_error = (pid < 0);
+    fork_response.data_->response_is_error_set = false;
+    fork_response.data_->pid = pid;
+    fork_response_msg->Args() = fork_response.handle_;
+    if (pid < 0) {
+      LOG_IF_EXCEPTION(
+          error_string_shm = PbString::Create(
+              shm_pool_, "Failed to fork the stub process. Errno = " +
+                             std::to_string(errno)));
+      if (error_string_shm != nullptr) {
+        fork_response.data_->response_is_error_set = true;
+        fork_response.data_->response_error = error_string_shm->ShmHandle();
       }
+    }
 
-      if (has_exception) {
-        // Do not delete the region. The region will be deleted by the parent
-        // process.
-        shm_pool_->SetDeleteRegion(false);
-        LOG_INFO << "Failed to initialize Python stub for auto-complete: "
-                 << error_string;
-        auto_complete_response.data_->response_has_error = true;
-        auto_complete_response.data_->response_is_error_set = false;
+    SendIPCMessage(fork_response_msg);
+    // Wait for the parent process to read the response.
+    stub_message_queue_->Pop();
+  }
+}
 
-        LOG_IF_EXCEPTION(
-            error_string_shm = PbString::Create(shm_pool_, error_string));
-        if (error_string_shm != nullptr) {
-          auto_complete_response.data_->response_is_error_set = true;
-          auto_complete_response.data_->response_error =
-              error_string_shm->ShmHandle();
-        }
+bool
+Stub::ProcessAutoCompleteRequest(std::unique_ptr<IPCMessage>& ipc_message)
+{
+  bool has_exception = false;
+  std::string error_string;
+  std::string auto_complete_config;
+
+  std::unique_ptr<IPCMessage> auto_complete_response_msg =
+      IPCMessage::Create(shm_pool_, false /* inline_response */);
+  auto_complete_response_msg->Command() = PYTHONSTUB_AutoCompleteResponse;
+  std::unique_ptr<PbString> error_string_shm;
+  std::unique_ptr<PbString> auto_complete_config_shm;
+  AllocatedSharedMemory<AutoCompleteResponseShm> auto_complete_response =
+      shm_pool_->Construct<AutoCompleteResponseShm>();
+
+  ScopedDefer receive_autocomplete_finalize(
+      [this] { stub_message_queue_->Pop(); });
+  ScopedDefer _([this, &auto_complete_response_msg] {
+    SendIPCMessage(auto_complete_response_msg);
+  });
+
+  auto_complete_response.data_->response_has_error = false;
+  auto_complete_response.data_->response_is_error_set = false;
+  auto_complete_response.data_->response_has_model_config = false;
+  auto_complete_response_msg->Args() = auto_complete_response.handle_;
+
+  try {
+    AutoCompleteModelConfig(ipc_message->Args(), &auto_complete_config);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    has_exception = true;
+    error_string = pb_exception.what();
+  }
+  catch (const py::error_already_set& error) {
+    has_exception = true;
+    error_string = error.what();
+  }
+
+  if (has_exception) {
+    // Do not delete the region. The region will be deleted by the parent
+    // process.
+    shm_pool_->SetDeleteRegion(false);
+    LOG_INFO << "Failed to initialize Python stub for auto-complete: "
+             << error_string;
+    auto_complete_response.data_->response_has_error = true;
+    auto_complete_response.data_->response_is_error_set = false;
+
+    LOG_IF_EXCEPTION(
+        error_string_shm = PbString::Create(shm_pool_, error_string));
+    if (error_string_shm != nullptr) {
+      auto_complete_response.data_->response_is_error_set = true;
+      auto_complete_response.data_->response_error =
+          error_string_shm->ShmHandle();
+    }
+
+    return true;
+  } else {
+    LOG_IF_EXCEPTION(
+        auto_complete_config_shm =
+            PbString::Create(shm_pool_, auto_complete_config));
+    if (auto_complete_config_shm != nullptr) {
+      auto_complete_response.data_->response_has_model_config = true;
+      auto_complete_response.data_->response_model_config =
+          auto_complete_config_shm->ShmHandle();
+    }
+  }
+
+  return false;
+}
 
+bool
+Stub::RunCommand()
+{
+  NVTX_RANGE(nvtx_, "RunCommand " + name_);
+  std::unique_ptr<IPCMessage> ipc_message;
+  {
+    // Release the GIL lock when waiting for new message. Without this line, the
+    // other threads in the user's Python model cannot make progress if they
+    // give up GIL.
+    ScopedGilRelease release;
+    ipc_message = this->PopMessage();
+  }
+  switch (ipc_message->Command()) {
+    case PYTHONSTUB_CommandType::PYTHONSTUB_AutoCompleteRequest:
+      // Only run this case when auto complete was requested by
+      // Triton core.
+      if (ProcessAutoCompleteRequest(ipc_message)) {
         return true;  // Terminate the stub process.
-      } else {
-        LOG_IF_EXCEPTION(
-            auto_complete_config_shm =
-                PbString::Create(shm_pool_, auto_complete_config));
-        if (auto_complete_config_shm != nullptr) {
-          auto_complete_response.data_->response_has_model_config = true;
-          auto_complete_response.data_->response_model_config =
-              auto_complete_config_shm->ShmHandle();
-        }
       }
-    } break;
+      break;
     case PYTHONSTUB_CommandType::PYTHONSTUB_InitializeRequest: {
       bool has_exception = false;
       std::string error_string;
@@ -411,6 +771,18 @@ Stub::StubSetup()
       c_python_backend_utils.attr("InferenceResponse"));
   py::setattr(
       python_backend_utils, "Logger", c_python_backend_utils.attr("Logger"));
+  py::setattr(
+      python_backend_utils, "get_batched_input_tensor_by_name",
+      c_python_backend_utils.attr("get_batched_input_tensor_by_name"));
+  py::setattr(
+      python_backend_utils, "exec_batch",
+      c_python_backend_utils.attr("exec_batch"));
+  py::setattr(
+      python_backend_utils, "empty_output",
+      c_python_backend_utils.attr("empty_output"));
+  py::setattr(
+      python_backend_utils, "get_shared_weights",
+      c_python_backend_utils.attr("get_shared_weights"));
 
   c_python_backend_utils.attr("shared_memory") = py::cast(shm_pool_.get());
 
@@ -487,12 +859,55 @@ Stub::Initialize(bi::managed_external_buffer::handle_t map_handle)
   // Get the unordered_map representation of the map in shared memory.
   map = pb_map_shm->UnorderedMap();
 
+  // The CUDA shared pool of the device is not part of the arguments of the
+  // model.
+  auto cuda_pool_handle = map.find("cuda_shared_pool_handle");
+  if (cuda_pool_handle != map.end()) {
+#ifdef TRITON_ENABLE_GPU
+    try {
+      CudaSharedPool::Register(CudaSharedPool::Open(
+          std::stoi(map["model_instance_device_id"]),
+          std::stoull(map["cuda_shared_pool_byte_size"]),
+          cuda_pool_handle->second));
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_INFO << "Failed to open the CUDA shared pool: "
+               << pb_exception.what();
+    }
+#endif  // TRITON_ENABLE_GPU
+    map.erase(cuda_pool_handle);
+    map.erase("cuda_shared_pool_byte_size");
+  }
+
+  // The sequence state store outlives the stub process, so the states that
+  // were kept by a previous stub process of the instance are found again.
+  auto sequence_state_region = map.find("sequence_state_region_name");
+  if (sequence_state_region != map.end()) {
+    sequence_state_store_ =
+        SequenceStateStore::Open(sequence_state_region->second);
+    map.erase(sequence_state_region);
+  }
+
+  // The weight files were read by the parent process, so mapping them only
+  // maps the pages that are in the page cache.
+  auto shared_weight_files = map.find("shared_weight_files");
+  if (shared_weight_files != map.end()) {
+    std::vector<std::pair<std::string, std::string>> files;
+    ParseSharedWeightFiles(shared_weight_files->second, &files);
+    for (const auto& file : files) {
+      shared_weight_files_[file.first] =
+          SharedWeightFile::Map(file.second, false /* prefault */);
+    }
+    map.erase(shared_weight_files);
+  }
+
   py::dict model_config_params;
 
   for (const auto& pair : map) {
     model_config_params[pair.first.c_str()] = pair.second;
   }
 
+  RegisterGcCallback();
   LaunchLogRequestThread();
   // Call initialize if exists.
   if (py::hasattr(model_instance_, "initialize")) {
@@ -579,25 +994,235 @@ Stub::LoadRequestsFromSharedMemory(RequestBatch* request_batch_shm_ptr)
   return py_request_list;
 }
 
+py::tuple
+Stub::GetBatchedInputTensor(py::list requests, const std::string& name)
+{
+  std::vector<std::shared_ptr<PbTensor>> inputs;
+  for (auto& request : requests) {
+    InferRequest* infer_request = request.cast<InferRequest*>();
+    std::shared_ptr<PbTensor> found_input;
+    for (auto& input : infer_request->Inputs()) {
+      if (input->Name() == name) {
+        found_input = input;
+        break;
+      }
+    }
+    if (!found_input) {
+      throw PythonBackendException(
+          "Input '" + name + "' was not found in request '" +
+          infer_request->RequestId() + "'.");
+    }
+    inputs.push_back(found_input);
+  }
+
+  if (inputs.empty()) {
+    throw PythonBackendException(
+        "Cannot create a batched tensor from an empty list of requests.");
+  }
+
+  std::shared_ptr<PbTensor>& first_input = inputs.front();
+  std::vector<int64_t> dims = first_input->Dims();
+  if (dims.empty()) {
+    throw PythonBackendException(
+        "Input '" + name + "' must have at least one dimension to be batched.");
+  }
+
+  py::list offsets;
+  int64_t batch_size = 0;
+  uint64_t byte_size = 0;
+  bool contiguous = true;
+  offsets.append(0);
+  for (auto& input : inputs) {
+    const std::vector<int64_t>& input_dims = input->Dims();
+    if (!input->IsCPU() || input->TritonDtype() != first_input->TritonDtype() ||
+        input_dims.size() != dims.size() ||
+        !std::equal(
+            input_dims.begin() + 1, input_dims.end(), dims.begin() + 1)) {
+      throw PythonBackendException(
+          "Input '" + name +
+          "' must be in CPU and have the same data type and the same shape "
+          "except for the first dimension in all the requests to be batched.");
+    }
+
+    std::unique_ptr<PbMemory>& memory = input->Memory();
+    std::unique_ptr<PbMemory>& first_memory = first_input->Memory();
+    contiguous = contiguous && memory && first_memory &&
+                 memory->DataHandle() != 0 &&
+                 memory->DataHandle() == first_memory->DataHandle() &&
+                 memory->DataOffset() == first_memory->DataOffset() + byte_size;
+
+    batch_size += input_dims[0];
+    byte_size += input->ByteSize();
+    offsets.append(batch_size);
+  }
+  dims[0] = batch_size;
+
+  std::unique_ptr<PbMemory> batched_memory;
+  if (contiguous) {
+    batched_memory = PbMemory::Create(
+        shm_pool_, first_input->Memory()->DataHandle(),
+        first_input->Memory()->DataOffset(), byte_size);
+  } else {
+    batched_memory = PbMemory::Create(
+        shm_pool_, TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, byte_size,
+        nullptr /* data */, false /* copy_gpu */);
+    uint64_t offset = 0;
+    for (auto& input : inputs) {
+      char* data = reinterpret_cast<char*>(input->DataPtr());
+      std::copy(
+          data, data + input->ByteSize(), batched_memory->DataPtr() + offset);
+      offset += input->ByteSize();
+    }
+  }
+
+  std::shared_ptr<PbTensor> batched_tensor = std::make_shared<PbTensor>(
+      name, dims, first_input->TritonDtype(), TRITONSERVER_MEMORY_CPU,
+      0 /* memory_type_id */, batched_memory->DataPtr(), byte_size,
+      nullptr /* dl_managed_tensor */);
+  batched_tensor->SetMemory(std::move(batched_memory));
+
+  return py::make_tuple(batched_tensor, offsets);
+}
+
+py::list
+Stub::SplitBatchedResponse(
+    std::shared_ptr<InferResponse> batched_response, py::list requests)
+{
+  std::vector<int64_t> request_batch_sizes;
+  int64_t batch_size = 0;
+  for (auto& request : requests) {
+    InferRequest* infer_request = request.cast<InferRequest*>();
+    const std::vector<std::shared_ptr<PbTensor>>& inputs =
+        infer_request->Inputs();
+    if (inputs.empty() || inputs[0]->Dims().empty()) {
+      throw PythonBackendException(
+          "Cannot split a batched response for request '" +
+          infer_request->RequestId() +
+          "' because its first input has no batch dimension.");
+    }
+    request_batch_sizes.push_back(inputs[0]->Dims()[0]);
+    batch_size += inputs[0]->Dims()[0];
+  }
+
+  std::vector<std::vector<std::shared_ptr<PbTensor>>> request_outputs(
+      request_batch_sizes.size());
+  if (!batched_response->HasError()) {
+    for (auto& output : batched_response->OutputTensors()) {
+      if (!output->IsCPU() ||
+          output->TritonDtype() == TRITONSERVER_TYPE_BYTES ||
+          output->Dims().empty() || output->Dims()[0] != batch_size) {
+        throw PythonBackendException(
+            "Output '" + output->Name() +
+            "' of a batched response must be a non-BYTES CPU tensor with a "
+            "first dimension of " +
+            std::to_string(batch_size) + ".");
+      }
+
+      // Outputs created from NumPy arrays are copied to shared memory once so
+      // that the per-request outputs can reference parts of it.
+      if (!output->Memory()) {
+        output->SetMemory(PbMemory::Create(
+            shm_pool_, TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+            output->ByteSize(), reinterpret_cast<char*>(output->DataPtr()),
+            false /* copy_gpu */));
+      }
+
+      uint64_t row_byte_size =
+          batch_size == 0 ? 0 : output->ByteSize() / batch_size;
+      uint64_t offset = 0;
+      for (size_t i = 0; i < request_batch_sizes.size(); i++) {
+        std::vector<int64_t> dims = output->Dims();
+        dims[0] = request_batch_sizes[i];
+        uint64_t byte_size = row_byte_size * request_batch_sizes[i];
+
+        std::unique_ptr<PbMemory> memory =
+            output->Memory()->Slice(shm_pool_, offset, byte_size);
+        std::shared_ptr<PbTensor> request_output = std::make_shared<PbTensor>(
+            output->Name(), dims, output->TritonDtype(),
+            TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, memory->DataPtr(),
+            byte_size, nullptr /* dl_managed_tensor */);
+        request_output->SetMemory(std::move(memory));
+        request_outputs[i].push_back(request_output);
+        offset += byte_size;
+      }
+    }
+  }
+
+  py::list responses;
+  for (auto& outputs : request_outputs) {
+    responses.append(
+        std::make_shared<InferResponse>(outputs, batched_response->Error()));
+  }
+
+  return responses;
+}
+
 void
 Stub::ProcessRequestsDecoupled(RequestBatch* request_batch_shm_ptr)
 {
+  // The requests of a decoupled model can be released before the BLS requests
+  // of the threads that the model starts, so they are not used as the parents
+  // of the BLS traces.
+  executing_batch_id_ = request_batch_shm_ptr->batch_id;
+  uint64_t stub_start_ns = SteadyClockNs();
+  auto load_requests_start = std::chrono::steady_clock::now();
   py::list py_request_list =
       LoadRequestsFromSharedMemory(request_batch_shm_ptr);
+  uint64_t load_requests_ns = ElapsedNs(load_requests_start);
+  // A new sequence may reuse the correlation ID of a sequence that did not
+  // end, such as a sequence that timed out.
+  EndSequenceStates(py_request_list, TRITONSERVER_REQUEST_FLAG_SEQUENCE_START);
+  ScopedDefer end_sequence_states([this, &py_request_list] {
+    EndSequenceStates(py_request_list, TRITONSERVER_REQUEST_FLAG_SEQUENCE_END);
+  });
   std::unique_ptr<IPCMessage> execute_response =
       IPCMessage::Create(shm_pool_, false /* Inline response */);
   execute_response->Command() = PYTHONSTUB_ExecuteResponse;
 
   AllocatedSharedMemory<ResponseBatch> response_batch =
-      shm_pool_->Construct<ResponseBatch>();
+      shm_pool_->Construct<ResponseBatch>(
+          1 /* count */, false /* aligned */, ShmObjectType::kBatch);
   ResponseBatch* response_batch_shm_ptr =
       reinterpret_cast<ResponseBatch*>(response_batch.data_.get());
   execute_response->Args() = response_batch.handle_;
+  response_batch_shm_ptr->load_requests_ns = load_requests_ns;
+  response_batch_shm_ptr->execute_ns = 0;
+  response_batch_shm_ptr->execute_gil_held_ns = 0;
+  response_batch_shm_ptr->execute_gil_wait_ns = 0;
+  response_batch_shm_ptr->execute_bls_ns = 0;
+  response_batch_shm_ptr->execute_gc_ns = 0;
+  response_batch_shm_ptr->save_responses_ns = 0;
+  response_batch_shm_ptr->batch_id = request_batch_shm_ptr->batch_id;
+  response_batch_shm_ptr->stub_start_ns = stub_start_ns;
   bool has_exception = false;
   std::string error_string;
   std::unique_ptr<PbString> error_string_shm;
 
-  ScopedDefer execute_finalize([this] { stub_message_queue_->Pop(); });
+  // The next message of a dispatched batch may already be the next batch, so
+  // the acknowledgement of the parent process is only read for the batches
+  // that the parent process waits for. The response of a dispatched batch is
+  // kept instead until a later batch reports that the parent process has
+  // loaded it.
+  const bool is_dispatched = request_batch_shm_ptr->is_dispatched;
+  if (is_dispatched) {
+    while (!dispatched_execute_responses_.empty() &&
+           dispatched_execute_responses_.front().batch_id <
+               request_batch_shm_ptr->released_batch_id) {
+      dispatched_execute_responses_.pop_front();
+    }
+  }
+  const uint64_t batch_id = request_batch_shm_ptr->batch_id;
+  ScopedDefer execute_finalize([this, is_dispatched, batch_id,
+                                &execute_response, &response_batch,
+                                &error_string_shm] {
+    if (!is_dispatched) {
+      stub_message_queue_->Pop();
+      return;
+    }
+    dispatched_execute_responses_.push_back(
+        {batch_id, std::move(execute_response), std::move(response_batch),
+         std::move(error_string_shm)});
+  });
   ScopedDefer _(
       [this, &execute_response] { SendIPCMessage(execute_response); });
 
@@ -612,11 +1237,68 @@ Stub::ProcessRequestsDecoupled(RequestBatch* request_batch_shm_ptr)
     }
 
     {
-      NVTX_RANGE(nvtx_, "PyExecute " + name_);
+      NVTX_RANGE(
+          nvtx_, "PyExecute " + name_ + " batch " +
+                     std::to_string(request_batch_shm_ptr->batch_id));
+      ExecuteTimer execute_timer(ipc_control_, response_batch_shm_ptr);
+      ScopedDefer execute_timer_stop(
+          [&execute_timer] { execute_timer.Stop(); });
 
       py::object execute_return =
           model_instance_.attr("execute")(py_request_list);
-      if (!py::isinstance<py::none>(execute_return)) {
+      py::module asyncio = py::module_::import("asyncio");
+      if (asyncio.attr("iscoroutine")(execute_return).cast<bool>()) {
+        // The coroutine keeps running after execute has returned, like the
+        // threads started by a decoupled model, so that the coroutines of
+        // several batches can wait for their BLS requests at the same time.
+        py::object future = asyncio.attr("run_coroutine_threadsafe")(
+            execute_return, AsyncEventLoop());
+        // Like the errors of the execute function, the errors of the
+        // coroutine are sent with the final flag to the requests that have
+        // not been closed, since nothing else completes them.
+        std::string name = name_;
+        future.attr("add_done_callback")(py::cpp_function(
+            [name, py_request_list](py::object future) {
+              if (future.attr("cancelled")().cast<bool>()) {
+                return;
+              }
+              std::string error_string;
+              py::object exception = future.attr("exception")();
+              if (!py::isinstance<py::none>(exception)) {
+                error_string = std::string(py::str(exception));
+                LOG_INFO << "Failed to execute the coroutine of model '"
+                         << name << "', message: " << error_string;
+              } else if (!py::isinstance<py::none>(
+                             future.attr("result")())) {
+                error_string = "Python model '" + name +
+                               "' is using the decoupled mode and the "
+                               "execute coroutine must return None.";
+                LOG_INFO << error_string;
+              } else {
+                return;
+              }
+
+              for (auto& py_request : py_request_list) {
+                std::shared_ptr<ResponseSender> response_sender =
+                    py_request.cast<InferRequest*>()->GetResponseSender();
+                if (response_sender->IsClosed()) {
+                  continue;
+                }
+                try {
+                  response_sender->Send(
+                      std::make_shared<InferResponse>(
+                          std::vector<std::shared_ptr<PbTensor>>{},
+                          std::make_shared<PbError>(error_string)),
+                      TRITONSERVER_RESPONSE_COMPLETE_FINAL);
+                }
+                catch (const PythonBackendException& pb_exception) {
+                  LOG_INFO << "Failed to send the error of the coroutine of "
+                              "model '"
+                           << name << "', message: " << pb_exception.what();
+                }
+              }
+            }));
+      } else if (!py::isinstance<py::none>(execute_return)) {
         throw PythonBackendException(
             "Python model '" + name_ +
             "' is using the decoupled mode and the execute function must "
@@ -650,14 +1332,17 @@ Stub::ProcessRequestsDecoupled(RequestBatch* request_batch_shm_ptr)
 void
 Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
 {
+  executing_batch_id_ = request_batch_shm_ptr->batch_id;
+  uint64_t stub_start_ns = SteadyClockNs();
   std::unique_ptr<IPCMessage> execute_response =
       IPCMessage::Create(shm_pool_, false /* Inline response */);
   execute_response->Command() = PYTHONSTUB_ExecuteResponse;
 
   AllocatedSharedMemory<char> response_batch = shm_pool_->Construct<char>(
       request_batch_shm_ptr->batch_size *
-          sizeof(bi::managed_external_buffer::handle_t) +
-      sizeof(ResponseBatch));
+              sizeof(bi::managed_external_buffer::handle_t) +
+          sizeof(ResponseBatch),
+      false /* aligned */, ShmObjectType::kBatch);
   ResponseBatch* response_batch_shm_ptr =
       reinterpret_cast<ResponseBatch*>(response_batch.data_.get());
 
@@ -676,6 +1361,15 @@ Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
       [this, &execute_response] { SendIPCMessage(execute_response); });
 
   execute_response->Args() = response_batch.handle_;
+  response_batch_shm_ptr->load_requests_ns = 0;
+  response_batch_shm_ptr->execute_ns = 0;
+  response_batch_shm_ptr->execute_gil_held_ns = 0;
+  response_batch_shm_ptr->execute_gil_wait_ns = 0;
+  response_batch_shm_ptr->execute_bls_ns = 0;
+  response_batch_shm_ptr->execute_gc_ns = 0;
+  response_batch_shm_ptr->save_responses_ns = 0;
+  response_batch_shm_ptr->batch_id = request_batch_shm_ptr->batch_id;
+  response_batch_shm_ptr->stub_start_ns = stub_start_ns;
 
   bool has_exception = false;
   std::string error_string;
@@ -689,8 +1383,25 @@ Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
       return;
     }
 
+    auto load_requests_start = std::chrono::steady_clock::now();
     py::list py_request_list =
         LoadRequestsFromSharedMemory(request_batch_shm_ptr);
+    response_batch_shm_ptr->load_requests_ns = ElapsedNs(load_requests_start);
+    EndSequenceStates(
+        py_request_list, TRITONSERVER_REQUEST_FLAG_SEQUENCE_START);
+    ScopedDefer end_sequence_states([this, &py_request_list] {
+      EndSequenceStates(
+          py_request_list, TRITONSERVER_REQUEST_FLAG_SEQUENCE_END);
+    });
+
+    for (auto& py_request : py_request_list) {
+      intptr_t trace_address = py_request.cast<InferRequest*>()->TraceAddress();
+      if (trace_address != 0) {
+        executing_trace_address_ = trace_address;
+        break;
+      }
+    }
+    ScopedDefer trace_reset([this] { executing_trace_address_ = 0; });
 
     if (!py::hasattr(model_instance_, "execute")) {
       std::string message = "Python model " + model_path_ +
@@ -706,17 +1417,31 @@ Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
     py::object responses_obj;
     bool is_coroutine;
 
+    ExecuteTimer execute_timer(ipc_control_, response_batch_shm_ptr);
     {
-      NVTX_RANGE(nvtx_, "PyExecute " + name_);
+      NVTX_RANGE(
+          nvtx_, "PyExecute " + name_ + " batch " +
+                     std::to_string(request_batch_shm_ptr->batch_id));
       execute_return = model_instance_.attr("execute")(request_list);
       is_coroutine = asyncio.attr("iscoroutine")(execute_return).cast<bool>();
     }
 
     if (is_coroutine) {
-      responses_obj = asyncio.attr("run")(execute_return);
+      responses_obj =
+          AsyncEventLoop().attr("run_until_complete")(execute_return);
     } else {
       responses_obj = execute_return;
     }
+    execute_timer.Stop();
+
+    // A model with the fused batch option may return a single response for
+    // all the requests.
+    if (ipc_control_->fused_batch &&
+        py::isinstance<InferResponse>(responses_obj)) {
+      responses_obj = SplitBatchedResponse(
+          responses_obj.cast<std::shared_ptr<InferResponse>>(),
+          py_request_list);
+    }
 
     // Check the return type of execute function.
     if (!py::isinstance<py::list>(responses_obj)) {
@@ -752,6 +1477,7 @@ Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
     }
     response_batch_shm_ptr->batch_size = response_size;
 
+    auto save_responses_start = std::chrono::steady_clock::now();
     for (size_t i = 0; i < batch_size; i++) {
       InferResponse* infer_response = responses[i].cast<InferResponse*>();
       InferRequest* infer_request = py_request_list[i].cast<InferRequest*>();
@@ -760,6 +1486,8 @@ Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
       ProcessResponse(infer_response);
       responses_shm_handle[i] = infer_response->ShmHandle();
     }
+    response_batch_shm_ptr->save_responses_ns =
+        ElapsedNs(save_responses_start);
   }
   catch (const PythonBackendException& pb_exception) {
     has_exception = true;
@@ -786,8 +1514,7 @@ Stub::ProcessRequests(RequestBatch* request_batch_shm_ptr)
 void
 Stub::UpdateHealth()
 {
-  bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
-  ipc_control_->stub_health = true;
+  ipc_control_->stub_heartbeat.fetch_add(1, std::memory_order_relaxed);
 }
 
 void
@@ -802,23 +1529,62 @@ Stub::Finalize()
       LOG_INFO << e.what();
     }
   }
+
+  if (async_event_loop_) {
+    try {
+      if (async_event_loop_thread_) {
+        async_event_loop_.attr("call_soon_threadsafe")(
+            async_event_loop_.attr("stop"));
+        async_event_loop_thread_.attr("join")();
+      }
+      async_event_loop_.attr("run_until_complete")(
+          async_event_loop_.attr("shutdown_asyncgens")());
+      async_event_loop_.attr("close")();
+    }
+    catch (const py::error_already_set& e) {
+      LOG_INFO << e.what();
+    }
+  }
+
+  // The callback must not run once the stub is destroyed.
+  if (gc_callback_) {
+    try {
+      py::module_::import("gc").attr("callbacks").attr("remove")(gc_callback_);
+    }
+    catch (const py::error_already_set& e) {
+      LOG_INFO << e.what();
+    }
+    gc_callback_ = py::none();
+  }
 }
 
-void
-Stub::SendIPCMessage(std::unique_ptr<IPCMessage>& ipc_message)
+py::object
+Stub::AsyncEventLoop()
 {
-  bool success = false;
-  while (!success) {
-    parent_message_queue_->Push(ipc_message->ShmHandle(), 1000, success);
+  // asyncio.run() would create a new event loop and a new default executor
+  // for the BLS requests of every batch.
+  if (!async_event_loop_) {
+    py::module asyncio = py::module_::import("asyncio");
+    async_event_loop_ = asyncio.attr("new_event_loop")();
+    asyncio.attr("set_event_loop")(async_event_loop_);
+    if (IsDecoupled()) {
+      async_event_loop_thread_ = py::module_::import("threading").attr(
+          "Thread")(
+          py::arg("target") = async_event_loop_.attr("run_forever"),
+          py::arg("daemon") = true);
+      async_event_loop_thread_.attr("start")();
+    }
   }
+
+  return async_event_loop_;
 }
 
 void
-Stub::SendIPCLogMessage(std::unique_ptr<IPCMessage>& ipc_message)
+Stub::SendIPCMessage(std::unique_ptr<IPCMessage>& ipc_message)
 {
   bool success = false;
   while (!success) {
-    log_message_queue_->Push(ipc_message->ShmHandle(), 1000, success);
+    parent_message_queue_->Push(ipc_message->ShmHandle(), 1000, success);
   }
 }
 
@@ -827,6 +1593,8 @@ Stub::~Stub()
   {
     py::gil_scoped_acquire acquire;
     model_instance_ = py::none();
+    async_event_loop_ = py::none();
+    async_event_loop_thread_ = py::none();
   }
   stub_instance_.reset();
   stub_message_queue_.reset();
@@ -872,6 +1640,10 @@ Stub::EnqueueLogRequest(std::unique_ptr<PbLog>& log_ptr)
 {
   {
     std::lock_guard<std::mutex> guard{log_message_mutex_};
+    if (log_request_buffer_.size() >= kMaxPendingLogMessages) {
+      dropped_log_messages_++;
+      return;
+    }
     log_request_buffer_.push(std::move(log_ptr));
   }
   log_message_cv_.notify_one();
@@ -880,51 +1652,51 @@ Stub::EnqueueLogRequest(std::unique_ptr<PbLog>& log_ptr)
 void
 Stub::ServiceLogRequests()
 {
-  while (log_thread_) {
-    std::unique_lock<std::mutex> guard{log_message_mutex_};
-    while (log_request_buffer_.empty()) {
-      log_message_cv_.wait(guard);
+  bool exit = false;
+  while (log_thread_ && !exit) {
+    std::vector<std::unique_ptr<PbLog>> log_requests;
+    uint32_t dropped_count;
+    {
+      std::unique_lock<std::mutex> guard{log_message_mutex_};
+      while (log_request_buffer_.empty()) {
+        log_message_cv_.wait(guard);
+      }
+      // On exit, will send messages until
+      // DUMMY_MESSAGE is reached
+      while (!log_request_buffer_.empty() &&
+             log_requests.size() < kMaxLogBatchSize) {
+        std::unique_ptr<PbLog> log_request =
+            std::move(log_request_buffer_.front());
+        log_request_buffer_.pop();
+        if (log_request == DUMMY_MESSAGE) {
+          exit = true;
+          break;
+        }
+        log_requests.emplace_back(std::move(log_request));
+      }
+      dropped_count = dropped_log_messages_;
+      dropped_log_messages_ = 0;
     }
-    // On exit, will send messages until
-    // DUMMY_MESSAGE is reached
-    std::unique_ptr<PbLog> log_request = std::move(log_request_buffer_.front());
-    if (log_request == DUMMY_MESSAGE) {
-      log_request_buffer_.pop();
-      break;
-    } else {
-      log_request_buffer_.pop();
-      SendLogMessage(log_request);
+
+    // The messages are sent without holding the lock so that the threads
+    // that log are not blocked by the parent process.
+    if (!log_requests.empty() || dropped_count > 0) {
+      SendLogMessages(log_requests, dropped_count);
     }
   }
 }
 
 void
-Stub::SendLogMessage(std::unique_ptr<PbLog>& log_send_message)
+Stub::SendLogMessages(
+    const std::vector<std::unique_ptr<PbLog>>& logs, uint32_t dropped_count)
 {
-  std::unique_ptr<PbLogShm> log_request_shm = PbLogShm::Create(
-      shm_pool_, log_send_message->Filename(), log_send_message->Line(),
-      log_send_message->Message(), log_send_message->Level());
-  LogSendMessage* send_message_payload = log_request_shm->LogMessage();
-  send_message_payload->waiting_on_stub = false;
-  std::unique_ptr<IPCMessage> log_request_msg =
-      IPCMessage::Create(shm_pool_, false /* inline_response */);
-  log_request_msg->Args() = log_request_shm->ShmHandle();
-  ScopedDefer _([send_message_payload] {
-    {
-      bi::scoped_lock<bi::interprocess_mutex> guard{
-          send_message_payload->log_mu};
-      send_message_payload->waiting_on_stub = false;
-      send_message_payload->log_cv.notify_all();
-    }
-  });
-
-  {
-    // Send a message to be caught by the log monitor thread in python_be.cc
-    bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->log_mu};
-    SendIPCLogMessage(log_request_msg);
-    while (!send_message_payload->waiting_on_stub) {
-      send_message_payload->log_cv.wait(guard);
-    }
+  // The batch is released by the log monitor thread in python_be.cc so there
+  // is no need to wait for the parent process to receive it.
+  bi::managed_external_buffer::handle_t log_batch_handle =
+      PbLogBatch::Create(shm_pool_, logs, dropped_count);
+  bool success = false;
+  while (!success) {
+    log_message_queue_->Push(log_batch_handle, 1000, success);
   }
 }
 
@@ -1067,14 +1839,19 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
                       const std::vector<std::string>& requested_output_names,
                       const std::string& model_name,
                       const int64_t model_version, const uint32_t flags,
-                      const int32_t timeout) {
+                      const int32_t timeout,
+                      const std::unordered_map<std::string, uint64_t>&
+                          expected_output_byte_sizes,
+                      const uint32_t priority) {
             std::set<std::string> requested_outputs;
             for (auto& requested_output_name : requested_output_names) {
               requested_outputs.emplace(requested_output_name);
             }
             return std::make_shared<InferRequest>(
                 request_id, correlation_id, inputs, requested_outputs,
-                model_name, model_version, flags, timeout);
+                model_name, model_version, flags, timeout,
+                0 /* response_factory_address */, 0 /* request_address */,
+                expected_output_byte_sizes, priority);
           }),
           py::arg("request_id").none(false) = "",
           py::arg("correlation_id").none(false) = 0,
@@ -1082,7 +1859,10 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
           py::arg("requested_output_names").none(false),
           py::arg("model_name").none(false),
           py::arg("model_version").none(false) = -1,
-          py::arg("flags").none(false) = 0, py::arg("timeout").none(false) = 0)
+          py::arg("flags").none(false) = 0, py::arg("timeout").none(false) = 0,
+          py::arg("expected_output_byte_sizes").none(false) =
+              std::unordered_map<std::string, uint64_t>(),
+          py::arg("priority").none(false) = 0)
       .def(
           "inputs", &InferRequest::Inputs,
           py::return_value_policy::reference_internal)
@@ -1091,6 +1871,20 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
       .def("flags", &InferRequest::Flags)
       .def("set_flags", &InferRequest::SetFlags)
       .def("timeout", &InferRequest::Timeout)
+      .def("priority", &InferRequest::Priority)
+      .def(
+          "get_sequence_state",
+          [](std::shared_ptr<InferRequest>& infer_request,
+             const std::string& name, const std::vector<int64_t>& shape,
+             py::object dtype) {
+            bool created;
+            std::shared_ptr<PbTensor> state = PbTensor::FromSequenceState(
+                infer_request->CorrelationId(), name, shape,
+                numpy_to_triton_type(dtype), &created);
+            return py::make_tuple(state, created);
+          },
+          py::arg("name").none(false), py::arg("shape").none(false),
+          py::arg("dtype").none(false))
       .def(
           "exec",
           [](std::shared_ptr<InferRequest>& infer_request,
@@ -1111,12 +1905,6 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
           "async_exec",
           [](std::shared_ptr<InferRequest>& infer_request,
              const bool decoupled) {
-            std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
-            if (stub->IsDecoupled()) {
-              throw PythonBackendException(
-                  "Async BLS request execution is not support in the decoupled "
-                  "API.");
-            }
             py::object loop =
                 py::module_::import("asyncio").attr("get_running_loop")();
             py::cpp_function callback = [infer_request, decoupled]() {
@@ -1139,7 +1927,17 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
       .def(
           "requested_output_names", &InferRequest::RequestedOutputNames,
           py::return_value_policy::reference_internal)
-      .def("get_response_sender", &InferRequest::GetResponseSender);
+      .def("get_response_sender", &InferRequest::GetResponseSender)
+      .def(
+          "allocate_output_tensor",
+          [](std::shared_ptr<InferRequest>& infer_request,
+             const std::string& name, const std::vector<int64_t>& shape,
+             py::object dtype) {
+            return infer_request->AllocateOutputTensor(
+                name, shape, numpy_to_triton_type(dtype));
+          },
+          py::arg("name").none(false), py::arg("shape").none(false),
+          py::arg("dtype").none(false));
 
   py::class_<PbTensor, std::shared_ptr<PbTensor>>(module, "Tensor")
       .def(py::init(&PbTensor::FromNumpy))
@@ -1151,6 +1949,11 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
       .def(
           "as_numpy", &PbTensor::AsNumpy,
           py::return_value_policy::reference_internal)
+      .def(
+          "as_bytes_view",
+          [](std::shared_ptr<PbTensor>& tensor) {
+            return tensor->AsBytesView(py::cast(tensor));
+          })
       .def("triton_dtype", &PbTensor::TritonDtype)
       .def("to_dlpack", &PbTensor::ToDLPack)
       .def("is_cpu", &PbTensor::IsCPU)
@@ -1171,10 +1974,52 @@ PYBIND11_EMBEDDED_MODULE(c_python_backend_utils, module)
       .def("has_error", &InferResponse::HasError)
       .def("error", &InferResponse::Error);
 
+  module.def(
+      "get_batched_input_tensor_by_name",
+      [](py::list requests, const std::string& name) {
+        std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
+        return stub->GetBatchedInputTensor(requests, name);
+      },
+      py::arg("requests").none(false), py::arg("name").none(false));
+
+  module.def(
+      "exec_batch",
+      [](std::vector<std::shared_ptr<InferRequest>>& infer_requests) {
+        std::vector<InferRequest*> requests;
+        for (auto& infer_request : infer_requests) {
+          requests.push_back(infer_request.get());
+        }
+        if (requests.empty()) {
+          return std::vector<std::shared_ptr<InferResponse>>{};
+        }
+        return InferRequest::ExecBatch(requests, false /* is_decoupled */);
+      },
+      py::arg("requests").none(false));
+
+  module.def(
+      "get_shared_weights",
+      [](const std::string& name) {
+        return Stub::GetOrCreateInstance()->SharedWeights(name);
+      },
+      py::arg("name").none(false));
+
+  module.def(
+      "empty_output",
+      [](const std::string& name, const std::vector<int64_t>& shape,
+         py::object dtype) {
+        return PbTensor::EmptyInSharedMemory(
+            name, shape, numpy_to_triton_type(dtype));
+      },
+      py::arg("name").none(false), py::arg("shape").none(false),
+      py::arg("dtype").none(false));
+
   py::class_<ResponseSender, std::shared_ptr<ResponseSender>>(
       module, "InferenceResponseSender")
       .def(
           "send", &ResponseSender::Send, py::arg("response") = nullptr,
+          py::arg("flags") = 0)
+      .def(
+          "send_many", &ResponseSender::SendMany, py::arg("responses"),
           py::arg("flags") = 0);
 
   py::class_<ResponseGenerator, std::shared_ptr<ResponseGenerator>>(
@@ -1272,14 +2117,23 @@ main(int argc, char** argv)
   py::scoped_interpreter guard{};
   pid_t parent_pid = std::stoi(argv[5]);
 
+  // The fork server returns only in the forked stubs, which continue as the
+  // stubs of their model instances.
+  if (stub->IsForkServer()) {
+    if (!stub->RunForkServer(parent_pid)) {
+      logger.reset();
+      stub.reset();
+      return 0;
+    }
+  }
+
   std::atomic<bool> background_thread_running = {true};
   std::thread background_thread =
       std::thread([&parent_pid, &background_thread_running, &stub, &logger] {
         while (background_thread_running) {
-          // Every 300ms set the health variable to true. This variable is in
-          // shared memory and will be set to false by the parent process.
-          // The parent process expects that the stub process sets this
-          // variable to true within 1 second.
+          // Every 300ms increment the heartbeat counter. This counter is in
+          // shared memory and the parent process expects it to change
+          // within 1 second.
           std::this_thread::sleep_for(std::chrono::milliseconds(300));
 
           stub->UpdateHealth();
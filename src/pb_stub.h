@@ -32,20 +32,26 @@
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <deque>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <unordered_map>
 #include "infer_request.h"
 #include "infer_response.h"
 #include "ipc_message.h"
 #include "message_queue.h"
 #include "pb_log.h"
 #include "pb_utils.h"
+#include "sequence_state.h"
+#include "shared_weights.h"
 
 
 namespace bi = boost::interprocess;
@@ -151,9 +157,34 @@ class LogMessage {
 
 #define LOG_FL(FN, LN, LVL) LogMessage((char*)(FN), LN, LVL).stream()
 
+/// Release the GIL for the lifetime of the object like py::gil_scoped_release
+/// and account the time spent reacquiring it. The GIL is not released if the
+/// calling thread does not hold it.
+class ScopedGilRelease {
+ public:
+  ScopedGilRelease();
+  ~ScopedGilRelease();
+
+  /// Total time the calling thread has released the GIL through this class.
+  static uint64_t ThreadReleasedNs();
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedGilRelease);
+
+ private:
+  std::chrono::steady_clock::time_point release_start_;
+  std::unique_ptr<py::gil_scoped_release> release_;
+  static thread_local uint64_t thread_released_ns_;
+};
+
 class Stub {
  public:
-  Stub() { log_thread_ = false; };
+  Stub()
+  {
+    log_thread_ = false;
+    dropped_log_messages_ = 0;
+    executing_batch_id_ = 0;
+    executing_trace_address_ = 0;
+  };
   static std::unique_ptr<Stub>& GetOrCreateInstance();
 
   /// Instantiate a new Python backend Stub.
@@ -164,15 +195,38 @@ class Stub {
       bi::managed_external_buffer::handle_t ipc_control_handle,
       const std::string& model_instance_name);
 
-  /// Get the health of the stub process.
-  bool& Health();
-
   /// Get the shared memory manager.
   std::unique_ptr<SharedMemoryManager>& SharedMemory();
 
+  /// Get the sequence state store of the model instance, or nullptr if the
+  /// store is disabled.
+  std::shared_ptr<SequenceStateStore>& SequenceStates();
+
+  /// Get a read-only array of the bytes of a shared weight file of the model.
+  py::array SharedWeights(const std::string& name);
+
+  /// Free the states of the sequences of the requests that have 'flag' set.
+  void EndSequenceStates(py::list requests, uint32_t flag);
+
   /// Run a single command from the shared memory.
   bool RunCommand();
 
+  /// Run the auto-complete of the model and send the completed model
+  /// configuration to the parent process.
+  /// \param ipc_message The auto-complete request.
+  /// \return true if the auto-complete failed.
+  bool ProcessAutoCompleteRequest(std::unique_ptr<IPCMessage>& ipc_message);
+
+  /// Whether the stub is the fork server of a model.
+  bool IsForkServer();
+
+  /// Import the model and fork a new stub for each fork request.
+  /// \param parent_pid The process id of the parent process.
+  /// \return true in a forked stub, which has been instantiated with the
+  /// shared memory region of its model instance. false if the fork server
+  /// should exit.
+  bool RunForkServer(pid_t parent_pid);
+
   /// Setup for the stub process
   py::module StubSetup();
 
@@ -187,13 +241,10 @@ class Stub {
   /// Send a message to the parent process.
   void SendIPCMessage(std::unique_ptr<IPCMessage>& ipc_message);
 
-  /// Send a log message to the parent process.
-  void SendIPCLogMessage(std::unique_ptr<IPCMessage>& ipc_message);
-
   /// Receive a message from the parent process.
   std::unique_ptr<IPCMessage> PopMessage();
 
-  /// Update the health variable in the stub process.
+  /// Increment the heartbeat counter of the stub process.
   void UpdateHealth();
 
   /// Finalize and terminate the stub process
@@ -202,17 +253,57 @@ class Stub {
   /// Load all the requests from shared memory
   py::list LoadRequestsFromSharedMemory(RequestBatch* request_batch_shm_ptr);
 
+  /// Get an input of all the requests as one tensor. The tensor references
+  /// the inputs without a copy when they are contiguous in shared memory.
+  /// \return A tuple of the tensor and the offsets of the requests along the
+  /// first dimension.
+  py::tuple GetBatchedInputTensor(py::list requests, const std::string& name);
+
+  /// Split a response that holds the outputs of all the requests along the
+  /// first dimension into one response per request.
+  py::list SplitBatchedResponse(
+      std::shared_ptr<InferResponse> batched_response, py::list requests);
+
   /// Execute a batch of requests.
   void ProcessRequests(RequestBatch* request_batch_shm_ptr);
 
   void ProcessRequestsDecoupled(RequestBatch* request_batch_shm_ptr);
 
+  /// The identifier of the batch that is being executed. The BLS requests
+  /// that are sent during the execution carry the identifier so that their
+  /// spans are part of the trace of the batch.
+  uint64_t ExecutingBatchId();
+
+  /// The address of the Triton trace of the first traced request of the batch
+  /// that is being executed, or zero. The BLS requests that are sent by the
+  /// execute function are traced as its children.
+  intptr_t ExecutingTraceAddress();
+
+  /// Add the time spent reacquiring the GIL to the counters of the stub.
+  void AddGilWaitTime(uint64_t wait_ns);
+
+  /// Add the time spent in a BLS request to the counters of the stub.
+  void AddBlsExecTime(uint64_t exec_ns);
+
+  /// Account the garbage collections of the interpreter in the counters of
+  /// the stub.
+  void RegisterGcCallback();
+
+  /// Get the event loop that runs the coroutines returned by the execute
+  /// function. The loop is created on the first call and lives as long as
+  /// the stub. In the decoupled mode, the loop runs in its own thread.
+  py::object AsyncEventLoop();
+
   /// Get the memory manager message queue
   std::unique_ptr<MessageQueue<uint64_t>>& MemoryManagerQueue();
 
   void ProcessResponse(InferResponse* response);
   void LoadGPUBuffers(std::unique_ptr<IPCMessage>& ipc_message);
   bool IsDecoupled();
+
+  /// Maximum number of responses of a request that are sent without waiting
+  /// for the parent process to send them.
+  uint32_t DecoupledSendWindow();
   ~Stub();
 
   /// Start client log handler process
@@ -227,8 +318,9 @@ class Stub {
   /// Thread process
   void ServiceLogRequests();
 
-  /// Send client log to the python backend
-  void SendLogMessage(std::unique_ptr<PbLog>& log_send_message);
+  /// Send a batch of client logs to the python backend
+  void SendLogMessages(
+      const std::vector<std::unique_ptr<PbLog>>& logs, uint32_t dropped_count);
 
   /// Check if log handler is running
   bool LogServiceActive();
@@ -238,14 +330,20 @@ class Stub {
   bi::interprocess_condition* stub_cond_;
   bi::interprocess_mutex* parent_mutex_;
   bi::interprocess_condition* parent_cond_;
-  bi::interprocess_mutex* health_mutex_;
   std::string model_path_;
   std::string model_version_;
   std::string name_;
   std::string triton_install_path_;
   IPCControlShm* ipc_control_;
   std::unique_ptr<SharedMemoryManager> shm_pool_;
+  std::shared_ptr<SequenceStateStore> sequence_state_store_;
+  std::unordered_map<std::string, std::shared_ptr<SharedWeightFile>>
+      shared_weight_files_;
   py::object model_instance_;
+  py::object async_event_loop_;
+  py::object async_event_loop_thread_;
+  py::object gc_callback_;
+  std::chrono::steady_clock::time_point gc_start_;
   py::object deserialize_bytes_;
   py::object serialize_bytes_;
   std::unique_ptr<MessageQueue<bi::managed_external_buffer::handle_t>>
@@ -263,5 +361,27 @@ class Stub {
   bool log_thread_;
   std::mutex log_message_mutex_;
   std::condition_variable log_message_cv_;
+
+  // The log messages are sent to the parent process in batches without
+  // waiting for the parent process to receive them. When the parent process
+  // falls behind, the messages that don't fit in the buffer are dropped and
+  // the number of dropped messages is reported with the next batch.
+  static constexpr size_t kMaxLogBatchSize = 1024;
+  static constexpr size_t kMaxPendingLogMessages = 16384;
+  uint32_t dropped_log_messages_;
+
+  std::atomic<uint64_t> executing_batch_id_;
+  std::atomic<intptr_t> executing_trace_address_;
+
+  // The execute responses of the dispatched batches that the parent process
+  // may not have loaded yet. They are released once a later batch reports
+  // that they have been loaded, see 'RequestBatch::released_batch_id'.
+  struct DispatchedExecuteResponse {
+    uint64_t batch_id;
+    std::unique_ptr<IPCMessage> execute_response;
+    AllocatedSharedMemory<ResponseBatch> response_batch;
+    std::unique_ptr<PbString> error_string_shm;
+  };
+  std::deque<DispatchedExecuteResponse> dispatched_execute_responses_;
 };
 }}}  // namespace triton::backend::python
@@ -25,6 +25,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "pb_stub_utils.h"
+#include <cstring>
 #include "pb_utils.h"
 
 namespace triton { namespace backend { namespace python {
@@ -298,4 +299,111 @@ dlpack_to_triton_type(const DLDataType& data_type)
 
   return TRITONSERVER_TYPE_INVALID;
 }
+
+py::array
+serialize_bytes_tensor(const py::array& numpy_array)
+{
+  const size_t element_count = numpy_array.size();
+  std::vector<std::pair<const char*, size_t>> elements;
+  elements.reserve(element_count);
+
+  // Holds the encoded strings until they are copied.
+  std::vector<py::object> encoded_elements;
+  size_t byte_size = 0;
+  if (numpy_array.dtype().kind() == 'O') {
+    PyObject* const* objects =
+        reinterpret_cast<PyObject* const*>(numpy_array.data());
+    for (size_t i = 0; i < element_count; ++i) {
+      // Only exact bytes objects are sent as they are. Any other object is
+      // converted to str and encoded in UTF-8.
+      if (PyBytes_CheckExact(objects[i])) {
+        elements.emplace_back(
+            PyBytes_AS_STRING(objects[i]), PyBytes_GET_SIZE(objects[i]));
+      } else {
+        py::object encoded =
+            py::str(py::handle(objects[i])).attr("encode")("utf-8");
+        elements.emplace_back(
+            PyBytes_AS_STRING(encoded.ptr()), PyBytes_GET_SIZE(encoded.ptr()));
+        encoded_elements.emplace_back(std::move(encoded));
+      }
+      byte_size += sizeof(uint32_t) + elements.back().second;
+    }
+  } else if (numpy_array.dtype().kind() == 'S') {
+    // NumPy removes the trailing zeros of the fixed size bytes.
+    const size_t item_size = numpy_array.itemsize();
+    const char* data = reinterpret_cast<const char*>(numpy_array.data());
+    for (size_t i = 0; i < element_count; ++i) {
+      const char* element = data + i * item_size;
+      size_t length = item_size;
+      while (length > 0 && element[length - 1] == '\0') {
+        --length;
+      }
+      elements.emplace_back(element, length);
+      byte_size += sizeof(uint32_t) + length;
+    }
+  } else {
+    throw PythonBackendException(
+        "Unable to serialize the BYTES tensor. NumPy dtype is not supported.");
+  }
+
+  py::array_t<uint8_t> serialized(byte_size);
+  char* dst = reinterpret_cast<char*>(serialized.mutable_data());
+  for (auto& element : elements) {
+    const uint32_t length = element.second;
+    std::memcpy(dst, &length, sizeof(uint32_t));
+    dst += sizeof(uint32_t);
+    std::memcpy(dst, element.first, element.second);
+    dst += element.second;
+  }
+
+  return serialized;
+}
+
+void
+parse_bytes_tensor(
+    const char* data, const size_t byte_size,
+    std::vector<std::pair<size_t, size_t>>& elements)
+{
+  size_t offset = 0;
+  while (offset < byte_size) {
+    if (byte_size - offset < sizeof(uint32_t)) {
+      throw PythonBackendException(
+          "Unable to deserialize the BYTES tensor. The length of an element "
+          "is truncated.");
+    }
+    uint32_t length;
+    std::memcpy(&length, data + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    if (byte_size - offset < length) {
+      throw PythonBackendException(
+          "Unable to deserialize the BYTES tensor. An element is truncated.");
+    }
+    elements.emplace_back(offset, length);
+    offset += length;
+  }
+}
+
+py::array
+deserialize_bytes_tensor(const char* data, const size_t byte_size)
+{
+  std::vector<std::pair<size_t, size_t>> elements;
+  parse_bytes_tensor(data, byte_size, elements);
+
+  py::array numpy_array(
+      py::dtype("O"), std::vector<ssize_t>{(ssize_t)elements.size()});
+  PyObject** objects = reinterpret_cast<PyObject**>(numpy_array.mutable_data());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    PyObject* element = PyBytes_FromStringAndSize(
+        data + elements[i].first, elements[i].second);
+    if (element == nullptr) {
+      throw py::error_already_set();
+    }
+    // The array owns the new reference. The elements of a new object array
+    // are either null or None.
+    Py_XDECREF(objects[i]);
+    objects[i] = element;
+  }
+
+  return numpy_array;
+}
 }}}  // namespace triton::backend::python
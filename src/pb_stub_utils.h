@@ -28,6 +28,8 @@
 #include <pybind11/embed.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
+#include <utility>
+#include <vector>
 #include "triton/core/tritonserver.h"
 
 namespace py = pybind11;
@@ -57,4 +59,24 @@ TRITONSERVER_DataType dlpack_to_triton_type(const DLDataType& data_type);
 /// \param data_type triton dtype to be converted.
 /// \return equivalent pybind numpy dtype.
 py::dtype triton_to_pybind_dtype(TRITONSERVER_DataType data_type);
+
+/// Serialize a C-contiguous NumPy array of bytes objects into the length
+/// prefixed format of the BYTES tensors. Same as 'serialize_byte_tensor' of
+/// triton_python_backend_utils.
+/// \param numpy_array array with the object_ or bytes_ dtype.
+/// \return 1-D uint8 array that holds the serialized elements.
+py::array serialize_bytes_tensor(const py::array& numpy_array);
+
+/// Find the elements of a serialized BYTES tensor.
+/// \param data the serialized tensor.
+/// \param byte_size the size of the serialized tensor.
+/// \param elements the offset of each element in 'data' and its length.
+void parse_bytes_tensor(
+    const char* data, const size_t byte_size,
+    std::vector<std::pair<size_t, size_t>>& elements);
+
+/// Deserialize a BYTES tensor to a NumPy array of bytes objects. Same as
+/// 'deserialize_bytes_tensor' of triton_python_backend_utils.
+/// \return 1-D array with the object_ dtype.
+py::array deserialize_bytes_tensor(const char* data, const size_t byte_size);
 }}}  // namespace triton::backend::python
@@ -29,6 +29,7 @@
 #endif  // TRITON_ENABLE_GPU
 
 #ifdef TRITON_PB_STUB
+#include "pb_stub.h"
 #include "pb_stub_utils.h"
 namespace py = pybind11;
 #endif
@@ -49,6 +50,7 @@ PbTensor::PbTensor(const std::string& name, py::array& numpy_array)
   memory_type_ = TRITONSERVER_MEMORY_CPU;
   memory_type_id_ = 0;
   dl_managed_tensor_ = nullptr;
+  lazy_request_address_ = 0;
 
   bool is_contiguous =
       numpy_array.attr("data").attr("c_contiguous").cast<bool>();
@@ -57,12 +59,10 @@ PbTensor::PbTensor(const std::string& name, py::array& numpy_array)
     numpy_array = numpy.attr("ascontiguousarray")(numpy_array);
   }
   numpy_array_ = numpy_array;
+  numpy_array_pending_ = false;
 
   if (dtype_ == TRITONSERVER_TYPE_BYTES) {
-    py::module triton_pb_utils =
-        py::module::import("triton_python_backend_utils");
-    numpy_array_serialized_ =
-        triton_pb_utils.attr("serialize_byte_tensor")(numpy_array);
+    numpy_array_serialized_ = serialize_bytes_tensor(numpy_array);
     memory_ptr_ = numpy_array_serialized_.request().ptr;
     byte_size_ = numpy_array_serialized_.nbytes();
   } else {
@@ -98,12 +98,10 @@ PbTensor::PbTensor(
     numpy_array = numpy.attr("ascontiguousarray")(numpy_array);
   }
   numpy_array_ = numpy_array;
+  numpy_array_pending_ = false;
 
   if (dtype == TRITONSERVER_TYPE_BYTES) {
-    py::module triton_pb_utils =
-        py::module::import("triton_python_backend_utils");
-    numpy_array_serialized_ =
-        triton_pb_utils.attr("serialize_byte_tensor")(numpy_array);
+    numpy_array_serialized_ = serialize_bytes_tensor(numpy_array);
     memory_ptr_ = numpy_array_serialized_.request().ptr;
     byte_size_ = numpy_array_serialized_.nbytes();
 
@@ -123,6 +121,7 @@ PbTensor::PbTensor(
   }
   memory_type_id_ = 0;
   dl_managed_tensor_ = nullptr;
+  lazy_request_address_ = 0;
 }
 #endif  // TRITON_PB_STUB
 
@@ -143,30 +142,17 @@ PbTensor::PbTensor(
   dtype_ = dtype;
   dims_ = dims;
 
-#ifdef TRITON_PB_STUB
-  if (memory_type_ == TRITONSERVER_MEMORY_CPU ||
-      memory_type_ == TRITONSERVER_MEMORY_CPU_PINNED) {
-    if (dtype != TRITONSERVER_TYPE_BYTES) {
-      py::object numpy_array =
-          py::array(triton_to_pybind_dtype(dtype_), dims_, (void*)memory_ptr_);
-      numpy_array_ = numpy_array.attr("view")(triton_to_numpy_type(dtype_));
-    } else {
-      py::object numpy_array = py::array(
-          triton_to_pybind_dtype(TRITONSERVER_TYPE_UINT8), {byte_size},
-          (void*)memory_ptr_);
-      py::module triton_pb_utils =
-          py::module::import("triton_python_backend_utils");
-      numpy_array_ =
-          triton_pb_utils.attr("deserialize_bytes_tensor")(numpy_array)
-              .attr("reshape")(dims);
-    }
-  } else {
-    numpy_array_ = py::none();
-  }
-#endif
-
   byte_size_ = byte_size;
   dl_managed_tensor_ = dl_managed_tensor;
+  lazy_request_address_ = 0;
+
+#ifdef TRITON_PB_STUB
+  numpy_array_ = py::none();
+  // The NumPy array is created when it is first used so that tensors that
+  // are never converted to NumPy, e.g. the parts of a fused batch output, do
+  // not copy their data.
+  numpy_array_pending_ = IsCPU();
+#endif
 }
 
 bool
@@ -231,6 +217,109 @@ PbTensor::FromNumpy(const std::string& name, py::array& numpy_array)
   return std::make_shared<PbTensor>(name, numpy_array);
 }
 
+std::shared_ptr<PbTensor>
+PbTensor::EmptyInSharedMemory(
+    const std::string& name, const std::vector<int64_t>& dims,
+    TRITONSERVER_DataType dtype)
+{
+  if (dtype == TRITONSERVER_TYPE_BYTES) {
+    throw PythonBackendException(
+        "Tensors with the BYTES data type can't be allocated in shared "
+        "memory.");
+  }
+  for (const int64_t dim : dims) {
+    if (dim < 0) {
+      throw PythonBackendException(
+          "Tensor '" + name + "' can't have a negative dimension.");
+    }
+  }
+
+  std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
+  const uint64_t byte_size = GetByteSize(dtype, dims);
+  std::unique_ptr<PbMemory> pb_memory = PbMemory::Create(
+      stub->SharedMemory(), TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+      byte_size, nullptr /* data */, false /* copy_gpu */);
+  std::shared_ptr<PbTensor> tensor = std::make_shared<PbTensor>(
+      name, dims, dtype, TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+      pb_memory->DataPtr(), byte_size, nullptr /* DLManagedTensor */);
+
+  // Unlike 'CreateNumpyArray', the array refers to the shared memory instead
+  // of a copy. The array holds a reference of its own to the memory, so the
+  // memory outlives the tensor as long as the array or one of its views is
+  // alive. The reference is not the tensor itself, which caches the array.
+  PbMemory* array_memory =
+      pb_memory->Slice(stub->SharedMemory(), 0 /* offset */, byte_size)
+          .release();
+  tensor->SetMemory(std::move(pb_memory));
+  py::capsule base(array_memory, [](void* memory) {
+    delete reinterpret_cast<PbMemory*>(memory);
+  });
+  py::object numpy_array = py::array(
+      triton_to_pybind_dtype(dtype), dims, tensor->memory_ptr_, base);
+  tensor->numpy_array_ = numpy_array.attr("view")(triton_to_numpy_type(dtype));
+  tensor->numpy_array_pending_ = false;
+
+  return tensor;
+}
+
+namespace {
+
+// Pin of a sequence state held by the NumPy array that refers to it.
+struct SequenceStatePin {
+  std::shared_ptr<SequenceStateStore> store;
+  uint32_t entry;
+};
+
+}  // namespace
+
+std::shared_ptr<PbTensor>
+PbTensor::FromSequenceState(
+    uint64_t correlation_id, const std::string& name,
+    const std::vector<int64_t>& dims, TRITONSERVER_DataType dtype,
+    bool* created)
+{
+  std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
+  std::shared_ptr<SequenceStateStore>& store = stub->SequenceStates();
+  if (store == nullptr) {
+    throw PythonBackendException(
+        "The sequence state store is disabled. Set the "
+        "'SEQUENCE_STATE_BYTE_SIZE' parameter of the model to use it.");
+  }
+  if (correlation_id == 0) {
+    throw PythonBackendException(
+        "Sequence state '" + name +
+        "' can only be used by a request with a correlation ID.");
+  }
+  if (dtype == TRITONSERVER_TYPE_BYTES) {
+    throw PythonBackendException(
+        "Sequence states with the BYTES data type are not supported.");
+  }
+  for (const int64_t dim : dims) {
+    if (dim < 0) {
+      throw PythonBackendException(
+          "Sequence state '" + name + "' can't have a negative dimension.");
+    }
+  }
+
+  uint32_t entry;
+  void* data = store->Acquire(
+      correlation_id, name, GetByteSize(dtype, dims), &entry, created);
+
+  // The state is unpinned when the array and every view of it are released.
+  py::capsule base(
+      new SequenceStatePin{store, entry}, [](void* sequence_state_pin) {
+        SequenceStatePin* pin =
+            reinterpret_cast<SequenceStatePin*>(sequence_state_pin);
+        pin->store->Unpin(pin->entry);
+        delete pin;
+      });
+  py::array numpy_array =
+      py::array(triton_to_pybind_dtype(dtype), dims, data, base)
+          .attr("view")(triton_to_numpy_type(dtype));
+
+  return std::make_shared<PbTensor>(name, numpy_array, dtype);
+}
+
 py::capsule
 PbTensor::ToDLPack()
 {
@@ -238,6 +327,7 @@ PbTensor::ToDLPack()
     throw PythonBackendException(
         "DLPack does not have support for string tensors.");
   }
+  LoadInputData();
 
   DLManagedTensor* dlpack_tensor = new DLManagedTensor;
   dlpack_tensor->dl_tensor.ndim = dims_.size();
@@ -300,6 +390,9 @@ PbTensor::DeleteDLPack()
 std::unique_ptr<PbMemory>&
 PbTensor::Memory()
 {
+#ifdef TRITON_PB_STUB
+  LoadInputData();
+#endif
   return pb_memory_;
 }
 
@@ -398,22 +491,149 @@ PbTensor::Name() const
 }
 
 #ifdef TRITON_PB_STUB
+void
+PbTensor::CreateNumpyArray() const
+{
+  if (dtype_ != TRITONSERVER_TYPE_BYTES) {
+    py::object numpy_array =
+        py::array(triton_to_pybind_dtype(dtype_), dims_, (void*)memory_ptr_);
+    numpy_array_ = numpy_array.attr("view")(triton_to_numpy_type(dtype_));
+  } else {
+    numpy_array_ = deserialize_bytes_tensor(
+                       reinterpret_cast<const char*>(memory_ptr_), byte_size_)
+                       .attr("reshape")(dims_);
+  }
+  numpy_array_pending_ = false;
+}
+
+py::tuple
+PbTensor::AsBytesView(const py::object& owner)
+{
+  if (dtype_ != TRITONSERVER_TYPE_BYTES) {
+    throw PythonBackendException(
+        "Only the tensors with the BYTES data type have a bytes view.");
+  }
+  if (!IsCPU()) {
+    throw PythonBackendException(
+        "Tensor is stored in GPU and cannot be converted to NumPy.");
+  }
+  LoadInputData();
+
+  const char* data = reinterpret_cast<const char*>(memory_ptr_);
+  std::vector<std::pair<size_t, size_t>> elements;
+  parse_bytes_tensor(data, byte_size_, elements);
+
+  py::array_t<int64_t> offsets(elements.size());
+  py::array_t<int64_t> lengths(elements.size());
+  int64_t* offsets_data = offsets.mutable_data();
+  int64_t* lengths_data = lengths.mutable_data();
+  for (size_t i = 0; i < elements.size(); ++i) {
+    offsets_data[i] = elements[i].first;
+    lengths_data[i] = elements[i].second;
+  }
+
+  // The buffer is not copied, so the tensor is kept alive by the array.
+  py::array buffer(
+      triton_to_pybind_dtype(TRITONSERVER_TYPE_UINT8),
+      std::vector<ssize_t>{(ssize_t)byte_size_}, memory_ptr_, owner);
+
+  return py::make_tuple(
+      buffer, offsets.attr("reshape")(dims_), lengths.attr("reshape")(dims_));
+}
+
 const py::array*
-PbTensor::AsNumpy() const
+PbTensor::AsNumpy()
 {
   if (IsCPU()) {
+    if (numpy_array_pending_) {
+      LoadInputData();
+      CreateNumpyArray();
+    }
     return &numpy_array_;
   } else {
     throw PythonBackendException(
         "Tensor is stored in GPU and cannot be converted to NumPy.");
   }
 }
+
+void
+PbTensor::LoadInputData()
+{
+  if (lazy_request_address_ == 0) {
+    return;
+  }
+
+  std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
+  std::unique_ptr<SharedMemoryManager>& shm_pool = stub->SharedMemory();
+  std::unique_ptr<PbString> name_shm = PbString::Create(shm_pool, name_);
+  AllocatedSharedMemory<InputBufferMessage> input_buffer_message_shm =
+      shm_pool->Construct<InputBufferMessage>();
+  InputBufferMessage* input_buffer_message =
+      input_buffer_message_shm.data_.get();
+  input_buffer_message->request_address = lazy_request_address_;
+  input_buffer_message->name = name_shm->ShmHandle();
+  input_buffer_message->memory = 0;
+  input_buffer_message->has_error = false;
+  input_buffer_message->is_error_set = false;
+
+  std::unique_ptr<IPCMessage> ipc_message =
+      IPCMessage::Create(shm_pool, true /* inline_response */);
+  ipc_message->Command() = PYTHONSTUB_InputBufferRequest;
+  ipc_message->Args() = input_buffer_message_shm.handle_;
+
+  std::unique_ptr<PbMemory> pb_memory;
+  std::string error_message;
+  {
+    // The data can also be loaded while a BLS request is sent, when the GIL is
+    // already released.
+    ScopedGilRelease release;
+    bi::scoped_lock<bi::interprocess_mutex> lock{
+        *(ipc_message->ResponseMutex())};
+    stub->SendIPCMessage(ipc_message);
+    ipc_message->ResponseCondition()->wait(lock);
+
+    // The parent process waits for the memory to be loaded before releasing
+    // its references.
+    try {
+      if (input_buffer_message->has_error) {
+        error_message = "Failed to load input '" + name_ + "'";
+        if (input_buffer_message->is_error_set) {
+          error_message += ": " + PbString::LoadFromSharedMemory(
+                                      shm_pool, input_buffer_message->error)
+                                      ->String();
+        }
+      } else {
+        pb_memory = PbMemory::LoadFromSharedMemory(
+            shm_pool, input_buffer_message->memory,
+            false /* open_cuda_handle */);
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      error_message = pb_exception.what();
+    }
+    ipc_message->ResponseCondition()->notify_all();
+  }
+
+  if (!pb_memory) {
+    throw PythonBackendException(error_message);
+  }
+
+  // The tensor may be passed back to the parent process, e.g. as an output.
+  pb_memory_ = std::move(pb_memory);
+  memory_ptr_ = pb_memory_->DataPtr();
+  tensor_shm_ptr_->memory = pb_memory_->ShmHandle();
+  tensor_shm_ptr_->lazy_request_address = 0;
+  lazy_request_address_ = 0;
+}
 #endif  // TRITON_PB_STUB
 
 void
 PbTensor::SaveToSharedMemory(
     std::unique_ptr<SharedMemoryManager>& shm_pool, bool copy_gpu)
 {
+#ifdef TRITON_PB_STUB
+  LoadInputData();
+#endif
   if (!tensor_shm_.data_) {
     uint64_t byte_size;
     if (!pb_memory_) {
@@ -425,11 +645,14 @@ PbTensor::SaveToSharedMemory(
       byte_size = sizeof(TensorShm) + sizeof(int64_t) * dims_.size() +
                   PbString::ShmStructSize(name_);
     }
-    tensor_shm_ = shm_pool->Construct<char>(byte_size);
+    tensor_shm_ = shm_pool->Construct<char>(
+        byte_size, false /* aligned */, ShmObjectType::kTensor);
 
     tensor_shm_ptr_ = reinterpret_cast<TensorShm*>(tensor_shm_.data_.get());
     tensor_shm_ptr_->dtype = dtype_;
     tensor_shm_ptr_->dims_count = dims_.size();
+    tensor_shm_ptr_->lazy_request_address = 0;
+    tensor_shm_ptr_->lazy_byte_size = 0;
     shm_handle_ = tensor_shm_.handle_;
 
     dims_shm_ptr_ = reinterpret_cast<int64_t*>(
@@ -499,9 +722,27 @@ PbTensor::TritonDtype() const
 void*
 PbTensor::DataPtr()
 {
+#ifdef TRITON_PB_STUB
+  LoadInputData();
+#endif
   return memory_ptr_;
 }
 
+void
+PbTensor::SaveToSharedMemoryWithoutData(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const intptr_t request_address)
+{
+  const uint64_t byte_size = byte_size_;
+  pb_memory_ = PbMemory::Create(
+      shm_pool, memory_type_, memory_type_id_, 0 /* byte_size */,
+      nullptr /* data */, false /* copy_gpu */);
+  SaveToSharedMemory(shm_pool, false /* copy_gpu */);
+  tensor_shm_ptr_->lazy_request_address = request_address;
+  tensor_shm_ptr_->lazy_byte_size = byte_size;
+  lazy_request_address_ = request_address;
+}
+
 bi::managed_external_buffer::handle_t
 PbTensor::ShmHandle()
 {
@@ -528,27 +769,14 @@ PbTensor::PbTensor(
   memory_type_ = pb_memory_->MemoryType();
   memory_type_id_ = pb_memory_->MemoryTypeId();
   shm_handle_ = tensor_shm_.handle_;
+  lazy_request_address_ = tensor_shm_ptr_->lazy_request_address;
+  if (lazy_request_address_ != 0) {
+    byte_size_ = tensor_shm_ptr_->lazy_byte_size;
+  }
 
 #ifdef TRITON_PB_STUB
-  if (memory_type_ == TRITONSERVER_MEMORY_CPU ||
-      memory_type_ == TRITONSERVER_MEMORY_CPU_PINNED) {
-    if (dtype_ != TRITONSERVER_TYPE_BYTES) {
-      py::object numpy_array =
-          py::array(triton_to_pybind_dtype(dtype_), dims_, (void*)memory_ptr_);
-      numpy_array_ = numpy_array.attr("view")(triton_to_numpy_type(dtype_));
-    } else {
-      py::object numpy_array = py::array(
-          triton_to_pybind_dtype(TRITONSERVER_TYPE_UINT8), {byte_size_},
-          (void*)memory_ptr_);
-      py::module triton_pb_utils =
-          py::module::import("triton_python_backend_utils");
-      numpy_array_ =
-          triton_pb_utils.attr("deserialize_bytes_tensor")(numpy_array)
-              .attr("reshape")(dims_);
-    }
-  } else {
-    numpy_array_ = py::none();
-  }
+  numpy_array_ = py::none();
+  numpy_array_pending_ = IsCPU();
 #endif
 }
 }}}  // namespace triton::backend::python
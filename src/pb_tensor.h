@@ -58,6 +58,11 @@ struct TensorShm {
   bi::managed_external_buffer::handle_t memory;
   TRITONSERVER_DataType dtype;
   size_t dims_count;
+  // Address of the request that the stub process loads the input data from
+  // when the tensor is first used, and the byte size of the input. The address
+  // is zero if the data is already stored in shared memory.
+  intptr_t lazy_request_address;
+  uint64_t lazy_byte_size;
 };
 
 // PbTensor class is the representation of Triton tensors inside Python backend.
@@ -125,6 +130,36 @@ class PbTensor {
   static std::shared_ptr<PbTensor> FromNumpy(
       const std::string& name, py::array& numpy_array);
 
+  /// Allocate an uninitialized CPU tensor in the shared memory pool. The
+  /// NumPy representation of the tensor is a writable view of the pool, so
+  /// the model can compute an output in place and return it without the copy
+  /// to shared memory.
+  /// \param name name of the tensor
+  /// \param dims Tensor dimensions
+  /// \param dtype Triton dtype
+  /// \throws PythonBackendException if the dtype is BYTES or a dimension is
+  /// negative.
+  static std::shared_ptr<PbTensor> EmptyInSharedMemory(
+      const std::string& name, const std::vector<int64_t>& dims,
+      TRITONSERVER_DataType dtype);
+
+  /// Get a state of a sequence from the sequence state store of the model
+  /// instance. The state is zeroed when it is first used. The NumPy
+  /// representation of the tensor is a writable view of the state, so the
+  /// changes are kept for the next request of the sequence.
+  /// \param correlation_id The correlation ID of the sequence
+  /// \param name name of the state
+  /// \param dims Tensor dimensions
+  /// \param dtype Triton dtype
+  /// \param created Set to true if the state was zeroed, either because the
+  /// sequence didn't use it before or because it was evicted.
+  /// \throws PythonBackendException if the store is disabled, the dtype is
+  /// BYTES or the state can't be allocated.
+  static std::shared_ptr<PbTensor> FromSequenceState(
+      uint64_t correlation_id, const std::string& name,
+      const std::vector<int64_t>& dims, TRITONSERVER_DataType dtype,
+      bool* created);
+
   /// Get a PyCapsule object containing the DLPack representation of the tensor.
   /// \return Capsule object containing pointer to a DLPack object.
   py::capsule ToDLPack();
@@ -159,7 +194,15 @@ class PbTensor {
   /// Get NumPy representation of the tensor.
   /// \throw If the tensor is stored in GPU, an exception is thrown
   /// \return NumPy representation of the Tensor
-  const py::array* AsNumpy() const;
+  const py::array* AsNumpy();
+
+  /// Get the elements of a BYTES tensor without copying them.
+  /// \param owner Python object that keeps the tensor alive.
+  /// \throw If the tensor is stored in GPU or its dtype is not BYTES, an
+  /// exception is thrown.
+  /// \return Tuple of a uint8 array over the serialized tensor, and the offset
+  /// and the length of each element in it.
+  py::tuple AsBytesView(const py::object& owner);
 #endif
 
   /// Save tensor inside shared memory.
@@ -174,6 +217,18 @@ class PbTensor {
   /// \return Get the raw pointer.
   void* DataPtr();
 
+  /// Save the tensor inside shared memory without its data. The stub process
+  /// requests the data of the input when the tensor is first used.
+  /// \param request_address The address of the request of the input.
+  void SaveToSharedMemoryWithoutData(
+      std::unique_ptr<SharedMemoryManager>& shm_pool,
+      const intptr_t request_address);
+
+#ifdef TRITON_PB_STUB
+  /// Load the data of an input that was saved without its data.
+  void LoadInputData();
+#endif
+
   /// This function will be automatically called by the stub when the tensor is
   /// no longer required.
   void DeleteDLPack();
@@ -216,9 +271,13 @@ class PbTensor {
  private:
   std::string name_;
 #ifdef TRITON_PB_STUB
-  py::array numpy_array_;
+  mutable py::array numpy_array_;
+  // True if 'numpy_array_' still has to be created from the tensor data.
+  mutable bool numpy_array_pending_;
   // Storing the serialized version of the numpy array
   py::array numpy_array_serialized_;
+
+  void CreateNumpyArray() const;
 #endif
   TRITONSERVER_DataType dtype_;
   void* memory_ptr_;
@@ -237,5 +296,8 @@ class PbTensor {
 
   // The pointer is null when the object is not stored in shared memory.
   std::unique_ptr<PbMemory> pb_memory_;
+
+  // The address of the request to load the input data from, or zero.
+  intptr_t lazy_request_address_;
 };
 }}}  // namespace triton::backend::python
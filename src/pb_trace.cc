@@ -0,0 +1,71 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "pb_trace.h"
+
+#include <iomanip>
+#include <sstream>
+#include "pb_exception.h"
+
+namespace triton { namespace backend { namespace python {
+
+PbTracer::PbTracer(const std::string& trace_file)
+    : file_(trace_file, std::ios::out | std::ios::trunc), has_spans_(false)
+{
+  if (!file_) {
+    throw PythonBackendException(
+        "Failed to open the trace file '" + trace_file + "'.");
+  }
+
+  // The closing bracket of the array is optional in the trace event format,
+  // which allows the file to be read while the server is running.
+  file_ << "[" << std::flush;
+}
+
+void
+PbTracer::WriteSpan(const PbTraceSpan& span)
+{
+  // The trace event format uses microseconds.
+  std::stringstream event;
+  event << std::fixed << std::setprecision(3);
+  event << "{\"name\":\"" << span.name << "\",\"cat\":\"python_backend\""
+        << ",\"ph\":\"X\",\"ts\":" << span.start_ns / 1000.0
+        << ",\"dur\":" << (span.end_ns - span.start_ns) / 1000.0
+        << ",\"pid\":" << span.pid << ",\"tid\":" << span.tid
+        << ",\"args\":{\"model\":\"" << span.model_name
+        << "\",\"instance\":\"" << span.instance_name
+        << "\",\"batch_id\":" << span.batch_id << ",\"trace_ids\":[";
+  for (size_t i = 0; i < span.trace_ids.size(); ++i) {
+    event << (i == 0 ? "" : ",") << span.trace_ids[i];
+  }
+  event << "]}}";
+
+  std::lock_guard<std::mutex> guard{mu_};
+  file_ << (has_spans_ ? ",\n" : "\n") << event.str() << std::flush;
+  has_spans_ = true;
+}
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,72 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <sys/types.h>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace triton { namespace backend { namespace python {
+
+// A span of the execution of a batch of requests, either in the Triton
+// process or in the stub process. The timestamps are taken from the steady
+// clock that is also used by the Triton request traces.
+struct PbTraceSpan {
+  std::string name;
+  std::string model_name;
+  std::string instance_name;
+  pid_t pid;
+  pid_t tid;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  // Identifier of the batch in the model instance. The BLS requests use the
+  // identifier of the batch that created them.
+  uint64_t batch_id;
+  // Ids of the Triton traces of the requests in the batch.
+  std::vector<uint64_t> trace_ids;
+};
+
+// Writes the spans of the Python backend to a file in the JSON trace event
+// format that can be opened in Perfetto or 'chrome://tracing'.
+class PbTracer {
+ public:
+  /// Open the trace file. Throws PythonBackendException if the file can't be
+  /// opened.
+  /// \param trace_file Path of the trace file. The file is overwritten.
+  explicit PbTracer(const std::string& trace_file);
+
+  void WriteSpan(const PbTraceSpan& span);
+
+ private:
+  std::mutex mu_;
+  std::ofstream file_;
+  bool has_spans_;
+};
+
+}}}  // namespace triton::backend::python
@@ -42,6 +42,7 @@
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include "scoped_defer.h"
@@ -106,11 +107,9 @@ CUDAHandler::IsAvailable()
 }
 
 void
-CUDAHandler::OpenCudaHandle(
-    int64_t memory_type_id, cudaIpcMemHandle_t* cuda_mem_handle,
-    void** data_ptr)
+CUDAHandler::SetDeviceAndRun(
+    int64_t memory_type_id, const std::function<void()>& function)
 {
-  std::lock_guard<std::mutex> guard{mu_};
   int current_device;
 
   // Save the previous device
@@ -145,59 +144,107 @@ CUDAHandler::OpenCudaHandle(
     }
   }
 
-  err = cudaIpcOpenMemHandle(
-      data_ptr, *cuda_mem_handle, cudaIpcMemLazyEnablePeerAccess);
-  if (err != cudaSuccess) {
-    throw PythonBackendException(
-        std::string("Failed to open the cudaIpcHandle. error: ") +
-        cudaGetErrorString(err));
-  }
+  function();
 }
 
 void
-CUDAHandler::CloseCudaHandle(int64_t memory_type_id, void* data_ptr)
+CUDAHandler::OpenCudaHandle(
+    int64_t memory_type_id, cudaIpcMemHandle_t* cuda_mem_handle,
+    void** data_ptr, const bool cache)
 {
   std::lock_guard<std::mutex> guard{mu_};
-  int current_device;
-
-  // Save the previous device
-  cudaError_t err = cudaGetDevice(&current_device);
-  if (err != cudaSuccess) {
-    throw PythonBackendException(
-        std::string("Failed to get the current CUDA device. error: ") +
-        cudaGetErrorString(err));
+  std::string key;
+  if (cache) {
+    key = std::to_string(memory_type_id) + ":" +
+          std::string(
+              reinterpret_cast<char*>(cuda_mem_handle),
+              sizeof(cudaIpcMemHandle_t));
+    auto opened_cuda_handle = opened_cuda_handles_.find(key);
+    if (opened_cuda_handle != opened_cuda_handles_.end()) {
+      opened_cuda_handle->second.ref_count++;
+      *data_ptr = opened_cuda_handle->second.data_ptr;
+      return;
+    }
   }
 
-  bool overridden = (current_device != memory_type_id);
+  SetDeviceAndRun(memory_type_id, [cuda_mem_handle, data_ptr] {
+    cudaError_t err = cudaIpcOpenMemHandle(
+        data_ptr, *cuda_mem_handle, cudaIpcMemLazyEnablePeerAccess);
+    if (err != cudaSuccess) {
+      throw PythonBackendException(
+          std::string("Failed to open the cudaIpcHandle. error: ") +
+          cudaGetErrorString(err));
+    }
+  });
 
-  // Restore the previous device before returning from the function.
-  ScopedDefer _(std::bind([&overridden, &current_device] {
-    if (overridden) {
-      cudaError_t err = cudaSetDevice(current_device);
-      if (err != cudaSuccess) {
-        throw PythonBackendException(
-            "Failed to set the CUDA device to " +
-            std::to_string(current_device) +
-            ". error: " + cudaGetErrorString(err));
-      }
+  if (cache) {
+    opened_cuda_handles_[key] = {
+        memory_type_id, *data_ptr, 1 /* ref_count */, 0 /* last_release */};
+    opened_cuda_handle_keys_[*data_ptr] = key;
+  }
+}
+
+void
+CUDAHandler::CloseCudaHandle(int64_t memory_type_id, void* data_ptr)
+{
+  std::lock_guard<std::mutex> guard{mu_};
+  auto key = opened_cuda_handle_keys_.find(data_ptr);
+  if (key != opened_cuda_handle_keys_.end()) {
+    OpenedCudaHandle& opened_cuda_handle = opened_cuda_handles_[key->second];
+    opened_cuda_handle.ref_count--;
+    if (opened_cuda_handle.ref_count == 0) {
+      opened_cuda_handle.last_release = ++release_count_;
+      CloseIdleCudaHandles();
     }
-  }));
+    return;
+  }
 
-  if (overridden) {
-    err = cudaSetDevice(memory_type_id);
+  SetDeviceAndRun(memory_type_id, [data_ptr] {
+    cudaError_t err = cudaIpcCloseMemHandle(data_ptr);
     if (err != cudaSuccess) {
       throw PythonBackendException(
-          std::string("Failed to set the CUDA device to ") +
-          std::to_string(memory_type_id) +
-          ". error: " + cudaGetErrorString(err));
+          std::string("Failed to close the cudaIpcHandle. error: ") +
+          cudaGetErrorString(err));
     }
-  }
+  });
+}
 
-  err = cudaIpcCloseMemHandle(data_ptr);
-  if (err != cudaSuccess) {
-    throw PythonBackendException(
-        std::string("Failed to close the cudaIpcHandle. error: ") +
-        cudaGetErrorString(err));
+void
+CUDAHandler::CloseIdleCudaHandles()
+{
+  // Keep the memory of allocations that are no longer used, e.g. CUDA shared
+  // memory regions that were unregistered by the client, from being held
+  // forever by closing the least recently used handles.
+  constexpr size_t kMaxIdleCudaHandles = 16;
+  while (true) {
+    size_t idle_count = 0;
+    auto oldest = opened_cuda_handles_.end();
+    for (auto it = opened_cuda_handles_.begin();
+         it != opened_cuda_handles_.end(); ++it) {
+      if (it->second.ref_count == 0) {
+        idle_count++;
+        if (oldest == opened_cuda_handles_.end() ||
+            it->second.last_release < oldest->second.last_release) {
+          oldest = it;
+        }
+      }
+    }
+    if (idle_count <= kMaxIdleCudaHandles) {
+      break;
+    }
+
+    void* data_ptr = oldest->second.data_ptr;
+    int64_t memory_type_id = oldest->second.memory_type_id;
+    opened_cuda_handle_keys_.erase(data_ptr);
+    opened_cuda_handles_.erase(oldest);
+    SetDeviceAndRun(memory_type_id, [data_ptr] {
+      cudaError_t err = cudaIpcCloseMemHandle(data_ptr);
+      if (err != cudaSuccess) {
+        throw PythonBackendException(
+            std::string("Failed to close the cudaIpcHandle. error: ") +
+            cudaGetErrorString(err));
+      }
+    });
   }
 }
 
@@ -212,6 +259,52 @@ CUDAHandler::~CUDAHandler() noexcept(false)
 }
 #endif
 
+bool
+ParseCpuList(const std::string& cpu_list, cpu_set_t* cpu_set)
+{
+  CPU_ZERO(cpu_set);
+  size_t start = 0;
+  while (start <= cpu_list.size()) {
+    size_t end = cpu_list.find(',', start);
+    if (end == std::string::npos) {
+      end = cpu_list.size();
+    }
+    std::string range = cpu_list.substr(start, end - start);
+    start = end + 1;
+
+    // The sysfs files end with a new line.
+    range.erase(0, range.find_first_not_of(" \n"));
+    range.erase(range.find_last_not_of(" \n") + 1);
+    size_t separator = range.find('-');
+    if (range.empty() ||
+        range.find_first_not_of("0123456789-") != std::string::npos ||
+        (separator != std::string::npos &&
+         range.find('-', separator + 1) != std::string::npos)) {
+      return false;
+    }
+
+    unsigned long first_cpu;
+    unsigned long last_cpu;
+    try {
+      first_cpu = std::stoul(range.substr(0, separator));
+      last_cpu = separator == std::string::npos
+                     ? first_cpu
+                     : std::stoul(range.substr(separator + 1));
+    }
+    catch (const std::logic_error& le) {
+      return false;
+    }
+    if (first_cpu > last_cpu || last_cpu >= CPU_SETSIZE) {
+      return false;
+    }
+    for (unsigned long cpu = first_cpu; cpu <= last_cpu; cpu++) {
+      CPU_SET(cpu, cpu_set);
+    }
+  }
+
+  return CPU_COUNT(cpu_set) > 0;
+}
+
 #ifndef TRITON_PB_STUB
 std::shared_ptr<TRITONSERVER_Error*>
 WrapTritonErrorInSharedPtr(TRITONSERVER_Error* error)
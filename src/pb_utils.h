@@ -30,9 +30,12 @@
 #include <cuda.h>
 #endif  // TRITON_ENABLE_GPU
 #include <pthread.h>
+#include <sched.h>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <atomic>
 #include <climits>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -113,6 +116,17 @@ struct InitializeResponseShm {
   bi::managed_external_buffer::handle_t response_error;
 };
 
+struct ForkResponseShm {
+  // Indicates whether the response has an error or not.
+  bool response_has_error;
+  // Indicates whether the response error is set or not.
+  bool response_is_error_set;
+  // Contains the error message.
+  bi::managed_external_buffer::handle_t response_error;
+  // The process id of the forked stub.
+  int64_t pid;
+};
+
 struct AutoCompleteResponseShm {
   // Indicates whether the response has an error or not.
   bool response_has_error;
@@ -129,12 +143,25 @@ struct AutoCompleteResponseShm {
 // Control data structure for the communication between the Python stub and the
 // main stub.
 struct IPCControlShm {
-  bool stub_health;
+  // Incremented by the stub every 300 milliseconds while it is running.
+  std::atomic<uint64_t> stub_heartbeat;
+  // Cumulative times of the stub process in nanoseconds: the GIL held by the
+  // thread that runs the execute function, the waits of all the threads to
+  // reacquire the GIL released by the stub, the BLS requests and the garbage
+  // collections.
+  std::atomic<uint64_t> gil_held_ns;
+  std::atomic<uint64_t> gil_wait_ns;
+  std::atomic<uint64_t> bls_exec_ns;
+  std::atomic<uint64_t> gc_pause_ns;
   bool parent_health;
   bool uses_env;
   bool decoupled;
+  bool fused_batch;
+  uint32_t decoupled_send_window;
+  // The stub only imports the model and forks the stubs of the model
+  // instances.
+  bool fork_server;
   bi::interprocess_mutex parent_health_mutex;
-  bi::interprocess_mutex stub_health_mutex;
   bi::managed_external_buffer::handle_t stub_message_queue;
   bi::managed_external_buffer::handle_t parent_message_queue;
   bi::managed_external_buffer::handle_t log_message_queue;
@@ -154,21 +181,45 @@ struct ResponseBatch {
   bool is_error_set;
 
   uint32_t response_size;
-};
 
-struct LogSendMessageBase {
-  bi::interprocess_mutex log_mu;
-  bi::interprocess_condition log_cv;
-  bool waiting_on_stub;
+  // Time spent by the stub process loading the requests, running the execute
+  // function and saving the responses. The durations are zero for the
+  // phases that were not reached.
+  uint64_t load_requests_ns;
+  uint64_t execute_ns;
+  uint64_t save_responses_ns;
+
+  // The parts of 'execute_ns' that were spent holding the GIL, and the times
+  // of the stub process spent reacquiring the GIL, in BLS requests and in
+  // garbage collections while the execute function ran.
+  uint64_t execute_gil_held_ns;
+  uint64_t execute_gil_wait_ns;
+  uint64_t execute_bls_ns;
+  uint64_t execute_gc_ns;
+
+  // The identifier of the request batch and the steady clock timestamp at
+  // which the stub process started to load the requests. They are used to put
+  // the spans of the stub process in the trace of the batch.
+  uint64_t batch_id;
+  uint64_t stub_start_ns;
 };
 
 enum LogLevel { INFO = 0, WARNING, ERROR, VERBOSE };
 
-struct LogSendMessage : LogSendMessageBase {
-  bi::managed_external_buffer::handle_t filename;
-  int32_t line;
-  bi::managed_external_buffer::handle_t log_message;
+// A batch of log messages is stored in a single shared memory block. The
+// header is followed by `log_count` records, each one followed by the file
+// name and the message.
+struct LogBatchShm {
+  uint32_t log_count;
+  // Number of log messages dropped by the stub since the previous batch.
+  uint32_t dropped_count;
+};
+
+struct LogRecordShm {
   LogLevel level;
+  uint32_t line;
+  uint32_t filename_size;
+  uint32_t message_size;
 };
 
 struct ResponseSenderBase {
@@ -192,6 +243,43 @@ struct ResponseSendMessage : ResponseSenderBase {
   uint32_t gpu_buffers_count;
 
   uint32_t flags;
+
+  // The stub process doesn't wait for the response to be sent. The parent
+  // process sets 'is_stub_turn' once it is sent.
+  bool is_async;
+
+  // Handles of the responses that are sent together instead of 'response'.
+  // The flags are sent with the last response.
+  bi::managed_external_buffer::handle_t responses;
+  uint32_t response_count;
+};
+
+// Request for the buffer of an output of a response that the stub process
+// writes the output to. The dimensions of the output follow this struct.
+struct OutputBufferMessage {
+  intptr_t request_address;
+  bi::managed_external_buffer::handle_t name;
+  TRITONSERVER_DataType dtype;
+  uint32_t dims_count;
+
+  // Set by the parent process.
+  bi::managed_external_buffer::handle_t memory;
+  bool has_error;
+  bool is_error_set;
+  bi::managed_external_buffer::handle_t error;
+};
+
+// Request for the data of an input that the parent process did not copy to
+// shared memory before the execution.
+struct InputBufferMessage {
+  intptr_t request_address;
+  bi::managed_external_buffer::handle_t name;
+
+  // Set by the parent process.
+  bi::managed_external_buffer::handle_t memory;
+  bool has_error;
+  bool is_error_set;
+  bi::managed_external_buffer::handle_t error;
 };
 
 struct RequestBatch {
@@ -202,6 +290,29 @@ struct RequestBatch {
 
   // GPU buffers count
   uint32_t gpu_buffers_count;
+
+  // Identifier of the batch in the model instance, used to correlate the
+  // spans of the Triton and stub processes. A batch of BLS requests has the
+  // identifier of the batch that was executing when it was created.
+  uint64_t batch_id;
+
+  // Highest priority of the requests of a batch of BLS requests, i.e. the
+  // lowest non-zero priority value, or zero if none of the requests has a
+  // priority.
+  uint32_t priority;
+
+  // Whether the parent process doesn't wait for the execute response of the
+  // batch, in which case it doesn't acknowledge the response either.
+  bool is_dispatched;
+
+  // The parent process has loaded the execute responses of the dispatched
+  // batches with a lower identifier, so the stub process can release them.
+  uint64_t released_batch_id;
+
+  // Trace of the request that was executing when a batch of BLS requests was
+  // created, used as the parent of the traces of the BLS requests that don't
+  // have a trace. Zero if there is none.
+  intptr_t trace_address;
 };
 
 #ifdef TRITON_ENABLE_GPU
@@ -219,8 +330,26 @@ class CUDAHandler {
   CUresult (*cu_pointer_get_attribute_fn_)(
       CUdeviceptr*, CUpointer_attribute, CUdeviceptr) = nullptr;
   CUresult (*cu_get_error_string_fn_)(CUresult, const char**) = nullptr;
+
+  // IPC handles that stay open after the last memory that uses them is
+  // released, keyed by the device and the handle bytes. Triton's memory pool
+  // returns parts of the same base allocations over and over, so opening
+  // their handles again can be skipped.
+  struct OpenedCudaHandle {
+    int64_t memory_type_id;
+    void* data_ptr;
+    uint32_t ref_count;
+    uint64_t last_release;
+  };
+  std::unordered_map<std::string, OpenedCudaHandle> opened_cuda_handles_;
+  std::unordered_map<void*, std::string> opened_cuda_handle_keys_;
+  uint64_t release_count_ = 0;
+
   CUDAHandler();
   ~CUDAHandler() noexcept(false);
+  void SetDeviceAndRun(
+      int64_t memory_type_id, const std::function<void()>& function);
+  void CloseIdleCudaHandles();
 
  public:
   CUDAHandler(CUDAHandler const&) = delete;
@@ -229,13 +358,24 @@ class CUDAHandler {
   void PointerGetAttribute(
       CUdeviceptr* start_address, CUpointer_attribute attr,
       CUdeviceptr device_ptr);
+
+  /// Open a CUDA IPC handle.
+  /// \param cache Whether the handle can be kept open after it is closed,
+  /// which must only be set if the base allocation is not freed while the
+  /// process is running.
   void OpenCudaHandle(
       int64_t memory_type_id, cudaIpcMemHandle_t* cuda_mem_handle,
-      void** data_ptr);
+      void** data_ptr, const bool cache = false);
   void CloseCudaHandle(int64_t memory_type_id, void* data_ptr);
 };
 #endif  // TRITON_ENABLE_GPU
 
+/// Parse a list of CPUs in the format of the Linux 'cpulist' files, such as
+/// "0-7,16-23".
+/// \return false if the list is empty or malformed, or if a CPU doesn't fit
+/// in 'cpu_set'.
+bool ParseCpuList(const std::string& cpu_list, cpu_set_t* cpu_set);
+
 #ifndef TRITON_PB_STUB
 std::shared_ptr<TRITONSERVER_Error*> WrapTritonErrorInSharedPtr(
     TRITONSERVER_Error* error);
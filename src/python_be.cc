@@ -32,11 +32,126 @@ namespace triton { namespace backend { namespace python {
 
 namespace bi = boost::interprocess;
 
+namespace {
+
+pid_t
+CurrentThreadId()
+{
+  return syscall(SYS_gettid);
+}
+
+}  // namespace
+
 ModelInstanceState::ModelInstanceState(
     ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance)
     : BackendModelInstance(model_state, triton_model_instance)
 {
   log_thread_ = false;
+  pipeline_thread_running_ = false;
+  is_stub_pool_member_ = false;
+
+  std::unique_ptr<PbMetricFamilies>& families =
+      model_state->StateForBackend()->metric_families;
+  const std::vector<std::pair<std::string, std::string>> instance_labels{
+      {"model", model_state->Name()},
+      {"version", std::to_string(model_state->Version())},
+      {"instance", Name()}};
+  auto labels = [&instance_labels](
+                    const std::string& key, const std::string& value) {
+    std::vector<std::pair<std::string, std::string>> metric_labels =
+        instance_labels;
+    metric_labels.emplace_back(key, value);
+    return metric_labels;
+  };
+  parent_spin_hits_metric_ =
+      CreateMetric(families->ipc_spin_hits, labels("queue", "parent"));
+  parent_sleeps_metric_ =
+      CreateMetric(families->ipc_sleeps, labels("queue", "parent"));
+  stub_spin_hits_metric_ =
+      CreateMetric(families->ipc_spin_hits, labels("queue", "stub"));
+  stub_sleeps_metric_ =
+      CreateMetric(families->ipc_sleeps, labels("queue", "stub"));
+  shm_global_lock_acquisitions_metric_ =
+      CreateMetric(families->shm_lock_acquisitions, labels("lock", "global"));
+  shm_global_lock_contentions_metric_ =
+      CreateMetric(families->shm_lock_contentions, labels("lock", "global"));
+  shm_slab_lock_acquisitions_metric_ =
+      CreateMetric(families->shm_lock_acquisitions, labels("lock", "slab"));
+  shm_slab_lock_contentions_metric_ =
+      CreateMetric(families->shm_lock_contentions, labels("lock", "slab"));
+  shm_thread_cache_hits_metric_ =
+      CreateMetric(families->shm_thread_cache_hits, instance_labels);
+  shm_thread_cache_misses_metric_ =
+      CreateMetric(families->shm_thread_cache_misses, instance_labels);
+  closed_request_checks_ = 0;
+  closed_request_checks_metric_ =
+      CreateMetric(families->closed_request_checks, instance_labels);
+  dropped_log_messages_ = 0;
+  dropped_log_messages_metric_ =
+      CreateMetric(families->dropped_log_messages, instance_labels);
+  save_requests_duration_metric_ =
+      CreateMetric(families->phase_duration, labels("phase", "save_requests"));
+  ipc_duration_metric_ =
+      CreateMetric(families->phase_duration, labels("phase", "ipc"));
+  stub_load_requests_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "stub_load_requests"));
+  stub_execute_duration_metric_ =
+      CreateMetric(families->phase_duration, labels("phase", "stub_execute"));
+  stub_save_responses_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "stub_save_responses"));
+  load_responses_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "load_responses"));
+  send_responses_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "send_responses"));
+  load_gpu_buffers_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "load_gpu_buffers"));
+  stub_execute_gil_held_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "stub_execute_gil_held"));
+  stub_execute_gil_wait_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "stub_execute_gil_wait"));
+  stub_execute_bls_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "stub_execute_bls"));
+  stub_execute_gc_duration_metric_ = CreateMetric(
+      families->phase_duration, labels("phase", "stub_execute_gc"));
+  stub_gil_held_time_metric_ =
+      CreateMetric(families->stub_time, labels("activity", "gil_held"));
+  stub_gil_wait_time_metric_ =
+      CreateMetric(families->stub_time, labels("activity", "gil_wait"));
+  stub_bls_exec_time_metric_ =
+      CreateMetric(families->stub_time, labels("activity", "bls_exec"));
+  stub_gc_pause_time_metric_ =
+      CreateMetric(families->stub_time, labels("activity", "gc_pause"));
+  for (size_t i = 0; i < kShmAllocationSizeBucketCount; ++i) {
+    shm_allocations_metrics_.emplace_back(CreateMetric(
+        families->shm_allocations,
+        labels("max_bytes", ShmAllocationSizeBucketName(i))));
+  }
+  for (size_t i = 0; i < kShmObjectTypeCount; ++i) {
+    shm_live_objects_metrics_.emplace_back(CreateMetric(
+        families->shm_live_objects, labels("type", ShmObjectTypeName(i))));
+  }
+  shm_peak_allocated_bytes_metric_ =
+      CreateMetric(families->shm_peak_allocated_bytes, instance_labels);
+  shm_grow_successes_metric_ =
+      CreateMetric(families->shm_grows, labels("result", "success"));
+  shm_grow_failures_metric_ =
+      CreateMetric(families->shm_grows, labels("result", "failure"));
+  shm_fragmentation_metric_ =
+      CreateMetric(families->shm_fragmentation, instance_labels);
+  last_fragmentation_report_ns_ = 0;
+  next_batch_id_ = 0;
+  released_batch_id_ = 0;
+  next_bls_task_sequence_ = 0;
+  if (model_state->StateForBackend()->bls_response_cache_byte_size > 0) {
+    bls_cache_hits_metric_ =
+        CreateMetric(families->bls_cache_requests, labels("result", "hit"));
+    bls_cache_misses_metric_ =
+        CreateMetric(families->bls_cache_requests, labels("result", "miss"));
+    bls_cache_in_flight_hits_metric_ = CreateMetric(
+        families->bls_cache_requests, labels("result", "in_flight"));
+    bls_cache_bytes_metric_ =
+        CreateMetric(families->bls_cache_bytes, instance_labels);
+  }
 }
 
 TRITONSERVER_Error*
@@ -56,6 +171,221 @@ ModelInstanceState::Create(
   return nullptr;
 }
 
+void
+ModelInstanceState::ObserveStubDurations(
+    ResponseBatch* response_batch, uint64_t round_trip_ns)
+{
+  uint64_t stub_ns = response_batch->load_requests_ns +
+                     response_batch->execute_ns +
+                     response_batch->save_responses_ns;
+  ObserveMetric(
+      ipc_duration_metric_,
+      round_trip_ns > stub_ns ? (round_trip_ns - stub_ns) / 1000.0 : 0);
+  ObserveMetric(
+      stub_load_requests_duration_metric_,
+      response_batch->load_requests_ns / 1000.0);
+  ObserveMetric(
+      stub_execute_duration_metric_, response_batch->execute_ns / 1000.0);
+  ObserveMetric(
+      stub_execute_gil_held_duration_metric_,
+      response_batch->execute_gil_held_ns / 1000.0);
+  // Most batches don't wait for the GIL, send BLS requests or collect
+  // garbage, so only the batches that do are observed.
+  if (response_batch->execute_gil_wait_ns > 0) {
+    ObserveMetric(
+        stub_execute_gil_wait_duration_metric_,
+        response_batch->execute_gil_wait_ns / 1000.0);
+  }
+  if (response_batch->execute_bls_ns > 0) {
+    ObserveMetric(
+        stub_execute_bls_duration_metric_,
+        response_batch->execute_bls_ns / 1000.0);
+  }
+  if (response_batch->execute_gc_ns > 0) {
+    ObserveMetric(
+        stub_execute_gc_duration_metric_,
+        response_batch->execute_gc_ns / 1000.0);
+  }
+  // The responses of the decoupled models are not saved by the execute
+  // function.
+  if (response_batch->save_responses_ns > 0) {
+    ObserveMetric(
+        stub_save_responses_duration_metric_,
+        response_batch->save_responses_ns / 1000.0);
+  }
+}
+
+template <typename RequestPtr>
+std::vector<uint64_t>
+ModelInstanceState::TraceIds(const std::vector<RequestPtr>& requests)
+{
+  std::vector<uint64_t> trace_ids;
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  if (model_state->StateForBackend()->tracer == nullptr) {
+    return trace_ids;
+  }
+
+  for (auto& request : requests) {
+    if (request->TraceAddress() == 0) {
+      continue;
+    }
+    uint64_t trace_id;
+    TRITONSERVER_Error* err = TRITONSERVER_InferenceTraceId(
+        reinterpret_cast<TRITONSERVER_InferenceTrace*>(request->TraceAddress()),
+        &trace_id);
+    if (err == nullptr) {
+      trace_ids.push_back(trace_id);
+    } else {
+      TRITONSERVER_ErrorDelete(err);
+    }
+  }
+
+  return trace_ids;
+}
+
+void
+ModelInstanceState::WriteTraceSpan(
+    const std::string& name, pid_t pid, pid_t tid, uint64_t start_ns,
+    uint64_t end_ns, uint64_t batch_id, const std::vector<uint64_t>& trace_ids)
+{
+  if (trace_ids.empty()) {
+    return;
+  }
+
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  PbTraceSpan span;
+  span.name = name;
+  span.model_name = model_state->Name();
+  span.instance_name = Name();
+  span.pid = pid;
+  span.tid = tid;
+  span.start_ns = start_ns;
+  span.end_ns = end_ns;
+  span.batch_id = batch_id;
+  span.trace_ids = trace_ids;
+  model_state->StateForBackend()->tracer->WriteSpan(span);
+}
+
+void
+ModelInstanceState::WriteStubTraceSpans(
+    ResponseBatch* response_batch, const std::vector<uint64_t>& trace_ids)
+{
+  // The stub process executes the batches on its main thread.
+  pid_t stub_pid = Stub()->StubPid();
+  uint64_t load_end_ns =
+      response_batch->stub_start_ns + response_batch->load_requests_ns;
+  uint64_t execute_end_ns = load_end_ns + response_batch->execute_ns;
+  WriteTraceSpan(
+      "stub_load_requests", stub_pid, stub_pid, response_batch->stub_start_ns,
+      load_end_ns, response_batch->batch_id, trace_ids);
+  WriteTraceSpan(
+      "stub_execute", stub_pid, stub_pid, load_end_ns, execute_end_ns,
+      response_batch->batch_id, trace_ids);
+  if (response_batch->save_responses_ns > 0) {
+    WriteTraceSpan(
+        "stub_save_responses", stub_pid, stub_pid, execute_end_ns,
+        execute_end_ns + response_batch->save_responses_ns,
+        response_batch->batch_id, trace_ids);
+  }
+}
+
+void
+ModelInstanceState::ReportMetrics()
+{
+  if (Stub()->ParentMessageQueue() == nullptr ||
+      Stub()->StubMessageQueue() == nullptr ||
+      Stub()->ShmPool() == nullptr) {
+    return;
+  }
+
+  AdvanceMetric(
+      parent_spin_hits_metric_, Stub()->ParentMessageQueue()->SpinHits());
+  AdvanceMetric(parent_sleeps_metric_, Stub()->ParentMessageQueue()->Sleeps());
+  AdvanceMetric(stub_spin_hits_metric_, Stub()->StubMessageQueue()->SpinHits());
+  AdvanceMetric(stub_sleeps_metric_, Stub()->StubMessageQueue()->Sleeps());
+
+  const ShmAllocatorStats& shm_stats = Stub()->ShmPool()->AllocatorStats();
+  AdvanceMetric(
+      shm_global_lock_acquisitions_metric_,
+      shm_stats.global_lock_acquisitions.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_global_lock_contentions_metric_,
+      shm_stats.global_lock_contentions.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_slab_lock_acquisitions_metric_,
+      shm_stats.slab_lock_acquisitions.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_slab_lock_contentions_metric_,
+      shm_stats.slab_lock_contentions.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_thread_cache_hits_metric_,
+      shm_stats.thread_cache_hits.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_thread_cache_misses_metric_,
+      shm_stats.thread_cache_misses.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      closed_request_checks_metric_,
+      closed_request_checks_.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      dropped_log_messages_metric_,
+      dropped_log_messages_.load(std::memory_order_relaxed));
+
+  // The counters of the stub process restart from zero with the stub.
+  IPCControlShm* ipc_control = Stub()->IpcControl().get();
+  if (ipc_control != nullptr) {
+    AdvanceMetric(
+        stub_gil_held_time_metric_, ipc_control->gil_held_ns.load() / 1000);
+    AdvanceMetric(
+        stub_gil_wait_time_metric_, ipc_control->gil_wait_ns.load() / 1000);
+    AdvanceMetric(
+        stub_bls_exec_time_metric_, ipc_control->bls_exec_ns.load() / 1000);
+    AdvanceMetric(
+        stub_gc_pause_time_metric_, ipc_control->gc_pause_ns.load() / 1000);
+  }
+
+  for (size_t i = 0; i < kShmAllocationSizeBucketCount; ++i) {
+    AdvanceMetric(
+        shm_allocations_metrics_[i],
+        shm_stats.allocation_sizes[i].load(std::memory_order_relaxed));
+  }
+  for (size_t i = 0; i < kShmObjectTypeCount; ++i) {
+    SetMetric(
+        shm_live_objects_metrics_[i],
+        shm_stats.live_objects[i].load(std::memory_order_relaxed));
+  }
+  SetMetric(
+      shm_peak_allocated_bytes_metric_,
+      shm_stats.peak_allocated_bytes.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_grow_successes_metric_,
+      shm_stats.grow_count.load(std::memory_order_relaxed));
+  AdvanceMetric(
+      shm_grow_failures_metric_,
+      shm_stats.grow_failures.load(std::memory_order_relaxed));
+
+  uint64_t now_ns = 0;
+  SET_TIMESTAMP(now_ns);
+  if (shm_fragmentation_metric_ != nullptr &&
+      now_ns - last_fragmentation_report_ns_ >=
+          kShmFragmentationReportIntervalNs) {
+    last_fragmentation_report_ns_ = now_ns;
+    try {
+      SetMetric(shm_fragmentation_metric_, Stub()->ShmPool()->Fragmentation());
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_MESSAGE(TRITONSERVER_LOG_WARN, pb_exception.what());
+    }
+  }
+
+  if (bls_response_cache_ != nullptr) {
+    AdvanceMetric(bls_cache_hits_metric_, bls_response_cache_->Hits());
+    AdvanceMetric(bls_cache_misses_metric_, bls_response_cache_->Misses());
+    AdvanceMetric(
+        bls_cache_in_flight_hits_metric_, bls_response_cache_->InFlightHits());
+    SetMetric(bls_cache_bytes_metric_, bls_response_cache_->ByteSize());
+  }
+}
+
 TRITONSERVER_Error*
 ModelInstanceState::CheckIncomingRequests(
     TRITONBACKEND_Request** requests, const uint32_t request_count,
@@ -126,10 +456,20 @@ ModelInstanceState::CheckIncomingRequests(
 bool
 ModelInstanceState::ExistsInClosedRequests(intptr_t closed_request)
 {
+  closed_request_checks_.fetch_add(1, std::memory_order_relaxed);
+
+  // The dispatched requests are closed once they leave the in flight
+  // requests, so that the set doesn't grow with the requests that are closed
+  // after their execute function returned.
+  if (reinterpret_cast<ModelState*>(Model())->DecoupledMaxInFlightRequests() >
+      0) {
+    std::lock_guard<std::mutex> guard{in_flight_mu_};
+    return in_flight_requests_.find(closed_request) ==
+           in_flight_requests_.end();
+  }
+
   std::lock_guard<std::mutex> guard{closed_requests_mutex_};
-  return std::find(
-             closed_requests_.begin(), closed_requests_.end(),
-             closed_request) != closed_requests_.end();
+  return closed_requests_.find(closed_request) != closed_requests_.end();
 }
 
 void
@@ -183,26 +523,8 @@ ModelInstanceState::SendMessageToStub(
 {
   bool success = false;
   while (!success) {
-    uint64_t timeout_miliseconds = 1000;
-    {
-      boost::posix_time::ptime timeout =
-          boost::get_system_time() +
-          boost::posix_time::milliseconds(timeout_miliseconds);
-
-      bi::scoped_lock<bi::interprocess_mutex> lock(
-          *(Stub()->HealthMutex()), timeout);
-
-      // Check if lock has been acquired.
-      if (lock) {
-        Stub()->IpcControl()->stub_health = false;
-      } else {
-        // If it failed to obtain the lock, it means that the stub has been
-        // stuck or exited while holding the health mutex lock.
-        return TRITONSERVER_ErrorNew(
-            TRITONSERVER_ERROR_INTERNAL, "Failed to obtain the health mutex.");
-      }
-    }
-
+    // Wake up regularly to notice a stub process that has exited.
+    uint64_t timeout_miliseconds = 100;
     Stub()->StubMessageQueue()->Push(
         message, timeout_miliseconds /* duration ms */, success);
 
@@ -221,26 +543,8 @@ ModelInstanceState::ReceiveMessageFromStub(
 {
   bool success = false;
   while (!success) {
-    uint64_t timeout_miliseconds = 1000;
-    {
-      boost::posix_time::ptime timeout =
-          boost::get_system_time() +
-          boost::posix_time::milliseconds(timeout_miliseconds);
-
-      bi::scoped_lock<bi::interprocess_mutex> lock(
-          *Stub()->HealthMutex(), timeout);
-
-      // Check if lock has been acquired.
-      if (lock) {
-        Stub()->IpcControl()->stub_health = false;
-      } else {
-        // If it failed to obtain the lock, it means that the stub has been
-        // stuck or exited while holding the health mutex lock.
-        return TRITONSERVER_ErrorNew(
-            TRITONSERVER_ERROR_INTERNAL, "Failed to obtain the health mutex.");
-      }
-    }
-
+    // Wake up regularly to notice a stub process that has exited.
+    uint64_t timeout_miliseconds = 100;
     message = Stub()->ParentMessageQueue()->Pop(
         timeout_miliseconds /* duration ms */, success);
 
@@ -284,24 +588,72 @@ ModelInstanceState::RespondErrorToAllRequests(
 void
 ModelInstanceState::WaitForBLSRequestsToFinish()
 {
+  std::lock_guard<std::mutex> guard{futures_mutex_};
   futures_.clear();
 }
 
-bool
-ModelInstanceState::IsStubProcessAlive()
+void
+ModelInstanceState::PostBLSTask(
+    std::packaged_task<void()>&& task, const uint32_t priority)
 {
-  boost::posix_time::ptime timeout =
-      boost::get_system_time() + boost::posix_time::seconds(1);
-  bi::scoped_lock<bi::interprocess_mutex> lock(*Stub()->HealthMutex(), timeout);
+  std::future<void> future = task.get_future();
+  {
+    std::lock_guard<std::mutex> guard{bls_tasks_mu_};
+    // The tasks without a priority rank after the lowest priority.
+    uint64_t rank = (priority == 0) ? (uint64_t{1} << 32) : priority;
+    bls_tasks_.emplace(
+        std::make_pair(rank, next_bls_task_sequence_++), std::move(task));
+  }
+  // Every posted function runs one task, which is the first one at the time
+  // a thread becomes available.
+  boost::asio::post(*thread_pool_, [this] { RunNextBLSTask(); });
+
+  std::lock_guard<std::mutex> guard{futures_mutex_};
+  futures_.erase(
+      std::remove_if(
+          futures_.begin(), futures_.end(),
+          [](const std::future<void>& future) {
+            return future.wait_for(std::chrono::seconds(0)) ==
+                   std::future_status::ready;
+          }),
+      futures_.end());
+  futures_.emplace_back(std::move(future));
+}
 
-  // Check if lock has been acquired.
-  if (lock) {
-    return Stub()->IpcControl()->stub_health;
-  } else {
-    // If It failed to obtain the lock, it means that the stub has been
-    // stuck or exited while holding the health mutex lock.
-    return false;
+void
+ModelInstanceState::RunNextBLSTask()
+{
+  std::packaged_task<void()> task;
+  {
+    std::lock_guard<std::mutex> guard{bls_tasks_mu_};
+    if (bls_tasks_.empty()) {
+      return;
+    }
+    task = std::move(bls_tasks_.begin()->second);
+    bls_tasks_.erase(bls_tasks_.begin());
+  }
+  task();
+}
+
+uint32_t
+ModelInstanceState::BLSRequestPriority(
+    const std::shared_ptr<IPCMessage>& ipc_message)
+{
+  try {
+    AllocatedSharedMemory<RequestBatch> request_batch =
+        Stub()->ShmPool()->Load<RequestBatch>(ipc_message->Args());
+    return request_batch.data_->priority;
   }
+  catch (const PythonBackendException& pb_exception) {
+    LOG_MESSAGE(TRITONSERVER_LOG_ERROR, pb_exception.what());
+    return 0;
+  }
+}
+
+bool
+ModelInstanceState::IsStubProcessAlive()
+{
+  return Stub()->IsStubAlive();
 }
 
 TRITONSERVER_Error*
@@ -318,16 +670,28 @@ ModelInstanceState::SaveRequestsToSharedMemory(
   RETURN_IF_EXCEPTION(
       request_batch = Stub()->ShmPool()->Construct<char>(
           sizeof(RequestBatch) +
-          request_count * sizeof(bi::managed_external_buffer::handle_t)));
+              request_count * sizeof(bi::managed_external_buffer::handle_t),
+          false /* aligned */, ShmObjectType::kBatch));
 
   RequestBatch* request_batch_shm_ptr =
       reinterpret_cast<RequestBatch*>(request_batch.data_.get());
   request_batch_shm_ptr->batch_size = request_count;
+  request_batch_shm_ptr->batch_id = next_batch_id_++;
+  request_batch_shm_ptr->is_dispatched = false;
+  request_batch_shm_ptr->released_batch_id = 0;
+  request_batch_shm_ptr->trace_address = 0;
 
   bi::managed_external_buffer::handle_t* requests_shm =
       reinterpret_cast<bi::managed_external_buffer::handle_t*>(
           request_batch.data_.get() + sizeof(RequestBatch));
 
+  std::unordered_map<std::string, std::vector<std::shared_ptr<PbTensor>>>
+      batched_inputs;
+  if (request_count > 1 && responses) {
+    RETURN_IF_ERROR(GetBatchedInputTensors(
+        requests, request_count, responses, batched_inputs));
+  }
+
   for (uint32_t r = 0; r < request_count; ++r) {
     TRITONBACKEND_Request* request = requests[r];
     uint32_t requested_input_count = 0;
@@ -342,8 +706,16 @@ ModelInstanceState::SaveRequestsToSharedMemory(
     for (size_t iidx = 0; iidx < requested_input_count; ++iidx) {
       std::shared_ptr<PbTensor> pb_input_tensor;
 
+      const char* input_name;
       RETURN_IF_ERROR(
-          GetInputTensor(iidx, pb_input_tensor, request, responses));
+          TRITONBACKEND_RequestInputName(request, iidx, &input_name));
+      auto batched_input = batched_inputs.find(input_name);
+      if (batched_input != batched_inputs.end()) {
+        pb_input_tensor = std::move(batched_input->second[r]);
+      } else {
+        RETURN_IF_ERROR(
+            GetInputTensor(iidx, pb_input_tensor, request, responses));
+      }
       pb_input_tensors.emplace_back(std::move(pb_input_tensor));
     }
 
@@ -384,6 +756,11 @@ ModelInstanceState::SaveRequestsToSharedMemory(
           reinterpret_cast<intptr_t>(request));
     }
 
+    // The trace is nullptr if Triton doesn't trace the request.
+    TRITONSERVER_InferenceTrace* trace;
+    RETURN_IF_ERROR(TRITONBACKEND_RequestTrace(request, &trace));
+    infer_request->SetTraceAddress(reinterpret_cast<intptr_t>(trace));
+
     RETURN_IF_EXCEPTION(infer_request->SaveToSharedMemory(Stub()->ShmPool()));
     requests_shm[r] = infer_request->ShmHandle();
     pb_inference_requests.emplace_back(std::move(infer_request));
@@ -400,19 +777,225 @@ ModelInstanceState::LaunchStubProcess()
       "MODEL_INSTANCE_STUB", Name(), DeviceId(),
       TRITONSERVER_InstanceGroupKindString(Kind()));
   RETURN_IF_ERROR(Stub()->Initialize(model_state));
-  RETURN_IF_ERROR(Stub()->Setup());
-  StartLogMonitor();
-  RETURN_IF_ERROR(Stub()->Launch());
+  {
+    // The launch slot is released before the stub pool is launched, which
+    // takes slots of its own.
+    StubLaunchLimiter* limiter =
+        model_state->StateForBackend()->stub_launch_limiter.get();
+    limiter->Acquire();
+    ScopedDefer release_launch([limiter] { limiter->Release(); });
+    RETURN_IF_ERROR(Stub()->Setup());
+    StartLogMonitor();
+    RETURN_IF_ERROR(Stub()->Launch());
+  }
+
+  if (model_state->StateForBackend()->bls_response_cache_byte_size > 0) {
+    bls_response_cache_ = std::make_unique<BLSResponseCache>(
+        Stub()->ShmPool(),
+        model_state->StateForBackend()->bls_response_cache_byte_size);
+  }
 
   thread_pool_ = std::make_unique<boost::asio::thread_pool>(
       model_state->StateForBackend()->thread_pool_size);
 
   if (model_state->IsDecoupled()) {
+    response_thread_pool_ = std::make_unique<boost::asio::thread_pool>(
+        model_state->StateForBackend()->response_thread_pool_size);
     decoupled_thread_ = true;
     decoupled_monitor_ =
         std::thread(&ModelInstanceState::DecoupledMessageQueueMonitor, this);
+  } else if (model_state->PipelineDepth() > 1) {
+    pipeline_thread_running_ = true;
+    pipeline_thread_ = std::thread(&ModelInstanceState::PipelineThread, this);
+  } else if (model_state->StubPoolSize() > 1 && !is_stub_pool_member_) {
+    RETURN_IF_ERROR(LaunchStubPool());
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::LaunchStubPool()
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  for (int64_t i = 1; i < model_state->StubPoolSize(); i++) {
+    std::unique_ptr<ModelInstanceState> member;
+    try {
+      member.reset(new ModelInstanceState(model_state, TritonModelInstance()));
+    }
+    catch (const BackendModelInstanceException& ex) {
+      RETURN_ERROR_IF_TRUE(
+          ex.err_ == nullptr, TRITONSERVER_ERROR_INTERNAL,
+          std::string("unexpected nullptr in BackendModelInstanceException"));
+      RETURN_IF_ERROR(ex.err_);
+    }
+    member->is_stub_pool_member_ = true;
+    RETURN_IF_ERROR(member->LaunchStubProcess());
+    stub_pool_.emplace_back(std::move(member));
+  }
+
+  stub_pool_threads_ =
+      std::make_unique<boost::asio::thread_pool>(stub_pool_.size());
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::GetBatchedInputTensors(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses,
+    std::unordered_map<std::string, std::vector<std::shared_ptr<PbTensor>>>&
+        batched_inputs)
+{
+  NVTX_RANGE(nvtx_, "GetBatchedInputTensors " + Name());
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+
+  // Inputs stored in shared memory objects are passed to the stub without a
+  // copy instead.
+  if (model_state->ZeroCopyInputMinByteSize() > 0) {
+    return nullptr;
+  }
+
+  bool cpu_only_tensors = model_state->ForceCPUOnlyInputTensors();
+#ifndef TRITON_ENABLE_GPU
+  cpu_only_tensors = true;
+#else
+  if (!CUDAHandler::getInstance().IsAvailable()) {
+    cpu_only_tensors = true;
+  }
+#endif  // TRITON_ENABLE_GPU
+
+  uint32_t input_count = 0;
+  RETURN_IF_ERROR(TRITONBACKEND_RequestInputCount(requests[0], &input_count));
+
+  std::vector<std::unique_ptr<BackendInputCollector>> collectors;
+  for (uint32_t iidx = 0; iidx < input_count; ++iidx) {
+    const char* input_name;
+    RETURN_IF_ERROR(
+        TRITONBACKEND_RequestInputName(requests[0], iidx, &input_name));
+
+    // All the requests must have the input with the same data type. The
+    // inputs may only be in GPU memory if they are moved to CPU.
+    std::vector<std::vector<int64_t>> shapes;
+    std::vector<uint64_t> byte_sizes;
+    TRITONSERVER_DataType batch_dtype = TRITONSERVER_TYPE_INVALID;
+    uint64_t total_byte_size = 0;
+    bool batchable = true;
+    for (uint32_t r = 0; r < request_count && batchable; ++r) {
+      TRITONBACKEND_Input* in;
+      TRITONSERVER_Error* err =
+          TRITONBACKEND_RequestInput(requests[r], input_name, &in);
+      if (err != nullptr) {
+        TRITONSERVER_ErrorDelete(err);
+        batchable = false;
+        break;
+      }
+
+      TRITONSERVER_DataType input_dtype;
+      const int64_t* input_shape;
+      uint32_t input_dims_count;
+      uint64_t input_byte_size;
+      uint32_t input_buffer_count;
+      RETURN_IF_ERROR(TRITONBACKEND_InputPropertiesForHostPolicy(
+          in, HostPolicyName().c_str(), nullptr, &input_dtype, &input_shape,
+          &input_dims_count, &input_byte_size, &input_buffer_count));
+      if (r != 0 && input_dtype != batch_dtype) {
+        batchable = false;
+      }
+      batch_dtype = input_dtype;
+
+      for (uint32_t b = 0; b < input_buffer_count && batchable; ++b) {
+        const void* buffer;
+        uint64_t buffer_byte_size;
+        TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+        int64_t memory_type_id = 0;
+        RETURN_IF_ERROR(TRITONBACKEND_InputBufferForHostPolicy(
+            in, HostPolicyName().c_str(), b, &buffer, &buffer_byte_size,
+            &memory_type, &memory_type_id));
+        if (memory_type == TRITONSERVER_MEMORY_GPU && !cpu_only_tensors &&
+            input_dtype != TRITONSERVER_TYPE_BYTES) {
+          batchable = false;
+        }
+      }
+
+      shapes.emplace_back(input_shape, input_shape + input_dims_count);
+      byte_sizes.push_back(input_byte_size);
+      total_byte_size += input_byte_size;
+    }
+
+    if (!batchable || total_byte_size == 0) {
+      continue;
+    }
+
+    AllocatedSharedMemory<char> batch_buffer;
+    RETURN_IF_EXCEPTION(
+        batch_buffer = Stub()->ShmPool()->Construct<char>(
+            total_byte_size, true /* aligned */));
+
+    cudaStream_t stream = CudaStream();
+#ifdef TRITON_ENABLE_GPU
+    // Copy the inputs on different streams so that the GPU to CPU copies of
+    // the inputs overlap.
+    if (collectors.size() > 0 && Kind() == TRITONSERVER_INSTANCEGROUPKIND_GPU &&
+        CUDAHandler::getInstance().IsAvailable()) {
+      size_t stream_idx = (collectors.size() - 1) % kInputCopyStreamCount;
+      if (stream_idx == input_copy_streams_.size()) {
+        cudaStream_t input_copy_stream;
+        RETURN_IF_CUDA_ERROR(
+            cudaSetDevice(DeviceId()), TRITONSERVER_ERROR_INTERNAL,
+            std::string("Failed to set the device for the input copy stream"));
+        RETURN_IF_CUDA_ERROR(
+            cudaStreamCreateWithFlags(
+                &input_copy_stream, cudaStreamNonBlocking),
+            TRITONSERVER_ERROR_INTERNAL,
+            std::string("Failed to create the input copy stream"));
+        input_copy_streams_.push_back(input_copy_stream);
+      }
+      stream = input_copy_streams_[stream_idx];
+    }
+#endif  // TRITON_ENABLE_GPU
+
+    // The pinned buffers are used to stage the GPU to CPU copies.
+    collectors.emplace_back(std::make_unique<BackendInputCollector>(
+        requests, request_count, responses.get(),
+        Model()->TritonMemoryManager(), true /* pinned_enable */, stream,
+        nullptr, nullptr, 0, HostPolicyName().c_str()));
+    collectors.back()->ProcessTensor(
+        input_name, batch_buffer.data_.get(), total_byte_size,
+        TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */);
+
+    std::vector<std::shared_ptr<PbTensor>>& input_tensors =
+        batched_inputs[input_name];
+    uint64_t offset = 0;
+    for (uint32_t r = 0; r < request_count; ++r) {
+      char* data = batch_buffer.data_.get() + offset;
+      std::shared_ptr<PbTensor> input_tensor = std::make_shared<PbTensor>(
+          std::string(input_name), shapes[r], batch_dtype,
+          TRITONSERVER_MEMORY_CPU /* memory_type */, 0 /* memory_type_id */,
+          data, byte_sizes[r], nullptr /* DLManagedTensor */);
+      RETURN_IF_EXCEPTION(input_tensor->SetMemory(PbMemory::Create(
+          Stub()->ShmPool(), batch_buffer.handle_, offset, byte_sizes[r])));
+      RETURN_IF_EXCEPTION(input_tensor->SaveToSharedMemory(
+          Stub()->ShmPool(), false /* copy_gpu */));
+      input_tensors.emplace_back(std::move(input_tensor));
+      offset += byte_sizes[r];
+    }
+  }
+
+  bool cuda_copy = false;
+  for (auto& collector : collectors) {
+    cuda_copy |= collector->Finalize();
   }
 
+#ifdef TRITON_ENABLE_GPU
+  if (cuda_copy) {
+    cudaStreamSynchronize(CudaStream());
+    for (cudaStream_t input_copy_stream : input_copy_streams_) {
+      cudaStreamSynchronize(input_copy_stream);
+    }
+  }
+#endif  // TRITON_ENABLE_GPU
+
   return nullptr;
 }
 
@@ -482,7 +1065,44 @@ ModelInstanceState::GetInputTensor(
   cpu_only_tensors = true;
 #endif  // TRITON_ENABLE_GPU
 
-  if (cpu_only_tensors || src_memory_type != TRITONSERVER_MEMORY_GPU) {
+  // Inputs that are already stored in a shared memory object, e.g. a system
+  // shared memory region registered by the client, are mapped by the stub
+  // instead of being copied to the shared memory pool.
+  ExternalShmLocation external_shm_location;
+  if (src_memory_type != TRITONSERVER_MEMORY_GPU && input_buffer_count == 1 &&
+      src_byte_size == input_byte_size &&
+      model_state->ZeroCopyInputMinByteSize() > 0 &&
+      input_byte_size >=
+          static_cast<uint64_t>(model_state->ZeroCopyInputMinByteSize()) &&
+      FindExternalShm(src_ptr, src_byte_size, &external_shm_location)) {
+    input_tensor = std::make_shared<PbTensor>(
+        std::string(input_name),
+        std::vector<int64_t>(input_shape, input_shape + input_dims_count),
+        input_dtype, TRITONSERVER_MEMORY_CPU /* memory_type */,
+        0 /* memory_type_id */, const_cast<void*>(src_ptr), input_byte_size,
+        nullptr /* DLManagedTensor */);
+    RETURN_IF_EXCEPTION(input_tensor->SetMemory(PbMemory::Create(
+        Stub()->ShmPool(), external_shm_location, input_byte_size,
+        reinterpret_cast<char*>(const_cast<void*>(src_ptr)))));
+    RETURN_IF_EXCEPTION(input_tensor->SaveToSharedMemory(
+        Stub()->ShmPool(), false /* copy_gpu */));
+  } else if (
+      (cpu_only_tensors || src_memory_type != TRITONSERVER_MEMORY_GPU) &&
+      responses && !model_state->IsDecoupled() &&
+      model_state->LazyInputMinByteSize() > 0 &&
+      input_byte_size >=
+          static_cast<uint64_t>(model_state->LazyInputMinByteSize())) {
+    // The input is copied to shared memory by LoadInputBuffer if the model
+    // uses it.
+    input_tensor = std::make_shared<PbTensor>(
+        std::string(input_name),
+        std::vector<int64_t>(input_shape, input_shape + input_dims_count),
+        input_dtype, TRITONSERVER_MEMORY_CPU /* memory_type */,
+        0 /* memory_type_id */, nullptr /* buffer ptr*/, input_byte_size,
+        nullptr /* DLManagedTensor */);
+    RETURN_IF_EXCEPTION(input_tensor->SaveToSharedMemoryWithoutData(
+        Stub()->ShmPool(), reinterpret_cast<intptr_t>(request)));
+  } else if (cpu_only_tensors || src_memory_type != TRITONSERVER_MEMORY_GPU) {
     input_tensor = std::make_shared<PbTensor>(
         std::string(input_name),
         std::vector<int64_t>(input_shape, input_shape + input_dims_count),
@@ -551,10 +1171,18 @@ ModelInstanceState::GetInputTensor(
             Stub()->ShmPool(), true /* copy_gpu */));
       }
     } else {
-      void* dev_ptr;
-      RETURN_IF_CUDA_ERROR(
-          cudaMalloc(&dev_ptr, input_byte_size), TRITONSERVER_ERROR_INTERNAL,
-          std::string("Failed to allocated CUDA memory"));
+      // The inputs in the CUDA shared pool are passed to the stub process
+      // without opening a CUDA IPC handle.
+      CudaSharedPool* cuda_pool = CudaSharedPool::Find(src_memory_type_id);
+      void* dev_ptr = cuda_pool != nullptr
+                          ? cuda_pool->Allocate(input_byte_size)
+                          : nullptr;
+      if (dev_ptr == nullptr) {
+        RETURN_IF_CUDA_ERROR(
+            cudaMalloc(&dev_ptr, input_byte_size),
+            TRITONSERVER_ERROR_INTERNAL,
+            std::string("Failed to allocated CUDA memory"));
+      }
 
       size_t byte_size = input_byte_size;
 
@@ -586,6 +1214,10 @@ ModelInstanceState::GetInputTensor(
           Stub()->GetMemoryManager()->AddRecord(std::move(gpu_memory_record));
       input_tensor->Memory()->SetMemoryReleaseId(memory_release_id);
     }
+
+    // The buffer stays valid until the request is released, so it can be
+    // passed to the BLS requests that forward this input as is.
+    input_tensor->Memory()->SetUpstreamInputAddress(input_tensor->DataPtr());
 #else
     return TRITONSERVER_ErrorNew(
         TRITONSERVER_ERROR_INTERNAL,
@@ -597,57 +1229,327 @@ ModelInstanceState::GetInputTensor(
 }
 
 void
-ModelInstanceState::GetBLSResponses(
-    std::vector<std::unique_ptr<InferResponse>>& responses,
-    std::future<std::unique_ptr<InferResponse>> future)
+ModelInstanceState::LoadInputBuffer(
+    const std::shared_ptr<IPCMessage>& ipc_message,
+    TRITONBACKEND_Request** requests, const uint32_t request_count)
 {
-  responses.push_back(future.get());
-  size_t size = responses.size();
-  for (size_t i = 0; i < size; i++) {
-    if (responses[i]) {
-      auto next_future = responses[i]->GetNextResponse();
-      if (next_future) {
-        responses.push_back(next_future->get());
-        size++;
+  AllocatedSharedMemory<InputBufferMessage> input_buffer_message_shm;
+  InputBufferMessage* input_buffer_message = nullptr;
+  std::unique_ptr<PbMemory> pb_memory;
+  std::unique_ptr<PbString> error_message;
+  try {
+    input_buffer_message_shm =
+        Stub()->ShmPool()->Load<InputBufferMessage>(ipc_message->Args());
+    input_buffer_message = input_buffer_message_shm.data_.get();
+    std::string name =
+        PbString::LoadFromSharedMemory(
+            Stub()->ShmPool(), input_buffer_message->name)
+            ->String();
+
+    uint32_t r = 0;
+    while (r < request_count &&
+           reinterpret_cast<intptr_t>(requests[r]) !=
+               input_buffer_message->request_address) {
+      ++r;
+    }
+    if (r == request_count) {
+      throw PythonBackendException(
+          "The request is not being executed anymore.");
+    }
+
+    TRITONBACKEND_Input* input;
+    THROW_IF_TRITON_ERROR(
+        TRITONBACKEND_RequestInput(requests[r], name.c_str(), &input));
+    uint64_t byte_size;
+    THROW_IF_TRITON_ERROR(TRITONBACKEND_InputPropertiesForHostPolicy(
+        input, HostPolicyName().c_str(), nullptr, nullptr, nullptr, nullptr,
+        &byte_size, nullptr));
+
+    pb_memory = PbMemory::Create(
+        Stub()->ShmPool(), TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+        byte_size, nullptr /* data */, false /* copy_gpu */);
+    size_t read_byte_size = byte_size;
+    THROW_IF_TRITON_ERROR(backend::ReadInputTensor(
+        requests[r], name, pb_memory->DataPtr(), &read_byte_size));
+    input_buffer_message->memory = pb_memory->ShmHandle();
+  }
+  catch (const PythonBackendException& pb_exception) {
+    if (input_buffer_message == nullptr) {
+      // The stub process can't be notified about the error.
+      LOG_MESSAGE(TRITONSERVER_LOG_ERROR, pb_exception.what());
+    } else {
+      input_buffer_message->has_error = true;
+      LOG_IF_EXCEPTION(
+          error_message =
+              PbString::Create(Stub()->ShmPool(), pb_exception.what()));
+      input_buffer_message->is_error_set = (error_message != nullptr);
+      if (error_message != nullptr) {
+        input_buffer_message->error = error_message->ShmHandle();
       }
     }
   }
+
+  // Wait for the stub process to load the input buffer or the error.
+  bi::scoped_lock<bi::interprocess_mutex> lock{*(ipc_message->ResponseMutex())};
+  ipc_message->ResponseCondition()->notify_all();
+  ipc_message->ResponseCondition()->wait(lock);
 }
 
 void
-ModelInstanceState::ExecuteBLSRequest(
-    std::shared_ptr<IPCMessage> ipc_message, const bool is_decoupled)
+ModelInstanceState::AllocateOutputBuffer(
+    const std::shared_ptr<IPCMessage>& ipc_message,
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses,
+    std::vector<std::unordered_map<
+        std::string, std::pair<std::unique_ptr<PbMemory>, void*>>>&
+        preallocated_outputs)
 {
-  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
-  auto request_executor = std::make_unique<RequestExecutor>(
-      Stub()->ShmPool(), model_state->TritonServer());
-  bool is_response_batch_set = false;
-  std::vector<std::unique_ptr<InferResponse>> infer_responses;
-  ResponseBatch* response_batch;
-  std::unique_ptr<PbString> pb_error_message;
-  std::unique_ptr<IPCMessage> bls_response;
-  AllocatedSharedMemory<char> response_batch_shm;
+  AllocatedSharedMemory<char> output_buffer_message_shm;
+  OutputBufferMessage* output_buffer_message = nullptr;
+  std::unique_ptr<PbString> error_message;
   try {
-    bls_response =
-        IPCMessage::Create(Stub()->ShmPool(), false /* inline_response */);
-
-    AllocatedSharedMemory<char> request_batch =
+    output_buffer_message_shm =
         Stub()->ShmPool()->Load<char>(ipc_message->Args());
-    RequestBatch* request_batch_shm_ptr =
-        reinterpret_cast<RequestBatch*>(request_batch.data_.get());
+    output_buffer_message = reinterpret_cast<OutputBufferMessage*>(
+        output_buffer_message_shm.data_.get());
+    std::string name =
+        PbString::LoadFromSharedMemory(
+            Stub()->ShmPool(), output_buffer_message->name)
+            ->String();
+    const int64_t* dims = reinterpret_cast<int64_t*>(
+        output_buffer_message_shm.data_.get() + sizeof(OutputBufferMessage));
+    const uint32_t dims_count = output_buffer_message->dims_count;
+    const TRITONSERVER_DataType dtype = output_buffer_message->dtype;
+
+    uint32_t r = 0;
+    while (r < request_count &&
+           reinterpret_cast<intptr_t>(requests[r]) !=
+               output_buffer_message->request_address) {
+      ++r;
+    }
+    if (r == request_count || (*responses)[r] == nullptr) {
+      throw PythonBackendException(
+          "The response of the request is not available.");
+    }
+    if (preallocated_outputs[r].find(name) != preallocated_outputs[r].end()) {
+      throw PythonBackendException("The output is already allocated.");
+    }
+    if (dtype == TRITONSERVER_TYPE_BYTES) {
+      throw PythonBackendException(
+          "Outputs with the BYTES data type can't be allocated in advance.");
+    }
 
-    bls_response->Command() = PYTHONSTUB_InferExecResponse;
-    ipc_message->ResponseHandle() = bls_response->ShmHandle();
+    bool is_requested = false;
+    uint32_t requested_output_count = 0;
+    THROW_IF_TRITON_ERROR(
+        TRITONBACKEND_RequestOutputCount(requests[r], &requested_output_count));
+    for (uint32_t i = 0; i < requested_output_count; ++i) {
+      const char* requested_output_name;
+      THROW_IF_TRITON_ERROR(TRITONBACKEND_RequestOutputName(
+          requests[r], i, &requested_output_name));
+      is_requested |= (name == requested_output_name);
+    }
+    if (!is_requested) {
+      throw PythonBackendException("The output is not requested.");
+    }
 
-    // The response batch of the handle will contain a ResponseBatch
-    response_batch_shm = Stub()->ShmPool()->Construct<char>(
-        sizeof(ResponseBatch) + sizeof(bi::managed_external_buffer::handle_t));
-    response_batch =
-        reinterpret_cast<ResponseBatch*>(response_batch_shm.data_.get());
-    bi::managed_external_buffer::handle_t* response_handle =
-        reinterpret_cast<bi::managed_external_buffer::handle_t*>(
-            response_batch_shm.data_.get() + sizeof(ResponseBatch));
-    bls_response->Args() = response_batch_shm.handle_;
+    uint64_t byte_size = TRITONSERVER_DataTypeByteSize(dtype);
+    for (uint32_t i = 0; i < dims_count; ++i) {
+      if (dims[i] < 0) {
+        throw PythonBackendException(
+            "The shape of the output must not have negative dimensions.");
+      }
+      byte_size *= dims[i];
+    }
+
+    TRITONBACKEND_Output* response_output;
+    THROW_IF_TRITON_ERROR(TRITONBACKEND_ResponseOutput(
+        (*responses)[r], &response_output, name.c_str(), dtype, dims,
+        dims_count));
+
+#ifdef TRITON_ENABLE_GPU
+    TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_GPU;
+    int64_t memory_type_id = DeviceId();
+#else
+    TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t memory_type_id = 0;
+#endif  // TRITON_ENABLE_GPU
+    void* buffer;
+    THROW_IF_TRITON_ERROR(TRITONBACKEND_OutputBuffer(
+        response_output, &buffer, byte_size, &memory_type, &memory_type_id));
+
+    std::unique_ptr<PbMemory> pb_memory;
+    if (memory_type == TRITONSERVER_MEMORY_GPU) {
+#ifdef TRITON_ENABLE_GPU
+      TRITONSERVER_BufferAttributes* output_buffer_attributes;
+      THROW_IF_TRITON_ERROR(TRITONBACKEND_OutputBufferAttributes(
+          response_output, &output_buffer_attributes));
+      cudaIpcMemHandle_t* cuda_ipc_mem_handle_p;
+      THROW_IF_TRITON_ERROR(TRITONSERVER_BufferAttributesCudaIpcHandle(
+          output_buffer_attributes,
+          reinterpret_cast<void**>(&cuda_ipc_mem_handle_p)));
+      pb_memory = PbMemory::Create(
+          Stub()->ShmPool(), memory_type, memory_type_id, byte_size,
+          reinterpret_cast<char*>(buffer),
+          cuda_ipc_mem_handle_p == nullptr /* copy_gpu */);
+      if (cuda_ipc_mem_handle_p != nullptr) {
+        pb_memory->SetCudaIpcHandle(cuda_ipc_mem_handle_p);
+      }
+#else
+      throw PythonBackendException(
+          "Python backend does not support GPU tensors.");
+#endif  // TRITON_ENABLE_GPU
+    } else {
+      // The output is copied from shared memory to the Triton buffer when the
+      // response is sent.
+      pb_memory = PbMemory::Create(
+          Stub()->ShmPool(), TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+          byte_size, nullptr /* data */, false /* copy_gpu */);
+    }
+
+    output_buffer_message->memory = pb_memory->ShmHandle();
+    preallocated_outputs[r][name] = {std::move(pb_memory), buffer};
+  }
+  catch (const PythonBackendException& pb_exception) {
+    if (output_buffer_message == nullptr) {
+      // The stub process can't be notified about the error.
+      LOG_MESSAGE(TRITONSERVER_LOG_ERROR, pb_exception.what());
+    } else {
+      output_buffer_message->has_error = true;
+      LOG_IF_EXCEPTION(
+          error_message =
+              PbString::Create(Stub()->ShmPool(), pb_exception.what()));
+      output_buffer_message->is_error_set = (error_message != nullptr);
+      if (error_message != nullptr) {
+        output_buffer_message->error = error_message->ShmHandle();
+      }
+    }
+  }
+
+  // Wait for the stub process to load the output buffer or the error.
+  bi::scoped_lock<bi::interprocess_mutex> lock{*(ipc_message->ResponseMutex())};
+  ipc_message->ResponseCondition()->notify_all();
+  ipc_message->ResponseCondition()->wait(lock);
+}
+
+void
+ModelInstanceState::GetBLSResponses(
+    std::vector<std::unique_ptr<InferResponse>>& responses,
+    std::future<std::unique_ptr<InferResponse>> future,
+    RequestExecutor& request_executor, const BLSParent* parent)
+{
+  responses.push_back(WaitForBLSResponse(future, request_executor, parent));
+  size_t size = responses.size();
+  for (size_t i = 0; i < size; i++) {
+    if (responses[i]) {
+      auto next_future = responses[i]->GetNextResponse();
+      if (next_future) {
+        responses.push_back(
+            WaitForBLSResponse(*next_future, request_executor, parent));
+        size++;
+      }
+    }
+  }
+}
+
+std::unique_ptr<InferResponse>
+ModelInstanceState::WaitForBLSResponse(
+    std::future<std::unique_ptr<InferResponse>>& future,
+    RequestExecutor& request_executor, const BLSParent* parent)
+{
+  // The deferred futures of the requests that wait for an identical request
+  // are not polled.
+  if (parent != nullptr) {
+    while (future.wait_for(std::chrono::milliseconds(
+               kBLSParentCheckIntervalMs)) == std::future_status::timeout) {
+      std::string reason = StaleBLSParentReason(*parent);
+      if (!reason.empty()) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_VERBOSE,
+            (std::string("Cancelling the BLS requests of model instance ") +
+             Name() + ": " + reason)
+                .c_str());
+        request_executor.Cancel();
+        break;
+      }
+    }
+  }
+
+  return future.get();
+}
+
+std::string
+ModelInstanceState::StaleBLSParentReason(const BLSParent& parent)
+{
+  if (parent.deadline_ns != 0) {
+    uint64_t now_ns = 0;
+    SET_TIMESTAMP(now_ns);
+    if (now_ns >= parent.deadline_ns) {
+      return "The deadline of the request that sent the BLS request has "
+             "passed.";
+    }
+  }
+
+  // The BLS requests are still needed if any request of the batch is not
+  // cancelled.
+  for (uint32_t r = 0; r < parent.request_count; ++r) {
+    bool is_cancelled = false;
+    TRITONSERVER_Error* err =
+        TRITONBACKEND_RequestIsCancelled(parent.requests[r], &is_cancelled);
+    if (err != nullptr) {
+      LOG_MESSAGE(TRITONSERVER_LOG_ERROR, TRITONSERVER_ErrorMessage(err));
+      TRITONSERVER_ErrorDelete(err);
+      return "";
+    }
+    if (!is_cancelled) {
+      return "";
+    }
+  }
+
+  return "The request that sent the BLS request was cancelled.";
+}
+
+void
+ModelInstanceState::ExecuteBLSRequest(
+    std::shared_ptr<IPCMessage> ipc_message, const bool is_decoupled,
+    const BLSParent* parent)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  auto request_executor = std::make_unique<RequestExecutor>(
+      Stub()->ShmPool(), model_state->TritonServer(),
+      *model_state->StateForBackend()->bls_model_metadata_cache,
+      bls_response_cache_.get(),
+      (parent != nullptr) ? parent->deadline_ns : 0 /* deadline_ns */);
+  bool is_response_batch_set = false;
+  std::vector<std::unique_ptr<InferResponse>> infer_responses;
+  ResponseBatch* response_batch;
+  std::unique_ptr<PbString> pb_error_message;
+  std::unique_ptr<IPCMessage> bls_response;
+  AllocatedSharedMemory<char> response_batch_shm;
+  uint64_t bls_start_ns = 0;
+  SET_TIMESTAMP(bls_start_ns);
+  try {
+    bls_response =
+        IPCMessage::Create(Stub()->ShmPool(), false /* inline_response */);
+
+    AllocatedSharedMemory<char> request_batch =
+        Stub()->ShmPool()->Load<char>(ipc_message->Args());
+    RequestBatch* request_batch_shm_ptr =
+        reinterpret_cast<RequestBatch*>(request_batch.data_.get());
+
+    bls_response->Command() = PYTHONSTUB_InferExecResponse;
+    ipc_message->ResponseHandle() = bls_response->ShmHandle();
+
+    // The response batch of the handle will contain a ResponseBatch
+    response_batch_shm = Stub()->ShmPool()->Construct<char>(
+        sizeof(ResponseBatch) + sizeof(bi::managed_external_buffer::handle_t),
+        false /* aligned */, ShmObjectType::kBatch);
+    response_batch =
+        reinterpret_cast<ResponseBatch*>(response_batch_shm.data_.get());
+    bi::managed_external_buffer::handle_t* response_handle =
+        reinterpret_cast<bi::managed_external_buffer::handle_t*>(
+            response_batch_shm.data_.get() + sizeof(ResponseBatch));
+    bls_response->Args() = response_batch_shm.handle_;
 
     response_batch->batch_size = 1;
     response_batch->has_error = false;
@@ -660,41 +1562,85 @@ ModelInstanceState::ExecuteBLSRequest(
     PythonBackendException pb_exception(std::string{});
 
     uint32_t gpu_buffers_count = 0;
-    if (request_batch_shm_ptr->batch_size == 1) {
-      std::shared_ptr<InferRequest> infer_request;
-      bi::managed_external_buffer::handle_t* request_handle =
+    const uint32_t batch_size = request_batch_shm_ptr->batch_size;
+    if (batch_size > 1 && is_decoupled) {
+      throw PythonBackendException(
+          "Decoupled BLS requests can't be executed in a batch.");
+    }
+    if (batch_size >= 1) {
+      std::vector<std::shared_ptr<InferRequest>> infer_requests;
+      bi::managed_external_buffer::handle_t* request_handles =
           reinterpret_cast<bi::managed_external_buffer::handle_t*>(
               request_batch.data_.get() + sizeof(RequestBatch));
-      infer_request = InferRequest::LoadFromSharedMemory(
-          Stub()->ShmPool(), *request_handle, false /* open_cuda_handle */);
+      for (uint32_t r = 0; r < batch_size; ++r) {
+        infer_requests.emplace_back(InferRequest::LoadFromSharedMemory(
+            Stub()->ShmPool(), request_handles[r],
+            false /* open_cuda_handle */));
+        // The BLS requests are traced as children of the request that was
+        // being executed when they were sent.
+        if (infer_requests.back()->TraceAddress() == 0) {
+          infer_requests.back()->SetTraceAddress(
+              request_batch_shm_ptr->trace_address);
+        }
+      }
 
       // If the BLS inputs are in GPU an additional round trip between the
       // stub process and the main process is required. The reason is that we
       // need to first allocate the GPU memory from the memory pool and then
-      // ask the stub process to fill in those allocated buffers.
+      // ask the stub process to fill in those allocated buffers. Inputs of
+      // the model requests that are forwarded as is and the tensors in the
+      // CUDA shared pool already point to their original buffer.
+      std::vector<PbTensor*> gpu_input_tensors;
       try {
-        for (auto& input_tensor : infer_request->Inputs()) {
-          if (!input_tensor->IsCPU()) {
+        for (auto& infer_request : infer_requests) {
+          for (auto& input_tensor : infer_request->Inputs()) {
+            if (!input_tensor->IsCPU() &&
+                !input_tensor->Memory()->IsUpstreamInput() &&
+                !input_tensor->Memory()->IsInCudaPool()) {
 #ifdef TRITON_ENABLE_GPU
-            gpu_buffers_count++;
-            BackendMemory* backend_memory;
-            std::unique_ptr<BackendMemory> lbackend_memory;
-            has_gpu_tensor = true;
-            TRITONSERVER_Error* error = BackendMemory::Create(
-                Model()->TritonMemoryManager(),
-                {BackendMemory::AllocationType::GPU_POOL,
-                 BackendMemory::AllocationType::GPU},
-                input_tensor->MemoryTypeId(), input_tensor->ByteSize(),
-                &backend_memory);
-            if (error != nullptr) {
-              LOG_MESSAGE(
-                  TRITONSERVER_LOG_ERROR, TRITONSERVER_ErrorMessage(error));
-              break;
-            }
-            lbackend_memory.reset(backend_memory);
-            input_tensor->SetMemory(std::move(PbMemory::Create(
-                Stub()->ShmPool(), std::move(lbackend_memory))));
+              gpu_buffers_count++;
+              gpu_input_tensors.push_back(input_tensor.get());
+              has_gpu_tensor = true;
+
+              // Allocate from the CUDA shared pool when possible so that the
+              // stub process doesn't have to open the buffer.
+              CudaSharedPool* cuda_pool =
+                  CudaSharedPool::Find(input_tensor->MemoryTypeId());
+              void* pool_buffer =
+                  cuda_pool != nullptr
+                      ? cuda_pool->Allocate(input_tensor->ByteSize())
+                      : nullptr;
+              if (pool_buffer != nullptr) {
+                std::unique_ptr<PbMemory> pool_memory = PbMemory::Create(
+                    Stub()->ShmPool(), TRITONSERVER_MEMORY_GPU,
+                    input_tensor->MemoryTypeId(), input_tensor->ByteSize(),
+                    reinterpret_cast<char*>(pool_buffer));
+                pool_memory->SetMemoryReleaseCallback(
+                    [cuda_pool, pool_buffer]() {
+                      cuda_pool->Free(pool_buffer);
+                    });
+                input_tensor->SetMemory(std::move(pool_memory));
+                continue;
+              }
+
+              BackendMemory* backend_memory;
+              std::unique_ptr<BackendMemory> lbackend_memory;
+              TRITONSERVER_Error* error = BackendMemory::Create(
+                  Model()->TritonMemoryManager(),
+                  {BackendMemory::AllocationType::GPU_POOL,
+                   BackendMemory::AllocationType::GPU},
+                  input_tensor->MemoryTypeId(), input_tensor->ByteSize(),
+                  &backend_memory);
+              if (error != nullptr) {
+                LOG_MESSAGE(
+                    TRITONSERVER_LOG_ERROR, TRITONSERVER_ErrorMessage(error));
+                break;
+              }
+              lbackend_memory.reset(backend_memory);
+              input_tensor->SetMemory(std::move(PbMemory::Create(
+                  Stub()->ShmPool(), std::move(lbackend_memory))));
 #endif  // TRITON_ENABLE_GPU
+            }
           }
         }
       }
@@ -715,12 +1661,9 @@ ModelInstanceState::ExecuteBLSRequest(
                                 gpu_buffers_count);
           request_batch_shm_ptr->gpu_buffers_count = gpu_buffers_count;
           request_batch_shm_ptr->gpu_buffers_handle = gpu_handles.handle_;
-          size_t i = 0;
-          for (auto& input_tensor : infer_request->Inputs()) {
-            if (!input_tensor->IsCPU()) {
-              gpu_handles.data_.get()[i] = input_tensor->Memory()->ShmHandle();
-              ++i;
-            }
+          for (size_t i = 0; i < gpu_input_tensors.size(); ++i) {
+            gpu_handles.data_.get()[i] =
+                gpu_input_tensors[i]->Memory()->ShmHandle();
           }
         }
         catch (const PythonBackendException& exception) {
@@ -734,17 +1677,66 @@ ModelInstanceState::ExecuteBLSRequest(
       }
 
       if (pb_exception.what() != nullptr) {
-        std::shared_ptr<InferPayload> infer_payload =
-            std::make_shared<InferPayload>(is_decoupled);
-        auto response_future =
-            request_executor->Infer(infer_request, infer_payload);
-        GetBLSResponses(infer_responses, std::move(response_future));
-
-        size_t response_length = infer_responses.size();
-        // It is possible that the last response from the decoupled model is an
-        // empty response.
-        if (infer_responses.back() == nullptr) {
-          response_length--;
+        // Skip the BLS requests whose responses won't be used. The round
+        // trip of the GPU inputs has been completed.
+        if (parent != nullptr) {
+          std::string reason = StaleBLSParentReason(*parent);
+          if (!reason.empty()) {
+            throw PythonBackendException(reason);
+          }
+        }
+
+        size_t response_length = 0;
+        if (batch_size == 1) {
+          std::shared_ptr<InferPayload> infer_payload =
+              std::make_shared<InferPayload>(is_decoupled);
+          auto response_future =
+              request_executor->Infer(infer_requests[0], infer_payload);
+          GetBLSResponses(
+              infer_responses, std::move(response_future), *request_executor,
+              parent);
+
+          response_length = infer_responses.size();
+          // It is possible that the last response from the decoupled model is
+          // an empty response.
+          if (infer_responses.back() == nullptr) {
+            response_length--;
+          }
+        } else {
+          // Submit all the requests before waiting for any of them. The
+          // payloads must stay alive and in place until their responses have
+          // been received.
+          std::vector<std::shared_ptr<InferPayload>> infer_payloads;
+          infer_payloads.reserve(batch_size);
+          std::vector<std::future<std::unique_ptr<InferResponse>>>
+              response_futures(batch_size);
+          infer_responses.resize(batch_size);
+          for (uint32_t r = 0; r < batch_size; ++r) {
+            infer_payloads.emplace_back(
+                std::make_shared<InferPayload>(false /* is_decoupled */));
+            try {
+              response_futures[r] =
+                  request_executor->Infer(infer_requests[r], infer_payloads[r]);
+            }
+            catch (const PythonBackendException& exception) {
+              infer_responses[r] = std::make_unique<InferResponse>(
+                  std::vector<std::shared_ptr<PbTensor>>{},
+                  std::make_shared<PbError>(exception.what()));
+            }
+          }
+          for (uint32_t r = 0; r < batch_size; ++r) {
+            if (response_futures[r].valid()) {
+              infer_responses[r] = WaitForBLSResponse(
+                  response_futures[r], *request_executor, parent);
+            }
+            if (infer_responses[r] == nullptr) {
+              infer_responses[r] = std::make_unique<InferResponse>(
+                  std::vector<std::shared_ptr<PbTensor>>{},
+                  std::make_shared<PbError>(
+                      "An error occurred while performing BLS request."));
+            }
+          }
+          response_length = batch_size;
         }
 
         if (response_length != 1) {
@@ -752,14 +1744,16 @@ ModelInstanceState::ExecuteBLSRequest(
           // responses for decoupled support.
           response_batch_shm = Stub()->ShmPool()->Construct<char>(
               sizeof(ResponseBatch) +
-              response_length * sizeof(bi::managed_external_buffer::handle_t));
+                  response_length *
+                      sizeof(bi::managed_external_buffer::handle_t),
+              false /* aligned */, ShmObjectType::kBatch);
           response_batch =
               reinterpret_cast<ResponseBatch*>(response_batch_shm.data_.get());
           response_handle =
               reinterpret_cast<bi::managed_external_buffer::handle_t*>(
                   response_batch_shm.data_.get() + sizeof(ResponseBatch));
           bls_response->Args() = response_batch_shm.handle_;
-          response_batch->batch_size = 1;
+          response_batch->batch_size = batch_size;
           response_batch->has_error = false;
           response_batch->is_error_set = false;
           response_batch->cleanup = false;
@@ -786,6 +1780,13 @@ ModelInstanceState::ExecuteBLSRequest(
           }
           response_handle[i] = infer_responses[i]->ShmHandle();
         }
+
+        uint64_t bls_end_ns = 0;
+        SET_TIMESTAMP(bls_end_ns);
+        WriteTraceSpan(
+            "bls " + infer_requests[0]->ModelName(), getpid(),
+            CurrentThreadId(), bls_start_ns, bls_end_ns,
+            request_batch_shm_ptr->batch_id, TraceIds(infer_requests));
       } else {
         throw pb_exception;
       }
@@ -832,17 +1833,39 @@ ModelInstanceState::DecoupledMessageQueueMonitor()
     // Need to notify the model instance thread that the execute response has
     // been received.
     if (message->Command() == PYTHONSTUB_ExecuteResponse) {
-      std::lock_guard<std::mutex> guard{mu_};
-      received_message_ = std::move(message);
-      cv_.notify_one();
+      if (reinterpret_cast<ModelState*>(Model())
+              ->DecoupledMaxInFlightRequests() > 0) {
+        CompleteExecuteDecoupled(std::move(message));
+      } else {
+        std::lock_guard<std::mutex> guard{mu_};
+        received_message_ = std::move(message);
+        cv_.notify_one();
+      }
     } else if (message->Command() == PYTHONSTUB_ResponseSend) {
       std::shared_ptr<IPCMessage> response_send_message = std::move(message);
-      std::packaged_task<void()> task([this, response_send_message] {
+      AllocatedSharedMemory<ResponseSendMessage> send_message =
+          Stub()->ShmPool()->Load<ResponseSendMessage>(
+              response_send_message->Args());
+      const intptr_t request_address = send_message.data_->request_address;
+
+      // The stub process doesn't wait for the asynchronous responses, so the
+      // responses of a request are sent one at a time and in order.
+      auto it = response_strands_.find(request_address);
+      if (it == response_strands_.end()) {
+        it = response_strands_
+                 .emplace(
+                     request_address, boost::asio::make_strand(
+                                          response_thread_pool_->executor()))
+                 .first;
+      }
+      boost::asio::post(it->second, [this, response_send_message] {
         ResponseSendDecoupled(response_send_message);
       });
-      std::future<void> future =
-          boost::asio::post(*thread_pool_, std::move(task));
-      futures_.emplace_back(std::move(future));
+
+      // The pending responses keep the strand alive.
+      if (send_message.data_->flags == TRITONSERVER_RESPONSE_COMPLETE_FINAL) {
+        response_strands_.erase(it);
+      }
     } else if (
         message->Command() == PYTHONSTUB_InferExecRequest ||
         message->Command() == PYTHONSTUB_InferStreamExecRequest) {
@@ -852,9 +1875,7 @@ ModelInstanceState::DecoupledMessageQueueMonitor()
             bls_execute,
             (bls_execute->Command() == PYTHONSTUB_InferStreamExecRequest));
       });
-      std::future<void> future =
-          boost::asio::post(*thread_pool_, std::move(task));
-      futures_.emplace_back(std::move(future));
+      PostBLSTask(std::move(task), BLSRequestPriority(bls_execute));
     }
   }
 }
@@ -868,57 +1889,53 @@ ModelInstanceState::LogMessageQueueMonitor()
     if (handle == DUMMY_MESSAGE) {
       break;
     }
-    std::unique_ptr<IPCMessage> message =
-        IPCMessage::LoadFromSharedMemory(Stub()->ShmPool(), handle);
-
-    AllocatedSharedMemory<LogSendMessage> log_message_response =
-        Stub()->ShmPool()->Load<LogSendMessage>(message->Args());
-    std::unique_ptr<PbLog> pb_log_message =
-        PbLogShm::LoadFromSharedMemory(Stub()->ShmPool(), message->Args());
-
-    const std::string& filename = pb_log_message->Filename();
-    uint32_t line = pb_log_message->Line();
-    const std::string& log_message = pb_log_message->Message();
-    LogLevel level = pb_log_message->Level();
-
-    switch (level) {
-      case LogLevel::INFO: {
-        TRITONSERVER_LogMessage(
-            TRITONSERVER_LOG_INFO, (filename.c_str()), line,
-            (log_message.c_str()));
-        break;
-      }
-      case LogLevel::WARNING: {
-        TRITONSERVER_LogMessage(
-            TRITONSERVER_LOG_WARN, (filename.c_str()), line,
-            (log_message.c_str()));
-        break;
-      }
-      case LogLevel::ERROR: {
-        TRITONSERVER_LogMessage(
-            TRITONSERVER_LOG_ERROR, (filename.c_str()), line,
-            (log_message.c_str()));
-        break;
-      }
-      case LogLevel::VERBOSE: {
-        TRITONSERVER_LogMessage(
-            TRITONSERVER_LOG_VERBOSE, (filename.c_str()), line,
-            (log_message.c_str()));
-        break;
+    uint32_t dropped_count;
+    std::vector<std::unique_ptr<PbLog>> pb_log_messages =
+        PbLogBatch::LoadFromSharedMemory(
+            Stub()->ShmPool(), handle, dropped_count);
+
+    for (auto& pb_log_message : pb_log_messages) {
+      const std::string& filename = pb_log_message->Filename();
+      uint32_t line = pb_log_message->Line();
+      const std::string& log_message = pb_log_message->Message();
+      LogLevel level = pb_log_message->Level();
+
+      switch (level) {
+        case LogLevel::INFO: {
+          TRITONSERVER_LogMessage(
+              TRITONSERVER_LOG_INFO, (filename.c_str()), line,
+              (log_message.c_str()));
+          break;
+        }
+        case LogLevel::WARNING: {
+          TRITONSERVER_LogMessage(
+              TRITONSERVER_LOG_WARN, (filename.c_str()), line,
+              (log_message.c_str()));
+          break;
+        }
+        case LogLevel::ERROR: {
+          TRITONSERVER_LogMessage(
+              TRITONSERVER_LOG_ERROR, (filename.c_str()), line,
+              (log_message.c_str()));
+          break;
+        }
+        case LogLevel::VERBOSE: {
+          TRITONSERVER_LogMessage(
+              TRITONSERVER_LOG_VERBOSE, (filename.c_str()), line,
+              (log_message.c_str()));
+          break;
+        }
       }
     }
-    // Send confirmation back to pb_stub.cc that the message
-    // was received.
-    LogSendMessage* send_message_payload =
-        reinterpret_cast<LogSendMessage*>(log_message_response.data_.get());
-    {
-      bi::scoped_lock<bi::interprocess_mutex> guard{
-          send_message_payload->log_mu};
-      send_message_payload->waiting_on_stub = true;
-      send_message_payload->log_cv.notify_all();
-      while (send_message_payload->waiting_on_stub) {
-        send_message_payload->log_cv.wait(guard);
-      }
+
+    if (dropped_count > 0) {
+      dropped_log_messages_.fetch_add(dropped_count, std::memory_order_relaxed);
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_WARN,
+          (std::string("Dropped ") + std::to_string(dropped_count) +
+           " log messages of model instance '" + Name() +
+           "' because the log queue of the stub process was full.")
+              .c_str());
     }
   }
 }
@@ -951,9 +1968,22 @@ ModelInstanceState::ResponseSendDecoupled(
   ResponseSendMessage* send_message_payload =
       reinterpret_cast<ResponseSendMessage*>(send_message.data_.get());
   std::unique_ptr<PbString> error_message;
-  ScopedDefer _([send_message_payload] {
+  ScopedDefer _([this, send_message_payload, &error_message] {
     {
       bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->mu};
+      if (send_message_payload->is_async) {
+        // The stub process reads the error when it sends the next response
+        // of the request.
+        if (error_message) {
+          std::lock_guard<std::mutex> errors_guard{async_send_errors_mutex_};
+          async_send_errors_[send_message_payload->request_address]
+              .emplace_back(std::move(error_message));
+        }
+        send_message_payload->is_stub_turn = true;
+        send_message_payload->cv.notify_all();
+        return;
+      }
+
       send_message_payload->is_stub_turn = true;
       send_message_payload->cv.notify_all();
 
@@ -967,11 +1997,56 @@ ModelInstanceState::ResponseSendDecoupled(
       reinterpret_cast<TRITONBACKEND_ResponseFactory*>(
           send_message_payload->response_factory_address);
   if (send_message_payload->flags == TRITONSERVER_RESPONSE_COMPLETE_FINAL) {
-    std::lock_guard<std::mutex> guard{closed_requests_mutex_};
-    closed_requests_.push_back(send_message_payload->request_address);
+    if (reinterpret_cast<ModelState*>(Model())
+            ->DecoupledMaxInFlightRequests() > 0) {
+      {
+        std::lock_guard<std::mutex> guard{in_flight_mu_};
+        in_flight_requests_.erase(send_message_payload->request_address);
+      }
+      in_flight_cv_.notify_all();
+    } else {
+      std::lock_guard<std::mutex> guard{closed_requests_mutex_};
+      closed_requests_.insert(send_message_payload->request_address);
+    }
+
+    // The stub process waits for the asynchronous responses of the request
+    // before sending the final response, so their errors were read.
+    std::lock_guard<std::mutex> guard{async_send_errors_mutex_};
+    async_send_errors_.erase(send_message_payload->request_address);
   }
 
-  if (send_message_payload->response != 0) {
+  if (send_message_payload->response_count > 0) {
+    // The stub process only sends the responses together if none of them has
+    // GPU outputs, so the responses don't need the additional round trip.
+    AllocatedSharedMemory<bi::managed_external_buffer::handle_t>
+        response_handles =
+            Stub()->ShmPool()->Load<bi::managed_external_buffer::handle_t>(
+                send_message_payload->responses);
+    for (uint32_t i = 0; i < send_message_payload->response_count; ++i) {
+      std::unique_ptr<InferResponse> infer_response =
+          InferResponse::LoadFromSharedMemory(
+              Stub()->ShmPool(), response_handles.data_.get()[i],
+              false /* open cuda ipc handle */);
+
+      bool requires_deferred_callback = false;
+      std::vector<std::pair<std::unique_ptr<PbMemory>, void*>>
+          gpu_output_buffers;
+      const uint32_t flags =
+          (i == send_message_payload->response_count - 1)
+              ? send_message_payload->flags
+              : 0;
+      std::shared_ptr<TRITONSERVER_Error*> error = infer_response->Send(
+          response_factory, CudaStream(), requires_deferred_callback, flags,
+          Stub()->ShmPool(), gpu_output_buffers);
+      // The remaining responses are still sent after an error since the last
+      // one carries the flags, and the request isn't complete without the
+      // final flag. The first error is the one reported to the stub.
+      if (!send_message_payload->has_error) {
+        SetErrorForResponseSendMessage(
+            send_message_payload, error, error_message);
+      }
+    }
+  } else if (send_message_payload->response != 0) {
     std::unique_ptr<InferResponse> infer_response =
         InferResponse::LoadFromSharedMemory(
             Stub()->ShmPool(), send_message_payload->response,
@@ -1063,7 +2138,10 @@ ModelInstanceState::ProcessRequestsDecoupled(
     PbMetricReporter& reporter)
 {
   NVTX_RANGE(nvtx_, "ProcessRequests " + Name());
-  closed_requests_ = {};
+  {
+    std::lock_guard<std::mutex> guard{closed_requests_mutex_};
+    closed_requests_.clear();
+  }
   ModelState* model_state = reinterpret_cast<ModelState*>(Model());
 
   size_t total_batch_size = 0;
@@ -1084,6 +2162,8 @@ ModelInstanceState::ProcessRequestsDecoupled(
   AllocatedSharedMemory<char> request_batch;
   std::shared_ptr<std::vector<TRITONBACKEND_Response*>> responses;
 
+  uint64_t save_requests_start_ns = 0;
+  SET_TIMESTAMP(save_requests_start_ns);
   RETURN_IF_ERROR(SaveRequestsToSharedMemory(
       requests, request_count, pb_inference_requests, request_batch,
       responses));
@@ -1091,6 +2171,9 @@ ModelInstanceState::ProcessRequestsDecoupled(
   uint64_t compute_start_ns = 0;
   SET_TIMESTAMP(compute_start_ns);
   reporter.SetComputeStartNs(compute_start_ns);
+  ObserveMetric(
+      save_requests_duration_metric_,
+      (compute_start_ns - save_requests_start_ns) / 1000.0);
 
   std::unique_ptr<IPCMessage> ipc_message;
   RETURN_IF_EXCEPTION(
@@ -1115,10 +2198,37 @@ ModelInstanceState::ProcessRequestsDecoupled(
   reporter.SetComputeEndNs(compute_end_ns);
   reporter.SetBatchStatistics(request_count);
 
-  if (response_batch.data_->has_error) {
-    if (response_batch.data_->is_error_set) {
+  return ReadExecuteResponseDecoupled(
+      response_batch.data_.get(), pb_inference_requests,
+      save_requests_start_ns, compute_start_ns, compute_end_ns);
+}
+
+TRITONSERVER_Error*
+ModelInstanceState::ReadExecuteResponseDecoupled(
+    ResponseBatch* response_batch,
+    std::vector<std::unique_ptr<InferRequest>>& pb_inference_requests,
+    uint64_t save_requests_start_ns, uint64_t compute_start_ns,
+    uint64_t compute_end_ns)
+{
+  ObserveStubDurations(response_batch, compute_end_ns - compute_start_ns);
+
+  std::vector<uint64_t> trace_ids = TraceIds(pb_inference_requests);
+  if (!trace_ids.empty()) {
+    uint64_t batch_id = response_batch->batch_id;
+    pid_t tid = CurrentThreadId();
+    WriteTraceSpan(
+        "save_requests", getpid(), tid, save_requests_start_ns,
+        compute_start_ns, batch_id, trace_ids);
+    WriteTraceSpan(
+        "execute", getpid(), tid, compute_start_ns, compute_end_ns, batch_id,
+        trace_ids);
+    WriteStubTraceSpans(response_batch, trace_ids);
+  }
+
+  if (response_batch->has_error) {
+    if (response_batch->is_error_set) {
       auto error = PbString::LoadFromSharedMemory(
-          Stub()->ShmPool(), response_batch.data_->error);
+          Stub()->ShmPool(), response_batch->error);
       return TRITONSERVER_ErrorNew(
           TRITONSERVER_ERROR_INTERNAL, error->String().c_str());
     }
@@ -1131,123 +2241,501 @@ ModelInstanceState::ProcessRequestsDecoupled(
 }
 
 void
-ModelInstanceState::ProcessRequests(
-    TRITONBACKEND_Request** requests, const uint32_t request_count,
-    bool& restart)
+ModelInstanceState::DispatchRequestsDecoupled(
+    TRITONBACKEND_Request** requests, const uint32_t request_count)
 {
-  NVTX_RANGE(nvtx_, "ProcessRequests " + Name());
   ModelState* model_state = reinterpret_cast<ModelState*>(Model());
-  std::string name = model_state->Name();
+  const size_t max_in_flight_requests =
+      model_state->DecoupledMaxInFlightRequests();
 
-  LOG_MESSAGE(
-      TRITONSERVER_LOG_VERBOSE,
-      (std::string("model ") + model_state->Name() + ", instance " + Name() +
-       ", executing " + std::to_string(request_count) + " requests")
-          .c_str());
+  // Triton doesn't send the next batch to the instance while this function
+  // waits, which limits the number of requests in flight.
+  {
+    std::unique_lock<std::mutex> guard{in_flight_mu_};
+    in_flight_cv_.wait(guard, [this, request_count, max_in_flight_requests] {
+      return in_flight_requests_.empty() ||
+             in_flight_requests_.size() + request_count <=
+                 max_in_flight_requests;
+    });
+    for (uint32_t r = 0; r < request_count; ++r) {
+      in_flight_requests_.insert(reinterpret_cast<intptr_t>(requests[r]));
+    }
+  }
 
   uint64_t exec_start_ns = 0;
   SET_TIMESTAMP(exec_start_ns);
+  std::unique_ptr<InFlightExecute> in_flight(new InFlightExecute());
+  in_flight->requests.assign(requests, requests + request_count);
+  in_flight->reporter.reset(new PbMetricReporter(
+      TritonModelInstance(), in_flight->requests.data(), request_count,
+      nullptr));
+  in_flight->reporter->SetExecStartNs(exec_start_ns);
 
-  // We take the responsibility of the responses.
-  std::shared_ptr<std::vector<TRITONBACKEND_Response*>> responses(
-      new std::vector<TRITONBACKEND_Response*>());
-  responses->reserve(request_count);
-  PbMetricReporter reporter(
-      TritonModelInstance(), requests, request_count, responses);
-  reporter.SetExecStartNs(exec_start_ns);
-
-  for (size_t i = 0; i < request_count; i++) {
-    TRITONBACKEND_Response* response;
-    auto err = TRITONBACKEND_ResponseNew(&response, requests[i]);
-    if (err == nullptr) {
-      responses->emplace_back(response);
-    } else {
-      responses->emplace_back(nullptr);
-      LOG_MESSAGE(TRITONSERVER_LOG_ERROR, "Fail to create response");
-      TRITONSERVER_ErrorDelete(err);
-    }
+  size_t total_batch_size = 0;
+  TRITONSERVER_Error* error =
+      CheckIncomingRequests(requests, request_count, total_batch_size);
+  if (error != nullptr || total_batch_size == 0) {
+    FinishExecuteDecoupled(std::move(in_flight), error);
+    return;
   }
 
-  size_t total_batch_size = 0;
-  RESPOND_ALL_AND_RETURN_IF_ERROR(
-      responses, request_count,
-      CheckIncomingRequests(requests, request_count, total_batch_size));
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("model ") + model_state->Name() + ", instance " + Name() +
+       ", dispatching " + std::to_string(request_count) + " requests")
+          .c_str());
 
-  // No request to process
-  if (total_batch_size == 0) {
+  std::shared_ptr<std::vector<TRITONBACKEND_Response*>> responses;
+  SET_TIMESTAMP(in_flight->save_requests_start_ns);
+  error = SaveRequestsToSharedMemory(
+      requests, request_count, in_flight->pb_inference_requests,
+      in_flight->request_batch, responses);
+  std::unique_ptr<IPCMessage> ipc_message;
+  if (error == nullptr) {
+    try {
+      ipc_message =
+          IPCMessage::Create(Stub()->ShmPool(), false /*inline_response*/);
+    }
+    catch (const PythonBackendException& pb_exception) {
+      error = CreateTritonErrorFromException(pb_exception);
+    }
+  }
+  if (error != nullptr) {
+    FinishExecuteDecoupled(std::move(in_flight), error);
     return;
   }
 
-  // Wait for all the pending BLS requests to be completed.
-  ScopedDefer bls_defer([this] { WaitForBLSRequestsToFinish(); });
-  std::vector<std::unique_ptr<InferRequest>> pb_inference_requests;
-  AllocatedSharedMemory<char> request_batch;
-  RESPOND_ALL_AND_RETURN_IF_ERROR(
-      responses, request_count,
-      SaveRequestsToSharedMemory(
-          requests, request_count, pb_inference_requests, request_batch,
-          responses));
+  SET_TIMESTAMP(in_flight->compute_start_ns);
+  in_flight->reporter->SetComputeStartNs(in_flight->compute_start_ns);
+  ObserveMetric(
+      save_requests_duration_metric_,
+      (in_flight->compute_start_ns - in_flight->save_requests_start_ns) /
+          1000.0);
 
-  std::shared_ptr<IPCMessage> ipc_message =
-      IPCMessage::Create(Stub()->ShmPool(), false /*inline_response*/);
+  RequestBatch* request_batch_shm_ptr =
+      reinterpret_cast<RequestBatch*>(in_flight->request_batch.data_.get());
+  request_batch_shm_ptr->is_dispatched = true;
+  request_batch_shm_ptr->released_batch_id = released_batch_id_;
+  const uint64_t batch_id = request_batch_shm_ptr->batch_id;
   ipc_message->Command() = PYTHONSTUB_CommandType::PYTHONSTUB_ExecuteRequest;
-  ipc_message->Args() = request_batch.handle_;
-
-  uint64_t compute_start_ns = 0;
-  SET_TIMESTAMP(compute_start_ns);
-  reporter.SetComputeStartNs(compute_start_ns);
-
-  // This means that the stub process has exited and Python
-  // backend failed to restart the stub process.
-  if (Stub()->StubPid() == 0) {
-    const char* error_message = "The stub process has exited unexpectedly.";
-    RespondErrorToAllRequests(
-        error_message, responses, requests, request_count);
-    return;
-  }
+  ipc_message->Args() = in_flight->request_batch.handle_;
+  const bi::managed_external_buffer::handle_t message_handle =
+      ipc_message->ShmHandle();
+  in_flight->ipc_message = std::move(ipc_message);
 
-  bi::managed_external_buffer::handle_t response_message;
+  // The batch is registered first since the monitor thread can receive the
+  // execute response as soon as the message is pushed.
   {
-    NVTX_RANGE(nvtx_, "StubProcessing " + Name());
-    SendMessageAndReceiveResponse(
-        ipc_message->ShmHandle(), response_message, restart, responses,
-        requests, request_count);
+    std::lock_guard<std::mutex> guard{in_flight_mu_};
+    in_flight_executes_.emplace(batch_id, std::move(in_flight));
   }
+  Stub()->StubMessageQueue()->Push(message_handle);
+}
 
-  ScopedDefer execute_finalize([this, &restart] {
-    // Push a dummy message to the message queue so that
-    // the stub process is notified that it can release
-    // the object stored in shared memory.
-    NVTX_RANGE(nvtx_, "RequestExecuteFinalize " + Name());
-    if (!restart)
-      Stub()->StubMessageQueue()->Push(DUMMY_MESSAGE);
-  });
-  if (restart) {
-    return;
-  }
+void
+ModelInstanceState::CompleteExecuteDecoupled(
+    std::unique_ptr<IPCMessage> execute_response)
+{
+  AllocatedSharedMemory<ResponseBatch> response_batch =
+      Stub()->ShmPool()->Load<ResponseBatch>(execute_response->Args());
+  uint64_t compute_end_ns = 0;
+  SET_TIMESTAMP(compute_end_ns);
 
-  RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
-      responses, request_count,
-      ipc_message = IPCMessage::LoadFromSharedMemory(
-          Stub()->ShmPool(), response_message));
+  // The stub process keeps the response until the next dispatched batch
+  // tells it that the response has been loaded. The responses are received
+  // in the order of their batches.
+  const uint64_t batch_id = response_batch.data_->batch_id;
+  ScopedDefer release_response(
+      [this, batch_id] { released_batch_id_ = batch_id + 1; });
 
-  // If the stub command is no longer PYTHONSTUB_InferExecRequest, it indicates
+  std::unique_ptr<InFlightExecute> in_flight;
+  {
+    std::lock_guard<std::mutex> guard{in_flight_mu_};
+    auto it = in_flight_executes_.find(response_batch.data_->batch_id);
+    if (it == in_flight_executes_.end()) {
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_ERROR,
+          (std::string("Received the execute response of unknown batch ") +
+           std::to_string(response_batch.data_->batch_id) + " of instance " +
+           Name())
+              .c_str());
+      return;
+    }
+    in_flight = std::move(it->second);
+    in_flight_executes_.erase(it);
+  }
+
+  in_flight->reporter->SetComputeEndNs(compute_end_ns);
+  in_flight->reporter->SetBatchStatistics(in_flight->requests.size());
+  TRITONSERVER_Error* error = ReadExecuteResponseDecoupled(
+      response_batch.data_.get(), in_flight->pb_inference_requests,
+      in_flight->save_requests_start_ns, in_flight->compute_start_ns,
+      compute_end_ns);
+  FinishExecuteDecoupled(std::move(in_flight), error);
+}
+
+void
+ModelInstanceState::FinishExecuteDecoupled(
+    std::unique_ptr<InFlightExecute> in_flight, TRITONSERVER_Error* error)
+{
+  uint64_t exec_end_ns = 0;
+  SET_TIMESTAMP(exec_end_ns);
+  in_flight->reporter->SetExecEndNs(exec_end_ns);
+
+  TRITONBACKEND_Request** requests = in_flight->requests.data();
+  const uint32_t request_count = in_flight->requests.size();
+  if (error != nullptr) {
+    in_flight->reporter->SetSuccessStatus(false);
+    RespondErrorDecoupled(
+        requests, request_count, in_flight->pb_inference_requests, error);
+    TRITONSERVER_ErrorDelete(error);
+  }
+
+  // The requests that were not sent to the stub process, or that received
+  // the error, can't have any other response.
+  if (error != nullptr || !in_flight->ipc_message) {
+    std::lock_guard<std::mutex> guard{in_flight_mu_};
+    for (uint32_t r = 0; r < request_count; ++r) {
+      in_flight_requests_.erase(reinterpret_cast<intptr_t>(requests[r]));
+    }
+  }
+  in_flight_cv_.notify_all();
+
+  // The statistics are reported before the requests are released.
+  in_flight->reporter.reset();
+  ReleaseRequests(requests, request_count);
+}
+
+void
+ModelInstanceState::RespondErrorDecoupled(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    std::vector<std::unique_ptr<InferRequest>>& pb_inference_requests,
+    TRITONSERVER_Error* error)
+{
+  // The dispatched requests that sent their final response have left the in
+  // flight requests. The open ones are taken out of the set under a single
+  // lock, so a final response can't be sent for them in between.
+  const bool is_dispatched =
+      reinterpret_cast<ModelState*>(Model())->DecoupledMaxInFlightRequests() >
+      0;
+  std::unordered_set<intptr_t> open_requests;
+  if (is_dispatched) {
+    std::lock_guard<std::mutex> guard{in_flight_mu_};
+    for (uint32_t r = 0; r < request_count; ++r) {
+      intptr_t request = reinterpret_cast<intptr_t>(requests[r]);
+      if (in_flight_requests_.erase(request) > 0) {
+        open_requests.insert(request);
+      }
+    }
+  }
+  auto is_open = [this, is_dispatched, &open_requests](intptr_t request) {
+    if (is_dispatched) {
+      return open_requests.find(request) != open_requests.end();
+    }
+    return !ExistsInClosedRequests(request);
+  };
+
+  for (uint32_t r = 0; r < request_count; ++r) {
+    TRITONBACKEND_Request* request = requests[r];
+    if (is_open(reinterpret_cast<intptr_t>(request))) {
+      TRITONBACKEND_Response* response = nullptr;
+      LOG_IF_ERROR(
+          TRITONBACKEND_ResponseNew(&response, request),
+          "Failed to create a new response.");
+
+      if (response != nullptr) {
+        LOG_IF_ERROR(
+            TRITONBACKEND_ResponseSend(
+                response, TRITONSERVER_RESPONSE_COMPLETE_FINAL, error),
+            "Failed to send the error response.");
+      }
+    }
+  }
+
+  // We should only delete the response factory for the requests that have
+  // not been closed.
+  for (auto& infer_request : pb_inference_requests) {
+    if (is_open(infer_request->RequestAddress())) {
+      LOG_IF_ERROR(
+          infer_request->DeleteResponseFactory(),
+          "Failed to delete the response factory.");
+    }
+  }
+}
+
+void
+ModelInstanceState::ProcessRequests(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    bool& restart)
+{
+  if (!stub_pool_.empty() && request_count > 1) {
+    ProcessRequestsInStubPool(requests, request_count, restart);
+    return;
+  }
+
+  std::unique_ptr<StagedRequests> staged_requests;
+  StageRequests(requests, request_count, staged_requests);
+  if (staged_requests != nullptr) {
+    ExecuteStagedRequests(*staged_requests, restart);
+  }
+}
+
+void
+ModelInstanceState::ProcessRequestsInStubPool(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    bool& restart)
+{
+  // The requests are split into contiguous parts of almost equal size. The
+  // first part is processed by this instance and the other parts by the
+  // members of the pool. The requests are reported by their parts, but the
+  // batch is reported once by this instance after all the parts are done.
+  uint64_t exec_start_ns = 0;
+  SET_TIMESTAMP(exec_start_ns);
+  std::shared_ptr<PooledBatchStatistics> batch_statistics =
+      std::make_shared<PooledBatchStatistics>();
+  auto process_part = [batch_statistics](
+                          ModelInstanceState* state,
+                          TRITONBACKEND_Request** part_requests,
+                          const uint32_t part_request_count,
+                          bool& part_restart) {
+    std::unique_ptr<StagedRequests> staged_requests;
+    state->StageRequests(part_requests, part_request_count, staged_requests);
+    if (staged_requests != nullptr) {
+      staged_requests->reporter->SetPooledBatchStatistics(batch_statistics);
+      state->ExecuteStagedRequests(*staged_requests, part_restart);
+    }
+  };
+
+  const uint32_t part_count =
+      std::min<uint32_t>(stub_pool_.size() + 1, request_count);
+  auto part_size = [request_count, part_count](uint32_t part) {
+    return request_count / part_count +
+           (part < request_count % part_count ? 1 : 0);
+  };
+
+  std::vector<std::future<void>> part_futures;
+  uint32_t offset = part_size(0);
+  for (uint32_t part = 1; part < part_count; part++) {
+    ModelInstanceState* member = stub_pool_[part - 1].get();
+    TRITONBACKEND_Request** part_requests = requests + offset;
+    const uint32_t part_request_count = part_size(part);
+    std::packaged_task<void()> task(
+        [member, part_requests, part_request_count, &process_part] {
+          bool member_restart = false;
+          process_part(
+              member, part_requests, part_request_count, member_restart);
+          if (member_restart) {
+            member->RestartStub();
+          }
+          member->ReportMetrics();
+        });
+    part_futures.emplace_back(
+        boost::asio::post(*stub_pool_threads_, std::move(task)));
+    offset += part_request_count;
+  }
+
+  process_part(this, requests, part_size(0), restart);
+
+  // The requests are released by the caller once all the parts are done.
+  for (auto& part_future : part_futures) {
+    part_future.wait();
+  }
+
+  uint64_t exec_end_ns = 0;
+  SET_TIMESTAMP(exec_end_ns);
+  if (batch_statistics->total_batch_size != 0) {
+    LOG_IF_ERROR(
+        TRITONBACKEND_ModelInstanceReportBatchStatistics(
+            TritonModelInstance(), batch_statistics->total_batch_size,
+            exec_start_ns, batch_statistics->compute_start_ns,
+            batch_statistics->compute_end_ns, exec_end_ns),
+        "failed reporting batch request statistics");
+  }
+}
+
+void
+ModelInstanceState::StageRequests(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    std::unique_ptr<StagedRequests>& staged_requests)
+{
+  NVTX_RANGE(nvtx_, "StageRequests " + Name());
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("model ") + model_state->Name() + ", instance " + Name() +
+       ", executing " + std::to_string(request_count) + " requests")
+          .c_str());
+
+  uint64_t exec_start_ns = 0;
+  SET_TIMESTAMP(exec_start_ns);
+
+  // The request pointers are copied since the batch may be executed after
+  // Triton's request array is no longer valid.
+  std::unique_ptr<StagedRequests> staged(new StagedRequests());
+  staged->requests.assign(requests, requests + request_count);
+  staged->total_batch_size = 0;
+
+  // We take the responsibility of the responses.
+  std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses =
+      staged->responses;
+  responses.reset(new std::vector<TRITONBACKEND_Response*>());
+  responses->reserve(request_count);
+  staged->reporter.reset(new PbMetricReporter(
+      TritonModelInstance(), staged->requests.data(), request_count,
+      responses));
+  staged->reporter->SetExecStartNs(exec_start_ns);
+  staged->exec_start_ns = exec_start_ns;
+
+  for (size_t i = 0; i < request_count; i++) {
+    TRITONBACKEND_Response* response;
+    auto err = TRITONBACKEND_ResponseNew(&response, requests[i]);
+    if (err == nullptr) {
+      responses->emplace_back(response);
+    } else {
+      responses->emplace_back(nullptr);
+      LOG_MESSAGE(TRITONSERVER_LOG_ERROR, "Fail to create response");
+      TRITONSERVER_ErrorDelete(err);
+    }
+  }
+
+  RESPOND_ALL_AND_RETURN_IF_ERROR(
+      responses, request_count,
+      CheckIncomingRequests(
+          requests, request_count, staged->total_batch_size));
+
+  // No request to process
+  if (staged->total_batch_size == 0) {
+    return;
+  }
+
+  uint64_t save_requests_start_ns = 0;
+  SET_TIMESTAMP(save_requests_start_ns);
+  staged->save_requests_start_ns = save_requests_start_ns;
+  staged->save_requests_tid = CurrentThreadId();
+  RESPOND_ALL_AND_RETURN_IF_ERROR(
+      responses, request_count,
+      SaveRequestsToSharedMemory(
+          requests, request_count, staged->pb_inference_requests,
+          staged->request_batch, responses));
+  uint64_t save_requests_end_ns = 0;
+  SET_TIMESTAMP(save_requests_end_ns);
+  staged->save_requests_ns = save_requests_end_ns - save_requests_start_ns;
+
+  staged_requests = std::move(staged);
+}
+
+void
+ModelInstanceState::ExecuteStagedRequests(
+    StagedRequests& staged_requests, bool& restart)
+{
+  NVTX_RANGE(nvtx_, "ProcessRequests " + Name());
+  TRITONBACKEND_Request** requests = staged_requests.requests.data();
+  const uint32_t request_count = staged_requests.requests.size();
+  std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses =
+      staged_requests.responses;
+  PbMetricReporter& reporter = *staged_requests.reporter;
+  size_t total_batch_size = staged_requests.total_batch_size;
+  AllocatedSharedMemory<char>& request_batch = staged_requests.request_batch;
+  uint64_t batch_id =
+      reinterpret_cast<RequestBatch*>(request_batch.data_.get())->batch_id;
+  std::vector<uint64_t> trace_ids =
+      TraceIds(staged_requests.pb_inference_requests);
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  BLSParent bls_parent{requests, request_count, 0 /* deadline_ns */};
+  if (model_state->BLSDeadlineMicroseconds() > 0) {
+    bls_parent.deadline_ns = staged_requests.exec_start_ns +
+                             model_state->BLSDeadlineMicroseconds() * 1000;
+  }
+
+  // Wait for all the pending BLS requests to be completed.
+  ScopedDefer bls_defer([this] { WaitForBLSRequestsToFinish(); });
+
+  std::shared_ptr<IPCMessage> ipc_message =
+      IPCMessage::Create(Stub()->ShmPool(), false /*inline_response*/);
+  ipc_message->Command() = PYTHONSTUB_CommandType::PYTHONSTUB_ExecuteRequest;
+  ipc_message->Args() = request_batch.handle_;
+
+  uint64_t compute_start_ns = 0;
+  SET_TIMESTAMP(compute_start_ns);
+  reporter.SetComputeStartNs(compute_start_ns);
+  ObserveMetric(
+      save_requests_duration_metric_,
+      staged_requests.save_requests_ns / 1000.0);
+
+  // This means that the stub process has exited and Python
+  // backend failed to restart the stub process.
+  if (Stub()->StubPid() == 0) {
+    const char* error_message = "The stub process has exited unexpectedly.";
+    RespondErrorToAllRequests(
+        error_message, responses, requests, request_count);
+    return;
+  }
+
+  bi::managed_external_buffer::handle_t response_message;
+  {
+    NVTX_RANGE(
+        nvtx_, "StubProcessing " + Name() + " batch " +
+                   std::to_string(batch_id));
+    SendMessageAndReceiveResponse(
+        ipc_message->ShmHandle(), response_message, restart, responses,
+        requests, request_count);
+  }
+
+  ScopedDefer execute_finalize([this, &restart] {
+    // Push a dummy message to the message queue so that
+    // the stub process is notified that it can release
+    // the object stored in shared memory.
+    NVTX_RANGE(nvtx_, "RequestExecuteFinalize " + Name());
+    if (!restart)
+      Stub()->StubMessageQueue()->Push(DUMMY_MESSAGE);
+  });
+  if (restart) {
+    return;
+  }
+
+  RESPOND_ALL_AND_RETURN_IF_EXCEPTION(
+      responses, request_count,
+      ipc_message = IPCMessage::LoadFromSharedMemory(
+          Stub()->ShmPool(), response_message));
+
+  // If the stub command is no longer PYTHONSTUB_InferExecRequest, it indicates
   // that inference request exeuction has finished and there are no more BLS
   // requests to execute. Otherwise, the Python backend will continuosly execute
-  // BLS requests pushed to the message queue.
+  // BLS requests pushed to the message queue. Input and output buffer requests
+  // are handled in this thread since they use the requests and add outputs to
+  // the responses.
+  std::vector<std::unordered_map<
+      std::string, std::pair<std::unique_ptr<PbMemory>, void*>>>
+      preallocated_outputs(request_count);
   while (ipc_message->Command() ==
              PYTHONSTUB_CommandType::PYTHONSTUB_InferExecRequest ||
          ipc_message->Command() ==
-             PYTHONSTUB_CommandType::PYTHONSTUB_InferStreamExecRequest) {
-    std::packaged_task<void()> task([this, ipc_message] {
-      ExecuteBLSRequest(
-          ipc_message,
-          (ipc_message->Command() ==
-           PYTHONSTUB_CommandType::PYTHONSTUB_InferStreamExecRequest));
-    });
-    std::future<void> future =
-        boost::asio::post(*thread_pool_, std::move(task));
-    futures_.emplace_back(std::move(future));
+             PYTHONSTUB_CommandType::PYTHONSTUB_InferStreamExecRequest ||
+         ipc_message->Command() ==
+             PYTHONSTUB_CommandType::PYTHONSTUB_OutputBufferRequest ||
+         ipc_message->Command() ==
+             PYTHONSTUB_CommandType::PYTHONSTUB_InputBufferRequest) {
+    if (ipc_message->Command() ==
+        PYTHONSTUB_CommandType::PYTHONSTUB_OutputBufferRequest) {
+      AllocateOutputBuffer(
+          ipc_message, requests, request_count, responses,
+          preallocated_outputs);
+    } else if (
+        ipc_message->Command() ==
+        PYTHONSTUB_CommandType::PYTHONSTUB_InputBufferRequest) {
+      LoadInputBuffer(ipc_message, requests, request_count);
+    } else {
+      // The requests stay valid until the BLS requests have finished.
+      std::packaged_task<void()> task([this, ipc_message, bls_parent] {
+        ExecuteBLSRequest(
+            ipc_message,
+            (ipc_message->Command() ==
+             PYTHONSTUB_CommandType::PYTHONSTUB_InferStreamExecRequest),
+            &bls_parent);
+      });
+      PostBLSTask(std::move(task), BLSRequestPriority(ipc_message));
+    }
 
     auto error = ReceiveMessageFromStub(response_message);
     if (error != nullptr) {
@@ -1275,6 +2763,18 @@ ModelInstanceState::ProcessRequests(
 
   ResponseBatch* response_batch_shm_ptr =
       reinterpret_cast<ResponseBatch*>(response_batch.data_.get());
+  ObserveStubDurations(
+      response_batch_shm_ptr, compute_end_ns - compute_start_ns);
+  WriteTraceSpan(
+      "save_requests", getpid(), staged_requests.save_requests_tid,
+      staged_requests.save_requests_start_ns,
+      staged_requests.save_requests_start_ns +
+          staged_requests.save_requests_ns,
+      batch_id, trace_ids);
+  WriteTraceSpan(
+      "execute", getpid(), CurrentThreadId(), compute_start_ns, compute_end_ns,
+      batch_id, trace_ids);
+  WriteStubTraceSpans(response_batch_shm_ptr, trace_ids);
 
   // If inference fails, release all the requests and send an error response.
   // If inference fails at this stage, it usually indicates a bug in the model
@@ -1311,6 +2811,8 @@ ModelInstanceState::ProcessRequests(
   std::vector<std::vector<std::pair<std::unique_ptr<PbMemory>, void*>>>
       gpu_output_buffers(request_count);
 
+  uint64_t load_responses_ns = 0;
+  uint64_t send_responses_ns = 0;
   for (uint32_t r = 0; r < request_count; ++r) {
     NVTX_RANGE(nvtx_, "LoadingResponse " + Name());
     TRITONBACKEND_Response* response = (*responses)[r];
@@ -1321,9 +2823,14 @@ ModelInstanceState::ProcessRequests(
     shm_responses.emplace_back(nullptr);
     std::unique_ptr<InferResponse>& infer_response = shm_responses.back();
     try {
+      uint64_t load_start_ns = 0;
+      SET_TIMESTAMP(load_start_ns);
       infer_response = InferResponse::LoadFromSharedMemory(
           Stub()->ShmPool(), response_shm_handle[r],
           false /* open_cuda_handle */);
+      uint64_t load_end_ns = 0;
+      SET_TIMESTAMP(load_end_ns);
+      load_responses_ns += load_end_ns - load_start_ns;
       if (infer_response->HasError()) {
         TRITONSERVER_Error* err = TRITONSERVER_ErrorNew(
             TRITONSERVER_ERROR_INTERNAL,
@@ -1369,10 +2876,16 @@ ModelInstanceState::ProcessRequests(
 
     gpu_output_buffers[r] =
         std::vector<std::pair<std::unique_ptr<PbMemory>, void*>>{};
+    uint64_t send_start_ns = 0;
+    SET_TIMESTAMP(send_start_ns);
     std::shared_ptr<TRITONSERVER_Error*> error = infer_response->Send(
         nullptr, CudaStream(), require_deferred_callback,
         TRITONSERVER_RESPONSE_COMPLETE_FINAL, Stub()->ShmPool(),
-        gpu_output_buffers[r], requested_output_names, response);
+        gpu_output_buffers[r], requested_output_names, response,
+        &preallocated_outputs[r]);
+    uint64_t send_end_ns = 0;
+    SET_TIMESTAMP(send_end_ns);
+    send_responses_ns += send_end_ns - send_start_ns;
     GUARDED_RESPOND_IF_ERROR(responses, r, *error);
 
     requires_deferred_callback[r] = require_deferred_callback;
@@ -1385,12 +2898,24 @@ ModelInstanceState::ProcessRequests(
     }
   }
 
+  ObserveMetric(load_responses_duration_metric_, load_responses_ns / 1000.0);
+  ObserveMetric(send_responses_duration_metric_, send_responses_ns / 1000.0);
+  if (!trace_ids.empty()) {
+    uint64_t responses_end_ns = 0;
+    SET_TIMESTAMP(responses_end_ns);
+    WriteTraceSpan(
+        "send_responses", getpid(), CurrentThreadId(), compute_end_ns,
+        responses_end_ns, batch_id, trace_ids);
+  }
+
   // Finalize the execute.
   execute_finalize.Complete();
 
   // If the output tensor is in GPU, there will be a second round trip
   // required for filling the GPU buffers provided by the main process.
   if (has_gpu_output) {
+    uint64_t load_gpu_buffers_start_ns = 0;
+    SET_TIMESTAMP(load_gpu_buffers_start_ns);
     size_t total_gpu_buffers_count = 0;
     for (auto& gpu_output_buffer : gpu_output_buffers) {
       total_gpu_buffers_count += gpu_output_buffer.size();
@@ -1451,6 +2976,12 @@ ModelInstanceState::ProcessRequests(
       }
 #endif  // TRITON_ENABLE_GPU
     }
+
+    uint64_t load_gpu_buffers_end_ns = 0;
+    SET_TIMESTAMP(load_gpu_buffers_end_ns);
+    ObserveMetric(
+        load_gpu_buffers_duration_metric_,
+        (load_gpu_buffers_end_ns - load_gpu_buffers_start_ns) / 1000.0);
   }
 
   bls_defer.Complete();
@@ -1468,18 +2999,201 @@ ModelInstanceState::ProcessRequests(
   return;
 }
 
+void
+ModelInstanceState::EnqueueRequests(
+    TRITONBACKEND_Request** requests, const uint32_t request_count)
+{
+  ModelState* model_state = reinterpret_cast<ModelState*>(Model());
+  const size_t max_queued_batches = model_state->PipelineDepth() - 1;
+
+  // Wait for a free slot before staging the batch so that at most
+  // 'PipelineDepth' batches hold shared memory at the same time.
+  {
+    std::unique_lock<std::mutex> guard{pipeline_mu_};
+    pipeline_cv_.wait(guard, [this, max_queued_batches] {
+      return pipelined_requests_.size() < max_queued_batches;
+    });
+  }
+
+  std::unique_ptr<StagedRequests> staged_requests;
+  {
+    // The batch is queued while holding the staging mutex so that a restart
+    // of the stub process can't happen between staging and queueing it.
+    std::lock_guard<std::mutex> staging_guard{staging_mu_};
+    StageRequests(requests, request_count, staged_requests);
+    if (staged_requests != nullptr) {
+      std::lock_guard<std::mutex> guard{pipeline_mu_};
+      pipelined_requests_.emplace_back(std::move(staged_requests));
+      pipeline_cv_.notify_all();
+      return;
+    }
+  }
+
+  ReleaseRequests(requests, request_count);
+}
+
+void
+ModelInstanceState::PipelineThread()
+{
+  while (true) {
+    std::unique_ptr<StagedRequests> staged_requests;
+    {
+      std::unique_lock<std::mutex> guard{pipeline_mu_};
+      pipeline_cv_.wait(guard, [this] {
+        return !pipelined_requests_.empty() || !pipeline_thread_running_;
+      });
+
+      // The queued batches are executed before the thread exits.
+      if (pipelined_requests_.empty()) {
+        break;
+      }
+      staged_requests = std::move(pipelined_requests_.front());
+      pipelined_requests_.pop_front();
+    }
+    pipeline_cv_.notify_all();
+
+    bool restart = false;
+    ExecuteStagedRequests(*staged_requests, restart);
+    FinishStagedRequests(std::move(staged_requests));
+
+    if (restart) {
+      // The queued batches are stored in the shared memory region of the
+      // unhealthy stub process, so they fail together with the current one.
+      std::lock_guard<std::mutex> staging_guard{staging_mu_};
+      std::deque<std::unique_ptr<StagedRequests>> failed_requests;
+      {
+        std::lock_guard<std::mutex> guard{pipeline_mu_};
+        failed_requests.swap(pipelined_requests_);
+      }
+      pipeline_cv_.notify_all();
+
+      for (auto& failed : failed_requests) {
+        RespondErrorToAllRequests(
+            "The stub process has exited unexpectedly.", failed->responses,
+            failed->requests.data(), failed->requests.size());
+        FinishStagedRequests(std::move(failed));
+      }
+      RestartStub();
+    }
+
+    ReportMetrics();
+  }
+}
+
+void
+ModelInstanceState::FinishStagedRequests(
+    std::unique_ptr<StagedRequests> staged_requests)
+{
+  // The statistics must be reported and the shared memory released before
+  // the requests are released.
+  staged_requests->reporter.reset();
+  std::vector<TRITONBACKEND_Request*> requests =
+      std::move(staged_requests->requests);
+  staged_requests.reset();
+
+  ReleaseRequests(requests.data(), requests.size());
+}
+
+void
+ModelInstanceState::RestartStub()
+{
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_ERROR,
+      "Stub process is unhealthy and it will be restarted.");
+  TerminateLogMonitor();
+  Stub()->KillStubProcess();
+  // The cached responses are in the shared memory pool that is recreated.
+  if (bls_response_cache_ != nullptr) {
+    bls_response_cache_->Clear();
+  }
+  TRITONSERVER_Error* err = Stub()->Setup();
+  if (err == nullptr) {
+    StartLogMonitor();
+  }
+  LOG_IF_ERROR(err, "Failed to restart the stub process.");
+  err = Stub()->Launch();
+  LOG_IF_ERROR(err, "Failed to restart the stub process.");
+}
+
+void
+ModelInstanceState::ReleaseRequests(
+    TRITONBACKEND_Request** requests, const uint32_t request_count)
+{
+  for (uint32_t r = 0; r < request_count; ++r) {
+    TRITONBACKEND_Request* request = requests[r];
+    LOG_IF_ERROR(
+        TRITONBACKEND_RequestRelease(request, TRITONSERVER_REQUEST_RELEASE_ALL),
+        "failed releasing request");
+  }
+
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("TRITONBACKEND_ModelInstanceExecute: model instance name ") +
+       Name() + " released " + std::to_string(request_count) + " requests")
+          .c_str());
+}
+
 ModelInstanceState::~ModelInstanceState()
 {
+  if (pipeline_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard{pipeline_mu_};
+      pipeline_thread_running_ = false;
+    }
+    pipeline_cv_.notify_all();
+    pipeline_thread_.join();
+  }
+
+  if (stub_pool_threads_ != nullptr) {
+    stub_pool_threads_->join();
+  }
+  stub_pool_.clear();
+
   ModelState* model_state = reinterpret_cast<ModelState*>(Model());
   Stub()->UpdateHealth();
   if (Stub()->IsHealthy()) {
     if (model_state->IsDecoupled()) {
-      futures_.clear();
+      // The dispatched batches are finished by the decoupled monitor thread
+      // once their execute function returns.
+      {
+        std::unique_lock<std::mutex> guard{in_flight_mu_};
+        while (!in_flight_executes_.empty() && Stub()->IsHealthy()) {
+          in_flight_cv_.wait_for(guard, std::chrono::seconds(1));
+          guard.unlock();
+          Stub()->UpdateHealth();
+          guard.lock();
+        }
+      }
+      WaitForBLSRequestsToFinish();
       Stub()->ParentMessageQueue()->Push(DUMMY_MESSAGE);
       decoupled_monitor_.join();
+      response_thread_pool_->wait();
     }
     thread_pool_->wait();
   }
+
+  // The requests of the dispatched batches whose execute function didn't
+  // return are still owned by the instance.
+  std::unordered_map<uint64_t, std::unique_ptr<InFlightExecute>>
+      in_flight_executes;
+  {
+    std::lock_guard<std::mutex> guard{in_flight_mu_};
+    in_flight_executes.swap(in_flight_executes_);
+  }
+  for (auto& in_flight : in_flight_executes) {
+    FinishExecuteDecoupled(
+        std::move(in_flight.second),
+        TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNAVAILABLE,
+            "The model instance was unloaded before the execute function "
+            "returned."));
+  }
+  // The error messages and the cached BLS responses are stored in the shared
+  // memory pool of the stub.
+  async_send_errors_.clear();
+  if (bls_response_cache_ != nullptr) {
+    bls_response_cache_->Clear();
+  }
   // Terminate stub first to allow any last
   // messages to be received by the back end
   // before deallocating the queue memory
@@ -1488,6 +3202,12 @@ ModelInstanceState::~ModelInstanceState()
   Stub()->ClearLogQueue();
   received_message_.reset();
   Stub().reset();
+
+#ifdef TRITON_ENABLE_GPU
+  for (cudaStream_t input_copy_stream : input_copy_streams_) {
+    cudaStreamDestroy(input_copy_stream);
+  }
+#endif  // TRITON_ENABLE_GPU
 }
 
 TRITONSERVER_Error*
@@ -1507,7 +3227,12 @@ ModelState::Create(TRITONBACKEND_Model* triton_model, ModelState** state)
   bool auto_complete_config = false;
   RETURN_IF_ERROR(TRITONBACKEND_ModelAutoCompleteConfig(
       triton_model, &auto_complete_config));
-  if (auto_complete_config) {
+  if (auto_complete_config && (*state)->UsesForkServer()) {
+    // The fork server is kept after the auto-complete, so the model instance
+    // stubs are forked with the modules that the auto-complete imported.
+    RETURN_IF_ERROR((*state)->AutoCompleteInForkServer());
+    RETURN_IF_ERROR((*state)->SetModelConfig());
+  } else if (auto_complete_config) {
     RETURN_IF_ERROR((*state)->LaunchAutoCompleteStubProcess());
     (*state)->ModelConfig() = std::move((*state)->Stub()->AutoCompleteConfig());
     RETURN_IF_ERROR((*state)->SetModelConfig());
@@ -1536,70 +3261,449 @@ ModelState::ModelState(TRITONBACKEND_Model* triton_model)
       TRITONBACKEND_ModelRepository(triton_model, &artifact_type, &path));
   python_execution_env_ = "";
   force_cpu_only_input_tensors_ = true;
+  zero_copy_input_min_byte_size_ = 0;
+  lazy_input_min_byte_size_ = 0;
   decoupled_ = false;
+  fused_batch_ = false;
+  pipeline_depth_ = 1;
+  stub_pool_size_ = 1;
+  stub_fork_server_ = false;
+  decoupled_send_window_ = 0;
+  decoupled_max_in_flight_requests_ = 0;
+  bls_deadline_microseconds_ = 0;
+  sequence_state_byte_size_ = 0;
+  sequence_state_max_entries_ = 1024;
+  neuron_cores_per_instance_ = 0;
 
   void* bstate;
   THROW_IF_BACKEND_MODEL_ERROR(TRITONBACKEND_BackendState(backend, &bstate));
   backend_state_ = reinterpret_cast<BackendState*>(bstate);
   triton::common::TritonJson::Value params;
   common::TritonJson::Value model_config;
+  std::string shared_weight_files;
   if (model_config_.Find("parameters", &params)) {
     // Skip the EXECUTION_ENV_PATH variable if it doesn't exist.
     TRITONSERVER_Error* error =
         GetParameterValue(params, "EXECUTION_ENV_PATH", &python_execution_env_);
     if (error == nullptr) {
-      std::string relative_path_keyword = "$$TRITON_MODEL_DIRECTORY";
-      size_t relative_path_loc =
-          python_execution_env_.find(relative_path_keyword);
-      if (relative_path_loc != std::string::npos) {
-        python_execution_env_.replace(
-            relative_path_loc, relative_path_loc + relative_path_keyword.size(),
-            path);
+      std::string relative_path_keyword = "$$TRITON_MODEL_DIRECTORY";
+      size_t relative_path_loc =
+          python_execution_env_.find(relative_path_keyword);
+      if (relative_path_loc != std::string::npos) {
+        python_execution_env_.replace(
+            relative_path_loc, relative_path_loc + relative_path_keyword.size(),
+            path);
+      }
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_INFO,
+          (std::string("Using Python execution env ") + python_execution_env_)
+              .c_str());
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    triton::common::TritonJson::Value model_transaction_policy;
+    if (model_config_.Find(
+            "model_transaction_policy", &model_transaction_policy)) {
+      triton::common::TritonJson::Value decoupled;
+      if (model_transaction_policy.Find("decoupled", &decoupled)) {
+        auto error = decoupled.AsBool(&decoupled_);
+        if (error != nullptr) {
+          throw BackendModelException(error);
+        }
+      }
+    }
+
+    // Skip the FORCE_CPU_ONLY_INPUT_TENSORS variable if it doesn't exits.
+    std::string force_cpu_only_input_tensor;
+    error = nullptr;
+    error = GetParameterValue(
+        params, "FORCE_CPU_ONLY_INPUT_TENSORS", &force_cpu_only_input_tensor);
+    if (error == nullptr) {
+      if (force_cpu_only_input_tensor == "yes") {
+        force_cpu_only_input_tensors_ = true;
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Forcing CPU only input tensors.")).c_str());
+      } else if (force_cpu_only_input_tensor == "no") {
+        force_cpu_only_input_tensors_ = false;
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Input tensors can be both in CPU and GPU. "
+                         "FORCE_CPU_ONLY_INPUT_TENSORS is off."))
+                .c_str());
+      } else {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNSUPPORTED,
+            (std::string("Incorrect value for FORCE_CPU_ONLY_INPUT_TENSORS: ") +
+             force_cpu_only_input_tensor + "'")
+                .c_str()));
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the FUSED_BATCH variable if it doesn't exist.
+    std::string fused_batch;
+    error = GetParameterValue(params, "FUSED_BATCH", &fused_batch);
+    if (error == nullptr) {
+      if (fused_batch == "yes") {
+        fused_batch_ = true;
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Using fused batch responses.")).c_str());
+      } else if (fused_batch == "no") {
+        fused_batch_ = false;
+      } else {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNSUPPORTED,
+            (std::string("Incorrect value for FUSED_BATCH: ") + fused_batch +
+             "'")
+                .c_str()));
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the ZERO_COPY_INPUT_MIN_BYTE_SIZE variable if it doesn't exist.
+    std::string zero_copy_input_min_byte_size;
+    error = GetParameterValue(
+        params, "ZERO_COPY_INPUT_MIN_BYTE_SIZE",
+        &zero_copy_input_min_byte_size);
+    if (error == nullptr) {
+      try {
+        zero_copy_input_min_byte_size_ =
+            std::stoll(zero_copy_input_min_byte_size);
+      }
+      catch (const std::logic_error& le) {
+        zero_copy_input_min_byte_size_ = -1;
+      }
+      if (zero_copy_input_min_byte_size_ < 0) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for ZERO_COPY_INPUT_MIN_BYTE_SIZE: ") +
+             zero_copy_input_min_byte_size + "'")
+                .c_str()));
+      }
+      if (zero_copy_input_min_byte_size_ > 0) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Passing input tensors of at least ") +
+             zero_copy_input_min_byte_size +
+             " bytes in shared memory objects to the stub without a copy.")
+                .c_str());
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the LAZY_INPUT_MIN_BYTE_SIZE variable if it doesn't exist.
+    std::string lazy_input_min_byte_size;
+    error = GetParameterValue(
+        params, "LAZY_INPUT_MIN_BYTE_SIZE", &lazy_input_min_byte_size);
+    if (error == nullptr) {
+      try {
+        lazy_input_min_byte_size_ = std::stoll(lazy_input_min_byte_size);
+      }
+      catch (const std::logic_error& le) {
+        lazy_input_min_byte_size_ = -1;
+      }
+      if (lazy_input_min_byte_size_ < 0) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for LAZY_INPUT_MIN_BYTE_SIZE: ") +
+             lazy_input_min_byte_size + "'")
+                .c_str()));
+      }
+      if (lazy_input_min_byte_size_ > 0 && !decoupled_) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Copying CPU input tensors of at least ") +
+             lazy_input_min_byte_size +
+             " bytes to shared memory only when they are used.")
+                .c_str());
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the PIPELINE_DEPTH variable if it doesn't exist.
+    std::string pipeline_depth;
+    error = GetParameterValue(params, "PIPELINE_DEPTH", &pipeline_depth);
+    if (error == nullptr) {
+      try {
+        pipeline_depth_ = std::stoll(pipeline_depth);
+      }
+      catch (const std::logic_error& le) {
+        pipeline_depth_ = 0;
+      }
+      if (pipeline_depth_ < 1) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for PIPELINE_DEPTH: ") +
+             pipeline_depth + "'")
+                .c_str()));
+      }
+      if (pipeline_depth_ > 1) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Using pipelined execution with a depth of ") +
+             pipeline_depth + ".")
+                .c_str());
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the STUB_POOL_SIZE variable if it doesn't exist.
+    std::string stub_pool_size;
+    error = GetParameterValue(params, "STUB_POOL_SIZE", &stub_pool_size);
+    if (error == nullptr) {
+      try {
+        stub_pool_size_ = std::stoll(stub_pool_size);
+      }
+      catch (const std::logic_error& le) {
+        stub_pool_size_ = 0;
+      }
+      if (stub_pool_size_ < 1) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for STUB_POOL_SIZE: ") +
+             stub_pool_size + "'")
+                .c_str()));
+      }
+      if (stub_pool_size_ > 1 && (decoupled_ || pipeline_depth_ > 1)) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNSUPPORTED,
+            "STUB_POOL_SIZE can't be used with the decoupled mode or with "
+            "PIPELINE_DEPTH."));
+      }
+      if (stub_pool_size_ > 1) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Using ") + stub_pool_size +
+             " stub processes per model instance.")
+                .c_str());
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the STUB_FORK_SERVER variable if it doesn't exist.
+    std::string stub_fork_server;
+    error = GetParameterValue(params, "STUB_FORK_SERVER", &stub_fork_server);
+    if (error == nullptr) {
+      if (stub_fork_server == "yes") {
+        stub_fork_server_ = true;
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Forking the stub processes from a fork server."))
+                .c_str());
+      } else if (stub_fork_server == "no") {
+        stub_fork_server_ = false;
+      } else {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNSUPPORTED,
+            (std::string("Incorrect value for STUB_FORK_SERVER: ") +
+             stub_fork_server + "'")
+                .c_str()));
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the DECOUPLED_SEND_WINDOW variable if it doesn't exist.
+    std::string decoupled_send_window;
+    error = GetParameterValue(
+        params, "DECOUPLED_SEND_WINDOW", &decoupled_send_window);
+    if (error == nullptr) {
+      try {
+        decoupled_send_window_ = std::stoll(decoupled_send_window);
+      }
+      catch (const std::logic_error& le) {
+        decoupled_send_window_ = -1;
+      }
+      if (decoupled_send_window_ < 0) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for DECOUPLED_SEND_WINDOW: ") +
+             decoupled_send_window + "'")
+                .c_str()));
+      }
+      if (decoupled_send_window_ > 0 && decoupled_) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Sending up to ") + decoupled_send_window +
+             " responses of a request without waiting for them.")
+                .c_str());
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the BLS_DEADLINE_MICROSECONDS variable if it doesn't exist.
+    std::string bls_deadline_microseconds;
+    error = GetParameterValue(
+        params, "BLS_DEADLINE_MICROSECONDS", &bls_deadline_microseconds);
+    if (error == nullptr) {
+      try {
+        bls_deadline_microseconds_ = std::stoll(bls_deadline_microseconds);
+      }
+      catch (const std::logic_error& le) {
+        bls_deadline_microseconds_ = -1;
+      }
+      if (bls_deadline_microseconds_ < 0) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for BLS_DEADLINE_MICROSECONDS: ") +
+             bls_deadline_microseconds + "'")
+                .c_str()));
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the DECOUPLED_MAX_IN_FLIGHT_REQUESTS variable if it doesn't exist.
+    std::string decoupled_max_in_flight_requests;
+    error = GetParameterValue(
+        params, "DECOUPLED_MAX_IN_FLIGHT_REQUESTS",
+        &decoupled_max_in_flight_requests);
+    if (error == nullptr) {
+      try {
+        decoupled_max_in_flight_requests_ =
+            std::stoll(decoupled_max_in_flight_requests);
+      }
+      catch (const std::logic_error& le) {
+        decoupled_max_in_flight_requests_ = -1;
+      }
+      if (decoupled_max_in_flight_requests_ < 0) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string(
+                 "Incorrect value for DECOUPLED_MAX_IN_FLIGHT_REQUESTS: ") +
+             decoupled_max_in_flight_requests + "'")
+                .c_str()));
+      }
+      if (!decoupled_) {
+        decoupled_max_in_flight_requests_ = 0;
+      } else if (decoupled_max_in_flight_requests_ > 0) {
+        LOG_MESSAGE(
+            TRITONSERVER_LOG_INFO,
+            (std::string("Executing the batches of model '") + Name() +
+             "' while up to " + decoupled_max_in_flight_requests +
+             " requests are in flight.")
+                .c_str());
+      }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the SEQUENCE_STATE_BYTE_SIZE variable if it doesn't exist.
+    std::string sequence_state_byte_size;
+    error = GetParameterValue(
+        params, "SEQUENCE_STATE_BYTE_SIZE", &sequence_state_byte_size);
+    if (error == nullptr) {
+      try {
+        sequence_state_byte_size_ = std::stoll(sequence_state_byte_size);
+      }
+      catch (const std::logic_error& le) {
+        sequence_state_byte_size_ = -1;
+      }
+      if (sequence_state_byte_size_ < 0) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for SEQUENCE_STATE_BYTE_SIZE: '") +
+             sequence_state_byte_size + "'")
+                .c_str()));
+      }
+      // The requests of a sequence are spread over the processes of the
+      // pool, which can't share the states of the sequence.
+      if (sequence_state_byte_size_ > 0 && stub_pool_size_ > 1) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNSUPPORTED,
+            "SEQUENCE_STATE_BYTE_SIZE can't be used with STUB_POOL_SIZE."));
       }
-      LOG_MESSAGE(
-          TRITONSERVER_LOG_INFO,
-          (std::string("Using Python execution env ") + python_execution_env_)
-              .c_str());
     } else {
       // Delete the error
       TRITONSERVER_ErrorDelete(error);
     }
 
-    triton::common::TritonJson::Value model_transaction_policy;
-    if (model_config_.Find(
-            "model_transaction_policy", &model_transaction_policy)) {
-      triton::common::TritonJson::Value decoupled;
-      if (model_transaction_policy.Find("decoupled", &decoupled)) {
-        auto error = decoupled.AsBool(&decoupled_);
-        if (error != nullptr) {
-          throw BackendModelException(error);
-        }
+    // Skip the SEQUENCE_STATE_MAX_ENTRIES variable if it doesn't exist.
+    std::string sequence_state_max_entries;
+    error = GetParameterValue(
+        params, "SEQUENCE_STATE_MAX_ENTRIES", &sequence_state_max_entries);
+    if (error == nullptr) {
+      try {
+        sequence_state_max_entries_ = std::stoll(sequence_state_max_entries);
+      }
+      catch (const std::logic_error& le) {
+        sequence_state_max_entries_ = -1;
+      }
+      if (sequence_state_max_entries_ <= 0 ||
+          sequence_state_max_entries_ > UINT32_MAX) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for SEQUENCE_STATE_MAX_ENTRIES: '") +
+             sequence_state_max_entries + "'")
+                .c_str()));
       }
+    } else {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
     }
 
-    // Skip the FORCE_CPU_ONLY_INPUT_TENSORS variable if it doesn't exits.
-    std::string force_cpu_only_input_tensor;
-    error = nullptr;
+    // Skip the STUB_CPU_AFFINITY variable if it doesn't exist. The CPU lists
+    // are validated by the stub launcher of each model instance.
+    error = GetParameterValue(params, "STUB_CPU_AFFINITY", &stub_cpu_affinity_);
+    if (error != nullptr) {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the SHARED_WEIGHT_FILES variable if it doesn't exist. The files
+    // are mapped once the artifact type is checked.
     error = GetParameterValue(
-        params, "FORCE_CPU_ONLY_INPUT_TENSORS", &force_cpu_only_input_tensor);
+        params, "SHARED_WEIGHT_FILES", &shared_weight_files);
+    if (error != nullptr) {
+      // Delete the error
+      TRITONSERVER_ErrorDelete(error);
+    }
+
+    // Skip the NEURON_CORES_PER_INSTANCE variable if it doesn't exist.
+    std::string neuron_cores_per_instance;
+    error = GetParameterValue(
+        params, "NEURON_CORES_PER_INSTANCE", &neuron_cores_per_instance);
     if (error == nullptr) {
-      if (force_cpu_only_input_tensor == "yes") {
-        force_cpu_only_input_tensors_ = true;
-        LOG_MESSAGE(
-            TRITONSERVER_LOG_INFO,
-            (std::string("Forcing CPU only input tensors.")).c_str());
-      } else if (force_cpu_only_input_tensor == "no") {
-        force_cpu_only_input_tensors_ = false;
-        LOG_MESSAGE(
-            TRITONSERVER_LOG_INFO,
-            (std::string("Input tensors can be both in CPU and GPU. "
-                         "FORCE_CPU_ONLY_INPUT_TENSORS is off."))
-                .c_str());
-      } else {
+      try {
+        neuron_cores_per_instance_ = std::stoll(neuron_cores_per_instance);
+      }
+      catch (const std::logic_error& le) {
+        neuron_cores_per_instance_ = -1;
+      }
+      if (neuron_cores_per_instance_ < 0) {
         throw BackendModelException(TRITONSERVER_ErrorNew(
-            TRITONSERVER_ERROR_UNSUPPORTED,
-            (std::string("Incorrect value for FORCE_CPU_ONLY_INPUT_TENSORS: ") +
-             force_cpu_only_input_tensor + "'")
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Incorrect value for NEURON_CORES_PER_INSTANCE: '") +
+             neuron_cores_per_instance + "'")
+                .c_str()));
+      }
+      if (neuron_cores_per_instance_ > 0 &&
+          backend_state_->neuron_core_allocator == nullptr) {
+        throw BackendModelException(TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("NEURON_CORES_PER_INSTANCE of model '") + Name() +
+             "' requires the 'neuron-core-count' backend option.")
                 .c_str()));
       }
     } else {
@@ -1614,6 +3718,50 @@ ModelState::ModelState(TRITONBACKEND_Model* triton_model)
         (std::string("unsupported artifact type for model '") + Name() + "'")
             .c_str()));
   }
+
+  if (!shared_weight_files.empty()) {
+    MapSharedWeightFiles(shared_weight_files);
+  }
+}
+
+void
+ModelState::MapSharedWeightFiles(const std::string& file_list)
+{
+  std::vector<std::pair<std::string, std::string>> files;
+  if (!ParseSharedWeightFiles(file_list, &files)) {
+    throw BackendModelException(TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("Incorrect value for SHARED_WEIGHT_FILES: '") +
+         file_list + "'")
+            .c_str()));
+  }
+
+  // The relative paths are relative to the directory of the model. The stub
+  // processes receive the absolute paths.
+  for (const auto& file : files) {
+    std::string path = file.second;
+    if (path[0] != '/') {
+      path = RepositoryPath() + "/" + path;
+    }
+    try {
+      shared_weight_files_.emplace_back(
+          SharedWeightFile::Map(path, true /* prefault */));
+    }
+    catch (const PythonBackendException& pb_exception) {
+      throw BackendModelException(TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG, pb_exception.what()));
+    }
+    if (!shared_weight_file_list_.empty()) {
+      shared_weight_file_list_ += ";";
+    }
+    shared_weight_file_list_ += file.first + "=" + path;
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_VERBOSE,
+        (std::string("Mapped shared weight file '") + file.first + "' of " +
+         std::to_string(shared_weight_files_.back()->ByteSize()) +
+         " bytes for model '" + Name() + "'")
+            .c_str());
+  }
 }
 
 TRITONSERVER_Error*
@@ -1639,6 +3787,59 @@ ModelState::LaunchAutoCompleteStubProcess()
   return nullptr;
 }
 
+TRITONSERVER_Error*
+ModelState::AutoCompleteInForkServer()
+{
+  StubLauncher* fork_server;
+  RETURN_IF_ERROR(GetForkServer(&fork_server));
+  TRITONSERVER_Error* err = fork_server->AutoCompleteInForkServer();
+  if (err != nullptr) {
+    // The model fails to load, so the fork server is not needed anymore.
+    std::lock_guard<std::mutex> lock(fork_server_mu_);
+    fork_server_->UpdateHealth();
+    fork_server_->TerminateStub();
+    fork_server_->ClearLogQueue();
+    fork_server_.reset();
+    return err;
+  }
+  ModelConfig() = std::move(fork_server->AutoCompleteConfig());
+
+  return nullptr;
+}
+
+ModelState::~ModelState()
+{
+  if (fork_server_ != nullptr) {
+    fork_server_->UpdateHealth();
+    fork_server_->TerminateStub();
+    fork_server_->ClearLogQueue();
+    fork_server_.reset();
+  }
+}
+
+TRITONSERVER_Error*
+ModelState::GetForkServer(StubLauncher** fork_server)
+{
+  std::lock_guard<std::mutex> lock(fork_server_mu_);
+  if (fork_server_ == nullptr) {
+    std::unique_ptr<StubLauncher> launcher =
+        std::make_unique<StubLauncher>("FORK_SERVER_STUB");
+    RETURN_IF_ERROR(launcher->Initialize(this));
+    RETURN_IF_ERROR(launcher->Setup());
+    TRITONSERVER_Error* err = launcher->Launch();
+    if (err != nullptr) {
+      launcher->UpdateHealth();
+      launcher->TerminateStub();
+      launcher->ClearLogQueue();
+      return err;
+    }
+    fork_server_ = std::move(launcher);
+  }
+
+  *fork_server = fork_server_.get();
+  return nullptr;
+}
+
 TRITONSERVER_Error*
 ModelState::ValidateModelConfig()
 {
@@ -1652,6 +3853,37 @@ ModelState::ValidateModelConfig()
   return nullptr;
 }
 
+namespace {
+
+// Parse a "yes"/"no" backend cmdline option. 'value' is left unchanged if the
+// option is not set.
+TRITONSERVER_Error*
+ParseYesNoOption(
+    triton::common::TritonJson::Value& cmdline, const std::string& name,
+    bool* value)
+{
+  triton::common::TritonJson::Value option;
+  if (cmdline.Find(name.c_str(), &option)) {
+    std::string option_str;
+    RETURN_IF_ERROR(option.AsString(&option_str));
+    if (option_str == "yes") {
+      *value = true;
+    } else if (option_str == "no") {
+      *value = false;
+    } else {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("Incorrect value for ") + name + ": '" + option_str +
+           "'. The value must be 'yes' or 'no'.")
+              .c_str());
+    }
+  }
+
+  return nullptr;
+}
+
+}  // namespace
+
 extern "C" {
 
 TRITONSERVER_Error*
@@ -1704,6 +3936,15 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
   backend_state->shm_message_queue_size = 1000;
   backend_state->number_of_instance_inits = 0;
   backend_state->thread_pool_size = 32;
+  backend_state->response_thread_pool_size = 4;
+  backend_state->ipc_spin_wait_microseconds = 0;
+  backend_state->shm_hugepages = false;
+  backend_state->shm_prefault = false;
+  backend_state->shm_growth_watermark_byte_size = 0;
+  backend_state->bls_response_cache_byte_size = 0;
+  backend_state->cuda_shared_pool_byte_size = 0;
+  backend_state->stub_launch_concurrency =
+      std::max(1u, std::thread::hardware_concurrency());
   backend_state->shared_memory_region_prefix =
       "triton_python_backend_shm_region_";
 
@@ -1766,6 +4007,28 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
       }
     }
 
+    triton::common::TritonJson::Value response_thread_pool_size;
+    std::string response_thread_pool_count;
+    if (cmdline.Find(
+            "response-thread-pool-size", &response_thread_pool_size)) {
+      RETURN_IF_ERROR(
+          response_thread_pool_size.AsString(&response_thread_pool_count));
+      try {
+        backend_state->response_thread_pool_size =
+            std::stol(response_thread_pool_count);
+        if (backend_state->response_thread_pool_size < 1) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("response-thread-pool-size") +
+               " can't be less than 1.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
     triton::common::TritonJson::Value shm_region_prefix;
     std::string shm_region_prefix_str;
     if (cmdline.Find("shm-region-prefix-name", &shm_region_prefix)) {
@@ -1781,6 +4044,25 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
       backend_state->shared_memory_region_prefix = shm_region_prefix_str;
     }
 
+    triton::common::TritonJson::Value env_cache_directory;
+    if (cmdline.Find("env-cache-directory", &env_cache_directory)) {
+      RETURN_IF_ERROR(
+          env_cache_directory.AsString(&backend_state->env_cache_directory));
+    }
+
+    triton::common::TritonJson::Value trace_file;
+    if (cmdline.Find("trace-file", &trace_file)) {
+      std::string trace_file_str;
+      RETURN_IF_ERROR(trace_file.AsString(&trace_file_str));
+      try {
+        backend_state->tracer = std::make_unique<PbTracer>(trace_file_str);
+      }
+      catch (const PythonBackendException& pb_exception) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG, pb_exception.what());
+      }
+    }
+
     triton::common::TritonJson::Value shm_message_queue_size;
     std::string shm_message_queue_size_str;
     if (cmdline.Find("shm_message_queue_size", &shm_message_queue_size)) {
@@ -1795,6 +4077,52 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
       }
     }
 
+    RETURN_IF_ERROR(ParseYesNoOption(
+        cmdline, "shm-hugepages", &backend_state->shm_hugepages));
+    RETURN_IF_ERROR(ParseYesNoOption(
+        cmdline, "shm-prefault", &backend_state->shm_prefault));
+
+    triton::common::TritonJson::Value shm_growth_watermark;
+    std::string shm_growth_watermark_byte_size;
+    if (cmdline.Find("shm-growth-watermark-byte-size", &shm_growth_watermark)) {
+      RETURN_IF_ERROR(
+          shm_growth_watermark.AsString(&shm_growth_watermark_byte_size));
+      try {
+        backend_state->shm_growth_watermark_byte_size =
+            std::stol(shm_growth_watermark_byte_size);
+        if (backend_state->shm_growth_watermark_byte_size < 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("shm-growth-watermark-byte-size") +
+               " can't be smaller than zero.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
+    triton::common::TritonJson::Value ipc_spin_wait;
+    std::string ipc_spin_wait_microseconds;
+    if (cmdline.Find("ipc-spin-wait-microseconds", &ipc_spin_wait)) {
+      RETURN_IF_ERROR(ipc_spin_wait.AsString(&ipc_spin_wait_microseconds));
+      try {
+        backend_state->ipc_spin_wait_microseconds =
+            std::stol(ipc_spin_wait_microseconds);
+        if (backend_state->ipc_spin_wait_microseconds < 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("ipc-spin-wait-microseconds") +
+               " can't be smaller than zero.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
     triton::common::TritonJson::Value stub_timeout_seconds;
     std::string stub_timeout_string_seconds;
     if (cmdline.Find("stub-timeout-seconds", &stub_timeout_seconds)) {
@@ -1815,7 +4143,96 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
         return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
       }
     }
+
+    triton::common::TritonJson::Value bls_response_cache_size;
+    std::string bls_response_cache_byte_size;
+    if (cmdline.Find(
+            "bls-response-cache-byte-size", &bls_response_cache_size)) {
+      RETURN_IF_ERROR(
+          bls_response_cache_size.AsString(&bls_response_cache_byte_size));
+      try {
+        backend_state->bls_response_cache_byte_size =
+            std::stol(bls_response_cache_byte_size);
+        if (backend_state->bls_response_cache_byte_size < 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("bls-response-cache-byte-size") +
+               " can't be smaller than zero.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
+    triton::common::TritonJson::Value cuda_shared_pool_size;
+    std::string cuda_shared_pool_byte_size;
+    if (cmdline.Find("cuda-shared-pool-byte-size", &cuda_shared_pool_size)) {
+      RETURN_IF_ERROR(
+          cuda_shared_pool_size.AsString(&cuda_shared_pool_byte_size));
+      try {
+        backend_state->cuda_shared_pool_byte_size =
+            std::stol(cuda_shared_pool_byte_size);
+        if (backend_state->cuda_shared_pool_byte_size < 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("cuda-shared-pool-byte-size") +
+               " can't be smaller than zero.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
+    triton::common::TritonJson::Value neuron_core_count;
+    std::string neuron_core_count_string;
+    if (cmdline.Find("neuron-core-count", &neuron_core_count)) {
+      RETURN_IF_ERROR(neuron_core_count.AsString(&neuron_core_count_string));
+      try {
+        long core_count = std::stol(neuron_core_count_string);
+        if (core_count < 0) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("neuron-core-count") +
+               " can't be smaller than zero.")
+                  .c_str());
+        }
+        if (core_count > 0) {
+          backend_state->neuron_core_allocator =
+              std::make_unique<NeuronCoreAllocator>(core_count);
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
+
+    triton::common::TritonJson::Value stub_launch_concurrency;
+    std::string stub_launch_concurrency_string;
+    if (cmdline.Find("stub-launch-concurrency", &stub_launch_concurrency)) {
+      RETURN_IF_ERROR(
+          stub_launch_concurrency.AsString(&stub_launch_concurrency_string));
+      try {
+        backend_state->stub_launch_concurrency =
+            std::stol(stub_launch_concurrency_string);
+        if (backend_state->stub_launch_concurrency < 1) {
+          return TRITONSERVER_ErrorNew(
+              TRITONSERVER_ERROR_INVALID_ARG,
+              (std::string("stub-launch-concurrency") +
+               " can't be less than 1.")
+                  .c_str());
+        }
+      }
+      catch (const std::invalid_argument& ia) {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, ia.what());
+      }
+    }
   }
+  backend_state->stub_launch_limiter = std::make_unique<StubLaunchLimiter>(
+      backend_state->stub_launch_concurrency);
 
   LOG_MESSAGE(
       TRITONSERVER_LOG_VERBOSE,
@@ -1823,8 +4240,25 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
        std::to_string(backend_state->shm_default_byte_size) +
        ",shm-growth-byte-size=" +
        std::to_string(backend_state->shm_growth_byte_size) +
+       ",shm-growth-watermark-byte-size=" +
+       std::to_string(backend_state->shm_growth_watermark_byte_size) +
        ",stub-timeout-seconds=" +
-       std::to_string(backend_state->stub_timeout_seconds))
+       std::to_string(backend_state->stub_timeout_seconds) +
+       ",ipc-spin-wait-microseconds=" +
+       std::to_string(backend_state->ipc_spin_wait_microseconds) +
+       ",shm-hugepages=" + (backend_state->shm_hugepages ? "yes" : "no") +
+       ",shm-prefault=" + (backend_state->shm_prefault ? "yes" : "no") +
+       ",bls-response-cache-byte-size=" +
+       std::to_string(backend_state->bls_response_cache_byte_size) +
+       ",cuda-shared-pool-byte-size=" +
+       std::to_string(backend_state->cuda_shared_pool_byte_size) +
+       ",neuron-core-count=" +
+       std::to_string(
+           backend_state->neuron_core_allocator != nullptr
+               ? backend_state->neuron_core_allocator->CoreCount()
+               : 0) +
+       ",stub-launch-concurrency=" +
+       std::to_string(backend_state->stub_launch_concurrency))
           .c_str());
 
   // Use BackendArtifacts to determine the location of Python files
@@ -1833,7 +4267,25 @@ TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
   RETURN_IF_ERROR(
       TRITONBACKEND_BackendArtifacts(backend, &artifact_type, &location));
   backend_state->python_lib = location;
-  backend_state->env_manager = std::make_unique<EnvironmentManager>();
+  try {
+    backend_state->env_manager = std::make_unique<EnvironmentManager>(
+        backend_state->env_cache_directory);
+  }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+  }
+  if (!backend_state->env_cache_directory.empty()) {
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_INFO,
+        (std::string("Caching the extracted Python execution environments "
+                     "in ") +
+         backend_state->env_cache_directory)
+            .c_str());
+  }
+  backend_state->metric_families = std::make_unique<PbMetricFamilies>();
+  backend_state->bls_model_metadata_cache =
+      std::make_unique<ModelMetadataCache>();
 
   RETURN_IF_ERROR(TRITONBACKEND_BackendSetState(
       backend, reinterpret_cast<void*>(backend_state.get())));
@@ -1957,22 +4409,24 @@ TRITONBACKEND_ModelInstanceExecute(
   ModelState* model_state =
       reinterpret_cast<ModelState*>(instance_state->Model());
   if (!model_state->IsDecoupled()) {
+    // In the pipelined mode the requests are released by the pipeline thread
+    // once they have been executed.
+    if (model_state->PipelineDepth() > 1) {
+      instance_state->EnqueueRequests(requests, request_count);
+      return nullptr;
+    }
+
     instance_state->ProcessRequests(requests, request_count, restart);
 
     if (restart) {
-      LOG_MESSAGE(
-          TRITONSERVER_LOG_ERROR,
-          "Stub process is unhealthy and it will be restarted.");
-      instance_state->TerminateLogMonitor();
-      instance_state->Stub()->KillStubProcess();
-      TRITONSERVER_Error* err = instance_state->Stub()->Setup();
-      if (err == nullptr) {
-        instance_state->StartLogMonitor();
-      }
-      LOG_IF_ERROR(err, "Failed to restart the stub process.");
-      err = instance_state->Stub()->Launch();
-      LOG_IF_ERROR(err, "Failed to restart the stub process.");
+      instance_state->RestartStub();
     }
+  } else if (model_state->DecoupledMaxInFlightRequests() > 0) {
+    // The requests are released by the decoupled monitor thread once the
+    // execute function has returned.
+    instance_state->DispatchRequestsDecoupled(requests, request_count);
+    instance_state->ReportMetrics();
+    return nullptr;
   } else {
     std::vector<std::unique_ptr<InferRequest>> infer_requests;
 
@@ -1993,50 +4447,13 @@ TRITONBACKEND_ModelInstanceExecute(
 
     if (error != nullptr) {
       reporter.SetSuccessStatus(false);
-      for (uint32_t r = 0; r < request_count; ++r) {
-        TRITONBACKEND_Request* request = requests[r];
-        if (!instance_state->ExistsInClosedRequests(
-                reinterpret_cast<intptr_t>(request))) {
-          TRITONBACKEND_Response* response = nullptr;
-          LOG_IF_ERROR(
-              TRITONBACKEND_ResponseNew(&response, request),
-              "Failed to create a new response.");
-
-          if (response != nullptr) {
-            LOG_IF_ERROR(
-                TRITONBACKEND_ResponseSend(
-                    response, TRITONSERVER_RESPONSE_COMPLETE_FINAL, error),
-                "Failed to send the error response.");
-          }
-        }
-      }
-
-      // We should only delete the response factory for the requests that have
-      // not been closed.
-      for (auto& infer_request : infer_requests) {
-        if (!instance_state->ExistsInClosedRequests(
-                infer_request->RequestAddress())) {
-          LOG_IF_ERROR(
-              infer_request->DeleteResponseFactory(),
-              "Failed to delete the response factory.");
-        }
-      }
+      instance_state->RespondErrorDecoupled(
+          requests, request_count, infer_requests, error);
     }
   }
 
-  for (uint32_t r = 0; r < request_count; ++r) {
-    TRITONBACKEND_Request* request = requests[r];
-    LOG_IF_ERROR(
-        TRITONBACKEND_RequestRelease(request, TRITONSERVER_REQUEST_RELEASE_ALL),
-        "failed releasing request");
-  }
-
-  LOG_MESSAGE(
-      TRITONSERVER_LOG_VERBOSE,
-      (std::string("TRITONBACKEND_ModelInstanceExecute: model instance name ") +
-       instance_state->Name() + " released " + std::to_string(request_count) +
-       " requests")
-          .c_str());
+  instance_state->ReportMetrics();
+  instance_state->ReleaseRequests(requests, request_count);
 
   return nullptr;
 }
@@ -2078,6 +4495,13 @@ TRITONBACKEND_GetBackendAttribute(
       backend_attributes, TRITONSERVER_INSTANCEGROUPKIND_CPU, 0, nullptr, 0));
 #endif
 
+  // The model instances can be initialized in parallel. The stub processes
+  // are launched with a bounded concurrency, and the setup that is shared by
+  // the instances, such as extracting the execution environment and
+  // launching the fork server, runs once under its own lock.
+  RETURN_IF_ERROR(TRITONBACKEND_BackendAttributeSetParallelModelInstanceLoading(
+      backend_attributes, true));
+
   return nullptr;
 }
 
@@ -28,14 +28,17 @@
 
 #include <pthread.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/vfs.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <boost/asio.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
@@ -47,26 +50,35 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <functional>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <regex>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "infer_request.h"
 #include "infer_response.h"
 #include "ipc_message.h"
 #include "memory_manager.h"
 #include "message_queue.h"
+#include "neuron_cores.h"
 #include "pb_env.h"
 #include "pb_map.h"
 #include "pb_metric_reporter.h"
+#include "pb_metrics.h"
+#include "pb_trace.h"
 #include "pb_utils.h"
 #include "request_executor.h"
 #include "scoped_defer.h"
+#include "shared_weights.h"
 #include "shm_manager.h"
 #include "stub_launcher.h"
 #include "triton/backend/backend_common.h"
@@ -212,7 +224,29 @@ struct BackendState {
   std::atomic<int> number_of_instance_inits;
   std::string shared_memory_region_prefix;
   int64_t thread_pool_size;
+  int64_t response_thread_pool_size;
+  int64_t ipc_spin_wait_microseconds;
+  bool shm_hugepages;
+  bool shm_prefault;
+  int64_t shm_growth_watermark_byte_size;
+  // The BLS responses are not cached if zero.
+  int64_t bls_response_cache_byte_size;
+  // The GPU tensors are not allocated from a CUDA shared pool if zero.
+  int64_t cuda_shared_pool_byte_size;
+  // Allocates the NeuronCores of the model instances. nullptr if
+  // 'neuron-core-count' is not set.
+  std::unique_ptr<NeuronCoreAllocator> neuron_core_allocator;
+  // Bounds the number of stub processes launched at the same time by the
+  // model instances that are initialized in parallel.
+  int64_t stub_launch_concurrency;
+  std::unique_ptr<StubLaunchLimiter> stub_launch_limiter;
+  std::string env_cache_directory;
   std::unique_ptr<EnvironmentManager> env_manager;
+  std::unique_ptr<PbMetricFamilies> metric_families;
+  std::unique_ptr<ModelMetadataCache> bls_model_metadata_cache;
+  // Writes the spans of the traced requests. nullptr if 'trace-file' is not
+  // set.
+  std::unique_ptr<PbTracer> tracer;
 };
 
 class ModelState : public BackendModel {
@@ -220,6 +254,8 @@ class ModelState : public BackendModel {
   static TRITONSERVER_Error* Create(
       TRITONBACKEND_Model* triton_model, ModelState** state);
 
+  ~ModelState();
+
   // Get backend state
   BackendState* StateForBackend() { return backend_state_; }
 
@@ -229,12 +265,83 @@ class ModelState : public BackendModel {
   // Force CPU only tensors
   bool ForceCPUOnlyInputTensors() { return force_cpu_only_input_tensors_; }
 
+  // Minimum byte size of the input tensors that are passed to the stub
+  // without a copy. Zero disables the zero-copy inputs.
+  int64_t ZeroCopyInputMinByteSize() { return zero_copy_input_min_byte_size_; }
+
+  // Minimum byte size of the CPU inputs that are only copied to shared memory
+  // when the model uses them. Zero copies all the inputs before the execution.
+  int64_t LazyInputMinByteSize() { return lazy_input_min_byte_size_; }
+
   // Is decoupled API being used.
   bool IsDecoupled() { return decoupled_; }
 
+  // Whether the execute function may return a single response for the whole
+  // batch.
+  bool FusedBatch() { return fused_batch_; }
+
+  // Maximum number of batches of a model instance that are staged in shared
+  // memory or executed at the same time. One disables the pipelined execution.
+  int64_t PipelineDepth() { return pipeline_depth_; }
+
+  // Number of stub processes of a model instance. The requests of a batch are
+  // split between the stub processes.
+  int64_t StubPoolSize() { return stub_pool_size_; }
+
+  // Whether the stub processes of the model instances are forked from a stub
+  // that has already imported the model.
+  bool UsesForkServer() { return stub_fork_server_; }
+
+  // Maximum number of responses of a request that a decoupled model sends
+  // without waiting for them to be sent. Zero sends every response
+  // synchronously.
+  int64_t DecoupledSendWindow() { return decoupled_send_window_; }
+
+  // Maximum number of requests of a decoupled model whose final response has
+  // not been sent when the next batch is sent to the stub process, without
+  // waiting for the execute function of the previous batch to return. Zero
+  // waits for the execute function of every batch.
+  int64_t DecoupledMaxInFlightRequests()
+  {
+    return decoupled_max_in_flight_requests_;
+  }
+
+  // Time after which the BLS requests of a batch are not sent anymore,
+  // measured from when the batch is received. Zero if the BLS requests have
+  // no deadline.
+  int64_t BLSDeadlineMicroseconds() { return bls_deadline_microseconds_; }
+
+  // Number of bytes of the per-sequence states of each model instance. Zero
+  // if the sequence state store is disabled.
+  int64_t SequenceStateByteSize() { return sequence_state_byte_size_; }
+
+  // Maximum number of per-sequence states of each model instance.
+  int64_t SequenceStateMaxEntries() { return sequence_state_max_entries_; }
+
+  // The CPUs that the stub processes of the model instances run on, as given
+  // by the 'STUB_CPU_AFFINITY' parameter. Empty if the stub processes of the
+  // GPU instances are placed near their device.
+  const std::string& StubCpuAffinity() { return stub_cpu_affinity_; }
+
+  // Number of NeuronCores allocated to each model instance when it is
+  // launched. Zero if the instances don't use NeuronCores.
+  int64_t NeuronCoresPerInstance() { return neuron_cores_per_instance_; }
+
+  // The weight files shared by the stub processes of the model instances, as
+  // a list of 'name=path' entries separated by ';' with absolute paths.
+  // Empty if the model doesn't share weight files.
+  const std::string& SharedWeightFileList() { return shared_weight_file_list_; }
+
+  // Get the fork server of the model, launching it on the first call.
+  TRITONSERVER_Error* GetForkServer(StubLauncher** fork_server);
+
   // Launch auto-complete stub process.
   TRITONSERVER_Error* LaunchAutoCompleteStubProcess();
 
+  // Auto-complete the model configuration in the fork server of the model
+  // instead of a separate auto-complete stub.
+  TRITONSERVER_Error* AutoCompleteInForkServer();
+
   // Validate Model Configuration
   TRITONSERVER_Error* ValidateModelConfig();
 
@@ -243,11 +350,71 @@ class ModelState : public BackendModel {
 
  private:
   ModelState(TRITONBACKEND_Model* triton_model);
+
+  // Map the files of the 'SHARED_WEIGHT_FILES' parameter.
+  void MapSharedWeightFiles(const std::string& file_list);
+
   BackendState* backend_state_;
   std::string python_execution_env_;
   bool force_cpu_only_input_tensors_;
+  int64_t zero_copy_input_min_byte_size_;
+  int64_t lazy_input_min_byte_size_;
   bool decoupled_;
+  bool fused_batch_;
+  int64_t pipeline_depth_;
+  int64_t stub_pool_size_;
+  bool stub_fork_server_;
+  int64_t decoupled_send_window_;
+  int64_t decoupled_max_in_flight_requests_;
+  int64_t bls_deadline_microseconds_;
+  int64_t sequence_state_byte_size_;
+  int64_t sequence_state_max_entries_;
+  std::string stub_cpu_affinity_;
+  int64_t neuron_cores_per_instance_;
+  std::vector<std::unique_ptr<SharedWeightFile>> shared_weight_files_;
+  std::string shared_weight_file_list_;
   std::unique_ptr<StubLauncher> auto_complete_stub_;
+  std::mutex fork_server_mu_;
+  std::unique_ptr<StubLauncher> fork_server_;
+};
+
+// A batch of requests whose inputs have been saved to shared memory and that
+// is waiting to be executed by the stub process.
+struct StagedRequests {
+  std::vector<TRITONBACKEND_Request*> requests;
+  std::shared_ptr<std::vector<TRITONBACKEND_Response*>> responses;
+  std::unique_ptr<PbMetricReporter> reporter;
+  std::vector<std::unique_ptr<InferRequest>> pb_inference_requests;
+  AllocatedSharedMemory<char> request_batch;
+  size_t total_batch_size;
+  uint64_t exec_start_ns;
+  uint64_t save_requests_start_ns;
+  uint64_t save_requests_ns;
+  pid_t save_requests_tid;
+};
+
+// A batch of a decoupled model that was sent to the stub process without
+// waiting for its execute function to return. The requests are released once
+// the execute function returns.
+struct InFlightExecute {
+  std::vector<TRITONBACKEND_Request*> requests;
+  std::unique_ptr<PbMetricReporter> reporter;
+  std::vector<std::unique_ptr<InferRequest>> pb_inference_requests;
+  AllocatedSharedMemory<char> request_batch;
+  // nullptr if the batch was not sent to the stub process.
+  std::unique_ptr<IPCMessage> ipc_message;
+  uint64_t save_requests_start_ns;
+  uint64_t compute_start_ns;
+};
+
+// The requests of the batch whose execution sent a BLS request. The BLS
+// request is not sent, or is cancelled, if the requests were cancelled or if
+// the deadline has passed.
+struct BLSParent {
+  TRITONBACKEND_Request** requests;
+  uint32_t request_count;
+  // Steady clock time in nanoseconds. Zero if there's no deadline.
+  uint64_t deadline_ns;
 };
 
 class ModelInstanceState : public BackendModelInstance {
@@ -258,19 +425,144 @@ class ModelInstanceState : public BackendModelInstance {
   std::unique_ptr<StubLauncher> model_instance_stub_;
   std::vector<TRITONSERVER_InferenceResponse*> bls_inference_responses_;
   std::mutex bls_responses_mutex_;
-  std::vector<intptr_t> closed_requests_;
+  std::unordered_set<intptr_t> closed_requests_;
   std::mutex closed_requests_mutex_;
+  std::atomic<uint64_t> closed_request_checks_;
+  // Errors of the asynchronous responses that the stub process hasn't read,
+  // keyed by the request address.
+  std::unordered_map<intptr_t, std::vector<std::unique_ptr<PbString>>>
+      async_send_errors_;
+  std::mutex async_send_errors_mutex_;
 
   std::thread log_monitor_;
   bool log_thread_;
+  std::atomic<uint64_t> dropped_log_messages_;
   // Decoupled monitor thread
   std::thread decoupled_monitor_;
   bool decoupled_thread_;
   std::mutex mu_;
   std::condition_variable cv_;
   std::unique_ptr<IPCMessage> received_message_;
+
+  // The decoupled batches whose execute function has not returned, keyed by
+  // the batch id, and the requests whose final response has not been sent.
+  // Only used if 'DECOUPLED_MAX_IN_FLIGHT_REQUESTS' is set.
+  std::unordered_map<uint64_t, std::unique_ptr<InFlightExecute>>
+      in_flight_executes_;
+  std::unordered_set<intptr_t> in_flight_requests_;
+  std::mutex in_flight_mu_;
+  std::condition_variable in_flight_cv_;
   std::vector<std::future<void>> futures_;
+  std::mutex futures_mutex_;
   std::unique_ptr<boost::asio::thread_pool> thread_pool_;
+  // The BLS tasks that wait for a thread of 'thread_pool_', keyed by the
+  // rank of their priority and the order in which they were posted. A thread
+  // runs the first task when it becomes available.
+  std::map<std::pair<uint64_t, uint64_t>, std::packaged_task<void()>>
+      bls_tasks_;
+  std::mutex bls_tasks_mu_;
+  uint64_t next_bls_task_sequence_;
+
+  // The responses of the decoupled models are sent by a separate thread pool
+  // so that they are not delayed by the BLS requests. The responses of each
+  // request are sent in order by the strand of the request. The strands are
+  // only used by the decoupled monitor thread.
+  using ResponseStrand =
+      boost::asio::strand<boost::asio::thread_pool::executor_type>;
+  std::unique_ptr<boost::asio::thread_pool> response_thread_pool_;
+  std::unordered_map<intptr_t, ResponseStrand> response_strands_;
+
+  // Pipelined execution. The batches are staged in shared memory by the
+  // execute thread and executed in order by the pipeline thread. The staging
+  // mutex prevents the pipeline thread from restarting the stub process while a
+  // batch is being staged.
+  std::thread pipeline_thread_;
+  bool pipeline_thread_running_;
+  std::mutex pipeline_mu_;
+  std::condition_variable pipeline_cv_;
+  std::deque<std::unique_ptr<StagedRequests>> pipelined_requests_;
+  std::mutex staging_mu_;
+
+  // Additional stub processes of this instance. Each member of the pool is a
+  // model instance state with its own stub process that shares the Triton
+  // model instance with this one.
+  bool is_stub_pool_member_;
+  std::vector<std::unique_ptr<ModelInstanceState>> stub_pool_;
+  std::unique_ptr<boost::asio::thread_pool> stub_pool_threads_;
+
+  // IPC and shared memory metrics. The metrics are nullptr if metrics are not
+  // available.
+  std::unique_ptr<PbMetric> parent_spin_hits_metric_;
+  std::unique_ptr<PbMetric> parent_sleeps_metric_;
+  std::unique_ptr<PbMetric> stub_spin_hits_metric_;
+  std::unique_ptr<PbMetric> stub_sleeps_metric_;
+  std::unique_ptr<PbMetric> shm_global_lock_acquisitions_metric_;
+  std::unique_ptr<PbMetric> shm_global_lock_contentions_metric_;
+  std::unique_ptr<PbMetric> shm_slab_lock_acquisitions_metric_;
+  std::unique_ptr<PbMetric> shm_slab_lock_contentions_metric_;
+  std::unique_ptr<PbMetric> shm_thread_cache_hits_metric_;
+  std::unique_ptr<PbMetric> shm_thread_cache_misses_metric_;
+  std::unique_ptr<PbMetric> closed_request_checks_metric_;
+  std::unique_ptr<PbMetric> dropped_log_messages_metric_;
+
+  // Duration of the phases of the execution of a batch. The stub phases are
+  // measured by the stub process and returned in the response batch. The IPC
+  // phase is the part of the stub round trip that is not spent in the stub
+  // phases.
+  std::unique_ptr<PbMetric> save_requests_duration_metric_;
+  std::unique_ptr<PbMetric> ipc_duration_metric_;
+  std::unique_ptr<PbMetric> stub_load_requests_duration_metric_;
+  std::unique_ptr<PbMetric> stub_execute_duration_metric_;
+  std::unique_ptr<PbMetric> stub_save_responses_duration_metric_;
+  std::unique_ptr<PbMetric> load_responses_duration_metric_;
+  std::unique_ptr<PbMetric> send_responses_duration_metric_;
+  std::unique_ptr<PbMetric> load_gpu_buffers_duration_metric_;
+
+  // The parts of the stub execute phase of a batch, and the cumulative times
+  // of the stub process that they are taken from.
+  std::unique_ptr<PbMetric> stub_execute_gil_held_duration_metric_;
+  std::unique_ptr<PbMetric> stub_execute_gil_wait_duration_metric_;
+  std::unique_ptr<PbMetric> stub_execute_bls_duration_metric_;
+  std::unique_ptr<PbMetric> stub_execute_gc_duration_metric_;
+  std::unique_ptr<PbMetric> stub_gil_held_time_metric_;
+  std::unique_ptr<PbMetric> stub_gil_wait_time_metric_;
+  std::unique_ptr<PbMetric> stub_bls_exec_time_metric_;
+  std::unique_ptr<PbMetric> stub_gc_pause_time_metric_;
+
+  // Shared memory pool telemetry. The fragmentation is measured by probing
+  // the allocator, so it is reported at most once per
+  // 'kShmFragmentationReportIntervalNs'.
+  std::vector<std::unique_ptr<PbMetric>> shm_allocations_metrics_;
+  std::vector<std::unique_ptr<PbMetric>> shm_live_objects_metrics_;
+  std::unique_ptr<PbMetric> shm_peak_allocated_bytes_metric_;
+  std::unique_ptr<PbMetric> shm_grow_successes_metric_;
+  std::unique_ptr<PbMetric> shm_grow_failures_metric_;
+  std::unique_ptr<PbMetric> shm_fragmentation_metric_;
+  static constexpr uint64_t kShmFragmentationReportIntervalNs = 1000000000;
+  uint64_t last_fragmentation_report_ns_;
+
+  // Identifier of the next request batch sent to the stub process.
+  std::atomic<uint64_t> next_batch_id_;
+
+  // The execute responses of the dispatched batches with a lower identifier
+  // have been loaded by the monitor thread.
+  std::atomic<uint64_t> released_batch_id_;
+
+  // The cached BLS responses refer to the shared memory pool of the stub, so
+  // each stub has its own cache. nullptr if 'bls-response-cache-byte-size' is
+  // not set.
+  std::unique_ptr<BLSResponseCache> bls_response_cache_;
+  std::unique_ptr<PbMetric> bls_cache_hits_metric_;
+  std::unique_ptr<PbMetric> bls_cache_misses_metric_;
+  std::unique_ptr<PbMetric> bls_cache_in_flight_hits_metric_;
+  std::unique_ptr<PbMetric> bls_cache_bytes_metric_;
+
+#ifdef TRITON_ENABLE_GPU
+  // Additional streams used to overlap the GPU to CPU copies of different
+  // inputs. The first input is always copied on the instance stream.
+  static constexpr size_t kInputCopyStreamCount = 3;
+  std::vector<cudaStream_t> input_copy_streams_;
+#endif
 
  public:
   static TRITONSERVER_Error* Create(
@@ -282,6 +574,9 @@ class ModelInstanceState : public BackendModelInstance {
   // Launch stub process.
   TRITONSERVER_Error* LaunchStubProcess();
 
+  // Launch the additional stub processes of the instance.
+  TRITONSERVER_Error* LaunchStubPool();
+
   TRITONSERVER_Error* SendMessageToStub(off_t message);
   void ResponseSendDecoupled(std::shared_ptr<IPCMessage> response_send_message);
 
@@ -319,11 +614,56 @@ class ModelInstanceState : public BackendModelInstance {
       TRITONBACKEND_Request* request,
       std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses);
 
+  // Collect the CPU inputs of all the requests into one shared memory buffer
+  // per input name with a single collector pass. The input tensors of each
+  // request refer to their part of the buffer. Inputs that can't be batched,
+  // e.g. inputs that stay in GPU memory, are not added to 'batched_inputs'.
+  TRITONSERVER_Error* GetBatchedInputTensors(
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses,
+      std::unordered_map<std::string, std::vector<std::shared_ptr<PbTensor>>>&
+          batched_inputs);
+
   // Process all the requests obtained from Triton.
   void ProcessRequests(
       TRITONBACKEND_Request** requests, const uint32_t request_count,
       bool& restart);
 
+  // Split the requests between the stub processes of the instance and
+  // process the parts concurrently.
+  void ProcessRequestsInStubPool(
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      bool& restart);
+
+  // Create the responses of the requests and save the requests to shared
+  // memory. 'staged_requests' is not set if there is nothing to execute, in
+  // which case the error responses have already been sent.
+  void StageRequests(
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      std::unique_ptr<StagedRequests>& staged_requests);
+
+  // Execute the staged requests in the stub process and send the responses.
+  void ExecuteStagedRequests(StagedRequests& staged_requests, bool& restart);
+
+  // Stage the requests and queue them for the pipeline thread. The function
+  // returns once the batch is queued, without waiting for the execution. The
+  // pipeline thread releases the requests.
+  void EnqueueRequests(
+      TRITONBACKEND_Request** requests, const uint32_t request_count);
+
+  // Execute the queued batches in order until the instance is destroyed.
+  void PipelineThread();
+
+  // Release the shared memory of a batch and release its requests.
+  void FinishStagedRequests(std::unique_ptr<StagedRequests> staged_requests);
+
+  // Restart the stub process after it became unhealthy.
+  void RestartStub();
+
+  // Release the requests back to Triton.
+  void ReleaseRequests(
+      TRITONBACKEND_Request** requests, const uint32_t request_count);
+
   // Process all the requests in the decoupled mode.
   TRITONSERVER_Error* ProcessRequestsDecoupled(
       TRITONBACKEND_Request** requests, const uint32_t request_count,
@@ -332,9 +672,62 @@ class ModelInstanceState : public BackendModelInstance {
 
   bool ExistsInClosedRequests(intptr_t closed_request);
 
-  // Execute a BLS Request
+  // Send the requests to the stub process without waiting for the execute
+  // function to return, once the other in flight requests leave room for
+  // them. A batch larger than 'DECOUPLED_MAX_IN_FLIGHT_REQUESTS' is sent when
+  // no other request is in flight.
+  void DispatchRequestsDecoupled(
+      TRITONBACKEND_Request** requests, const uint32_t request_count);
+
+  // Finish the dispatched batch whose execute function returned.
+  void CompleteExecuteDecoupled(std::unique_ptr<IPCMessage> execute_response);
+
+  // Report the statistics of a dispatched batch and release its requests.
+  // 'error' is sent to the requests whose final response has not been sent,
+  // and is deleted.
+  void FinishExecuteDecoupled(
+      std::unique_ptr<InFlightExecute> in_flight, TRITONSERVER_Error* error);
+
+  // Read the result of the execute function of a decoupled batch from the
+  // response batch and write the spans of the traced requests.
+  TRITONSERVER_Error* ReadExecuteResponseDecoupled(
+      ResponseBatch* response_batch,
+      std::vector<std::unique_ptr<InferRequest>>& pb_inference_requests,
+      uint64_t save_requests_start_ns, uint64_t compute_start_ns,
+      uint64_t compute_end_ns);
+
+  // Send 'error' to the requests of a decoupled batch whose final response
+  // has not been sent and delete their response factories.
+  void RespondErrorDecoupled(
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      std::vector<std::unique_ptr<InferRequest>>& pb_inference_requests,
+      TRITONSERVER_Error* error);
+
+  // Execute a BLS Request. 'parent' is nullptr if the requests that sent the
+  // BLS request are not known, e.g. for the decoupled models.
   void ExecuteBLSRequest(
-      std::shared_ptr<IPCMessage> ipc_message, const bool is_stream);
+      std::shared_ptr<IPCMessage> ipc_message, const bool is_stream,
+      const BLSParent* parent = nullptr);
+
+  // Get the reason why the BLS requests of a batch must not be sent anymore,
+  // or an empty string if they can be sent.
+  std::string StaleBLSParentReason(const BLSParent& parent);
+
+  // Copy the data of an input that was not copied before the execution to
+  // shared memory.
+  void LoadInputBuffer(
+      const std::shared_ptr<IPCMessage>& ipc_message,
+      TRITONBACKEND_Request** requests, const uint32_t request_count);
+
+  // Add an output to the response of a request for the stub process to write
+  // the output to.
+  void AllocateOutputBuffer(
+      const std::shared_ptr<IPCMessage>& ipc_message,
+      TRITONBACKEND_Request** requests, const uint32_t request_count,
+      std::shared_ptr<std::vector<TRITONBACKEND_Response*>>& responses,
+      std::vector<std::unordered_map<
+          std::string, std::pair<std::unique_ptr<PbMemory>, void*>>>&
+          preallocated_outputs);
 
   // Cleanup BLS responses
   void CleanupBLSResponses();
@@ -342,10 +735,33 @@ class ModelInstanceState : public BackendModelInstance {
   // Wait for BLS requests to complete
   void WaitForBLSRequestsToFinish();
 
+  // Run a BLS request in the thread pool and release the futures of the BLS
+  // requests that have completed. The queued tasks with a higher priority,
+  // i.e. a lower non-zero priority value, run first. The tasks without a
+  // priority run after them, and the tasks with the same priority run in
+  // order.
+  void PostBLSTask(
+      std::packaged_task<void()>&& task, const uint32_t priority = 0);
+
+  // Run the first queued BLS task.
+  void RunNextBLSTask();
+
+  // Get the priority of a batch of BLS requests, or zero if it can't be
+  // read.
+  uint32_t BLSRequestPriority(const std::shared_ptr<IPCMessage>& ipc_message);
+
   // Get BLS responses
   void GetBLSResponses(
       std::vector<std::unique_ptr<InferResponse>>& responses,
-      std::future<std::unique_ptr<InferResponse>> future);
+      std::future<std::unique_ptr<InferResponse>> future,
+      RequestExecutor& request_executor, const BLSParent* parent);
+
+  // Wait for the response of a BLS request and cancel the requests of the
+  // executor if the BLS requests of the parent batch become stale meanwhile.
+  std::unique_ptr<InferResponse> WaitForBLSResponse(
+      std::future<std::unique_ptr<InferResponse>>& future,
+      RequestExecutor& request_executor, const BLSParent* parent);
+  static constexpr uint64_t kBLSParentCheckIntervalMs = 10;
 
   // Check the incoming requests for errors
   TRITONSERVER_Error* CheckIncomingRequests(
@@ -372,5 +788,31 @@ class ModelInstanceState : public BackendModelInstance {
 
   // Start the log monitor thread
   void StartLogMonitor();
+
+  // Export the message queue and shared memory allocator counters.
+  void ReportMetrics();
+
+  // Observe the durations measured by the stub process and the IPC overhead
+  // of a stub round trip that took 'round_trip_ns'.
+  void ObserveStubDurations(
+      ResponseBatch* response_batch, uint64_t round_trip_ns);
+
+  // Get the ids of the Triton traces of the requests. The ids are only
+  // collected if the backend has a trace file, so an empty result means that
+  // the spans of the batch are not written.
+  template <typename RequestPtr>
+  std::vector<uint64_t> TraceIds(const std::vector<RequestPtr>& requests);
+
+  // Write a span of a batch with the Triton traces 'trace_ids' to the trace
+  // file of the backend. Nothing is written if 'trace_ids' is empty.
+  void WriteTraceSpan(
+      const std::string& name, pid_t pid, pid_t tid, uint64_t start_ns,
+      uint64_t end_ns, uint64_t batch_id,
+      const std::vector<uint64_t>& trace_ids);
+
+  // Write the spans of the stub process from the timestamp and the durations
+  // returned in the response batch.
+  void WriteStubTraceSpans(
+      ResponseBatch* response_batch, const std::vector<uint64_t>& trace_ids);
 };
 }}}  // namespace triton::backend::python
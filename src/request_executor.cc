@@ -26,9 +26,9 @@
 
 #include "request_executor.h"
 
+#include <algorithm>
 #include <future>
 #include "pb_utils.h"
-#include "scoped_defer.h"
 #include "triton/backend/backend_common.h"
 #include "triton/core/tritonserver.h"
 
@@ -45,11 +45,20 @@ void
 InferRequestComplete(
     TRITONSERVER_InferenceRequest* request, const uint32_t flags, void* userp)
 {
+  auto in_flight_requests =
+      reinterpret_cast<std::shared_ptr<InFlightRequests>*>(userp);
   if (request != nullptr) {
+    // The request is removed before it is deleted so that it isn't cancelled
+    // after it has been deleted.
+    {
+      std::lock_guard<std::mutex> lock((*in_flight_requests)->mu);
+      (*in_flight_requests)->requests.erase(request);
+    }
     LOG_IF_ERROR(
         TRITONSERVER_InferenceRequestDelete(request),
         "Failed to delete inference request.");
   }
+  delete in_flight_requests;
 }
 
 void
@@ -173,10 +182,7 @@ ResponseAlloc(
     void** buffer_userp, TRITONSERVER_MemoryType* actual_memory_type,
     int64_t* actual_memory_type_id)
 {
-  std::unique_ptr<SharedMemoryManager> shm_pool(
-      reinterpret_cast<SharedMemoryManager*>(userp));
-
-  ScopedDefer _([&shm_pool] { shm_pool.release(); });
+  OutputArena* output_arena = reinterpret_cast<OutputArena*>(userp);
   *actual_memory_type = preferred_memory_type;
   *actual_memory_type_id = preferred_memory_type_id;
 
@@ -195,9 +201,8 @@ ResponseAlloc(
         *actual_memory_type = TRITONSERVER_MEMORY_CPU;
         *actual_memory_type_id = 0;
         try {
-          std::unique_ptr<PbMemory> pb_memory = PbMemory::Create(
-              shm_pool, *actual_memory_type, *actual_memory_type_id, byte_size,
-              nullptr /* data */, false /* copy_gpu */);
+          std::unique_ptr<PbMemory> pb_memory =
+              output_arena->Allocate(tensor_name, byte_size);
           *buffer = pb_memory->DataPtr();
           *buffer_userp = reinterpret_cast<void*>(pb_memory.get());
           pb_memory.release();
@@ -222,6 +227,17 @@ ResponseAlloc(
                   .c_str());
         }
 
+        // The outputs in the CUDA shared pool are passed to the stub process
+        // without opening a CUDA IPC handle. They are released by the memory
+        // manager like the other GPU outputs.
+        CudaSharedPool* cuda_pool =
+            CudaSharedPool::Find(*actual_memory_type_id);
+        *buffer = cuda_pool != nullptr ? cuda_pool->Allocate(byte_size)
+                                       : nullptr;
+        if (*buffer != nullptr) {
+          break;
+        }
+
         err = cudaMalloc(buffer, byte_size);
         if (err != cudaSuccess) {
           return TRITONSERVER_ErrorNew(
@@ -259,9 +275,276 @@ ResponseRelease(
   return nullptr;  // Success
 }
 
+OutputArena::OutputArena(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const std::unordered_map<std::string, uint64_t>& expected_output_byte_sizes)
+    : shm_pool_(shm_pool),
+      expected_output_byte_sizes_(expected_output_byte_sizes),
+      arena_byte_size_(0)
+{
+  // Align every output to a cache line.
+  constexpr uint64_t kAlignment = 64;
+  for (auto& expected_output_byte_size : expected_output_byte_sizes_) {
+    output_offsets_[expected_output_byte_size.first] = arena_byte_size_;
+    arena_byte_size_ += (expected_output_byte_size.second + kAlignment - 1) /
+                        kAlignment * kAlignment;
+  }
+}
+
+std::unique_ptr<PbMemory>
+OutputArena::Allocate(const std::string& output_name, const uint64_t byte_size)
+{
+  auto expected_output_byte_size =
+      expected_output_byte_sizes_.find(output_name);
+  if (expected_output_byte_size == expected_output_byte_sizes_.end() ||
+      byte_size > expected_output_byte_size->second) {
+    return PbMemory::Create(
+        shm_pool_, TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */, byte_size,
+        nullptr /* data */, false /* copy_gpu */);
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  // The output was already allocated from the current arena, which means
+  // that this is the output of the next response.
+  if (!arena_.data_ ||
+      allocated_outputs_.find(output_name) != allocated_outputs_.end()) {
+    arena_ = shm_pool_->Construct<char>(
+        arena_byte_size_, false /* aligned */, ShmObjectType::kMemory);
+    allocated_outputs_.clear();
+  }
+  allocated_outputs_.insert(output_name);
+
+  // The memory keeps a reference to the arena, so the arena is released
+  // once all of its outputs are released.
+  return PbMemory::Create(
+      shm_pool_, arena_.handle_, output_offsets_[output_name], byte_size);
+}
+
+bool
+ModelMetadataCache::Find(const std::string& model_key, uint32_t* txn_flags)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  auto entry = entries_.find(model_key);
+  if (entry == entries_.end()) {
+    return false;
+  }
+  if (entry->second.expiry < std::chrono::steady_clock::now()) {
+    entries_.erase(entry);
+    return false;
+  }
+
+  *txn_flags = entry->second.txn_flags;
+  return true;
+}
+
+void
+ModelMetadataCache::Insert(
+    const std::string& model_key, const uint32_t txn_flags)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  entries_[model_key] = {
+      txn_flags, std::chrono::steady_clock::now() + std::chrono::seconds(1)};
+}
+
+void
+ModelMetadataCache::Erase(const std::string& model_key)
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  entries_.erase(model_key);
+}
+
+BLSResponseCache::BLSResponseCache(
+    std::unique_ptr<SharedMemoryManager>& shm_pool,
+    const uint64_t capacity_byte_size)
+    : shm_pool_(shm_pool), capacity_byte_size_(capacity_byte_size), hits_(0),
+      misses_(0), in_flight_hits_(0), byte_size_(0)
+{
+}
+
+std::string
+BLSResponseCache::Key(std::shared_ptr<InferRequest>& infer_request)
+{
+  // The responses of the requests of a sequence depend on the state of the
+  // sequence.
+  if (infer_request->CorrelationId() != 0 || infer_request->Flags() != 0) {
+    return "";
+  }
+
+  // The key holds the inputs instead of a hash of them so that the requests
+  // that only have the same hash are not mixed up.
+  std::string key = infer_request->ModelName();
+  key += '\0';
+  key += std::to_string(infer_request->ModelVersion());
+  key += '\0';
+  for (auto& requested_output_name : infer_request->RequestedOutputNames()) {
+    key += requested_output_name;
+    key += '\0';
+  }
+  for (auto& input : infer_request->Inputs()) {
+    if (!input->IsCPU()) {
+      return "";
+    }
+    TRITONSERVER_DataType dtype = input->TritonDtype();
+    uint64_t dim_count = input->Dims().size();
+    uint64_t byte_size = input->ByteSize();
+    key += '\0';
+    key += input->Name();
+    key += '\0';
+    key.append(reinterpret_cast<const char*>(&dtype), sizeof(dtype));
+    key.append(reinterpret_cast<const char*>(&dim_count), sizeof(dim_count));
+    key.append(
+        reinterpret_cast<const char*>(input->Dims().data()),
+        dim_count * sizeof(int64_t));
+    key.append(reinterpret_cast<const char*>(&byte_size), sizeof(byte_size));
+    key.append(reinterpret_cast<const char*>(input->DataPtr()), byte_size);
+  }
+
+  return key;
+}
+
+BLSResponseCache::LookupResult
+BLSResponseCache::Lookup(
+    const std::string& key, std::unique_ptr<InferResponse>& response,
+    std::shared_future<std::shared_ptr<CachedResponse>>& in_flight)
+{
+  std::shared_ptr<CachedResponse> cached_response;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto entry = entries_.find(key);
+    if (entry != entries_.end() &&
+        entry->second->response->expiry < std::chrono::steady_clock::now()) {
+      byte_size_ -= entry->second->response->byte_size;
+      lru_.erase(entry->second);
+      entries_.erase(entry);
+      entry = entries_.end();
+    }
+    if (entry != entries_.end()) {
+      lru_.splice(lru_.begin(), lru_, entry->second);
+      cached_response = entry->second->response;
+    } else {
+      auto in_flight_request = in_flight_.find(key);
+      if (in_flight_request != in_flight_.end()) {
+        in_flight_hits_++;
+        in_flight = in_flight_request->second.future;
+        return LookupResult::kInFlight;
+      }
+
+      misses_++;
+      InFlight& new_in_flight = in_flight_[key];
+      new_in_flight.future = new_in_flight.promise.get_future().share();
+      return LookupResult::kMiss;
+    }
+  }
+
+  // The copies of the outputs are created outside of the lock since they are
+  // allocated in the shared memory pool.
+  hits_++;
+  response = CreateResponse(*cached_response);
+  return LookupResult::kHit;
+}
+
+void
+BLSResponseCache::Complete(const std::string& key, InferResponse* response)
+{
+  std::shared_ptr<CachedResponse> cached_response;
+  if (response != nullptr && !response->HasError()) {
+    cached_response = std::make_shared<CachedResponse>();
+    cached_response->byte_size = key.size();
+    cached_response->expiry =
+        std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    try {
+      for (auto& output_tensor : response->OutputTensors()) {
+        CachedOutput output;
+        output.name = output_tensor->Name();
+        output.dims = output_tensor->Dims();
+        output.dtype = output_tensor->TritonDtype();
+        if (output_tensor->ByteSize() != 0) {
+          if (!output_tensor->IsCPU() || output_tensor->Memory() == nullptr) {
+            throw PythonBackendException(
+                "Only the outputs in the shared memory pool can be cached.");
+          }
+          // The response is handed to the stub, which may modify its
+          // outputs, so the cache can't share their memory.
+          output.memory = PbMemory::Create(
+              shm_pool_, TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+              output_tensor->ByteSize(), output_tensor->Memory()->DataPtr(),
+              false /* copy_gpu */);
+          cached_response->byte_size += output_tensor->ByteSize();
+        }
+        cached_response->outputs.emplace_back(std::move(output));
+      }
+    }
+    catch (const PythonBackendException& pb_exception) {
+      cached_response.reset();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mu_);
+  if (cached_response != nullptr &&
+      cached_response->byte_size <= capacity_byte_size_ &&
+      entries_.find(key) == entries_.end()) {
+    lru_.push_front({key, cached_response});
+    entries_[key] = lru_.begin();
+    byte_size_ += cached_response->byte_size;
+    while (byte_size_ > capacity_byte_size_) {
+      byte_size_ -= lru_.back().response->byte_size;
+      entries_.erase(lru_.back().key);
+      lru_.pop_back();
+    }
+  }
+
+  auto in_flight_request = in_flight_.find(key);
+  if (in_flight_request != in_flight_.end()) {
+    in_flight_request->second.promise.set_value(cached_response);
+    in_flight_.erase(in_flight_request);
+  }
+}
+
+std::unique_ptr<InferResponse>
+BLSResponseCache::CreateResponse(const CachedResponse& cached_response)
+{
+  std::vector<std::shared_ptr<PbTensor>> output_tensors;
+  for (auto& output : cached_response.outputs) {
+    if (output.memory == nullptr) {
+      output_tensors.push_back(std::make_shared<PbTensor>(
+          output.name, output.dims, output.dtype, TRITONSERVER_MEMORY_CPU,
+          0 /* memory_type_id */, nullptr /* memory_ptr */, 0 /* byte_size */,
+          nullptr /* DLManagedTensor */));
+      continue;
+    }
+
+    std::unique_ptr<PbMemory> memory = PbMemory::Create(
+        shm_pool_, TRITONSERVER_MEMORY_CPU, 0 /* memory_type_id */,
+        output.memory->ByteSize(), output.memory->DataPtr(),
+        false /* copy_gpu */);
+    std::shared_ptr<PbTensor> pb_tensor = std::make_shared<PbTensor>(
+        output.name, output.dims, output.dtype, TRITONSERVER_MEMORY_CPU,
+        0 /* memory_type_id */, memory->DataPtr(), memory->ByteSize(),
+        nullptr /* DLManagedTensor */);
+    pb_tensor->SetMemory(std::move(memory));
+    output_tensors.push_back(pb_tensor);
+  }
+
+  return std::make_unique<InferResponse>(output_tensors);
+}
+
+void
+BLSResponseCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(mu_);
+  entries_.clear();
+  lru_.clear();
+  byte_size_ = 0;
+}
+
 RequestExecutor::RequestExecutor(
-    std::unique_ptr<SharedMemoryManager>& shm_pool, TRITONSERVER_Server* server)
-    : server_(server), shm_pool_(shm_pool)
+    std::unique_ptr<SharedMemoryManager>& shm_pool, TRITONSERVER_Server* server,
+    ModelMetadataCache& model_metadata_cache, BLSResponseCache* response_cache,
+    const uint64_t deadline_ns)
+    : server_(server), shm_pool_(shm_pool),
+      model_metadata_cache_(model_metadata_cache),
+      response_cache_(response_cache), deadline_ns_(deadline_ns),
+      in_flight_requests_(std::make_shared<InFlightRequests>())
 {
   TRITONSERVER_ResponseAllocator* allocator;
   THROW_IF_TRITON_ERROR(TRITONSERVER_ResponseAllocatorNew(
@@ -274,29 +557,38 @@ RequestExecutor::RequestExecutor(
 std::future<std::unique_ptr<InferResponse>>
 RequestExecutor::Infer(
     std::shared_ptr<InferRequest>& infer_request,
-    std::shared_ptr<InferPayload>& infer_payload)
+    std::shared_ptr<InferPayload>& infer_payload, bool use_response_cache)
 {
   std::future<std::unique_ptr<InferResponse>> response_future;
   std::unique_ptr<InferResponse> infer_response;
   bool is_ready = false;
   const char* model_name = infer_request->ModelName().c_str();
   TRITONSERVER_InferenceRequest* irequest = nullptr;
+  int64_t model_version = infer_request->ModelVersion();
+  std::string model_key =
+      infer_request->ModelName() + ":" + std::to_string(model_version);
+  std::string cache_key;
+  std::shared_ptr<InFlightRequests>* request_release_userp = nullptr;
 
   try {
-    int64_t model_version = infer_request->ModelVersion();
-    THROW_IF_TRITON_ERROR(TRITONSERVER_ServerModelIsReady(
-        server_, model_name, model_version, &is_ready));
+    uint32_t txn_flags;
+    if (!model_metadata_cache_.Find(model_key, &txn_flags)) {
+      THROW_IF_TRITON_ERROR(TRITONSERVER_ServerModelIsReady(
+          server_, model_name, model_version, &is_ready));
+
+      if (!is_ready) {
+        throw PythonBackendException(
+            (std::string("Failed for execute the inference request. Model '") +
+             model_name + "' is not ready.")
+                .c_str());
+      }
 
-    if (!is_ready) {
-      throw PythonBackendException(
-          (std::string("Failed for execute the inference request. Model '") +
-           model_name + "' is not ready.")
-              .c_str());
+      THROW_IF_TRITON_ERROR(TRITONSERVER_ServerModelTransactionProperties(
+          server_, model_name, model_version, &txn_flags,
+          nullptr /* voidp */));
+      model_metadata_cache_.Insert(model_key, txn_flags);
     }
 
-    uint32_t txn_flags;
-    THROW_IF_TRITON_ERROR(TRITONSERVER_ServerModelTransactionProperties(
-        server_, model_name, model_version, &txn_flags, nullptr /* voidp */));
     infer_request->SetIsDecoupled(
         (txn_flags & TRITONSERVER_TXN_DECOUPLED) != 0);
 
@@ -310,6 +602,70 @@ RequestExecutor::Infer(
           "models.'");
     }
 
+    // Don't send the request if the request that sent it won't be able to
+    // use its response, and don't let it wait in the queue of the model after
+    // the deadline.
+    uint64_t timeout_us = infer_request->Timeout();
+    if (deadline_ns_ != 0) {
+      uint64_t now_ns = 0;
+      SET_TIMESTAMP(now_ns);
+      if (now_ns >= deadline_ns_) {
+        throw PythonBackendException(
+            "The deadline of the request that sent the BLS request has "
+            "passed.");
+      }
+      uint64_t remaining_us =
+          std::max<uint64_t>((deadline_ns_ - now_ns) / 1000, 1);
+      if (timeout_us == 0 || timeout_us > remaining_us) {
+        timeout_us = remaining_us;
+      }
+    }
+
+    if (use_response_cache && response_cache_ != nullptr &&
+        !infer_payload->IsDecoupled() && !infer_request->IsDecoupled()) {
+      std::string key = BLSResponseCache::Key(infer_request);
+      std::unique_ptr<InferResponse> cached_response;
+      std::shared_future<std::shared_ptr<BLSResponseCache::CachedResponse>>
+          in_flight;
+      BLSResponseCache::LookupResult result =
+          key.empty() ? BLSResponseCache::LookupResult::kMiss
+                      : response_cache_->Lookup(
+                            key, cached_response, in_flight);
+      if (result == BLSResponseCache::LookupResult::kHit) {
+        std::promise<std::unique_ptr<InferResponse>> promise;
+        promise.set_value(std::move(cached_response));
+        return promise.get_future();
+      }
+
+      if (result == BLSResponseCache::LookupResult::kInFlight) {
+        // The request is sent after all if the response of the identical
+        // request could not be cached. The caller keeps the payload alive
+        // until the future is ready.
+        std::shared_ptr<InferPayload>* payload = &infer_payload;
+        std::shared_ptr<InferRequest> request = infer_request;
+        return std::async(
+            std::launch::deferred,
+            [this, in_flight, request, payload]() mutable {
+              std::shared_ptr<BLSResponseCache::CachedResponse>
+                  cached_response = in_flight.get();
+              if (cached_response != nullptr) {
+                return response_cache_->CreateResponse(*cached_response);
+              }
+              return Infer(request, *payload, false /* use_response_cache */)
+                  .get();
+            });
+      }
+
+      if (!key.empty()) {
+        cache_key = key;
+        BLSResponseCache* response_cache = response_cache_;
+        infer_payload->SetCompletionCallback(
+            [response_cache, key](InferResponse* response) {
+              response_cache->Complete(key, response);
+            });
+      }
+    }
+
     // Inference
     THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceRequestNew(
         &irequest, server_, model_name, model_version));
@@ -324,10 +680,16 @@ RequestExecutor::Infer(
         irequest, infer_request->Flags()));
 
     THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceRequestSetTimeoutMicroseconds(
-        irequest, infer_request->Timeout()));
+        irequest, timeout_us));
 
+    THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceRequestSetPriority(
+        irequest, infer_request->Priority()));
+
+    request_release_userp =
+        new std::shared_ptr<InFlightRequests>(in_flight_requests_);
     THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceRequestSetReleaseCallback(
-        irequest, InferRequestComplete, nullptr /* request_release_userp */));
+        irequest, InferRequestComplete,
+        reinterpret_cast<void*>(request_release_userp)));
 
     for (auto& infer_input : infer_request->Inputs()) {
       THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceRequestAddInput(
@@ -349,15 +711,44 @@ RequestExecutor::Infer(
     {
       infer_payload->SetFuture(response_future);
 
+      output_arenas_.emplace_back(std::make_unique<OutputArena>(
+          shm_pool_, infer_request->ExpectedOutputByteSizes()));
       THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceRequestSetResponseCallback(
-          irequest, response_allocator_, shm_pool_.get(), InferResponseComplete,
-          reinterpret_cast<void*>(&infer_payload)));
+          irequest, response_allocator_, output_arenas_.back().get(),
+          InferResponseComplete, reinterpret_cast<void*>(&infer_payload)));
+
+      // The BLS request is traced as a child of the request that sent it.
+      // Triton releases the child trace with the inference request.
+      TRITONSERVER_InferenceTrace* trace = nullptr;
+      if (infer_request->TraceAddress() != 0) {
+        THROW_IF_TRITON_ERROR(TRITONSERVER_InferenceTraceSpawnChildTrace(
+            reinterpret_cast<TRITONSERVER_InferenceTrace*>(
+                infer_request->TraceAddress()),
+            &trace));
+      }
 
-      THROW_IF_TRITON_ERROR(TRITONSERVER_ServerInferAsync(
-          server_, irequest, nullptr /* trace */));
+      {
+        std::lock_guard<std::mutex> lock(in_flight_requests_->mu);
+        in_flight_requests_->requests.insert(irequest);
+      }
+      THROW_IF_TRITON_ERROR(
+          TRITONSERVER_ServerInferAsync(server_, irequest, trace));
     }
   }
   catch (const PythonBackendException& pb_exception) {
+    // The model may have been unloaded or reloaded with a different
+    // transaction policy.
+    model_metadata_cache_.Erase(model_key);
+    // Let the identical requests that wait for this one send themselves.
+    if (!cache_key.empty()) {
+      response_cache_->Complete(cache_key, nullptr);
+    }
+    // Triton doesn't release the requests that it failed to accept.
+    {
+      std::lock_guard<std::mutex> lock(in_flight_requests_->mu);
+      in_flight_requests_->requests.erase(irequest);
+    }
+    delete request_release_userp;
     LOG_IF_ERROR(
         TRITONSERVER_InferenceRequestDelete(irequest),
         "Failed to delete inference request.");
@@ -370,6 +761,17 @@ RequestExecutor::Infer(
   return response_future;
 }
 
+void
+RequestExecutor::Cancel()
+{
+  std::lock_guard<std::mutex> lock(in_flight_requests_->mu);
+  for (TRITONSERVER_InferenceRequest* request : in_flight_requests_->requests) {
+    LOG_IF_ERROR(
+        TRITONSERVER_InferenceRequestCancel(request),
+        "Failed to cancel inference request.");
+  }
+}
+
 RequestExecutor::~RequestExecutor()
 {
   if (response_allocator_ != nullptr) {
@@ -26,7 +26,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include "infer_payload.h"
 #include "infer_request.h"
 #include "infer_response.h"
@@ -36,19 +44,205 @@ namespace triton { namespace backend { namespace python {
 TRITONSERVER_Error* CreateTritonErrorFromException(
     const PythonBackendException& pb_exception);
 
+//
+// Transaction flags of the models that are ready to receive BLS requests,
+// keyed by model name and version. The backend API doesn't notify backends
+// about model loads and unloads, so the entries expire after a second and are
+// removed when a request to the model fails.
+//
+class ModelMetadataCache {
+ public:
+  // Returns false if the model is not in the cache.
+  bool Find(const std::string& model_key, uint32_t* txn_flags);
+  void Insert(const std::string& model_key, const uint32_t txn_flags);
+  void Erase(const std::string& model_key);
+
+ private:
+  struct Entry {
+    uint32_t txn_flags;
+    std::chrono::steady_clock::time_point expiry;
+  };
+
+  std::mutex mu_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+//
+// Allocates the CPU outputs of the responses of a BLS request. The outputs
+// with an expected byte size are placed in a single allocation of the shared
+// memory pool that holds all of them, which is replaced when a response of a
+// decoupled model reuses an output.
+//
+class OutputArena {
+ public:
+  OutputArena(
+      std::unique_ptr<SharedMemoryManager>& shm_pool,
+      const std::unordered_map<std::string, uint64_t>&
+          expected_output_byte_sizes);
+
+  /// Allocate the memory of an output.
+  /// \param output_name The name of the output.
+  /// \param byte_size The byte size of the output.
+  /// \return The memory, which refers to the arena if the output fits in the
+  /// space reserved for it.
+  std::unique_ptr<PbMemory> Allocate(
+      const std::string& output_name, const uint64_t byte_size);
+
+ private:
+  std::unique_ptr<SharedMemoryManager>& shm_pool_;
+  std::unordered_map<std::string, uint64_t> expected_output_byte_sizes_;
+  std::unordered_map<std::string, uint64_t> output_offsets_;
+  uint64_t arena_byte_size_;
+
+  std::mutex mu_;
+  AllocatedSharedMemory<char> arena_;
+  std::unordered_set<std::string> allocated_outputs_;
+};
+
+//
+// Responses of the BLS requests to models that are not decoupled, keyed by
+// the model, the inputs and the requested outputs. The cache keeps its own
+// copy of the outputs in the shared memory pool of the stub process and every
+// response created from it gets a copy of them, so the stub can't modify the
+// cached outputs in place. A request that is identical to a request in flight
+// waits for the response of that request instead of being sent to Triton.
+// The backend isn't notified when a model is reloaded, so the responses expire
+// after a second like the entries of ModelMetadataCache. The least recently
+// used responses are evicted when the inputs and outputs of the cached
+// responses exceed the capacity.
+//
+class BLSResponseCache {
+ public:
+  struct CachedOutput {
+    std::string name;
+    std::vector<int64_t> dims;
+    TRITONSERVER_DataType dtype;
+    // nullptr if the output is empty.
+    std::unique_ptr<PbMemory> memory;
+  };
+
+  struct CachedResponse {
+    std::vector<CachedOutput> outputs;
+    uint64_t byte_size;
+    std::chrono::steady_clock::time_point expiry;
+  };
+
+  enum class LookupResult { kHit, kMiss, kInFlight };
+
+  BLSResponseCache(
+      std::unique_ptr<SharedMemoryManager>& shm_pool,
+      const uint64_t capacity_byte_size);
+
+  /// Get the key of a request.
+  /// \return The key, or an empty string if the request can't be cached, e.g.
+  /// because it has GPU inputs or belongs to a sequence.
+  static std::string Key(std::shared_ptr<InferRequest>& infer_request);
+
+  /// Look up the response of a request.
+  /// \return kHit if the response is cached and has been copied to
+  /// 'response'. kInFlight if an identical request is in flight, its result
+  /// is returned by 'in_flight' and is nullptr if the response could not be
+  /// cached. kMiss if the request must be sent, in which case 'Complete' must
+  /// be called with its response.
+  LookupResult Lookup(
+      const std::string& key, std::unique_ptr<InferResponse>& response,
+      std::shared_future<std::shared_ptr<CachedResponse>>& in_flight);
+
+  /// Store the response of the request that missed the cache and pass it to
+  /// the identical requests that are waiting for it.
+  /// \param response The response, or nullptr if the request failed.
+  void Complete(const std::string& key, InferResponse* response);
+
+  /// Create a response with a copy of the outputs of a cached response.
+  std::unique_ptr<InferResponse> CreateResponse(
+      const CachedResponse& cached_response);
+
+  /// Release the cached responses. Must be called before the shared memory
+  /// pool is destroyed.
+  void Clear();
+
+  uint64_t Hits() { return hits_.load(std::memory_order_relaxed); }
+  uint64_t Misses() { return misses_.load(std::memory_order_relaxed); }
+  uint64_t InFlightHits()
+  {
+    return in_flight_hits_.load(std::memory_order_relaxed);
+  }
+  uint64_t ByteSize() { return byte_size_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<CachedResponse> response;
+  };
+
+  struct InFlight {
+    std::promise<std::shared_ptr<CachedResponse>> promise;
+    std::shared_future<std::shared_ptr<CachedResponse>> future;
+  };
+
+  std::unique_ptr<SharedMemoryManager>& shm_pool_;
+  const uint64_t capacity_byte_size_;
+
+  std::mutex mu_;
+  // The most recently used entry is at the front.
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+  std::unordered_map<std::string, InFlight> in_flight_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> in_flight_hits_;
+  std::atomic<uint64_t> byte_size_;
+};
+
+// The requests sent by an executor that Triton has not released yet. It is
+// shared with the release callbacks of the requests since they may be called
+// after the executor is destroyed.
+struct InFlightRequests {
+  std::mutex mu;
+  std::unordered_set<TRITONSERVER_InferenceRequest*> requests;
+};
+
 class RequestExecutor {
   TRITONSERVER_ResponseAllocator* response_allocator_ = nullptr;
   TRITONSERVER_Server* server_;
   std::unique_ptr<SharedMemoryManager>& shm_pool_;
+  ModelMetadataCache& model_metadata_cache_;
+  // nullptr if the BLS responses are not cached.
+  BLSResponseCache* response_cache_;
+  // Steady clock time in nanoseconds after which the requests are not sent
+  // anymore. Zero if the requests have no deadline.
+  uint64_t deadline_ns_;
+  std::shared_ptr<InFlightRequests> in_flight_requests_;
+  // The allocators of the outputs of the requests that were executed. They
+  // stay alive until the executor is destroyed since the server may allocate
+  // the outputs until the final response is received.
+  std::vector<std::unique_ptr<OutputArena>> output_arenas_;
 
  public:
+  /// Send a BLS request to Triton. 'infer_payload' must stay alive until the
+  /// future is ready.
+  /// \param use_response_cache Whether the response may be taken from or
+  /// stored in the response cache of the executor.
   std::future<std::unique_ptr<InferResponse>> Infer(
       std::shared_ptr<InferRequest>& infer_request,
-      std::shared_ptr<InferPayload>& infer_payload);
+      std::shared_ptr<InferPayload>& infer_payload,
+      bool use_response_cache = true);
+
+  /// Cancel the requests that have been sent and have not been released by
+  /// Triton yet. Their futures are ready once Triton has responded with the
+  /// cancellation error.
+  void Cancel();
 
+  /// \param deadline_ns The steady clock time in nanoseconds after which the
+  /// requests are not sent anymore. The timeout of the requests is reduced so
+  /// that they don't wait in the queue of the model past the deadline. Zero if
+  /// the requests have no deadline.
   RequestExecutor(
       std::unique_ptr<SharedMemoryManager>& shm_pool,
-      TRITONSERVER_Server* server);
+      TRITONSERVER_Server* server, ModelMetadataCache& model_metadata_cache,
+      BLSResponseCache* response_cache = nullptr,
+      const uint64_t deadline_ns = 0);
 
   ~RequestExecutor();
 };
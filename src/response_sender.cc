@@ -25,6 +25,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "response_sender.h"
+#include <exception>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include "pb_stub.h"
@@ -35,13 +36,73 @@ namespace triton { namespace backend { namespace python {
 
 ResponseSender::ResponseSender(
     intptr_t request_address, intptr_t response_factory_address,
+    const std::set<std::string>& requested_output_names,
     std::unique_ptr<SharedMemoryManager>& shm_pool)
     : request_address_(request_address),
-      response_factory_address_(response_factory_address), shm_pool_(shm_pool),
+      response_factory_address_(response_factory_address),
+      requested_output_names_(requested_output_names), shm_pool_(shm_pool),
       closed_(false)
 {
 }
 
+ResponseSender::~ResponseSender()
+{
+  // The parent process may still be reading the pending responses.
+  while (!pending_responses_.empty()) {
+    try {
+      WaitForPendingResponse();
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_INFO << "Failed to send a response: " << pb_exception.what();
+    }
+  }
+}
+
+void
+ResponseSender::WaitForPendingResponse()
+{
+  PendingResponse pending_response = std::move(pending_responses_.front());
+  pending_responses_.pop_front();
+
+  ResponseSendMessage* send_message_payload =
+      pending_response.send_message.data_.get();
+  {
+    bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->mu};
+    while (!send_message_payload->is_stub_turn) {
+      send_message_payload->cv.wait(guard);
+    }
+  }
+
+  if (send_message_payload->has_error) {
+    if (send_message_payload->is_error_set) {
+      std::unique_ptr<PbString> error = PbString::LoadFromSharedMemory(
+          shm_pool_, send_message_payload->error);
+      throw PythonBackendException(error->String());
+    } else {
+      throw PythonBackendException(
+          "An error occurred while sending a response.");
+    }
+  }
+}
+
+void
+ResponseSender::ReapPendingResponses(const size_t max_pending)
+{
+  while (!pending_responses_.empty()) {
+    ResponseSendMessage* send_message_payload =
+        pending_responses_.front().send_message.data_.get();
+    bool is_sent;
+    {
+      bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->mu};
+      is_sent = send_message_payload->is_stub_turn;
+    }
+
+    if (!is_sent && pending_responses_.size() <= max_pending) {
+      break;
+    }
+    WaitForPendingResponse();
+  }
+}
 
 void
 ResponseSender::Send(
@@ -70,9 +131,44 @@ ResponseSender::Send(
 
   std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
 
+  bool has_gpu_output = false;
+  std::vector<std::shared_ptr<PbTensor>> gpu_tensors;
+  if (infer_response) {
+    infer_response->PruneOutputTensors(requested_output_names_);
+    for (auto& tensor : infer_response->OutputTensors()) {
+      if (!tensor->IsCPU()) {
+        has_gpu_output = true;
+        gpu_tensors.push_back(tensor);
+      }
+    }
+  }
+
+  // Responses with GPU outputs need an additional round trip to fill the
+  // output buffers, and the final response must be sent after all the other
+  // responses of the request.
+  const uint32_t send_window = stub->DecoupledSendWindow();
+  const bool is_async = send_window > 0 && infer_response != nullptr &&
+                        !has_gpu_output &&
+                        flags != TRITONSERVER_RESPONSE_COMPLETE_FINAL;
+  std::exception_ptr pending_error;
+  if (is_async) {
+    ReapPendingResponses(send_window - 1 /* max_pending */);
+  } else if (flags == TRITONSERVER_RESPONSE_COMPLETE_FINAL) {
+    // Send the final response even if one of the pending responses failed so
+    // that the request is released.
+    try {
+      ReapPendingResponses(0 /* max_pending */);
+    }
+    catch (const PythonBackendException&) {
+      pending_error = std::current_exception();
+    }
+  } else {
+    ReapPendingResponses(0 /* max_pending */);
+  }
+
   AllocatedSharedMemory<ResponseSendMessage> response_send_message =
       shm_pool_->Construct<ResponseSendMessage>(
-          1 /* count */, true /* aligned */);
+          1 /* count */, true /* aligned */, ShmObjectType::kResponseSend);
 
   if (infer_response) {
     infer_response->SaveToSharedMemory(shm_pool_, false /* copy_gpu */);
@@ -95,6 +191,8 @@ ResponseSender::Send(
   send_message_payload->has_error = false;
   send_message_payload->is_error_set = false;
   send_message_payload->flags = flags;
+  send_message_payload->is_async = is_async;
+  send_message_payload->response_count = 0;
 
   std::unique_ptr<IPCMessage> ipc_message =
       IPCMessage::Create(shm_pool_, false /* inline_response */);
@@ -102,6 +200,14 @@ ResponseSender::Send(
   ipc_message->Command() = PYTHONSTUB_ResponseSend;
   ipc_message->Args() = response_send_message.handle_;
 
+  if (is_async) {
+    stub->SendIPCMessage(ipc_message);
+    pending_responses_.push_back(
+        {std::move(response_send_message), std::move(ipc_message),
+         infer_response});
+    return;
+  }
+
   ScopedDefer _([send_message_payload] {
     {
       bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->mu};
@@ -118,17 +224,6 @@ ResponseSender::Send(
     }
   }
 
-  bool has_gpu_output = false;
-  std::vector<std::shared_ptr<PbTensor>> gpu_tensors;
-  if (infer_response) {
-    for (auto& tensor : infer_response->OutputTensors()) {
-      if (!tensor->IsCPU()) {
-        has_gpu_output = true;
-        gpu_tensors.push_back(tensor);
-      }
-    }
-  }
-
   if (has_gpu_output) {
     AllocatedSharedMemory<char> gpu_buffers_handle =
         shm_pool_->Load<char>(send_message_payload->gpu_buffers_handle);
@@ -179,5 +274,137 @@ ResponseSender::Send(
           "An error occurred while sending a response.");
     }
   }
+
+  if (pending_error) {
+    std::rethrow_exception(pending_error);
+  }
+}
+
+void
+ResponseSender::SendMany(
+    const std::vector<std::shared_ptr<InferResponse>>& infer_responses,
+    const uint32_t flags)
+{
+  bool has_gpu_output = false;
+  for (auto& infer_response : infer_responses) {
+    if (infer_response == nullptr) {
+      throw PythonBackendException(
+          "Unable to send responses. Inference Response object must be "
+          "provided for each response.");
+    }
+    for (auto& tensor : infer_response->OutputTensors()) {
+      if (!tensor->IsCPU()) {
+        has_gpu_output = true;
+      }
+    }
+  }
+
+  // The GPU output buffers of each response are filled in a separate round
+  // trip, so these responses are sent one at a time.
+  if (has_gpu_output || infer_responses.size() <= 1) {
+    if (infer_responses.empty()) {
+      Send(nullptr, flags);
+      return;
+    }
+    for (size_t i = 0; i < infer_responses.size(); ++i) {
+      Send(
+          infer_responses[i],
+          i == infer_responses.size() - 1 ? flags : 0 /* flags */);
+    }
+    return;
+  }
+
+  if (closed_) {
+    throw PythonBackendException(
+        "Unable to send response. Response sender has been closed.");
+  }
+
+  if (flags != TRITONSERVER_RESPONSE_COMPLETE_FINAL && flags != 0) {
+    throw PythonBackendException(
+        "Unable to send response. Unsupported flag provided.");
+  }
+
+  if (flags == TRITONSERVER_RESPONSE_COMPLETE_FINAL) {
+    closed_ = true;
+  }
+
+  std::exception_ptr pending_error;
+  try {
+    ReapPendingResponses(0 /* max_pending */);
+  }
+  catch (const PythonBackendException&) {
+    if (flags != TRITONSERVER_RESPONSE_COMPLETE_FINAL) {
+      throw;
+    }
+    pending_error = std::current_exception();
+  }
+
+  std::unique_ptr<Stub>& stub = Stub::GetOrCreateInstance();
+
+  AllocatedSharedMemory<ResponseSendMessage> response_send_message =
+      shm_pool_->Construct<ResponseSendMessage>(
+          1 /* count */, true /* aligned */, ShmObjectType::kResponseSend);
+  AllocatedSharedMemory<bi::managed_external_buffer::handle_t>
+      response_handles =
+          shm_pool_->Construct<bi::managed_external_buffer::handle_t>(
+              infer_responses.size());
+
+  for (size_t i = 0; i < infer_responses.size(); ++i) {
+    infer_responses[i]->PruneOutputTensors(requested_output_names_);
+    infer_responses[i]->SaveToSharedMemory(shm_pool_, false /* copy_gpu */);
+    response_handles.data_.get()[i] = infer_responses[i]->ShmHandle();
+  }
+
+  ResponseSendMessage* send_message_payload = response_send_message.data_.get();
+  new (&(send_message_payload->mu)) bi::interprocess_mutex;
+  new (&(send_message_payload->cv)) bi::interprocess_condition;
+
+  send_message_payload->is_stub_turn = false;
+  send_message_payload->request_address = request_address_;
+  send_message_payload->response_factory_address = response_factory_address_;
+  send_message_payload->response = 0;
+  send_message_payload->has_error = false;
+  send_message_payload->is_error_set = false;
+  send_message_payload->flags = flags;
+  send_message_payload->is_async = false;
+  send_message_payload->responses = response_handles.handle_;
+  send_message_payload->response_count = infer_responses.size();
+
+  std::unique_ptr<IPCMessage> ipc_message =
+      IPCMessage::Create(shm_pool_, false /* inline_response */);
+
+  ipc_message->Command() = PYTHONSTUB_ResponseSend;
+  ipc_message->Args() = response_send_message.handle_;
+
+  ScopedDefer _([send_message_payload] {
+    {
+      bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->mu};
+      send_message_payload->is_stub_turn = false;
+      send_message_payload->cv.notify_all();
+    }
+  });
+
+  {
+    bi::scoped_lock<bi::interprocess_mutex> guard{send_message_payload->mu};
+    stub->SendIPCMessage(ipc_message);
+    while (!send_message_payload->is_stub_turn) {
+      send_message_payload->cv.wait(guard);
+    }
+  }
+
+  if (send_message_payload->has_error) {
+    if (send_message_payload->is_error_set) {
+      std::unique_ptr<PbString> error = PbString::LoadFromSharedMemory(
+          shm_pool_, send_message_payload->error);
+      throw PythonBackendException(error->String());
+    } else {
+      throw PythonBackendException(
+          "An error occurred while sending a response.");
+    }
+  }
+
+  if (pending_error) {
+    std::rethrow_exception(pending_error);
+  }
 }
 }}}  // namespace triton::backend::python
@@ -26,7 +26,11 @@
 
 #pragma once
 
+#include <deque>
+#include <set>
+#include <string>
 #include "infer_response.h"
+#include "pb_utils.h"
 #include "shm_manager.h"
 
 namespace triton { namespace backend { namespace python {
@@ -35,13 +39,43 @@ class ResponseSender {
  public:
   ResponseSender(
       intptr_t request_address, intptr_t response_factory_address,
+      const std::set<std::string>& requested_output_names,
       std::unique_ptr<SharedMemoryManager>& shm_pool);
+  ~ResponseSender();
   void Send(std::shared_ptr<InferResponse> response, const uint32_t flags);
 
+  /// Send several responses of the request in one message to the parent
+  /// process. 'flags' is sent together with the last response.
+  void SendMany(
+      const std::vector<std::shared_ptr<InferResponse>>& responses,
+      const uint32_t flags);
+
+  /// Whether the final response of the request has been sent.
+  bool IsClosed() const { return closed_; }
+
  private:
+  // A response that was sent without waiting for the parent process.
+  struct PendingResponse {
+    AllocatedSharedMemory<ResponseSendMessage> send_message;
+    std::unique_ptr<IPCMessage> ipc_message;
+    std::shared_ptr<InferResponse> response;
+  };
+
+  /// Wait for the oldest pending response to be sent and throw its error if
+  /// any.
+  void WaitForPendingResponse();
+
+  /// Remove the pending responses that have been sent. If 'max_pending' is
+  /// specified, wait until at most 'max_pending' responses are pending.
+  void ReapPendingResponses(const size_t max_pending);
+
   intptr_t request_address_;
   intptr_t response_factory_address_;
+  // The outputs that are not requested are removed from the responses before
+  // they are saved to shared memory.
+  std::set<std::string> requested_output_names_;
   std::unique_ptr<SharedMemoryManager>& shm_pool_;
   bool closed_;
+  std::deque<PendingResponse> pending_responses_;
 };
 }}}  // namespace triton::backend::python
@@ -0,0 +1,298 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "sequence_state.h"
+
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <cstring>
+#include "pb_exception.h"
+
+namespace triton { namespace backend { namespace python {
+
+// Bytes of the region used by the managed buffer for the names of the
+// objects and the headers of the allocations, on top of the states.
+constexpr uint64_t kSequenceStateRegionOverhead = 64 * 1024;
+constexpr uint64_t kSequenceStateAllocationOverhead = 64;
+
+SequenceStateStore::SequenceStateStore(
+    const std::string& region_name, bool create)
+    : region_name_(region_name), create_(create), header_(nullptr),
+      entries_(nullptr)
+{
+}
+
+std::unique_ptr<SequenceStateStore>
+SequenceStateStore::Create(
+    const std::string& region_name, uint64_t byte_size, uint32_t max_entries)
+{
+  std::unique_ptr<SequenceStateStore> store(
+      new SequenceStateStore(region_name, true /* create */));
+  uint64_t region_size =
+      byte_size + sizeof(SequenceStateHeader) +
+      max_entries *
+          (sizeof(SequenceStateEntry) + kSequenceStateAllocationOverhead) +
+      kSequenceStateRegionOverhead;
+
+  try {
+    bi::shared_memory_object::remove(region_name.c_str());
+    store->shm_obj_ = std::make_unique<bi::shared_memory_object>(
+        bi::create_only, region_name.c_str(), bi::read_write);
+    store->shm_obj_->truncate(region_size);
+    store->shm_map_ =
+        std::make_unique<bi::mapped_region>(*store->shm_obj_, bi::read_write);
+    store->managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
+        bi::create_only, store->shm_map_->get_address(), region_size);
+    store->header_ =
+        store->managed_buffer_->construct<SequenceStateHeader>(
+            "sequence state header")();
+    store->entries_ =
+        store->managed_buffer_->construct<SequenceStateEntry>(
+            "sequence state entries")[max_entries]();
+  }
+  catch (bi::interprocess_exception& ex) {
+    throw PythonBackendException(
+        "Unable to create the sequence state region '" + region_name +
+        "' of " + std::to_string(region_size) + " bytes. Error: " + ex.what());
+  }
+
+  store->header_->clock = 0;
+  store->header_->byte_size = byte_size;
+  store->header_->used_bytes = 0;
+  store->header_->max_entries = max_entries;
+
+  return store;
+}
+
+std::unique_ptr<SequenceStateStore>
+SequenceStateStore::Open(const std::string& region_name)
+{
+  std::unique_ptr<SequenceStateStore> store(
+      new SequenceStateStore(region_name, false /* create */));
+  try {
+    store->shm_obj_ = std::make_unique<bi::shared_memory_object>(
+        bi::open_only, region_name.c_str(), bi::read_write);
+    store->shm_map_ =
+        std::make_unique<bi::mapped_region>(*store->shm_obj_, bi::read_write);
+    store->managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
+        bi::open_only, store->shm_map_->get_address(),
+        store->shm_map_->get_size());
+    store->header_ = store->managed_buffer_
+                         ->find<SequenceStateHeader>("sequence state header")
+                         .first;
+    store->entries_ = store->managed_buffer_
+                          ->find<SequenceStateEntry>("sequence state entries")
+                          .first;
+  }
+  catch (bi::interprocess_exception& ex) {
+    throw PythonBackendException(
+        "Unable to open the sequence state region '" + region_name +
+        "'. Error: " + ex.what());
+  }
+
+  if (store->header_ == nullptr || store->entries_ == nullptr) {
+    throw PythonBackendException(
+        "The sequence state region '" + region_name +
+        "' has not been initialized.");
+  }
+
+  // A previous stub process may have been killed while holding the mutex or
+  // the pins of the states. The parent process doesn't use the states, so
+  // this process is the only user of the store from now on.
+  new (&store->header_->mutex) bi::interprocess_mutex();
+  for (uint32_t i = 0; i < store->header_->max_entries; i++) {
+    SequenceStateEntry& entry = store->entries_[i];
+    if (entry.in_use) {
+      entry.pin_count = 0;
+      if (entry.ended) {
+        store->FreeEntry(entry);
+      }
+    }
+  }
+
+  return store;
+}
+
+void*
+SequenceStateStore::Acquire(
+    uint64_t correlation_id, const std::string& name, uint64_t byte_size,
+    uint32_t* entry, bool* created)
+{
+  if (name.size() >= kSequenceStateMaxNameLength) {
+    throw PythonBackendException(
+        "The name of sequence state '" + name + "' must be shorter than " +
+        std::to_string(kSequenceStateMaxNameLength) + " characters.");
+  }
+  if (byte_size > header_->byte_size) {
+    throw PythonBackendException(
+        "Sequence state '" + name + "' of " + std::to_string(byte_size) +
+        " bytes is larger than the sequence state store (" +
+        std::to_string(header_->byte_size) + " bytes).");
+  }
+
+  bi::scoped_lock<bi::interprocess_mutex> lock(header_->mutex);
+  header_->clock++;
+
+  // The states of an ended sequence are not returned since the correlation
+  // ID may already be used by a new sequence.
+  for (uint32_t i = 0; i < header_->max_entries; i++) {
+    SequenceStateEntry& state = entries_[i];
+    if (!state.in_use || state.ended ||
+        state.correlation_id != correlation_id || name != state.name) {
+      continue;
+    }
+    if (state.byte_size != byte_size) {
+      throw PythonBackendException(
+          "Sequence state '" + name + "' of correlation ID " +
+          std::to_string(correlation_id) + " has " +
+          std::to_string(state.byte_size) + " bytes, requested " +
+          std::to_string(byte_size) + " bytes.");
+    }
+    state.last_used = header_->clock;
+    state.pin_count++;
+    *entry = i;
+    *created = false;
+    return managed_buffer_->get_address_from_handle(state.handle);
+  }
+
+  void* data = nullptr;
+  while (data == nullptr) {
+    uint32_t free_entry = header_->max_entries;
+    for (uint32_t i = 0; i < header_->max_entries; i++) {
+      if (!entries_[i].in_use) {
+        free_entry = i;
+        break;
+      }
+    }
+
+    if (free_entry < header_->max_entries &&
+        header_->used_bytes + byte_size <= header_->byte_size) {
+      try {
+        data = managed_buffer_->allocate(byte_size);
+        *entry = free_entry;
+        break;
+      }
+      catch (bi::bad_alloc& ex) {
+        // The free memory of the region is fragmented, evict a state below.
+      }
+    }
+
+    if (!EvictLeastRecentlyUsed()) {
+      throw PythonBackendException(
+          "There is no room for sequence state '" + name +
+          "' of correlation ID " + std::to_string(correlation_id) +
+          " since all the states in the sequence state store are in use.");
+    }
+  }
+
+  std::memset(data, 0, byte_size);
+  SequenceStateEntry& state = entries_[*entry];
+  state.correlation_id = correlation_id;
+  std::strncpy(state.name, name.c_str(), kSequenceStateMaxNameLength);
+  state.handle = managed_buffer_->get_handle_from_address(data);
+  state.byte_size = byte_size;
+  state.last_used = header_->clock;
+  state.pin_count = 1;
+  state.in_use = true;
+  state.ended = false;
+  header_->used_bytes += byte_size;
+  *created = true;
+
+  return data;
+}
+
+void
+SequenceStateStore::Unpin(uint32_t entry)
+{
+  bi::scoped_lock<bi::interprocess_mutex> lock(header_->mutex);
+  SequenceStateEntry& state = entries_[entry];
+  if (state.pin_count > 0) {
+    state.pin_count--;
+  }
+  if (state.ended && state.pin_count == 0) {
+    FreeEntry(state);
+  }
+}
+
+void
+SequenceStateStore::EndSequence(uint64_t correlation_id)
+{
+  bi::scoped_lock<bi::interprocess_mutex> lock(header_->mutex);
+  for (uint32_t i = 0; i < header_->max_entries; i++) {
+    SequenceStateEntry& state = entries_[i];
+    if (!state.in_use || state.ended ||
+        state.correlation_id != correlation_id) {
+      continue;
+    }
+    if (state.pin_count == 0) {
+      FreeEntry(state);
+    } else {
+      state.ended = true;
+    }
+  }
+}
+
+void
+SequenceStateStore::FreeEntry(SequenceStateEntry& entry)
+{
+  managed_buffer_->deallocate(
+      managed_buffer_->get_address_from_handle(entry.handle));
+  header_->used_bytes -= entry.byte_size;
+  entry.in_use = false;
+  entry.ended = false;
+  entry.pin_count = 0;
+}
+
+bool
+SequenceStateStore::EvictLeastRecentlyUsed()
+{
+  SequenceStateEntry* least_recently_used = nullptr;
+  for (uint32_t i = 0; i < header_->max_entries; i++) {
+    SequenceStateEntry& state = entries_[i];
+    if (state.in_use && state.pin_count == 0 &&
+        (least_recently_used == nullptr ||
+         state.last_used < least_recently_used->last_used)) {
+      least_recently_used = &state;
+    }
+  }
+
+  if (least_recently_used == nullptr) {
+    return false;
+  }
+  FreeEntry(*least_recently_used);
+  return true;
+}
+
+SequenceStateStore::~SequenceStateStore()
+{
+  managed_buffer_.reset();
+  shm_map_.reset();
+  shm_obj_.reset();
+  if (create_) {
+    bi::shared_memory_object::remove(region_name_.c_str());
+  }
+}
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,130 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/interprocess/managed_external_buffer.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <memory>
+#include <string>
+
+namespace triton { namespace backend { namespace python {
+namespace bi = boost::interprocess;
+
+constexpr std::size_t kSequenceStateMaxNameLength = 64;
+
+// A state of a sequence in the store. 'last_used' is the value of the store
+// clock when the state was last acquired. 'pin_count' is the number of
+// tensors of the stub process that refer to the state, a pinned state is
+// never freed. A state whose sequence has ended is freed once it is unpinned.
+struct SequenceStateEntry {
+  uint64_t correlation_id;
+  char name[kSequenceStateMaxNameLength];
+  bi::managed_external_buffer::handle_t handle;
+  uint64_t byte_size;
+  uint64_t last_used;
+  uint32_t pin_count;
+  bool in_use;
+  bool ended;
+};
+
+// 'byte_size' is the number of bytes the states can use in total and
+// 'used_bytes' the number of bytes they use.
+struct SequenceStateHeader {
+  bi::interprocess_mutex mutex;
+  uint64_t clock;
+  uint64_t byte_size;
+  uint64_t used_bytes;
+  uint32_t max_entries;
+};
+
+/// Per-sequence states of a model instance kept in a shared memory region of
+/// their own. The region is created by the parent process and is not
+/// recreated when the stub process restarts, so the states of the sequences
+/// outlive the stub process. Only the stub process uses the states. When the
+/// region or the table of states is full, the least recently used state that
+/// is not pinned is evicted.
+class SequenceStateStore {
+ public:
+  /// Create the region of the store.
+  /// \param byte_size The number of bytes the states can use in total.
+  /// \param max_entries The maximum number of states in the store.
+  /// \throws PythonBackendException if the region can't be created.
+  static std::unique_ptr<SequenceStateStore> Create(
+      const std::string& region_name, uint64_t byte_size,
+      uint32_t max_entries);
+
+  /// Open the region created by the parent process. The states that were
+  /// pinned by a previous stub process are unpinned.
+  /// \throws PythonBackendException if the region can't be opened.
+  static std::unique_ptr<SequenceStateStore> Open(
+      const std::string& region_name);
+
+  /// Get the state 'name' of a sequence and pin it, allocating a zeroed state
+  /// of 'byte_size' bytes if it doesn't exist.
+  /// \param entry Set to the index of the state to pass to 'Unpin'.
+  /// \param created Set to true if the state was allocated by this call.
+  /// \return The address of the state.
+  /// \throws PythonBackendException if the state exists with a different
+  /// size or if there is no room left for the state.
+  void* Acquire(
+      uint64_t correlation_id, const std::string& name, uint64_t byte_size,
+      uint32_t* entry, bool* created);
+
+  /// Release a pin of the state returned by 'Acquire'.
+  void Unpin(uint32_t entry);
+
+  /// Free the states of a sequence. The states that are pinned are freed
+  /// when they are unpinned.
+  void EndSequence(uint64_t correlation_id);
+
+  const std::string& RegionName() { return region_name_; }
+
+  ~SequenceStateStore();
+
+ private:
+  SequenceStateStore(const std::string& region_name, bool create);
+
+  // Free the state of an entry. Must be called with the mutex held.
+  void FreeEntry(SequenceStateEntry& entry);
+
+  // Evict the least recently used state that is not pinned. Must be called
+  // with the mutex held.
+  // \return False if all the states are pinned.
+  bool EvictLeastRecentlyUsed();
+
+  std::string region_name_;
+  bool create_;
+  std::unique_ptr<bi::shared_memory_object> shm_obj_;
+  std::unique_ptr<bi::mapped_region> shm_map_;
+  std::unique_ptr<bi::managed_external_buffer> managed_buffer_;
+  SequenceStateHeader* header_;
+  SequenceStateEntry* entries_;
+};
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,96 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "shared_weights.h"
+
+#include <unistd.h>
+#include <set>
+#include <sstream>
+#include "pb_exception.h"
+
+namespace triton { namespace backend { namespace python {
+
+SharedWeightFile::SharedWeightFile(const std::string& path) : path_(path) {}
+
+std::unique_ptr<SharedWeightFile>
+SharedWeightFile::Map(const std::string& path, bool prefault)
+{
+  std::unique_ptr<SharedWeightFile> weight_file(new SharedWeightFile(path));
+  try {
+    weight_file->file_mapping_ =
+        std::make_unique<bi::file_mapping>(path.c_str(), bi::read_only);
+    weight_file->region_ = std::make_unique<bi::mapped_region>(
+        *weight_file->file_mapping_, bi::read_only);
+  }
+  catch (bi::interprocess_exception& ex) {
+    throw PythonBackendException(
+        "Unable to map the shared weight file '" + path +
+        "'. Error: " + ex.what());
+  }
+
+  if (prefault) {
+    // Reading one byte of each page is enough to load the page in the page
+    // cache.
+    const volatile char* data =
+        reinterpret_cast<const volatile char*>(weight_file->Data());
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < weight_file->ByteSize();
+         offset += page_size) {
+      data[offset];
+    }
+  }
+
+  return weight_file;
+}
+
+bool
+ParseSharedWeightFiles(
+    const std::string& file_list,
+    std::vector<std::pair<std::string, std::string>>* files)
+{
+  std::set<std::string> names;
+  std::stringstream entries(file_list);
+  std::string entry;
+  while (std::getline(entries, entry, ';')) {
+    if (entry.empty()) {
+      continue;
+    }
+    size_t separator = entry.find('=');
+    if (separator == std::string::npos || separator == 0 ||
+        separator == entry.size() - 1) {
+      return false;
+    }
+    std::string name = entry.substr(0, separator);
+    if (!names.insert(name).second) {
+      return false;
+    }
+    files->emplace_back(name, entry.substr(separator + 1));
+  }
+
+  return true;
+}
+
+}}}  // namespace triton::backend::python
@@ -0,0 +1,72 @@
+// Copyright 2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace triton { namespace backend { namespace python {
+namespace bi = boost::interprocess;
+
+/// A file of weights that is mapped read-only by the parent process and by
+/// the stub processes of all the instances of a model. The pages of the file
+/// are read once by the parent process and then shared through the page
+/// cache, so the memory used by the weights doesn't grow with the number of
+/// instances.
+class SharedWeightFile {
+ public:
+  /// Map the file read-only.
+  /// \param prefault Read all the pages of the file so that they are in the
+  /// page cache before the stub processes map them.
+  /// \throws PythonBackendException if the file can't be mapped.
+  static std::unique_ptr<SharedWeightFile> Map(
+      const std::string& path, bool prefault);
+
+  const void* Data() { return region_->get_address(); }
+  size_t ByteSize() { return region_->get_size(); }
+  const std::string& Path() { return path_; }
+
+ private:
+  SharedWeightFile(const std::string& path);
+
+  std::string path_;
+  std::unique_ptr<bi::file_mapping> file_mapping_;
+  std::unique_ptr<bi::mapped_region> region_;
+};
+
+/// Parse a list of 'name=path' entries separated by ';'.
+/// \return False if an entry has no name or no path, or if a name is
+/// repeated.
+bool ParseSharedWeightFiles(
+    const std::string& file_list,
+    std::vector<std::pair<std::string, std::string>>* files);
+
+}}}  // namespace triton::backend::python
@@ -24,22 +24,160 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <boost/interprocess/managed_external_buffer.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <mutex>
+#include <new>
+#include <unordered_map>
 
 #include "shm_manager.h"
 
 namespace triton { namespace backend { namespace python {
 
+namespace {
+
+// Managers that are alive in this process. The registry is used by the
+// thread caches to return their blocks when a thread exits. The objects are
+// intentionally leaked so that they outlive any thread exiting during the
+// process shutdown.
+std::mutex&
+RegistryMutex()
+{
+  static std::mutex* mutex = new std::mutex;
+  return *mutex;
+}
+
+std::unordered_map<uint64_t, SharedMemoryManager*>&
+Registry()
+{
+  static auto* registry =
+      new std::unordered_map<uint64_t, SharedMemoryManager*>;
+  return *registry;
+}
+
+uint64_t
+RegisterManager(SharedMemoryManager* manager)
+{
+  static std::atomic<uint64_t> next_id{1};
+  uint64_t id = next_id++;
+  std::lock_guard<std::mutex> lock{RegistryMutex()};
+  Registry()[id] = manager;
+  return id;
+}
+
+void
+UnregisterManager(uint64_t id)
+{
+  std::lock_guard<std::mutex> lock{RegistryMutex()};
+  Registry().erase(id);
+}
+
+}  // namespace
+
+const char*
+ShmObjectTypeName(std::size_t object_type)
+{
+  static const char* names[kShmObjectTypeCount] = {
+      "other",   "ipc_message", "tensor",        "memory", "string",
+      "request", "response",    "response_send", "batch",  "log"};
+  return object_type < kShmObjectTypeCount ? names[object_type] : "other";
+}
+
+std::string
+ShmAllocationSizeBucketName(std::size_t bucket)
+{
+  if (bucket + 1 >= kShmAllocationSizeBucketCount) {
+    return "+Inf";
+  }
+  return std::to_string(kShmSlabMinBlockSize << (2 * bucket));
+}
+
+// Blocks cached by a thread for each shared memory manager. The caches are
+// only accessed by their owning thread.
+class ShmThreadCaches {
+ public:
+  using Cache = std::array<
+      std::vector<bi::managed_external_buffer::handle_t>,
+      kShmSlabSizeClassCount>;
+
+  ~ShmThreadCaches()
+  {
+    std::lock_guard<std::mutex> lock{RegistryMutex()};
+    for (auto& cache : caches_) {
+      auto it = Registry().find(cache.first);
+      if (it == Registry().end()) {
+        continue;
+      }
+      for (std::size_t i = 0; i < kShmSlabSizeClassCount; ++i) {
+        it->second->FlushThreadCache(i, cache.second[i], cache.second[i].size());
+      }
+    }
+  }
+
+  Cache& Get(uint64_t manager_id)
+  {
+    auto it = caches_.find(manager_id);
+    if (it != caches_.end()) {
+      return it->second;
+    }
+
+    // Drop the caches of the managers that no longer exist. Their blocks
+    // belong to regions that have already been removed.
+    {
+      std::lock_guard<std::mutex> lock{RegistryMutex()};
+      for (auto cache = caches_.begin(); cache != caches_.end();) {
+        if (Registry().find(cache->first) == Registry().end()) {
+          cache = caches_.erase(cache);
+        } else {
+          ++cache;
+        }
+      }
+    }
+
+    return caches_[manager_id];
+  }
+
+  static ShmThreadCaches& Local()
+  {
+    thread_local ShmThreadCaches caches;
+    return caches;
+  }
+
+ private:
+  std::unordered_map<uint64_t, Cache> caches_;
+};
+
 SharedMemoryManager::SharedMemoryManager(
     const std::string& shm_region_name, size_t shm_size,
-    size_t shm_growth_bytes, bool create)
+    size_t shm_growth_bytes, bool create, bool hugepages, bool prefault,
+    size_t grow_watermark_bytes, int32_t numa_node)
 {
   shm_region_name_ = shm_region_name;
   create_ = create;
   shm_growth_bytes_ = shm_growth_bytes;
+  hugepages_ = hugepages;
+  prefault_ = prefault;
+  numa_node_ = numa_node;
+  grow_watermark_bytes_ = grow_watermark_bytes;
+  grow_requested_ = false;
+  grow_exit_ = false;
+  reservation_ = nullptr;
+
+  if (create && hugepages) {
+    // Huge pages can only back ranges that are multiples of the huge page
+    // size.
+    shm_size = RoundUpToHugePage(shm_size);
+    shm_growth_bytes_ = RoundUpToHugePage(shm_growth_bytes_);
+  }
 
   try {
     if (create) {
@@ -54,20 +192,24 @@ SharedMemoryManager::SharedMemoryManager(
           bi::open_only, shm_region_name.c_str(), bi::read_write);
     }
 
+    if (!create) {
+      int64_t region_size = 0;
+      shm_obj_->get_size(region_size);
+      shm_size = region_size;
+    }
     current_capacity_ = shm_size;
-    shm_map_ = std::make_shared<bi::mapped_region>(*shm_obj_, bi::read_write);
-    old_shm_maps_.push_back(shm_map_);
+    ReserveAddressSpace();
+    // The advice given by 'MapRegion' on create must come before the pages
+    // are touched for the first time by the managed buffer.
+    MapRegion(shm_size);
 
     // Only create the managed external buffer for the stub process.
     if (create) {
       managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
-          bi::create_only, shm_map_->get_address(), shm_size);
+          bi::create_only, base_, shm_size);
     } else {
-      int64_t shm_size = 0;
-      shm_obj_->get_size(shm_size);
       managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
-          bi::open_only, shm_map_->get_address(), shm_size);
-      current_capacity_ = shm_size;
+          bi::open_only, base_, shm_size);
     }
   }
   catch (bi::interprocess_exception& ex) {
@@ -79,6 +221,9 @@ SharedMemoryManager::SharedMemoryManager(
          "model instance requires at least 64MBs of shared memory. Error: " +
          ex.what());
     // Remove the shared memory region if there was an error.
+    if (reservation_ != nullptr) {
+      munmap(reservation_, reservation_size_);
+    }
     bi::shared_memory_object::remove(shm_region_name.c_str());
     throw PythonBackendException(std::move(error_message));
   }
@@ -87,10 +232,199 @@ SharedMemoryManager::SharedMemoryManager(
   shm_mutex_ =
       managed_buffer_->find_or_construct<bi::interprocess_mutex>("shm_mutex")();
   total_size_ = managed_buffer_->find_or_construct<uint64_t>("total size")();
+  slabs_ = managed_buffer_->find_or_construct<ShmSlabs>("shm slabs")();
+  allocator_stats_ = managed_buffer_->find_or_construct<ShmAllocatorStats>(
+      "shm allocator stats")();
+  options_ =
+      managed_buffer_->find_or_construct<ShmRegionOptions>("shm options")();
+  thread_cached_bytes_ = 0;
+  id_ = RegisterManager(this);
   delete_region_ = true;
+  if (create) {
+    options_->hugepages = hugepages_;
+    options_->prefault = prefault_;
+    options_->grow_watermark_bytes = grow_watermark_bytes_;
+    options_->numa_node = numa_node_;
+  } else {
+    // The process that opens the region uses the options of the creator.
+    hugepages_ = options_->hugepages;
+    prefault_ = options_->prefault;
+    grow_watermark_bytes_ = options_->grow_watermark_bytes;
+    numa_node_ = options_->numa_node;
+    AdviseMapping(base_, mapped_size_);
+  }
   if (create) {
     *total_size_ = current_capacity_;
     new (shm_mutex_) bi::interprocess_mutex;
+    for (ShmSlabSizeClass& size_class : slabs_->size_classes) {
+      new (&size_class.mutex) bi::interprocess_mutex;
+      size_class.head = 0;
+      size_class.free_count = 0;
+    }
+  }
+  UpdateMappedView();
+
+  if (grow_watermark_bytes_ != 0) {
+    grow_thread_ =
+        std::thread(&SharedMemoryManager::BackgroundGrowthLoop, this);
+  }
+}
+
+std::size_t
+SharedMemoryManager::RoundUpToHugePage(std::size_t byte_size)
+{
+  return (byte_size + kShmHugePageSize - 1) / kShmHugePageSize *
+         kShmHugePageSize;
+}
+
+void
+SharedMemoryManager::AdviseMapping(char* address, std::size_t byte_size)
+{
+  // The calls are best effort. Transparent huge pages for shared memory are
+  // only used if '/sys/kernel/mm/transparent_hugepage/shmem_enabled' allows
+  // it.
+  if (hugepages_) {
+    madvise(address, byte_size, MADV_HUGEPAGE);
+  }
+
+  // The policy of a shared memory range is kept by the region, so it applies
+  // to the pages touched by either process. The preferred policy falls back
+  // to the other nodes instead of failing when the node is out of memory.
+  if (numa_node_ >= 0) {
+    const std::size_t bits_per_mask = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> node_mask(numa_node_ / bits_per_mask + 1, 0);
+    node_mask[numa_node_ / bits_per_mask] |= 1UL
+                                             << (numa_node_ % bits_per_mask);
+    syscall(
+        SYS_mbind, address, byte_size, MPOL_PREFERRED, node_mask.data(),
+        node_mask.size() * bits_per_mask + 1, 0);
+  }
+
+  if (prefault_) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(address, byte_size, MADV_POPULATE_WRITE) == 0) {
+      return;
+    }
+#endif
+    // Fall back to touching every page for kernels without
+    // MADV_POPULATE_WRITE. The atomic add of zero writes the page without
+    // modifying data that may already be in use.
+    std::size_t page_size = sysconf(_SC_PAGESIZE);
+    for (std::size_t offset = 0; offset < byte_size; offset += page_size) {
+      __atomic_fetch_add(address + offset, 0, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+void
+SharedMemoryManager::ReserveAddressSpace()
+{
+  // The extra huge page leaves room to align the start of the mapping so
+  // that the region can be backed by huge pages. The reservation is neither
+  // accessible nor backed by memory until the region is mapped into it.
+  reservation_size_ = kShmAddressReservationSize + kShmHugePageSize;
+  void* reservation = mmap(
+      nullptr, reservation_size_, PROT_NONE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reservation == MAP_FAILED) {
+    reservation_ = nullptr;
+    reserved_base_ = nullptr;
+    use_reservation_ = false;
+  } else {
+    reservation_ = reinterpret_cast<char*>(reservation);
+    reserved_base_ = reinterpret_cast<char*>(RoundUpToHugePage(
+        reinterpret_cast<std::uintptr_t>(reservation_)));
+    use_reservation_ = true;
+  }
+  base_ = nullptr;
+  mapped_size_ = 0;
+}
+
+void
+SharedMemoryManager::MapRegion(uint64_t byte_size)
+{
+  if (byte_size <= mapped_size_) {
+    return;
+  }
+
+  if (use_reservation_ && byte_size <= kShmAddressReservationSize) {
+    // Extend the existing mapping in place. The last page of the existing
+    // mapping may be partially mapped, so the new mapping starts at that
+    // page.
+    std::size_t page_size = sysconf(_SC_PAGESIZE);
+    std::size_t offset = mapped_size_ / page_size * page_size;
+    void* address = mmap(
+        reserved_base_ + offset, byte_size - offset, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_FIXED, shm_obj_->get_mapping_handle().handle,
+        offset);
+    if (address != MAP_FAILED) {
+      base_ = reserved_base_;
+      mapped_size_ = byte_size;
+      AdviseMapping(reserved_base_ + offset, byte_size - offset);
+      return;
+    }
+  }
+
+  // The region does not fit in the reserved range. The reserved range stays
+  // mapped since objects may still be referenced through it.
+  use_reservation_ = false;
+  shm_map_ = std::make_shared<bi::mapped_region>(*shm_obj_, bi::read_write);
+  old_shm_maps_.push_back(shm_map_);
+  base_ = reinterpret_cast<char*>(shm_map_->get_address());
+  mapped_size_ = shm_map_->get_size();
+  AdviseMapping(base_, mapped_size_);
+}
+
+size_t
+SharedMemoryManager::MappingCount()
+{
+  bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_};
+  return old_shm_maps_.size() + (reservation_ != nullptr ? 1 : 0);
+}
+
+void
+SharedMemoryManager::RequestBackgroundGrowth()
+{
+  if (grow_watermark_bytes_ == 0 ||
+      managed_buffer_->get_free_memory() >= grow_watermark_bytes_) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{grow_mu_};
+    grow_requested_ = true;
+  }
+  grow_cv_.notify_one();
+}
+
+void
+SharedMemoryManager::BackgroundGrowthLoop()
+{
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock{grow_mu_};
+      grow_cv_.wait(lock, [this] { return grow_requested_ || grow_exit_; });
+      if (grow_exit_) {
+        return;
+      }
+      grow_requested_ = false;
+    }
+
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+    LockGlobal(gaurd);
+    try {
+      // The other process may have already grown the region.
+      GrowIfNeeded(0);
+      while (grow_watermark_bytes_ != 0 &&
+             managed_buffer_->get_free_memory() < grow_watermark_bytes_) {
+        GrowIfNeeded(1);
+      }
+    }
+    catch (const PythonBackendException& ex) {
+      // The region cannot grow any further. Allocations will grow the region
+      // inline and report the error to the caller.
+      grow_watermark_bytes_ = 0;
+    }
   }
 }
 
@@ -99,35 +433,279 @@ SharedMemoryManager::SharedMemoryManager(const std::string& shm_region_name)
   shm_region_name_ = shm_region_name;
   create_ = false;
   shm_growth_bytes_ = 1024;
+  hugepages_ = false;
+  prefault_ = false;
+  numa_node_ = -1;
+  grow_watermark_bytes_ = 0;
+  grow_requested_ = false;
+  grow_exit_ = false;
 
   shm_obj_ = std::make_unique<bi::shared_memory_object>(
       bi::open_only, shm_region_name.c_str(), bi::read_write);
 
-  shm_map_ = std::make_shared<bi::mapped_region>(*shm_obj_, bi::read_write);
-  old_shm_maps_.push_back(shm_map_);
-
   int64_t shm_size = 0;
   shm_obj_->get_size(shm_size);
+  ReserveAddressSpace();
+  MapRegion(shm_size);
   managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
-      bi::open_only, shm_map_->get_address(), shm_size);
+      bi::open_only, base_, shm_size);
   current_capacity_ = shm_size;
 
   // Construct a mutex in shared memory.
   shm_mutex_ =
       managed_buffer_->find_or_construct<bi::interprocess_mutex>("shm_mutex")();
   total_size_ = managed_buffer_->find_or_construct<uint64_t>("total size")();
+  slabs_ = managed_buffer_->find_or_construct<ShmSlabs>("shm slabs")();
+  allocator_stats_ = managed_buffer_->find_or_construct<ShmAllocatorStats>(
+      "shm allocator stats")();
+  options_ =
+      managed_buffer_->find_or_construct<ShmRegionOptions>("shm options")();
+  thread_cached_bytes_ = 0;
+  id_ = RegisterManager(this);
   delete_region_ = false;
+  UpdateMappedView();
+}
+
+void
+SharedMemoryManager::UpdateMappedView()
+{
+  mapped_views_.emplace_back(new MappedView{base_, mapped_size_});
+  mapped_view_.store(mapped_views_.back().get(), std::memory_order_release);
+}
+
+void*
+SharedMemoryManager::AddressFromHandle(
+    bi::managed_external_buffer::handle_t handle, std::size_t byte_size)
+{
+  // 'byte_size' only covers the header of the object, so a block that starts
+  // in the mapping may still end past it if the other process has grown the
+  // region. The handle is received after the growth, so the new total size
+  // is seen here.
+  MappedView* view = mapped_view_.load(std::memory_order_acquire);
+  uint64_t total_size = __atomic_load_n(total_size_, __ATOMIC_ACQUIRE);
+  if (total_size <= view->capacity &&
+      static_cast<uint64_t>(handle) + byte_size <= view->capacity) {
+    return view->base + handle;
+  }
+
+  // The region has grown since it was last mapped by this process.
+  bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+  LockGlobal(gaurd);
+  GrowIfNeeded(0);
+  return managed_buffer_->get_address_from_handle(handle);
+}
+
+void
+SharedMemoryManager::LockGlobal(bi::scoped_lock<bi::interprocess_mutex>& lock)
+{
+  if (!lock.try_lock()) {
+    allocator_stats_->global_lock_contentions.fetch_add(
+        1, std::memory_order_relaxed);
+    lock.lock();
+  }
+  allocator_stats_->global_lock_acquisitions.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void
+SharedMemoryManager::LockSlab(bi::scoped_lock<bi::interprocess_mutex>& lock)
+{
+  if (!lock.try_lock()) {
+    allocator_stats_->slab_lock_contentions.fetch_add(
+        1, std::memory_order_relaxed);
+    lock.lock();
+  }
+  allocator_stats_->slab_lock_acquisitions.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void
+SharedMemoryManager::RefillThreadCache(
+    std::size_t size_class,
+    std::vector<bi::managed_external_buffer::handle_t>& handles)
+{
+  {
+    ShmSlabSizeClass& slab = slabs_->size_classes[size_class];
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{slab.mutex, bi::defer_lock};
+    LockSlab(gaurd);
+    while (slab.head != 0 && handles.size() < kShmThreadCacheBatchSize) {
+      bi::managed_external_buffer::handle_t handle = slab.head;
+      AllocatedShmOwnership* shm_ownership_data =
+          reinterpret_cast<AllocatedShmOwnership*>(
+              AddressFromHandle(handle, SlabBlockSize(size_class)));
+      slab.head = shm_ownership_data->next_free_;
+      slab.free_count--;
+      shm_ownership_data->next_free_ = 0;
+      handles.push_back(handle);
+    }
+  }
+
+  if (!handles.empty()) {
+    return;
+  }
+
+  // The slab free list is empty. Carve a batch of blocks out of the managed
+  // buffer while holding the global lock once. If the region is full, the
+  // caller falls back to the regular allocation that grows the region.
+  bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+  LockGlobal(gaurd);
+  GrowIfNeeded(0);
+  while (handles.size() < kShmThreadCacheBatchSize) {
+    void* allocated_data;
+    try {
+      allocated_data = Allocate(SlabBlockSize(size_class), true /* aligned */);
+    }
+    catch (bi::bad_alloc& ex) {
+      break;
+    }
+
+    AllocatedShmOwnership* shm_ownership_data =
+        reinterpret_cast<AllocatedShmOwnership*>(allocated_data);
+    shm_ownership_data->ref_count_ = 0;
+    shm_ownership_data->size_class_ = size_class + 1;
+    shm_ownership_data->object_type_ = 0;
+    shm_ownership_data->next_free_ = 0;
+    handles.push_back(managed_buffer_->get_handle_from_address(allocated_data));
+  }
+  RequestBackgroundGrowth();
+  UpdatePeakAllocatedBytes();
+}
+
+void
+SharedMemoryManager::FlushThreadCache(
+    std::size_t size_class,
+    std::vector<bi::managed_external_buffer::handle_t>& handles,
+    std::size_t count)
+{
+  std::size_t flushed = 0;
+  {
+    ShmSlabSizeClass& slab = slabs_->size_classes[size_class];
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{slab.mutex, bi::defer_lock};
+    LockSlab(gaurd);
+    while (flushed < count && slab.free_count < kShmSlabMaxFreeBlocks) {
+      bi::managed_external_buffer::handle_t handle = handles.back();
+      AllocatedShmOwnership* shm_ownership_data =
+          reinterpret_cast<AllocatedShmOwnership*>(
+              AddressFromHandle(handle, SlabBlockSize(size_class)));
+      shm_ownership_data->next_free_ = slab.head;
+      slab.head = handle;
+      slab.free_count++;
+      handles.pop_back();
+      flushed++;
+    }
+  }
+
+  if (flushed < count) {
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+    LockGlobal(gaurd);
+    GrowIfNeeded(0);
+    while (flushed < count) {
+      DeallocateUnsafe(handles.back());
+      handles.pop_back();
+      flushed++;
+    }
+  }
+
+  thread_cached_bytes_ -= count * SlabBlockSize(size_class);
+}
+
+AllocatedShmOwnership*
+SharedMemoryManager::AllocateFromSlab(
+    std::size_t size_class, bi::managed_external_buffer::handle_t& handle)
+{
+  std::vector<bi::managed_external_buffer::handle_t>& handles =
+      ShmThreadCaches::Local().Get(id_)[size_class];
+  if (handles.empty()) {
+    allocator_stats_->thread_cache_misses.fetch_add(
+        1, std::memory_order_relaxed);
+    RefillThreadCache(size_class, handles);
+    if (handles.empty()) {
+      return nullptr;
+    }
+    thread_cached_bytes_ += handles.size() * SlabBlockSize(size_class);
+  } else {
+    allocator_stats_->thread_cache_hits.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  handle = handles.back();
+  handles.pop_back();
+  thread_cached_bytes_ -= SlabBlockSize(size_class);
+
+  return reinterpret_cast<AllocatedShmOwnership*>(
+      AddressFromHandle(handle, SlabBlockSize(size_class)));
+}
+
+void
+SharedMemoryManager::RecordAllocation(
+    std::size_t byte_size, ShmObjectType object_type)
+{
+  std::size_t bucket = 0;
+  while (bucket + 1 < kShmAllocationSizeBucketCount &&
+         (kShmSlabMinBlockSize << (2 * bucket)) < byte_size) {
+    bucket++;
+  }
+  allocator_stats_->allocation_sizes[bucket].fetch_add(
+      1, std::memory_order_relaxed);
+  allocator_stats_->live_objects[static_cast<std::size_t>(object_type)]
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+SharedMemoryManager::UpdatePeakAllocatedBytes()
+{
+  uint64_t allocated_bytes =
+      managed_buffer_->get_size() - managed_buffer_->get_free_memory();
+  if (allocated_bytes >
+      allocator_stats_->peak_allocated_bytes.load(std::memory_order_relaxed)) {
+    allocator_stats_->peak_allocated_bytes.store(
+        allocated_bytes, std::memory_order_relaxed);
+  }
+}
+
+void
+SharedMemoryManager::Release(
+    AllocatedShmOwnership* shm_ownership_data,
+    bi::managed_external_buffer::handle_t handle)
+{
+  if (shm_ownership_data->object_type_ < kShmObjectTypeCount) {
+    allocator_stats_->live_objects[shm_ownership_data->object_type_].fetch_sub(
+        1, std::memory_order_relaxed);
+  }
+
+  if (shm_ownership_data->size_class_ != 0) {
+    std::size_t size_class = shm_ownership_data->size_class_ - 1;
+    std::vector<bi::managed_external_buffer::handle_t>& handles =
+        ShmThreadCaches::Local().Get(id_)[size_class];
+    handles.push_back(handle);
+    thread_cached_bytes_ += SlabBlockSize(size_class);
+
+    // Keep at most two batches in the thread cache so that the blocks freed
+    // by one thread can be reused by the others.
+    if (handles.size() > 2 * kShmThreadCacheBatchSize) {
+      FlushThreadCache(size_class, handles, kShmThreadCacheBatchSize);
+    }
+    return;
+  }
+
+  bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+  LockGlobal(gaurd);
+  // Before using any shared memory function you need to make sure that you
+  // are using the correct mapping. For example, shared memory growth may
+  // happen between the time an object was created and the time the object
+  // gets destructed.
+  GrowIfNeeded(0);
+  DeallocateUnsafe(handle);
 }
 
 void
 SharedMemoryManager::GrowIfNeeded(uint64_t byte_size)
 {
   if (*total_size_ != current_capacity_) {
-    shm_map_ = std::make_shared<bi::mapped_region>(*shm_obj_, bi::read_write);
+    MapRegion(*total_size_);
     managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
-        bi::open_only, shm_map_->get_address(), *total_size_);
-    old_shm_maps_.push_back(shm_map_);
+        bi::open_only, base_, *total_size_);
     current_capacity_ = *total_size_;
+    UpdateMappedView();
   }
 
   if (byte_size != 0) {
@@ -138,6 +716,7 @@ SharedMemoryManager::GrowIfNeeded(uint64_t byte_size)
       shm_obj_->truncate(new_size);
     }
     catch (bi::interprocess_exception& ex) {
+      allocator_stats_->grow_failures.fetch_add(1, std::memory_order_relaxed);
       std::string error_message =
           ("Failed to increase the shared memory pool size for key '" +
            shm_region_name_ + "' to " + std::to_string(*total_size_) +
@@ -149,15 +728,17 @@ SharedMemoryManager::GrowIfNeeded(uint64_t byte_size)
 
     try {
       shm_obj_->truncate(new_size);
-      shm_map_ = std::make_shared<bi::mapped_region>(*shm_obj_, bi::read_write);
-      old_shm_maps_.push_back(shm_map_);
+      MapRegion(new_size);
       managed_buffer_ = std::make_unique<bi::managed_external_buffer>(
-          bi::open_only, shm_map_->get_address(), new_size);
+          bi::open_only, base_, new_size);
       managed_buffer_->grow(new_size - current_capacity_);
       current_capacity_ = managed_buffer_->get_size();
       *total_size_ = new_size;
+      UpdateMappedView();
+      allocator_stats_->grow_count.fetch_add(1, std::memory_order_relaxed);
     }
     catch (bi::interprocess_exception& ex) {
+      allocator_stats_->grow_failures.fetch_add(1, std::memory_order_relaxed);
       shm_obj_->truncate(*total_size_);
       std::string error_message =
           ("Failed to create new mapped region for the grown shared memory "
@@ -172,12 +753,68 @@ size_t
 SharedMemoryManager::FreeMemory()
 {
   GrowIfNeeded(0);
-  return managed_buffer_->get_free_memory();
+  size_t free_memory = managed_buffer_->get_free_memory();
+  for (std::size_t i = 0; i < kShmSlabSizeClassCount; ++i) {
+    ShmSlabSizeClass& slab = slabs_->size_classes[i];
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{slab.mutex};
+    free_memory += slab.free_count * SlabBlockSize(i);
+  }
+  free_memory += thread_cached_bytes_;
+
+  return free_memory;
+}
+
+double
+SharedMemoryManager::Fragmentation()
+{
+  // Only a snapshot of the free memory and of the largest free block is taken
+  // under the global lock. The allocator keeps its free blocks sorted by size,
+  // so a request for all of the free memory that accepts any smaller size is
+  // served by the largest free block in a single lookup.
+  std::size_t free_memory;
+  std::size_t largest_block = 0;
+  {
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+    LockGlobal(gaurd);
+    GrowIfNeeded(0);
+    free_memory = managed_buffer_->get_free_memory();
+    if (free_memory != 0) {
+      std::size_t byte_size = free_memory;
+      char* reuse = nullptr;
+      char* ptr = managed_buffer_->allocation_command<char>(
+          bi::allocate_new | bi::nothrow_allocation, 1 /* limit_size */,
+          byte_size, reuse);
+      if (ptr != nullptr) {
+        managed_buffer_->deallocate(ptr);
+        largest_block = byte_size;
+      }
+    }
+  }
+
+  if (free_memory == 0) {
+    return 0;
+  }
+  return 1.0 - std::min(1.0, static_cast<double>(largest_block) / free_memory);
 }
 
 
 SharedMemoryManager::~SharedMemoryManager() noexcept(false)
 {
+  if (grow_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{grow_mu_};
+      grow_exit_ = true;
+    }
+    grow_cv_.notify_one();
+    grow_thread_.join();
+  }
+
+  UnregisterManager(id_);
+  // The managed buffer must not be used after the region is unmapped.
+  managed_buffer_.reset();
+  if (reservation_ != nullptr) {
+    munmap(reservation_, reservation_size_);
+  }
   if (delete_region_) {
     bi::shared_memory_object::remove(shm_region_name_.c_str());
   }
@@ -189,4 +826,12 @@ SharedMemoryManager::SetDeleteRegion(bool delete_region)
   delete_region_ = delete_region;
 }
 
+void
+SharedMemoryManager::DetachFromForkedChild()
+{
+  // The thread caches skip the managers that are not registered.
+  UnregisterManager(id_);
+  delete_region_ = false;
+}
+
 }}}  // namespace triton::backend::python
@@ -30,9 +30,16 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/detail/atomic.hpp>
 #include <boost/interprocess/managed_external_buffer.hpp>
+#include <atomic>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <condition_variable>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <type_traits>
+#include <thread>
 #include <typeinfo>
 #include <vector>
 #include <functional>
@@ -55,6 +62,38 @@ struct AllocatedSharedMemory {
   bi::managed_external_buffer::handle_t handle_;
 };
 
+// Types of the objects stored in the shared memory. The type of an object is
+// recorded in its ownership header so that the live objects can be counted by
+// type.
+enum class ShmObjectType : uint16_t {
+  kOther = 0,
+  kIPCMessage,
+  kTensor,
+  kMemory,
+  kString,
+  kRequest,
+  kResponse,
+  kResponseSend,
+  kBatch,
+  kLog,
+  kCount
+};
+
+constexpr std::size_t kShmObjectTypeCount =
+    static_cast<std::size_t>(ShmObjectType::kCount);
+
+// Name of the object type used in the metric labels.
+const char* ShmObjectTypeName(std::size_t object_type);
+
+// The allocations are counted in buckets of the requested size. The upper
+// bound of a bucket is four times the bound of the previous bucket and the
+// last bucket has no upper bound.
+constexpr std::size_t kShmAllocationSizeBucketCount = 10;
+
+// Name of the allocation size bucket used in the metric labels. The name is
+// the upper bound of the bucket in bytes, or "+Inf" for the last bucket.
+std::string ShmAllocationSizeBucketName(std::size_t bucket);
+
 // The alignment here is used to extend the size of the shared memory allocation
 // struct to 16 bytes. The reason for this change is that when an aligned shared
 // memory location is requested using the `Construct` method, the memory
@@ -62,52 +101,165 @@ struct AllocatedSharedMemory {
 // info is placed in the beginning and the actual object is placed after that
 // (i.e. 4 plus the aligned address is not 16-bytes aligned). The aligned memory
 // is required by semaphore otherwise it may lead to SIGBUS error on ARM.
+//
+// The reference count is updated atomically so that releasing an object does
+// not require the shared memory mutex. 'size_class_' is the slab size class
+// plus one if the block can be recycled through the slab free lists, or zero
+// otherwise. 'object_type_' is the ShmObjectType of the object. 'next_free_'
+// links the block into a slab free list while it is not in use.
 struct AllocatedShmOwnership {
   uint32_t ref_count_;
+  uint16_t size_class_;
+  uint16_t object_type_;
+  bi::managed_external_buffer::handle_t next_free_;
 } __attribute__((aligned(16)));
 
+static_assert(
+    sizeof(AllocatedShmOwnership) == 16,
+    "AllocatedShmOwnership must be 16 bytes to keep the objects aligned.");
+
+// Small allocations are served from per-size-class free lists (slabs) that
+// are shared by both processes. The size classes are powers of two starting
+// from 'kShmSlabMinBlockSize' and include the ownership header. Recycled blocks
+// only take the lock of their size class instead of the global allocator lock.
+constexpr std::size_t kShmSlabSizeClassCount = 4;
+constexpr std::size_t kShmSlabMinBlockSize = 64;
+constexpr uint64_t kShmSlabMaxFreeBlocks = 1024;
+
+struct ShmSlabSizeClass {
+  bi::interprocess_mutex mutex;
+  bi::managed_external_buffer::handle_t head;
+  uint64_t free_count;
+};
+
+struct ShmSlabs {
+  ShmSlabSizeClass size_classes[kShmSlabSizeClassCount];
+};
+
+// Allocator counters shared by both processes. A lock acquisition is counted
+// as contended if the lock could not be acquired without blocking.
+// 'peak_allocated_bytes' is the largest number of bytes that were allocated
+// from the region at once, including the blocks cached for reuse.
+struct ShmAllocatorStats {
+  std::atomic<uint64_t> global_lock_acquisitions{0};
+  std::atomic<uint64_t> global_lock_contentions{0};
+  std::atomic<uint64_t> slab_lock_acquisitions{0};
+  std::atomic<uint64_t> slab_lock_contentions{0};
+  std::atomic<uint64_t> thread_cache_hits{0};
+  std::atomic<uint64_t> thread_cache_misses{0};
+  std::atomic<uint64_t> allocation_sizes[kShmAllocationSizeBucketCount] = {};
+  std::atomic<int64_t> live_objects[kShmObjectTypeCount] = {};
+  std::atomic<uint64_t> peak_allocated_bytes{0};
+  std::atomic<uint64_t> grow_count{0};
+  std::atomic<uint64_t> grow_failures{0};
+};
+
+// Number of blocks moved between a thread cache and the shared slab free
+// lists at once.
+constexpr std::size_t kShmThreadCacheBatchSize = 16;
+
+class ShmThreadCaches;
+
+// Options of the region chosen by the process that creates it. The process
+// that opens the region applies the same options to its mappings.
+struct ShmRegionOptions {
+  bool hugepages;
+  bool prefault;
+  uint64_t grow_watermark_bytes;
+  int32_t numa_node;
+};
+
+constexpr std::size_t kShmHugePageSize = 2 * 1024 * 1024;
+
+// Virtual address range reserved for the mappings of a region. The region is
+// mapped at the start of the range and grows in place, so growing the region
+// neither moves the mapping nor leaves old mappings behind. Regions that grow
+// beyond the range fall back to a new mapping of the whole region.
+constexpr std::size_t kShmAddressReservationSize = 64ULL * 1024 * 1024 * 1024;
+
 class SharedMemoryManager {
  public:
+  /// Create or open a shared memory pool.
+  /// \param hugepages Back the region with transparent huge pages. The region
+  /// size and the growth size are rounded up to a multiple of 2 MiB.
+  /// \param prefault Populate the page tables of every mapping of the region
+  /// so that the first access to a page does not take a page fault.
+  /// \param grow_watermark_bytes Grow the region in a background thread when
+  /// the free memory of the managed buffer drops below this many bytes, so
+  /// that allocations rarely have to grow the region inline. Zero disables
+  /// the background growth.
+  /// \param numa_node Allocate the pages of the region on this NUMA node when
+  /// it has free memory. -1 leaves the placement to the kernel.
+  /// The options are ignored when opening an existing region. The options of
+  /// the process that created the region are used instead.
   SharedMemoryManager(
       const std::string& shm_region_name, size_t shm_size,
-      size_t shm_growth_bytes, bool create);
+      size_t shm_growth_bytes, bool create, bool hugepages = false,
+      bool prefault = false, size_t grow_watermark_bytes = 0,
+      int32_t numa_node = -1);
 
   SharedMemoryManager(const std::string& shm_region_name);
 
   template <typename T>
-  AllocatedSharedMemory<T> Construct(uint64_t count = 1, bool aligned = false)
+  AllocatedSharedMemory<T> Construct(
+      uint64_t count = 1, bool aligned = false,
+      ShmObjectType object_type = ShmObjectType::kOther)
   {
     T* obj = nullptr;
     AllocatedShmOwnership* shm_ownership_data = nullptr;
     bi::managed_external_buffer::handle_t handle = 0;
 
-    {
-      bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_};
-      std::size_t requested_bytes =
-          sizeof(T) * count + sizeof(AllocatedShmOwnership);
+    std::size_t requested_bytes =
+        sizeof(T) * count + sizeof(AllocatedShmOwnership);
+    std::size_t size_class = SlabSizeClass(requested_bytes);
+    if (size_class < kShmSlabSizeClassCount) {
+      shm_ownership_data = AllocateFromSlab(size_class, handle);
+    }
+
+    if (shm_ownership_data == nullptr) {
+      bi::scoped_lock<bi::interprocess_mutex> gaurd{
+          *shm_mutex_, bi::defer_lock};
+      LockGlobal(gaurd);
       GrowIfNeeded(0);
 
+      // Blocks that belong to a size class are always allocated with the
+      // size and alignment of the class so that they can be recycled for any
+      // request of that class.
+      std::size_t allocated_bytes = requested_bytes;
+      if (size_class < kShmSlabSizeClassCount) {
+        allocated_bytes = SlabBlockSize(size_class);
+        aligned = true;
+      }
+
       void* allocated_data;
       try {
-        allocated_data = Allocate(requested_bytes, aligned);
+        allocated_data = Allocate(allocated_bytes, aligned);
       }
       catch (bi::bad_alloc& ex) {
         // Try to grow the shared memory region if the allocate failed.
-        GrowIfNeeded(requested_bytes);
-        allocated_data = Allocate(requested_bytes, aligned);
+        GrowIfNeeded(allocated_bytes);
+        allocated_data = Allocate(allocated_bytes, aligned);
       }
+      RequestBackgroundGrowth();
+      UpdatePeakAllocatedBytes();
 
       shm_ownership_data =
           reinterpret_cast<AllocatedShmOwnership*>(allocated_data);
-      obj = reinterpret_cast<T*>(
-          (reinterpret_cast<char*>(shm_ownership_data)) +
-          sizeof(AllocatedShmOwnership));
-      shm_ownership_data->ref_count_ = 1;
+      shm_ownership_data->size_class_ =
+          size_class < kShmSlabSizeClassCount ? size_class + 1 : 0;
+      shm_ownership_data->next_free_ = 0;
 
       handle = managed_buffer_->get_handle_from_address(
           reinterpret_cast<void*>(shm_ownership_data));
     }
 
+    obj = reinterpret_cast<T*>(
+        (reinterpret_cast<char*>(shm_ownership_data)) +
+        sizeof(AllocatedShmOwnership));
+    shm_ownership_data->ref_count_ = 1;
+    shm_ownership_data->object_type_ = static_cast<uint16_t>(object_type);
+    RecordAllocation(requested_bytes, object_type);
+
     return WrapObjectInUniquePtr(obj, shm_ownership_data, handle);
   }
 
@@ -116,29 +268,35 @@ class SharedMemoryManager {
       bi::managed_external_buffer::handle_t handle, bool unsafe = false)
   {
     T* object_ptr;
-    AllocatedShmOwnership* shm_ownership_data;
-
-    {
-      bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_};
-      GrowIfNeeded(0);
-      shm_ownership_data = reinterpret_cast<AllocatedShmOwnership*>(
-          managed_buffer_->get_address_from_handle(handle));
-      object_ptr = reinterpret_cast<T*>(
-          reinterpret_cast<char*>(shm_ownership_data) +
-          sizeof(AllocatedShmOwnership));
-      if (!unsafe) {
-        shm_ownership_data->ref_count_ += 1;
-      }
+    AllocatedShmOwnership* shm_ownership_data =
+        reinterpret_cast<AllocatedShmOwnership*>(AddressFromHandle(
+            handle, sizeof(AllocatedShmOwnership) + sizeof(T)));
+    object_ptr = reinterpret_cast<T*>(
+        reinterpret_cast<char*>(shm_ownership_data) +
+        sizeof(AllocatedShmOwnership));
+    if (!unsafe) {
+      bi::ipcdetail::atomic_inc32(&shm_ownership_data->ref_count_);
     }
 
     return WrapObjectInUniquePtr(object_ptr, shm_ownership_data, handle);
   }
 
+  /// Free memory in the pool, including the blocks cached in the slab free
+  /// lists and in the thread caches of this process.
   size_t FreeMemory();
 
+  /// Allocator counters of both processes using the pool.
+  const ShmAllocatorStats& AllocatorStats() { return *allocator_stats_; }
+
+  /// Fraction of the free memory of the region that cannot be allocated as a
+  /// single block. The largest free block is found with a single probe of the
+  /// allocator, so the global lock is only held for one allocation.
+  double Fragmentation();
+
   void Deallocate(bi::managed_external_buffer::handle_t handle)
   {
-    bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_};
+    bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_, bi::defer_lock};
+    LockGlobal(gaurd);
     GrowIfNeeded(0);
     void* ptr = managed_buffer_->get_address_from_handle(handle);
     managed_buffer_->deallocate(ptr);
@@ -153,11 +311,31 @@ class SharedMemoryManager {
   void GrowIfNeeded(uint64_t bytes);
   bi::interprocess_mutex* Mutex() { return shm_mutex_; }
 
+  /// Number of mappings of the region held by this process. Mappings are only
+  /// added when the region outgrows the reserved address range.
+  size_t MappingCount();
+
   void SetDeleteRegion(bool delete_region);
 
+  /// Forget the manager in a child process forked from the process that owns
+  /// it. The manager must be leaked afterwards, since its growth thread does
+  /// not exist in the child. The blocks that the threads of the child
+  /// inherited in their caches are dropped instead of being returned to the
+  /// region, whose allocator still belongs to the parent.
+  void DetachFromForkedChild();
+
   ~SharedMemoryManager() noexcept(false);
 
  private:
+  // Immutable snapshot of a mapping of the region. Mappings are never
+  // unmapped while the manager is alive, so a snapshot stays valid for the
+  // lifetime of the manager and handles below 'capacity' can be translated
+  // without the shared memory mutex.
+  struct MappedView {
+    char* base;
+    uint64_t capacity;
+  };
+
   std::string shm_region_name_;
   std::unique_ptr<bi::managed_external_buffer> managed_buffer_;
   std::unique_ptr<bi::shared_memory_object> shm_obj_;
@@ -169,6 +347,120 @@ class SharedMemoryManager {
   uint64_t* total_size_;
   bool create_;
   bool delete_region_;
+  ShmSlabs* slabs_;
+  ShmAllocatorStats* allocator_stats_;
+  ShmRegionOptions* options_;
+  bool hugepages_;
+  bool prefault_;
+  int32_t numa_node_;
+  std::vector<std::unique_ptr<MappedView>> mapped_views_;
+  std::atomic<MappedView*> mapped_view_;
+
+  // Start of the current mapping of the region and the number of bytes of
+  // the region that are mapped there.
+  char* base_;
+  uint64_t mapped_size_;
+  // Reserved address range, or nullptr if the reservation failed. The region
+  // is mapped at 'reserved_base_', the first huge page aligned address of the
+  // range, while 'use_reservation_' is true.
+  char* reservation_;
+  std::size_t reservation_size_;
+  char* reserved_base_;
+  bool use_reservation_;
+
+  // Background growth of the region. 'grow_watermark_bytes_' is protected by
+  // the shared memory mutex.
+  uint64_t grow_watermark_bytes_;
+  std::thread grow_thread_;
+  std::mutex grow_mu_;
+  std::condition_variable grow_cv_;
+  bool grow_requested_;
+  bool grow_exit_;
+
+  // Process-wide unique id of this manager used to find the thread caches.
+  uint64_t id_;
+  // Bytes held in the thread caches of this process.
+  std::atomic<uint64_t> thread_cached_bytes_;
+
+  friend class ShmThreadCaches;
+
+  void LockGlobal(bi::scoped_lock<bi::interprocess_mutex>& lock);
+  void LockSlab(bi::scoped_lock<bi::interprocess_mutex>& lock);
+
+  // Move up to 'kShmThreadCacheBatchSize' blocks of the size class from the
+  // slab free list, or from the managed buffer if the free list is empty, to
+  // 'handles'.
+  void RefillThreadCache(
+      std::size_t size_class,
+      std::vector<bi::managed_external_buffer::handle_t>& handles);
+
+  // Return blocks from a thread cache to the slab free list. Blocks that do
+  // not fit in the free list are deallocated.
+  void FlushThreadCache(
+      std::size_t size_class,
+      std::vector<bi::managed_external_buffer::handle_t>& handles,
+      std::size_t count);
+
+  // Apply the huge page, prefault and NUMA node options to a mapped range.
+  void AdviseMapping(char* address, std::size_t byte_size);
+
+  // Reserve the address range for the mappings of the region.
+  void ReserveAddressSpace();
+
+  // Map the first 'byte_size' bytes of the region. Inside the reserved range
+  // only the bytes that are not mapped yet are added to the existing mapping.
+  void MapRegion(uint64_t byte_size);
+
+  // Wake up the background growth thread if the free memory dropped below
+  // the watermark. Must be called with the shared memory mutex held.
+  void RequestBackgroundGrowth();
+
+  void BackgroundGrowthLoop();
+
+  static std::size_t RoundUpToHugePage(std::size_t byte_size);
+
+  // Publish the current mapping for lock-free handle translation. Must be
+  // called whenever the region is mapped.
+  void UpdateMappedView();
+
+  // Translate a handle to an address, remapping the region if the handle is
+  // not covered by the current mapping.
+  void* AddressFromHandle(
+      bi::managed_external_buffer::handle_t handle, std::size_t byte_size);
+
+  static std::size_t SlabSizeClass(std::size_t byte_size)
+  {
+    std::size_t size_class = 0;
+    while (size_class < kShmSlabSizeClassCount &&
+           SlabBlockSize(size_class) < byte_size) {
+      size_class++;
+    }
+    return size_class;
+  }
+
+  static std::size_t SlabBlockSize(std::size_t size_class)
+  {
+    return kShmSlabMinBlockSize << size_class;
+  }
+
+  // Count an allocation of 'byte_size' bytes by size and type.
+  void RecordAllocation(std::size_t byte_size, ShmObjectType object_type);
+
+  // Update the peak number of allocated bytes. Must be called with the shared
+  // memory mutex held.
+  void UpdatePeakAllocatedBytes();
+
+  // Pop a block of the size class from the thread cache, refilling the cache
+  // in a batch if it is empty. Returns nullptr if no block is available
+  // without growing the region.
+  AllocatedShmOwnership* AllocateFromSlab(
+      std::size_t size_class, bi::managed_external_buffer::handle_t& handle);
+
+  // Return a block whose reference count dropped to zero either to the
+  // thread cache or to the managed buffer.
+  void Release(
+      AllocatedShmOwnership* shm_ownership_data,
+      bi::managed_external_buffer::handle_t handle);
 
   template <typename T>
   AllocatedSharedMemory<T> WrapObjectInUniquePtr(
@@ -178,19 +470,9 @@ class SharedMemoryManager {
     // Custom deleter to conditionally deallocate the object
     std::function<void(T*)> deleter = [this, handle,
                                        shm_ownership_data](T* memory) {
-      bool destroy = false;
-      bi::scoped_lock<bi::interprocess_mutex> gaurd{*shm_mutex_};
-      // Before using any shared memory function you need to make sure that you
-      // are using the correct mapping. For example, shared memory growth may
-      // happen between the time an object was created and the time the object
-      // gets destructed.
-      GrowIfNeeded(0);
-      shm_ownership_data->ref_count_ -= 1;
-      if (shm_ownership_data->ref_count_ == 0) {
-        destroy = true;
-      }
-      if (destroy) {
-        DeallocateUnsafe(handle);
+      // 'atomic_dec32' returns the value before the decrement.
+      if (bi::ipcdetail::atomic_dec32(&shm_ownership_data->ref_count_) == 1) {
+        Release(shm_ownership_data, handle);
       }
     };
 
@@ -30,11 +30,40 @@
 namespace triton { namespace backend { namespace python {
 namespace py = pybind11;
 
+py::dict
+AllocatorStats(SharedMemoryManager& shm_pool)
+{
+  const ShmAllocatorStats& shm_stats = shm_pool.AllocatorStats();
+  py::dict allocation_sizes;
+  for (size_t i = 0; i < kShmAllocationSizeBucketCount; ++i) {
+    allocation_sizes[py::str(ShmAllocationSizeBucketName(i))] =
+        shm_stats.allocation_sizes[i].load();
+  }
+  py::dict live_objects;
+  for (size_t i = 0; i < kShmObjectTypeCount; ++i) {
+    live_objects[ShmObjectTypeName(i)] = shm_stats.live_objects[i].load();
+  }
+
+  py::dict stats;
+  stats["allocation_sizes"] = allocation_sizes;
+  stats["live_objects"] = live_objects;
+  stats["peak_allocated_bytes"] = shm_stats.peak_allocated_bytes.load();
+  stats["grow_count"] = shm_stats.grow_count.load();
+  stats["grow_failures"] = shm_stats.grow_failures.load();
+  stats["global_lock_acquisitions"] = shm_stats.global_lock_acquisitions.load();
+  stats["global_lock_contentions"] = shm_stats.global_lock_contentions.load();
+  stats["slab_lock_acquisitions"] = shm_stats.slab_lock_acquisitions.load();
+  stats["slab_lock_contentions"] = shm_stats.slab_lock_contentions.load();
+  return stats;
+}
+
 PYBIND11_MODULE(triton_shm_monitor, m)
 {
   py::class_<SharedMemoryManager>(m, "SharedMemoryManager")
       .def(py::init<const std::string&>())
-      .def("free_memory", &SharedMemoryManager::FreeMemory);
+      .def("free_memory", &SharedMemoryManager::FreeMemory)
+      .def("fragmentation", &SharedMemoryManager::Fragmentation)
+      .def("allocator_stats", &AllocatorStats);
 }
 
 }}}  // namespace triton::backend::python
@@ -25,14 +25,102 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "stub_launcher.h"
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <cctype>
+#include <fstream>
 #include "python_be.h"
 
+#ifdef TRITON_ENABLE_GPU
+#include <cuda_runtime_api.h>
+#endif  // TRITON_ENABLE_GPU
+
 namespace triton { namespace backend { namespace python {
 
+namespace {
+
+// Read the first line of a sysfs file. Empty if the file can't be read.
+std::string
+ReadSysfsFile(const std::string& path)
+{
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+// The NUMA node of 'cpu', or -1 if it is unknown.
+int32_t
+NumaNodeOfCpu(int cpu)
+{
+  DIR* nodes = opendir("/sys/devices/system/node");
+  if (nodes == nullptr) {
+    return -1;
+  }
+
+  int32_t numa_node = -1;
+  while (dirent* entry = readdir(nodes)) {
+    std::string name = entry->d_name;
+    if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+        name.find_first_not_of("0123456789", 4) != std::string::npos) {
+      continue;
+    }
+    cpu_set_t node_cpus;
+    if (ParseCpuList(
+            ReadSysfsFile("/sys/devices/system/node/" + name + "/cpulist"),
+            &node_cpus) &&
+        CPU_ISSET(cpu, &node_cpus)) {
+      numa_node = std::stoi(name.substr(4));
+      break;
+    }
+  }
+  closedir(nodes);
+
+  return numa_node;
+}
+
+// The CPUs that are local to the PCIe root of a GPU, and its NUMA node.
+// Empty if the locality of the device is unknown.
+std::string
+DeviceLocalCpuList(int32_t device_id, int32_t* numa_node)
+{
+  *numa_node = -1;
+#ifdef TRITON_ENABLE_GPU
+  char pci_bus_id[32];
+  if (cudaDeviceGetPCIBusId(pci_bus_id, sizeof(pci_bus_id), device_id) !=
+      cudaSuccess) {
+    cudaGetLastError();
+    return "";
+  }
+
+  // The PCI devices in sysfs are named with lower case hexadecimal digits.
+  std::string device_path = "/sys/bus/pci/devices/";
+  for (const char* c = pci_bus_id; *c != '\0'; c++) {
+    device_path += std::tolower(*c);
+  }
+  try {
+    *numa_node = std::stoi(ReadSysfsFile(device_path + "/numa_node"));
+  }
+  catch (const std::logic_error& le) {
+    *numa_node = -1;
+  }
+  return ReadSysfsFile(device_path + "/local_cpulist");
+#else
+  return "";
+#endif  // TRITON_ENABLE_GPU
+}
+
+}  // namespace
+
 StubLauncher::StubLauncher(const std::string stub_process_kind)
-    : parent_pid_(0), stub_pid_(0), is_initialized_(false),
-      stub_process_kind_(stub_process_kind), model_instance_name_(""),
-      device_id_(0), kind_("")
+    : parent_pid_(0), stub_pid_(0), is_initialized_(false), is_forked_(false),
+      is_healthy_(false), stub_process_kind_(stub_process_kind),
+      model_instance_name_(""), device_id_(0), kind_(""), stub_pidfd_(-1),
+      stub_exited_(true), fork_server_(nullptr),
+      neuron_core_allocator_(nullptr), neuron_core_start_(0),
+      neuron_core_count_(0)
 
 {
 }
@@ -40,13 +128,40 @@ StubLauncher::StubLauncher(const std::string stub_process_kind)
 StubLauncher::StubLauncher(
     const std::string stub_process_kind, const std::string model_instance_name,
     const int32_t device_id, const std::string kind)
-    : parent_pid_(0), stub_pid_(0), is_initialized_(false),
-      stub_process_kind_(stub_process_kind),
+    : parent_pid_(0), stub_pid_(0), is_initialized_(false), is_forked_(false),
+      is_healthy_(false), stub_process_kind_(stub_process_kind),
       model_instance_name_(model_instance_name), device_id_(device_id),
-      kind_(kind)
+      kind_(kind), stub_pidfd_(-1), stub_exited_(true), fork_server_(nullptr),
+      neuron_core_allocator_(nullptr), neuron_core_start_(0),
+      neuron_core_count_(0)
 {
 }
 
+void
+StubLaunchLimiter::Acquire()
+{
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this] { return available_ > 0; });
+  available_--;
+}
+
+void
+StubLaunchLimiter::Release()
+{
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    available_++;
+  }
+  cv_.notify_one();
+}
+
+StubLauncher::~StubLauncher()
+{
+  if (neuron_core_count_ > 0) {
+    neuron_core_allocator_->Release(neuron_core_start_, neuron_core_count_);
+  }
+}
+
 TRITONSERVER_Error*
 StubLauncher::Initialize(ModelState* model_state)
 {
@@ -56,11 +171,22 @@ StubLauncher::Initialize(ModelState* model_state)
   shm_growth_byte_size_ = model_state->StateForBackend()->shm_growth_byte_size;
   shm_message_queue_size_ =
       model_state->StateForBackend()->shm_message_queue_size;
+  ipc_spin_wait_microseconds_ =
+      model_state->StateForBackend()->ipc_spin_wait_microseconds;
+  shm_hugepages_ = model_state->StateForBackend()->shm_hugepages;
+  shm_prefault_ = model_state->StateForBackend()->shm_prefault;
+  shm_growth_watermark_byte_size_ =
+      model_state->StateForBackend()->shm_growth_watermark_byte_size;
+  cuda_shared_pool_byte_size_ =
+      model_state->StateForBackend()->cuda_shared_pool_byte_size;
   python_execution_env_ = model_state->PythonExecutionEnv();
   python_lib_ = model_state->StateForBackend()->python_lib;
   model_state->ModelConfig().Write(&model_config_buffer_);
   is_decoupled_ = model_state->IsDecoupled();
+  fused_batch_ = model_state->FusedBatch();
+  decoupled_send_window_ = model_state->DecoupledSendWindow();
   model_repository_path_ = model_state->RepositoryPath();
+  shared_weight_file_list_ = model_state->SharedWeightFileList();
 
   // Atomically increase and read the stub process count to avoid shared memory
   // region name collision
@@ -120,8 +246,135 @@ StubLauncher::Initialize(ModelState* model_state)
     }
   }
 
+  if (stub_process_kind_ == "MODEL_INSTANCE_STUB" &&
+      model_state->NeuronCoresPerInstance() > 0) {
+    NeuronCoreAllocator* allocator =
+        model_state->StateForBackend()->neuron_core_allocator.get();
+    int64_t core_count = model_state->NeuronCoresPerInstance();
+    if (core_count > allocator->CoreCount() ||
+        !allocator->Allocate(core_count, &neuron_core_start_)) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_UNAVAILABLE,
+          (std::string("Unable to allocate ") + std::to_string(core_count) +
+           " free NeuronCores to '" + model_instance_name_ + "' out of " +
+           std::to_string(allocator->CoreCount()) + " NeuronCores.")
+              .c_str());
+    }
+    neuron_core_allocator_ = allocator;
+    neuron_core_count_ = core_count;
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_INFO,
+        (std::string("Allocated NeuronCores ") +
+         NeuronCoreAllocator::CoreRange(
+             neuron_core_start_, neuron_core_count_) +
+         " to '" + model_instance_name_ + "'")
+            .c_str());
+  }
+
+  has_cpu_set_ = false;
+  numa_node_ = -1;
+  if (stub_process_kind_ == "MODEL_INSTANCE_STUB") {
+    RETURN_IF_ERROR(InitializePlacement(model_state->StubCpuAffinity()));
+  }
+
+  if (stub_process_kind_ == "MODEL_INSTANCE_STUB" &&
+      model_state->SequenceStateByteSize() > 0) {
+    try {
+      sequence_state_store_ = SequenceStateStore::Create(
+          shm_region_name_ + "_sequence_state",
+          model_state->SequenceStateByteSize(),
+          model_state->SequenceStateMaxEntries());
+    }
+    catch (const PythonBackendException& pb_exception) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+    }
+  }
+
   parent_pid_ = getpid();
 
+  if (stub_process_kind_ == "MODEL_INSTANCE_STUB" &&
+      model_state->UsesForkServer()) {
+    RETURN_IF_ERROR(model_state->GetForkServer(&fork_server_));
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubLauncher::InitializePlacement(const std::string& cpu_affinity)
+{
+  // The parameter is a CPU list for all the instances, or a list of
+  // 'instance_name=cpu_list' entries separated by ';'. An entry without an
+  // instance name applies to the instances that don't have an entry.
+  std::string default_cpu_list;
+  std::string instance_cpu_list;
+  std::stringstream entries(cpu_affinity);
+  std::string entry;
+  while (std::getline(entries, entry, ';')) {
+    size_t separator = entry.find('=');
+    if (separator == std::string::npos) {
+      default_cpu_list = entry;
+    } else if (entry.substr(0, separator) == model_instance_name_) {
+      instance_cpu_list = entry.substr(separator + 1);
+    }
+  }
+  std::string cpu_list =
+      instance_cpu_list.empty() ? default_cpu_list : instance_cpu_list;
+
+  if (cpu_list == "none") {
+    return nullptr;
+  } else if (!cpu_list.empty()) {
+    if (!ParseCpuList(cpu_list, &cpu_set_)) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INVALID_ARG,
+          (std::string("Incorrect CPU list in STUB_CPU_AFFINITY for '") +
+           model_instance_name_ + "': '" + cpu_list + "'")
+              .c_str());
+    }
+    int first_cpu = 0;
+    while (!CPU_ISSET(first_cpu, &cpu_set_)) {
+      first_cpu++;
+    }
+    numa_node_ = NumaNodeOfCpu(first_cpu);
+  } else if (kind_ == "KIND_GPU") {
+    cpu_list = DeviceLocalCpuList(device_id_, &numa_node_);
+    if (!ParseCpuList(cpu_list, &cpu_set_)) {
+      numa_node_ = -1;
+      return nullptr;
+    }
+  } else {
+    return nullptr;
+  }
+
+  // The CPUs outside of the affinity of Triton, such as the CPUs of other
+  // containers, can't be used by the stub process either.
+  cpu_set_t allowed_cpus;
+  if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) == 0) {
+    CPU_AND(&allowed_cpus, &allowed_cpus, &cpu_set_);
+    if (CPU_COUNT(&allowed_cpus) == 0) {
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_WARN,
+          (std::string("None of the CPUs '") + cpu_list + "' of '" +
+           model_instance_name_ +
+           "' can be used by Triton, the stub process is not pinned.")
+              .c_str());
+      numa_node_ = -1;
+      return nullptr;
+    }
+  }
+
+  has_cpu_set_ = true;
+  cpu_list_ = cpu_list;
+  LOG_MESSAGE(
+      TRITONSERVER_LOG_VERBOSE,
+      (std::string("Running the stub process of '") + model_instance_name_ +
+       "' on CPUs '" + cpu_list_ + "'" +
+       (numa_node_ >= 0 ? " with its shared memory on NUMA node " +
+                              std::to_string(numa_node_)
+                        : std::string()))
+          .c_str());
+
   return nullptr;
 }
 
@@ -141,7 +394,8 @@ StubLauncher::Setup()
     shm_pool_ = nullptr;
     shm_pool_ = std::make_unique<SharedMemoryManager>(
         shm_region_name_, shm_default_byte_size_, shm_growth_byte_size_,
-        true /* create */);
+        true /* create */, shm_hugepages_, shm_prefault_,
+        shm_growth_watermark_byte_size_, numa_node_);
   }
   catch (const PythonBackendException& pb_exception) {
     return TRITONSERVER_ErrorNew(
@@ -153,14 +407,16 @@ StubLauncher::Setup()
   ipc_control_ = std::move(current_ipc_control.data_);
   ipc_control_handle_ = current_ipc_control.handle_;
 
+  // The parent<->stub channels are on the critical path of every execute
+  // and have a single consumer, so they use the lock-free ring.
   RETURN_IF_EXCEPTION(
       stub_message_queue_ =
           MessageQueue<bi::managed_external_buffer::handle_t>::Create(
-              shm_pool_, shm_message_queue_size_));
+              shm_pool_, shm_message_queue_size_, true /* spsc */));
   RETURN_IF_EXCEPTION(
       parent_message_queue_ =
           MessageQueue<bi::managed_external_buffer::handle_t>::Create(
-              shm_pool_, shm_message_queue_size_));
+              shm_pool_, shm_message_queue_size_, true /* spsc */));
   RETURN_IF_EXCEPTION(
       log_message_queue_ =
           MessageQueue<bi::managed_external_buffer::handle_t>::Create(
@@ -174,7 +430,15 @@ StubLauncher::Setup()
   memory_manager_message_queue->ResetSemaphores();
   ipc_control_->memory_manager_message_queue =
       memory_manager_message_queue->ShmHandle();
+  ipc_control_->stub_heartbeat = 0;
+  ipc_control_->gil_held_ns = 0;
+  ipc_control_->gil_wait_ns = 0;
+  ipc_control_->bls_exec_ns = 0;
+  ipc_control_->gc_pause_ns = 0;
   ipc_control_->decoupled = is_decoupled_;
+  ipc_control_->fused_batch = fused_batch_;
+  ipc_control_->decoupled_send_window = decoupled_send_window_;
+  ipc_control_->fork_server = (stub_process_kind_ == "FORK_SERVER_STUB");
 
   memory_manager_ =
       std::make_unique<MemoryManager>(std::move(memory_manager_message_queue));
@@ -182,13 +446,13 @@ StubLauncher::Setup()
   ipc_control_->log_message_queue = log_message_queue_->ShmHandle();
   ipc_control_->stub_message_queue = stub_message_queue_->ShmHandle();
 
-  new (&(ipc_control_->stub_health_mutex)) bi::interprocess_mutex;
-  health_mutex_ = &(ipc_control_->stub_health_mutex);
-
   stub_message_queue_->ResetSemaphores();
   parent_message_queue_->ResetSemaphores();
   log_message_queue_->ResetSemaphores();
 
+  stub_message_queue_->SetSpinWait(ipc_spin_wait_microseconds_);
+  parent_message_queue_->SetSpinWait(ipc_spin_wait_microseconds_);
+
   is_initialized_ = false;
 
   return nullptr;
@@ -198,12 +462,44 @@ TRITONSERVER_Error*
 StubLauncher::Launch()
 {
   std::string stub_name;
-  if (stub_process_kind_ == "AUTOCOMPLETE_STUB") {
+  if (stub_process_kind_ == "AUTOCOMPLETE_STUB" ||
+      stub_process_kind_ == "FORK_SERVER_STUB") {
     stub_name = model_name_;
   } else {
     stub_name = model_instance_name_;
   }
 
+  is_forked_ = false;
+  if (fork_server_ != nullptr) {
+    std::unordered_map<std::string, std::string> fork_map = {
+        {"shm_region_name", shm_region_name_},
+        {"shm_default_byte_size", std::to_string(shm_default_byte_size_)},
+        {"shm_growth_byte_size", std::to_string(shm_growth_byte_size_)},
+        {"ipc_control_handle", std::to_string(ipc_control_handle_)},
+        {"name", stub_name}};
+    if (has_cpu_set_) {
+      fork_map["cpu_affinity"] = cpu_list_;
+    }
+
+    // The fork server has already reverted the LD_LIBRARY_PATH changes of the
+    // execution environment.
+    ipc_control_->uses_env = false;
+    pid_t pid;
+    TRITONSERVER_Error* err = fork_server_->ForkStub(fork_map, &pid);
+    if (err == nullptr) {
+      is_forked_ = true;
+      return ConnectStubProcess(pid);
+    }
+
+    LOG_MESSAGE(
+        TRITONSERVER_LOG_WARN,
+        (std::string("Failed to fork the stub process of ") + stub_name +
+         " from the fork server, starting a new stub process: " +
+         TRITONSERVER_ErrorMessage(err))
+            .c_str());
+    TRITONSERVER_ErrorDelete(err);
+  }
+
   const char* stub_args[4];
   stub_args[0] = "bash";
   stub_args[1] = "-c";
@@ -223,6 +519,16 @@ StubLauncher::Launch()
 
   std::string bash_argument;
 
+  // The Neuron runtime of the stub process only uses the NeuronCores of the
+  // model instance.
+  std::string neuron_env;
+  if (neuron_core_count_ > 0) {
+    neuron_env = "NEURON_RT_VISIBLE_CORES=" +
+                 NeuronCoreAllocator::CoreRange(
+                     neuron_core_start_, neuron_core_count_) +
+                 " ";
+  }
+
   // This shared memory variable indicates whether the stub process should
   // revert the LD_LIBRARY_PATH changes to avoid shared library issues in
   // executables and libraries.
@@ -233,7 +539,8 @@ StubLauncher::Launch()
     // Need to properly set the LD_LIBRARY_PATH so that Python environments
     // using different python versions load properly.
     ss << "source " << path_to_activate_
-        << " && exec env LD_LIBRARY_PATH=" << path_to_libpython_
+        << " && exec env " << neuron_env
+        << "LD_LIBRARY_PATH=" << path_to_libpython_
         << ":$LD_LIBRARY_PATH " << python_backend_stub << " " << model_path_
         << " " << shm_region_name_ << " " << shm_default_byte_size_ << " "
         << shm_growth_byte_size_ << " " << parent_pid_ << " " << python_lib_
@@ -242,7 +549,8 @@ StubLauncher::Launch()
     bash_argument = ss.str();
   } else {
     std::stringstream ss;
-    ss << " exec " << python_backend_stub << " " << model_path_ << " "
+    ss << " exec " << (neuron_env.empty() ? "" : "env " + neuron_env)
+        << python_backend_stub << " " << model_path_ << " "
         << shm_region_name_ << " " << shm_default_byte_size_ << " "
         << shm_growth_byte_size_ << " " << parent_pid_ << " " << python_lib_
         << " " << ipc_control_handle_ << " " << stub_name;
@@ -282,6 +590,10 @@ StubLauncher::Launch()
         "Failed to fork the stub process for auto-complete.");
   }
   if (pid == 0) {
+    // The affinity is inherited by the stub process and its threads.
+    if (has_cpu_set_) {
+      sched_setaffinity(0, sizeof(cpu_set_), &cpu_set_);
+    }
     // Replace this child process with the new stub process.
     execvp("bash", (char**)stub_args);
     // execvp() never return if succeeded. Otherwise, an error has occured.
@@ -296,53 +608,115 @@ StubLauncher::Launch()
     std::cerr << '\n' << ss.str() << '\n';
     // Terminate the child execution immediately to avoid any issues.
     _Exit(1);
-  } else {
-    ScopedDefer _([&] {
-      // Push a dummy message to the message queue so that the stub
-      // process is notified that it can release the object stored in
-      // shared memory.
-      stub_message_queue_->Push(DUMMY_MESSAGE);
-
-      // If the model is not initialized, wait for the stub process to exit.
-      if (!is_initialized_) {
-        int status;
-        stub_message_queue_.reset();
-        parent_message_queue_.reset();
-        memory_manager_.reset();
-        waitpid(stub_pid_, &status, 0);
-      }
-    });
+  }
 
-    stub_pid_ = pid;
+  return ConnectStubProcess(pid);
+}
 
-    if (stub_process_kind_ == "AUTOCOMPLETE_STUB") {
-      try {
-        AutocompleteStubProcess();
-      }
-      catch (const PythonBackendException& ex) {
-        // Need to kill the stub process first
-        kill(stub_pid_, SIGKILL);
-        int status;
-        waitpid(stub_pid_, &status, 0);
-        stub_pid_ = 0;
-        throw BackendModelException(
-            TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, ex.what()));
-      }
-    } else if (stub_process_kind_ == "MODEL_INSTANCE_STUB") {
-      RETURN_IF_ERROR(ModelInstanceStubProcess());
-    } else {
-      return TRITONSERVER_ErrorNew(
-          TRITONSERVER_ERROR_INTERNAL,
-          (std::string("Unknown stub_process_kind: ") + stub_process_kind_)
-              .c_str());
+TRITONSERVER_Error*
+StubLauncher::ConnectStubProcess(pid_t stub_pid)
+{
+  ScopedDefer _([&] {
+    // Push a dummy message to the message queue so that the stub
+    // process is notified that it can release the object stored in
+    // shared memory.
+    stub_message_queue_->Push(DUMMY_MESSAGE);
+
+    // If the model is not initialized, wait for the stub process to exit.
+    if (!is_initialized_) {
+      stub_message_queue_.reset();
+      parent_message_queue_.reset();
+      memory_manager_.reset();
+      WaitForStubExit();
     }
+  });
+
+  CloseStubPidfd();
+  stub_pid_ = stub_pid;
+  stub_exited_ = false;
+#ifdef SYS_pidfd_open
+  // The pidfd becomes readable when the stub process exits, which is also
+  // the case for the forked stubs that are not children of this process.
+  stub_pidfd_ = syscall(SYS_pidfd_open, stub_pid_, 0);
+#endif
+  last_heartbeat_ = 0;
+  last_heartbeat_time_ = std::chrono::steady_clock::now();
 
-    is_initialized_ = true;
+  if (stub_process_kind_ == "AUTOCOMPLETE_STUB") {
+    try {
+      AutocompleteStubProcess();
+    }
+    catch (const PythonBackendException& ex) {
+      // Need to kill the stub process first
+      KillStubProcess();
+      throw BackendModelException(
+          TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, ex.what()));
+    }
+  } else if (stub_process_kind_ == "MODEL_INSTANCE_STUB") {
+    RETURN_IF_ERROR(ModelInstanceStubProcess());
+  } else if (stub_process_kind_ == "FORK_SERVER_STUB") {
+    RETURN_IF_ERROR(ForkServerStubProcess());
+  } else {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("Unknown stub_process_kind: ") + stub_process_kind_)
+            .c_str());
   }
 
+  is_initialized_ = true;
+
   return nullptr;
 }
 
+void
+StubLauncher::WaitForStubExit()
+{
+  if (stub_exited_) {
+    // The stub process has already been reaped.
+  } else if (is_forked_ && stub_pidfd_ != -1) {
+    struct pollfd stub_pollfd = {stub_pidfd_, POLLIN, 0};
+    poll(&stub_pollfd, 1, -1 /* timeout */);
+  } else if (is_forked_) {
+    // The fork server lets the kernel reap the forked stubs, so the process
+    // is gone once it has exited.
+    while (kill(stub_pid_, 0) == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  } else {
+    int status;
+    waitpid(stub_pid_, &status, 0);
+  }
+  stub_exited_ = true;
+  CloseStubPidfd();
+}
+
+bool
+StubLauncher::StubProcessExited()
+{
+  if (!stub_exited_ && stub_pidfd_ != -1) {
+    struct pollfd stub_pollfd = {stub_pidfd_, POLLIN, 0};
+    return poll(&stub_pollfd, 1, 0 /* timeout */) > 0;
+  }
+
+  if (!stub_exited_ && is_forked_) {
+    stub_exited_ = (kill(stub_pid_, 0) != 0);
+  } else if (!stub_exited_) {
+    int status;
+    stub_exited_ = (waitpid(stub_pid_, &status, WNOHANG) == stub_pid_);
+  }
+
+  return stub_exited_;
+}
+
+void
+StubLauncher::CloseStubPidfd()
+{
+  if (stub_pidfd_ != -1) {
+    close(stub_pidfd_);
+    stub_pidfd_ = -1;
+  }
+}
+
 void
 StubLauncher::AutocompleteStubProcess()
 {
@@ -411,6 +785,41 @@ StubLauncher::ModelInstanceStubProcess()
       {"model_version", std::to_string(model_version_)},
       {"model_name", model_name_}};
 
+#ifdef TRITON_ENABLE_GPU
+  // The GPU instances open the CUDA shared pool of their device once so that
+  // the tensors allocated from it don't need a CUDA IPC handle each.
+  if (kind_ == "KIND_GPU" && cuda_shared_pool_byte_size_ > 0) {
+    try {
+      std::shared_ptr<CudaSharedPool> cuda_pool = CudaSharedPool::GetOrCreate(
+          device_id_, cuda_shared_pool_byte_size_);
+      initialize_map["cuda_shared_pool_handle"] = cuda_pool->IpcHandleString();
+      initialize_map["cuda_shared_pool_byte_size"] =
+          std::to_string(cuda_pool->ByteSize());
+    }
+    catch (const PythonBackendException& pb_exception) {
+      LOG_MESSAGE(
+          TRITONSERVER_LOG_WARN,
+          (std::string("Failed to create the CUDA shared pool of device ") +
+           std::to_string(device_id_) + ": " + pb_exception.what())
+              .c_str());
+    }
+  }
+#endif  // TRITON_ENABLE_GPU
+
+  if (neuron_core_count_ > 0) {
+    initialize_map["neuron_core_range"] = NeuronCoreAllocator::CoreRange(
+        neuron_core_start_, neuron_core_count_);
+  }
+
+  if (sequence_state_store_ != nullptr) {
+    initialize_map["sequence_state_region_name"] =
+        sequence_state_store_->RegionName();
+  }
+
+  if (!shared_weight_file_list_.empty()) {
+    initialize_map["shared_weight_files"] = shared_weight_file_list_;
+  }
+
   std::unique_ptr<IPCMessage> initialize_message =
       IPCMessage::Create(shm_pool_, false /* inline_response */);
   initialize_message->Command() = PYTHONSTUB_InitializeRequest;
@@ -456,25 +865,173 @@ StubLauncher::ModelInstanceStubProcess()
   return nullptr;
 }
 
-void
-StubLauncher::UpdateHealth()
+TRITONSERVER_Error*
+StubLauncher::ForkServerStubProcess()
 {
-  is_healthy_ = false;
-  if (is_initialized_) {
-    {
-      bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
-      ipc_control_->stub_health = false;
+  // The fork server imports the model and reports back without any request.
+  std::unique_ptr<IPCMessage> ready_message =
+      IPCMessage::LoadFromSharedMemory(shm_pool_, parent_message_queue_->Pop());
+
+  if (ready_message->Command() != PYTHONSTUB_InitializeResponse) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string(
+             "Received unexpected response from Python backend stub: ") +
+         model_name_)
+            .c_str());
+  }
+
+  auto ready_response =
+      std::move(
+          (shm_pool_->Load<InitializeResponseShm>(ready_message->Args())))
+          .data_;
+
+  if (ready_response->response_has_error) {
+    if (ready_response->response_is_error_set) {
+      std::unique_ptr<PbString> error_message = PbString::LoadFromSharedMemory(
+          shm_pool_, ready_response->response_error);
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL, error_message->String().c_str());
+    } else {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string("Launch stub fork server failed for ") + model_name_)
+              .c_str());
     }
+  }
 
-    // Sleep 1 second so that the child process has a chance to change the
-    // health variable
-    sleep(1);
+  return nullptr;
+}
 
-    {
-      bi::scoped_lock<bi::interprocess_mutex> lock(*health_mutex_);
-      is_healthy_ = ipc_control_->stub_health;
+TRITONSERVER_Error*
+StubLauncher::ForkStub(
+    const std::unordered_map<std::string, std::string>& fork_map,
+    pid_t* stub_pid)
+{
+  std::lock_guard<std::mutex> lock(fork_mu_);
+  if (!is_initialized_) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNAVAILABLE,
+        (std::string("The stub fork server of ") + model_name_ +
+         " is not running.")
+            .c_str());
+  }
+
+  try {
+    std::unique_ptr<IPCMessage> fork_message =
+        IPCMessage::Create(shm_pool_, false /* inline_response */);
+    fork_message->Command() = PYTHONSTUB_ForkRequest;
+
+    std::unique_ptr<PbMap> pb_map = PbMap::Create(shm_pool_, fork_map);
+    fork_message->Args() = pb_map->ShmHandle();
+    stub_message_queue_->Push(fork_message->ShmHandle());
+
+    bi::managed_external_buffer::handle_t response_handle;
+    bool success = false;
+    while (!success) {
+      response_handle = parent_message_queue_->Pop(1000, success);
+      if (!success && StubProcessExited()) {
+        is_initialized_ = false;
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_UNAVAILABLE,
+            (std::string("The stub fork server of ") + model_name_ +
+             " has exited.")
+                .c_str());
+      }
     }
+
+    // Let the fork server release the response once it has been read.
+    ScopedDefer _([this] { stub_message_queue_->Push(DUMMY_MESSAGE); });
+
+    std::unique_ptr<IPCMessage> fork_response_message =
+        IPCMessage::LoadFromSharedMemory(shm_pool_, response_handle);
+    if (fork_response_message->Command() != PYTHONSTUB_ForkResponse) {
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL,
+          (std::string("Received unexpected response from the stub fork "
+                       "server: ") +
+           model_name_)
+              .c_str());
+    }
+
+    AllocatedSharedMemory<ForkResponseShm> fork_response =
+        shm_pool_->Load<ForkResponseShm>(fork_response_message->Args());
+    if (fork_response.data_->response_has_error) {
+      std::string error_message = "Failed to fork the stub process.";
+      if (fork_response.data_->response_is_error_set) {
+        error_message = PbString::LoadFromSharedMemory(
+                            shm_pool_, fork_response.data_->response_error)
+                            ->String();
+      }
+      return TRITONSERVER_ErrorNew(
+          TRITONSERVER_ERROR_INTERNAL, error_message.c_str());
+    }
+
+    *stub_pid = fork_response.data_->pid;
+  }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+  }
+
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+StubLauncher::AutoCompleteInForkServer()
+{
+  std::lock_guard<std::mutex> lock(fork_mu_);
+  if (!is_initialized_) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNAVAILABLE,
+        (std::string("The stub fork server of ") + model_name_ +
+         " is not running.")
+            .c_str());
+  }
+
+  // Let the fork server release the response once it has been read.
+  ScopedDefer _([this] { stub_message_queue_->Push(DUMMY_MESSAGE); });
+  try {
+    AutocompleteStubProcess();
   }
+  catch (const PythonBackendException& pb_exception) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL, pb_exception.what());
+  }
+
+  return nullptr;
+}
+
+void
+StubLauncher::UpdateHealth()
+{
+  is_healthy_ = is_initialized_ && IsStubAlive();
+}
+
+bool
+StubLauncher::IsStubAlive()
+{
+  if (StubProcessExited()) {
+    return false;
+  }
+
+  // The fork server doesn't run the health thread of the stub, so it is
+  // healthy as long as it is running.
+  if (stub_process_kind_ == "FORK_SERVER_STUB") {
+    return true;
+  }
+
+  // The stub process is stuck if the heartbeat counter hasn't changed for a
+  // second since it was last seen changing.
+  std::lock_guard<std::mutex> lock(heartbeat_mu_);
+  uint64_t heartbeat = ipc_control_->stub_heartbeat.load();
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (heartbeat != last_heartbeat_) {
+    last_heartbeat_ = heartbeat;
+    last_heartbeat_time_ = now;
+  }
+
+  return (now - last_heartbeat_time_) < std::chrono::seconds(1);
 }
 
 void
@@ -498,11 +1055,10 @@ StubLauncher::TerminateStub()
       force_kill = true;
     }
 
-    int status;
-    if (force_kill) {
+    if (force_kill && !stub_exited_) {
       kill(stub_pid_, SIGKILL);
     }
-    waitpid(stub_pid_, &status, 0);
+    WaitForStubExit();
   }
 
   // First destroy the IPCControl. This makes sure that IPCControl is
@@ -522,9 +1078,10 @@ StubLauncher::ClearLogQueue()
 void
 StubLauncher::KillStubProcess()
 {
-  kill(stub_pid_, SIGKILL);
-  int status;
-  waitpid(stub_pid_, &status, 0);
+  if (!stub_exited_) {
+    kill(stub_pid_, SIGKILL);
+  }
+  WaitForStubExit();
   stub_pid_ = 0;
 }
 
@@ -36,14 +36,20 @@
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/thread/thread_time.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <future>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "ipc_message.h"
 #include "memory_manager.h"
 #include "message_queue.h"
+#include "neuron_cores.h"
 #include "pb_utils.h"
+#include "sequence_state.h"
 #include "triton/backend/backend_common.h"
 #include "triton/backend/backend_model.h"
 #include "triton/backend/backend_model_instance.h"
@@ -54,6 +60,24 @@ namespace triton { namespace backend { namespace python {
 
 class ModelState;
 
+// Bounds the number of stub processes that are launched at the same time when
+// Triton initializes the instances of the models in parallel.
+class StubLaunchLimiter {
+ public:
+  StubLaunchLimiter(int64_t max_launches) : available_(max_launches) {}
+
+  // Wait until one more stub process can be launched.
+  void Acquire();
+
+  // Release the launch acquired by 'Acquire'.
+  void Release();
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+  int64_t available_;
+};
+
 class StubLauncher {
  public:
   StubLauncher(const std::string stub_process_kind);
@@ -62,6 +86,8 @@ class StubLauncher {
       const std::string model_instance_name, const int32_t device_id,
       const std::string kind);
 
+  ~StubLauncher();
+
   // Initialize stub process
   TRITONSERVER_Error* Initialize(ModelState* model_state);
 
@@ -77,12 +103,22 @@ class StubLauncher {
   // Model instance stub process
   TRITONSERVER_Error* ModelInstanceStubProcess();
 
+  // Fork server stub process
+  TRITONSERVER_Error* ForkServerStubProcess();
+
+  // Fork a stub process from the fork server. The stub attaches to the shared
+  // memory region described by 'fork_map'.
+  TRITONSERVER_Error* ForkStub(
+      const std::unordered_map<std::string, std::string>& fork_map,
+      pid_t* stub_pid);
+
+  // Run the auto-complete of the model in the fork server. The modules
+  // imported by the auto-complete stay loaded for the forked stubs.
+  TRITONSERVER_Error* AutoCompleteInForkServer();
+
   // Stub PID
   pid_t StubPid() { return stub_pid_; }
 
-  // Health mutex
-  bi::interprocess_mutex* HealthMutex() { return health_mutex_; }
-
   // Stub message queue
   std::unique_ptr<MessageQueue<bi::managed_external_buffer::handle_t>>&
   StubMessageQueue()
@@ -129,6 +165,10 @@ class StubLauncher {
   // Is Healthy
   bool IsHealthy() { return is_healthy_; }
 
+  // Whether the stub process is running and its heartbeat counter has changed
+  // within the last second. Does not block.
+  bool IsStubAlive();
+
   // Destruct Stub process
   void TerminateStub();
 
@@ -139,14 +179,37 @@ class StubLauncher {
   void KillStubProcess();
 
  private:
+  // Wait for the stub process to be initialized after it has been started.
+  TRITONSERVER_Error* ConnectStubProcess(pid_t stub_pid);
+
+  // Wait for the stub process to exit. The forked stubs are not children of
+  // this process, so waitpid() can't be used for them.
+  void WaitForStubExit();
+
+  // Whether the stub process has exited. Does not block.
+  bool StubProcessExited();
+
+  // Close the pidfd of the stub process.
+  void CloseStubPidfd();
+
+  // Choose the CPUs and the NUMA node of the stub process. 'cpu_affinity' is
+  // the 'STUB_CPU_AFFINITY' parameter of the model. Without a CPU list for
+  // the instance, the stub processes of the GPU instances are placed on the
+  // CPUs and the NUMA node that are local to the PCIe root of their device.
+  TRITONSERVER_Error* InitializePlacement(const std::string& cpu_affinity);
+
   pid_t parent_pid_;
   pid_t stub_pid_;
 
   bool is_initialized_;
+  bool is_forked_;
   bool is_decoupled_;
+  bool fused_batch_;
+  uint32_t decoupled_send_window_;
   bool is_healthy_;
   std::string shm_region_name_;
   std::string model_repository_path_;
+  std::string shared_weight_file_list_;
   std::string model_path_;
   const std::string stub_process_kind_;
   std::string model_name_;
@@ -159,6 +222,23 @@ class StubLauncher {
   int64_t shm_default_byte_size_;
   int64_t shm_growth_byte_size_;
   int64_t shm_message_queue_size_;
+  int64_t ipc_spin_wait_microseconds_;
+  bool shm_hugepages_;
+  bool shm_prefault_;
+  int64_t shm_growth_watermark_byte_size_;
+  int64_t cuda_shared_pool_byte_size_;
+
+  // The per-sequence states of the model instance. The store is created once
+  // so that the states are kept when the stub process is restarted.
+  std::unique_ptr<SequenceStateStore> sequence_state_store_;
+
+  // Placement of the stub process. 'has_cpu_set_' is false if the stub
+  // process runs on the CPUs of this process. 'numa_node_' is -1 if the pages
+  // of the shared memory region are placed by the kernel.
+  bool has_cpu_set_;
+  cpu_set_t cpu_set_;
+  std::string cpu_list_;
+  int32_t numa_node_;
 
   // Path to python execution environment
   std::string path_to_libpython_;
@@ -168,7 +248,12 @@ class StubLauncher {
   common::TritonJson::WriteBuffer model_config_buffer_;
   common::TritonJson::Value auto_complete_config_;
 
-  bi::interprocess_mutex* health_mutex_;
+  // pidfd of the stub process, -1 if the kernel doesn't support pidfds.
+  int stub_pidfd_;
+  bool stub_exited_;
+  std::mutex heartbeat_mu_;
+  uint64_t last_heartbeat_;
+  std::chrono::steady_clock::time_point last_heartbeat_time_;
   std::unique_ptr<MessageQueue<bi::managed_external_buffer::handle_t>>
       stub_message_queue_;
   std::unique_ptr<MessageQueue<bi::managed_external_buffer::handle_t>>
@@ -180,5 +265,16 @@ class StubLauncher {
       ipc_control_;
   bi::managed_external_buffer::handle_t ipc_control_handle_;
   std::unique_ptr<SharedMemoryManager> shm_pool_;
+
+  // The fork server of the model, if the stub process is forked from it.
+  StubLauncher* fork_server_;
+  // Serializes the fork requests of the model instances.
+  std::mutex fork_mu_;
+
+  // The NeuronCores allocated to the model instance. 'neuron_core_count_' is
+  // zero if the instance doesn't use NeuronCores.
+  NeuronCoreAllocator* neuron_core_allocator_;
+  uint32_t neuron_core_start_;
+  uint32_t neuron_core_count_;
 };
 }}}  // namespace triton::backend::python